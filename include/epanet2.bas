@@ -5,7 +5,7 @@ Attribute VB_Name = "Module1"
 'Declarations of functions in the EPANET PROGRAMMERs TOOLKIT
 '(EPANET2.DLL)
 
-'Last updated on 04/23/2025
+'Last updated on 10/18/2026
 
 ' These are codes used by the DLL functions
 Public Const EN_ELEVATION = 0     ' Node parameters
@@ -98,6 +98,11 @@ Public Const EN_MASSBALANCE = 4
 Public Const EN_DEFICIENTNODES = 5
 Public Const EN_DEMANDREDUCTION = 6
 Public Const EN_LEAKAGELOSS = 7
+Public Const EN_FULLSORTS = 8
+Public Const EN_LOCALSORTS = 9
+Public Const EN_PEAKSEGMENTS = 10
+Public Const EN_MERGEERROR = 11
+Public Const EN_QUALSTEPS = 12
 
 Public Const EN_NODE = 0          ' Component types
 Public Const EN_LINK = 1
@@ -113,6 +118,8 @@ Public Const EN_PATCOUNT = 3
 Public Const EN_CURVECOUNT = 4
 Public Const EN_CONTROLCOUNT = 5
 Public Const EN_RULECOUNT = 6
+Public Const EN_CONSTITCOUNT = 7
+Public Const EN_TRACECOUNT = 8
 
 Public Const EN_JUNCTION = 0      ' Node types
 Public Const EN_RESERVOIR = 1
@@ -199,6 +206,14 @@ Public Const EN_DEMANDPATTERN = 23
 Public Const EN_EMITBACKFLOW = 24
 Public Const EN_PRESS_UNITS = 25
 Public Const EN_STATUS_REPORT = 26
+Public Const EN_THREADS = 27
+Public Const EN_TRANSPORT = 28
+Public Const EN_SEGBUDGET = 29
+Public Const EN_COURANT = 30
+Public Const EN_HYDMEMORY = 31
+
+Public Const EN_LAGRANGIAN = 0      ' Transport methods
+Public Const EN_EULERIAN = 1
 
 Public Const EN_LOWLEVEL = 0      ' Control types
 Public Const EN_HILEVEL = 1
@@ -273,6 +288,10 @@ Public Const EN_R_IS_OPEN = 1     ' Rule status types
 Public Const EN_R_IS_CLOSED = 2
 Public Const EN_R_IS_ACTIVE = 3
 
+Public Const EN_SENS_ROUGHNESS = 0   ' Sensitivity parameters
+Public Const EN_SENS_DEMAND = 1
+Public Const EN_SENS_EMITTER = 2
+
 Public Const EN_STEP_REPORT = 0   ' Types of events that can cause a timestep to end
 Public Const EN_STEP_HYD = 1
 Public Const EN_STEP_WQ = 2
@@ -322,6 +341,11 @@ Public Const EN_TRUE = 1    ' boolean true
  Declare Function ENstepQ Lib "epanet2.dll" (timeLeft As Long) As Long
  Declare Function ENcloseQ Lib "epanet2.dll" () As Long
 
+'Simulation State Functions
+ Declare Function ENgetstatesize Lib "epanet2.dll" (size As Long) As Long
+ Declare Function ENsavestate Lib "epanet2.dll" (buffer As Any, ByVal size As Long) As Long
+ Declare Function ENrestorestate Lib "epanet2.dll" (buffer As Any, ByVal size As Long) As Long
+
 'Reporting Functions
  Declare Function ENwriteline Lib "epanet2.dll" (ByVal line As String) As Long
  Declare Function ENreport Lib "epanet2.dll" () As Long
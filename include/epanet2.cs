@@ -3,7 +3,7 @@ using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 
 //epanet2.cs[By Oscar Vegas]
-//Last updated on 04/23/2025
+//Last updated on 10/18/2026
 
 //Declarations of functions in the EPANET PROGRAMMERs TOOLKIT
 //(EPANET2.DLL) for use with C#
@@ -110,6 +110,11 @@ namespace EpanetCSharpLibrary
         public const int EN_DEFICIENTNODES = 5;
         public const int EN_DEMANDREDUCTION = 6;
         public const int EN_LEAKAGELOSS = 7;
+        public const int EN_FULLSORTS = 8;
+        public const int EN_LOCALSORTS = 9;
+        public const int EN_PEAKSEGMENTS = 10;
+        public const int EN_MERGEERROR = 11;
+        public const int EN_QUALSTEPS = 12;
 
         public const int EN_NODE = 0;          //Component types
         public const int EN_LINK = 1;
@@ -125,6 +130,8 @@ namespace EpanetCSharpLibrary
         public const int EN_CURVECOUNT = 4;
         public const int EN_CONTROLCOUNT = 5;
         public const int EN_RULECOUNT = 6;
+        public const int EN_CONSTITCOUNT = 7;
+        public const int EN_TRACECOUNT = 8;
 
         public const int EN_JUNCTION = 0;      //Node types
         public const int EN_RESERVOIR = 1;
@@ -203,6 +210,14 @@ namespace EpanetCSharpLibrary
         public const int EN_EMITBACKFLOW = 24;
         public const int EN_PRESS_UNITS = 25;
         public const int EN_STATUS_REPORT = 26;
+        public const int EN_THREADS = 27;
+        public const int EN_TRANSPORT = 28;
+        public const int EN_SEGBUDGET = 29;
+        public const int EN_COURANT = 30;
+        public const int EN_HYDMEMORY = 31;
+
+        public const int EN_LAGRANGIAN = 0;      //Transport methods
+        public const int EN_EULERIAN = 1;
 
         public const int EN_LOWLEVEL = 0;      //Control types
         public const int EN_HILEVEL = 1;
@@ -276,6 +291,10 @@ namespace EpanetCSharpLibrary
         public const int EN_R_IS_CLOSED = 2;
         public const int EN_R_IS_ACTIVE = 3;
 
+        public const int EN_SENS_ROUGHNESS = 0;   //Sensitivity parameters
+        public const int EN_SENS_DEMAND    = 1;
+        public const int EN_SENS_EMITTER   = 2;
+
         public const double EN_MISSING = -1.0E10;
         public const double EN_SET_CLOSED = -1.0E10
         public const double EN_SET_OPEN = 1.0E10
@@ -377,6 +396,17 @@ namespace EpanetCSharpLibrary
         public static extern int ENcloseQ();
 
 
+        //Simulation State Functions
+        [DllImport(EPANETDLL, EntryPoint = "ENgetstatesize")]
+        public static extern int ENgetstatesize(ref int size);
+
+        [DllImport(EPANETDLL, EntryPoint = "ENsavestate")]
+        public static extern int ENsavestate(byte[] buffer, int size);
+
+        [DllImport(EPANETDLL, EntryPoint = "ENrestorestate")]
+        public static extern int ENrestorestate(byte[] buffer, int size);
+
+
         //Reporting Functions
         [DllImport(EPANETDLL, EntryPoint = "ENwriteline")]
         public static extern int ENwriteline(string line);
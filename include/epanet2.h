@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/14/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
  */
 
@@ -138,6 +138,18 @@ extern "C" {
 
   int  DLLEXPORT ENcloseQ();
 
+/********************************************************************
+
+    Simulation State Functions
+
+********************************************************************/
+
+  int  DLLEXPORT ENgetstatesize(long *size);
+
+  int  DLLEXPORT ENsavestate(char *buffer, long size);
+
+  int  DLLEXPORT ENrestorestate(const char *buffer, long size);
+
 /********************************************************************
 
     Reporting Functions
@@ -3,7 +3,7 @@ unit epanet2;
 { Declarations of imported procedures from the EPANET PROGRAMMERs TOOLKIT }
 { (EPANET2.DLL) }
 
-{Last updated on 04/23/2025}
+{Last updated on 10/18/2026}
 
 interface
 
@@ -106,6 +106,11 @@ const
  EN_DEFICIENTNODES = 5;
  EN_DEMANDREDUCTION = 6;
  EN_LEAKAGELOSS     = 7;
+ EN_FULLSORTS       = 8;
+ EN_LOCALSORTS      = 9;
+ EN_PEAKSEGMENTS    = 10;
+ EN_MERGEERROR      = 11;
+ EN_QUALSTEPS       = 12;
 
  EN_NODE    = 0;        { Component Types }
  EN_LINK    = 1;
@@ -121,6 +126,8 @@ const
  EN_CURVECOUNT   = 4;
  EN_CONTROLCOUNT = 5;
  EN_RULECOUNT    = 6;
+ EN_CONSTITCOUNT = 7;
+ EN_TRACECOUNT   = 8;
   
  EN_JUNCTION   = 0;   { Node types }
  EN_RESERVOIR  = 1;
@@ -207,6 +214,14 @@ const
  EN_EMITBACKFLOW  = 24;
  EN_PRESS_UNITS   = 25;
  EN_STATUS_REPORT = 26;
+ EN_THREADS       = 27;
+ EN_TRANSPORT     = 28;
+ EN_SEGBUDGET     = 29;
+ EN_COURANT       = 30;
+ EN_HYDMEMORY     = 31;
+
+ EN_LAGRANGIAN = 0;   { Transport methods }
+ EN_EULERIAN   = 1;
 
  EN_LOWLEVEL   = 0;   { Control types }
  EN_HILEVEL    = 1;
@@ -281,6 +296,10 @@ const
  EN_R_IS_CLOSED = 2;
  EN_R_IS_ACTIVE = 3;
  
+ EN_SENS_ROUGHNESS = 0;   { Sensitivity parameters }
+ EN_SENS_DEMAND    = 1;
+ EN_SENS_EMITTER   = 2;
+ 
  EN_FALSE       = 0;   { boolean false }
  EN_TRUE        = 1;   { boolean true }
 
@@ -342,6 +361,11 @@ const
  function  ENstepQ(var Tleft: TimeType): Integer; cdecl; external EpanetLib;
  function  ENcloseQ: Integer; cdecl; external EpanetLib;
 
+{Simulation State Functions}
+ function  ENgetstatesize(var Size: Integer): Integer; cdecl; external EpanetLib;
+ function  ENsavestate(Buffer: Pointer; Size: Integer): Integer; cdecl; external EpanetLib;
+ function  ENrestorestate(Buffer: Pointer; Size: Integer): Integer; cdecl; external EpanetLib;
+
 {Reporting Functions}
  function  ENwriteline(S: PAnsiChar): Integer; cdecl; external EpanetLib;
  function  ENreport: Integer; cdecl; external EpanetLib;
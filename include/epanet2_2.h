@@ -11,7 +11,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 04/25/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
  */
 
@@ -142,6 +142,242 @@ typedef struct Project *EN_Project;
   int DLLEXPORT EN_openX(EN_Project ph, const char *inpFile, const char *rptFile,
                 const char *outFile);
 
+  /**
+  @brief Makes a project a copy of another open project.
+  @param ph an EPANET project handle of an open project.
+  @param clone the handle of a project (created with ::EN_createproject) that becomes a copy of ph.
+  @param rptFile the name of a report file to be created for the clone (or NULL if no report
+  is to be written).
+  @param outFile the name of a binary output file to be created for the clone (or "" if not needed).
+  @return an error code.
+
+  The clone receives the network data and analysis options of project ph without reading
+  an input file. Network data are shared by the two projects until one of them changes
+  them, at which point that project makes its own copy of the data it changes. This makes
+  cloning a fast way of running many variations of the same network, including from
+  different threads, as long as each project is only used by one thread at a time.
+
+  Any data already held by the clone are discarded. Computed results are not copied.
+  */
+  int DLLEXPORT EN_cloneproject(EN_Project ph, EN_Project clone, const char *rptFile,
+                const char *outFile);
+
+  /**
+  @brief Runs a batch of scenarios that modify an open project.
+  @param ph an EPANET project handle of an open project.
+  @param scnFile the name of a file listing the changes made by each scenario.
+  @param sumFile the name of a summary file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to run the scenarios (or 0 for one per processor).
+  @return an error code.
+
+  Each line of the scenario file assigns a new value to a property of the project's network
+  for a named scenario:
+  @code
+  scenario  NODE    nodeID  ELEV | DEMAND | PATTERN | EMITTER | QUAL | LEVEL  value
+  scenario  LINK    linkID  DIAMETER | LENGTH | ROUGHNESS | STATUS | SETTING  value
+  scenario  OPTION  DEMAND | DURATION  value
+  @endcode
+  Values are in the project's units, a PATTERN value is a time pattern ID, a STATUS value is
+  OPEN or CLOSED, the DEMAND option is the global demand multiplier and DURATION is in hours.
+
+  Each scenario is run as a hydraulic analysis on a clone of the project (see ::EN_cloneproject),
+  with several scenarios being run at once. As each scenario completes, a line is written to the
+  summary file with its error or warning code, the lowest junction pressure along with the
+  junction and time at which it occurs, and the highest link velocity and the link where it occurs.
+  The project itself is not changed.
+  */
+  int DLLEXPORT EN_runbatch(EN_Project ph, const char *scnFile, const char *sumFile,
+                int nThreads);
+
+  /**
+  @brief Runs a Monte Carlo analysis of demand and roughness uncertainty.
+  @param ph an EPANET project handle of an open project.
+  @param mcFile the name of a file describing the analysis.
+  @param statsFile the name of a results file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to run realizations (or 0 for one per processor).
+  @return an error code.
+
+  The Monte Carlo file sets the number of realizations, a random number seed, the quantiles
+  to be estimated and the distributions of the multipliers applied to junction demands and
+  pipe roughness values:
+  @code
+  REALIZATIONS  n
+  SEED          s
+  QUANTILES     p1  p2  ...
+  DEMAND        nodeID | *  distribution  parameters
+  ROUGHNESS     linkID | *  distribution  parameters
+  @endcode
+  where * gives every junction (or pipe) a multiplier of its own and a distribution is one of
+  `NORMAL mean stdDev`, `LOGNORMAL mean stdDev`, `UNIFORM low high` or
+  `TRIANGULAR low mode high`, truncated at zero.
+
+  Each realization is a hydraulic analysis of a clone of the project (see ::EN_cloneproject).
+  The results file lists the mean, standard deviation, minimum, maximum and quantiles of each
+  node's lowest pressure and each link's highest velocity over all realizations. These are
+  computed as the realizations are run, using an amount of memory that doesn't depend on the
+  number of realizations, and no binary output file is written. Each realization draws its
+  multipliers from a random number stream seeded from the analysis seed and its realization
+  number, so the results don't depend on the number of threads used. The project itself is
+  not changed.
+  */
+  int DLLEXPORT EN_runmontecarlo(EN_Project ph, const char *mcFile, const char *statsFile,
+                int nThreads);
+
+  /**
+  @brief Finds the fire flow available at each junction of a project's network.
+  @param ph an EPANET project handle of an open project.
+  @param pressure the residual pressure to be maintained at a junction supplying a
+  fire flow (in pressure units).
+  @param time the time of the simulation at which fire flows are found (in seconds).
+  @param rptFile the name of a report file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to analyze junctions (or 0 for one per processor).
+  @param[out] out_flows an array that receives the fire flow available at each node
+  (in flow units, 0 for tanks and reservoirs), or NULL if not needed.
+  @return an error code.
+
+  A junction's available fire flow is the largest flow that can be drawn from it, on top of
+  its normal demand, while keeping its pressure at or above the residual pressure. The
+  network's hydraulics are solved once, from the start of the simulation up to the given
+  time, and each junction's fire flow is then found from that solution, re-using its factored
+  solution matrix where possible and falling back to a full hydraulic solution when a fire
+  flow changes the status of a link. The report file lists each junction's static pressure,
+  available fire flow, the lowest junction pressure that the fire flow produces and the
+  junction where it occurs. The out_flows array must be sized for the number of nodes,
+  with element i - 1 holding the result for node i. The project itself is not changed.
+  */
+  int DLLEXPORT EN_runfireflow(EN_Project ph, double pressure, long time, const char *rptFile,
+                int nThreads, double *out_flows);
+
+  /**
+  @brief Finds the effect of closing each link of a project's network in turn.
+  @param ph an EPANET project handle of an open project.
+  @param pressure the pressure below which a junction is counted as deficient
+  (in pressure units).
+  @param time the time of the simulation at which links are closed (in seconds).
+  @param rptFile the name of a report file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to analyze links (or 0 for one per processor).
+  @param[out] out_shortfalls an array that receives the demand shortfall with each link
+  closed (in flow units), or NULL if not needed.
+  @param[out] out_deficient an array that receives the number of junctions below the
+  pressure target with each link closed, or NULL if not needed.
+  @return an error code.
+
+  The network's hydraulics are solved once, from the start of the simulation up to the
+  given time. Each link is then closed on its own and the network re-solved from that
+  solution, re-using its factored solution matrix where possible and falling back to a
+  full hydraulic solution when the closure changes the status of other links or
+  disconnects part of the network. With pressure driven demands the demand shortfall is
+  the demand that is not delivered; otherwise it is the demand of the junctions whose
+  pressure falls below the target. Check valves are not closed (their results are reported
+  with error code 207). The report file lists the results for the base case and for each
+  link, along with the lowest junction pressure and the junction where it occurs. The
+  output arrays must be sized for the number of links, with element k - 1 holding the
+  result for link k. The project itself is not changed.
+  */
+  int DLLEXPORT EN_runcriticality(EN_Project ph, double pressure, long time,
+                const char *rptFile, int nThreads, double *out_shortfalls,
+                int *out_deficient);
+
+  /**
+  @brief Calibrates pipe roughness values and junction demands against field observations.
+  @param ph an EPANET project handle of an open project.
+  @param calFile the name of a file describing the calibration.
+  @param obsFile the name of a CSV file of field observations.
+  @param rptFile the name of a report file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to run simulations (or 0 for one per processor).
+  @return an error code.
+
+  The calibration file groups pipes and junctions, each group sharing a multiplier applied to
+  its pipes' roughness or its junctions' demands, and sets the calibration's options:
+  @code
+  ROUGHNESS   group  linkID | *  linkID ...
+  DEMAND      group  nodeID | *  nodeID ...
+  LIMITS      group  lower  upper
+  WEIGHT      PRESSURE | FLOW | LEVEL  weight
+  ITERATIONS  n
+  TOLERANCE   t
+  @endcode
+  where * stands for every pipe (or junction). Multipliers start at 1 and are kept within
+  their limits (0.1 to 10 by default). Each line of the observations file holds a time (in
+  decimal hours or hours:minutes), the type of quantity observed (`PRESSURE`, `FLOW` or
+  `LEVEL`), the ID of the node, link or tank observed and the observed value in the
+  project's units.
+
+  The multipliers that minimize the weighted sum of squared differences between observed
+  and simulated values are found with the Levenberg-Marquardt method, using sensitivities
+  found from each time step's factored solution matrix (see ::EN_getsensitivity). At each
+  time that every tank's level is observed, the extended period simulation is split into a
+  new period starting from the observed levels and the periods are simulated in parallel.
+  The results don't depend on the number of threads used.
+
+  The report lists each group's multiplier and each observation's simulated value. The
+  project's pipe roughness values and junction base demands are updated with the calibrated
+  multipliers.
+  */
+  int DLLEXPORT EN_runcalibration(EN_Project ph, const char *calFile, const char *obsFile,
+                const char *rptFile, int nThreads);
+
+  /**
+  @brief Runs a batch of water quality scenarios that inject a chemical into a project's
+  network, all over the same hydraulics.
+  @param ph an EPANET project handle of an open project.
+  @param hydFile the name of a hydraulics file saved for the project (see ::EN_savehydfile),
+  or "" to solve the project's hydraulics at the start of the run.
+  @param scnFile the name of a file of scenarios.
+  @param sumFile the name of a summary file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to run the scenarios (or 0 for one per processor).
+  @return an error code.
+
+  Each line of the scenario file adds an injection to a named scenario:
+  @code
+  scenario  nodeID  CONCEN | MASS | SETPOINT | FLOWPACED  strength  (start)  (duration)
+  @endcode
+  The strength is in the project's units for a water quality source of the given type
+  (see ::EN_SourceType) and the start time and duration are in decimal hours or
+  hours:minutes. An injection starts at time 0 and lasts for the rest of the simulation
+  by default. Injections replace any source the project has at a node.
+
+  The hydraulics file is mapped into memory once and read in place by every scenario,
+  each scenario being run as a chemical water quality analysis on a clone of the project
+  (see ::EN_cloneproject) that holds only its own water quality state, with several
+  scenarios being run at once. If the project isn't set up for a chemical analysis one is
+  run for a chemical in mg/L that is initially absent from the network. As each scenario completes, a line is written to the summary
+  file with its error or warning code, the number of nodes where the chemical's
+  concentration rises above the water quality tolerance and its highest concentration
+  along with the node and time at which it occurs. The project itself is not changed.
+  */
+  int DLLEXPORT EN_runqualbatch(EN_Project ph, const char *hydFile, const char *scnFile,
+                const char *sumFile, int nThreads);
+
+  /**
+  @brief Traces water sampled at sensor nodes back through a project's network to find
+  the nodes it passed through and when.
+  @param ph an EPANET project handle of an open project.
+  @param hydFile the name of a hydraulics file saved for the project (see ::EN_savehydfile),
+  or "" to solve the project's hydraulics at the start of the run.
+  @param snsFile the name of a file of sensor samples.
+  @param outFile the name of a results file to be created (or "" to write to standard output).
+  @param nThreads the number of threads used to trace the samples (or 0 for one per processor).
+  @return an error code.
+
+  Each line of the sensor file is a sample of water taken at a sensor node at a given
+  (alarm) time, in decimal hours or hours:minutes:
+  @code
+  nodeID  time
+  @endcode
+  Each sample is traced backward in time through the project's hydraulics, all samples
+  being traced in a single pass over the hydraulics with several samples traced at once.
+  For every node the sample's water passed through, a line is written to the results file
+  with its impact (the percent of the sample's water that passed through the node, which
+  is what a water quality trace from the node would give at the sensor at the alarm time),
+  the largest percent passing in a single water quality time step and its time, and the
+  earliest and latest times the water passed the node. These are the nodes and times at
+  which a contaminant injected into the network could have reached the sensor when it was
+  sampled. Tanks are treated as completely mixed. The project itself is not changed.
+  */
+  int DLLEXPORT EN_runbacktrack(EN_Project ph, const char *hydFile, const char *snsFile,
+                const char *outFile, int nThreads);
+
   /**
   @brief Retrieves the title lines of the project
   @param ph an EPANET project handle.
@@ -374,6 +610,58 @@ typedef struct Project *EN_Project;
   */
   int DLLEXPORT EN_nextH(EN_Project ph, long *out_tStep);
 
+  /**
+  @brief Finds the sensitivity of the current hydraulic solution's heads and flows
+  to a single model parameter.
+  @param ph an EPANET project handle.
+  @param param the type of parameter (see @ref EN_SensitivityParam).
+  @param index the index of the link (for ::EN_SENS_ROUGHNESS) or junction whose
+  parameter is perturbed.
+  @param[out] out_headSens an array of size number of nodes that receives the change
+  in each node's head per unit change in the parameter (may be NULL).
+  @param[out] out_flowSens an array of size number of links that receives the change
+  in each link's flow per unit change in the parameter (may be NULL).
+  @return an error code.
+
+  This function must be called after ::EN_runH has found a solution and before any
+  further hydraulic analysis is made. It re-uses the factored matrix of the solver's
+  last iteration, so each call costs a single forward and back substitution.
+
+  Sensitivities are in project units, e.g. feet of head per gpm of base demand. The
+  head of a tank or reservoir is fixed and has zero sensitivity. Flows through active
+  pressure and flow control valves are set by the valve and their sensitivities are
+  only approximate.
+
+  Error code 109 is returned if there is no current hydraulic solution.
+  */
+  int DLLEXPORT EN_getsensitivity(EN_Project ph, int param, int index,
+                double *out_headSens, double *out_flowSens);
+
+  /**
+  @brief Finds the gradient of a weighted sum of heads and flows with respect to
+  a parameter of every link or node.
+  @param ph an EPANET project handle.
+  @param param the type of parameter (see @ref EN_SensitivityParam).
+  @param headWeights an array of size number of nodes holding the weight placed
+  on each node's head (may be NULL).
+  @param flowWeights an array of size number of links holding the weight placed
+  on each link's flow (may be NULL).
+  @param[out] out_gradient an array that receives the derivative of the weighted
+  sum with respect to the parameter of each link (for ::EN_SENS_ROUGHNESS, of size
+  number of links) or of each node (otherwise, of size number of nodes).
+  @return an error code.
+
+  The gradient is found from a single adjoint solution no matter how many parameters
+  there are, making this function suited to calibration and optimization. For the
+  objective J = sum(w_i * H_i) + sum(v_k * Q_k), out_gradient[j] equals the dot product
+  of the weights with the sensitivities returned by ::EN_getsensitivity for parameter j.
+
+  The same conditions apply as for ::EN_getsensitivity.
+  */
+  int DLLEXPORT EN_getadjointgradient(EN_Project ph, int param,
+                const double *headWeights, const double *flowWeights,
+                double *out_gradient);
+
   /**
   @brief Transfers a project's hydraulics results from its temporary hydraulics file
   to its binary output file, where results are only reported at uniform reporting intervals.
@@ -550,6 +838,67 @@ typedef struct Project *EN_Project;
   */
   int DLLEXPORT EN_closeQ(EN_Project ph);
 
+/*===================================================================
+
+  Simulation State Functions
+
+===================================================================*/
+
+  /**
+  @brief Retrieves the size of a buffer needed to save the current state of
+  a simulation.
+  @param ph an EPANET project handle.
+  @param[out] out_size the size of the simulation state in bytes.
+  @return an error code.
+
+  The size of the state depends on the number of water quality segments that
+  pipes and tanks currently hold, so it should be retrieved each time before
+  calling ::EN_savestate.
+  */
+  int DLLEXPORT EN_getstatesize(EN_Project ph, long *out_size);
+
+  /**
+  @brief Saves the current state of a simulation to a block of memory.
+  @param ph an EPANET project handle.
+  @param[out] buffer a memory block that receives the simulation state.
+  @param size the size of the buffer in bytes.
+  @return an error code.
+
+  The hydraulic solver must be open (see ::EN_openH). The state saved consists
+  of the current simulation times, the hydraulic solution, tank volumes, pump
+  energy usage and flow balance totals and, if the water quality solver is
+  also open, node and tank water quality, the water quality segments in pipes
+  and tanks and mass balance totals.
+
+  Call this function between ::EN_runH and ::EN_nextH (and, if water quality is
+  being analyzed step by step, ::EN_runQ and ::EN_nextQ) at the time the
+  simulation is to be branched from. The contents of the project's binary
+  output and report files are not saved.
+  */
+  int DLLEXPORT EN_savestate(EN_Project ph, char *buffer, long size);
+
+  /**
+  @brief Restores a simulation to a state saved by ::EN_savestate.
+  @param ph an EPANET project handle.
+  @param buffer a memory block holding a saved simulation state.
+  @param size the size of the saved state in bytes.
+  @return an error code.
+
+  The state can be restored into the project it was saved from or into another
+  project created from the same network, whose hydraulic (and, if the state
+  includes water quality, water quality) solver has been opened and initialized.
+  The simulation then continues from the time the state was saved with a call to
+  ::EN_nextH (and ::EN_nextQ). Error 265 is returned if the buffer does not hold
+  a state that matches the project's network.
+
+  Restoring a state replaces current link status and settings but does not
+  undo other changes made to network data since the state was saved. A what-if
+  scenario that branches off from the saved state can be defined by changing
+  network data (e.g., closing a pump with ::EN_setlinkvalue) after the state
+  has been restored.
+  */
+  int DLLEXPORT EN_restorestate(EN_Project ph, const char *buffer, long size);
+
 /*===================================================================
 
   Reporting Functions
@@ -841,6 +1190,66 @@ typedef struct Project *EN_Project;
   int  DLLEXPORT EN_setqualtype(EN_Project ph, int qualType, const char *chemName,
                  const char *chemUnits, const char *traceNode);
 
+  /**
+  @brief Adds a water quality constituent routed along with the main one.
+  @param ph an EPANET project handle.
+  @param type the type of constituent, either `EN_AGE` or `EN_TRACE`.
+  @param traceNode the ID name of the node being traced if `type` = `EN_TRACE`.
+  @param[out] out_index the index of the new constituent.
+  @return an error code.
+
+  Added constituents share the transport pass of the analysis selected with
+  @ref EN_setqualtype and are only computed when that analysis is not `EN_NONE`.
+  At most 64 constituents can be added and none while the quality solver is open.
+  */
+  int  DLLEXPORT EN_addconstituent(EN_Project ph, int type, const char *traceNode,
+                 int *out_index);
+
+  /**
+  @brief Retrieves the type of an added water quality constituent.
+  @param ph an EPANET project handle.
+  @param index a constituent index (starting from 1).
+  @param[out] out_type the type of constituent (`EN_AGE` or `EN_TRACE`).
+  @param[out] out_traceNode the index of the node being traced if `out_type` = `EN_TRACE`.
+  @return an error code.
+  */
+  int  DLLEXPORT EN_getconstituent(EN_Project ph, int index, int *out_type,
+                 int *out_traceNode);
+
+  /**
+  @brief Retrieves the computed quality of an added constituent at a node or link.
+  @param ph an EPANET project handle.
+  @param constit a constituent index (starting from 1).
+  @param objectType `EN_NODE` or `EN_LINK`.
+  @param index a node or link index (starting from 1).
+  @param[out] out_value the constituent's water age (hours) or percent of flow
+  from its trace node.
+  @return an error code.
+
+  The quality solver must be open when this function is called.
+  */
+  int  DLLEXPORT EN_getconstituentvalue(EN_Project ph, int constit, int objectType,
+                 int index, double *out_value);
+
+  /**
+  @brief Retrieves the share of each node's water that comes from each traced source.
+  @param ph an EPANET project handle.
+  @param[out] out_sources the index of each source node (may be NULL).
+  @param[out] out_matrix the fraction (0 to 1) of the water at each node that
+  came from each source, stored node by node.
+  @return an error code.
+
+  The sources are the trace node of an `EN_TRACE` analysis followed by the trace
+  node of each `EN_TRACE` constituent added with @ref EN_addconstituent, so that
+  many sources can be traced in a single run. Their number is returned by
+  @ref EN_getcount with `EN_TRACECOUNT`; `out_sources` must hold that many values
+  and `out_matrix` that many times the number of nodes.
+
+  The quality solver must be open when this function is called, normally at
+  each reporting period of a step-by-step simulation.
+  */
+  int  DLLEXPORT EN_gettracematrix(EN_Project ph, int *out_sources, double *out_matrix);
+
 /*===================================================================
 
   Node Functions
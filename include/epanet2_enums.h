@@ -9,7 +9,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 04/23/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -158,7 +158,12 @@ typedef enum {
   EN_MASSBALANCE     = 4, //!< Cumulative water quality mass balance ratio
   EN_DEFICIENTNODES  = 5, //!< Number of pressure deficient nodes
   EN_DEMANDREDUCTION = 6, //!< % demand reduction at pressure deficient nodes
-  EN_LEAKAGELOSS     = 7  //!< % flow lost to system leakage
+  EN_LEAKAGELOSS     = 7, //!< % flow lost to system leakage
+  EN_FULLSORTS       = 8, //!< Number of full topological sorts of the nodes for water quality
+  EN_LOCALSORTS      = 9, //!< Number of local repairs of the sorted nodes for water quality
+  EN_PEAKSEGMENTS    = 10, //!< Most water quality segments held in pipes and tanks
+  EN_MERGEERROR      = 11, //!< Largest spread in quality of pipe segments merged to stay within the segment budget
+  EN_QUALSTEPS       = 12  //!< Number of water quality transport steps taken
 } EN_AnalysisStatistic;
 
 /// Types of network objects
@@ -185,7 +190,9 @@ typedef enum {
   EN_PATCOUNT     = 3,  //!< Number of time patterns
   EN_CURVECOUNT   = 4,  //!< Number of data curves
   EN_CONTROLCOUNT = 5,  //!< Number of simple controls
-  EN_RULECOUNT    = 6   //!< Number of rule-based controls
+  EN_RULECOUNT    = 6,  //!< Number of rule-based controls
+  EN_CONSTITCOUNT = 7,  //!< Number of quality constituents added to the QUALITY one
+  EN_TRACECOUNT   = 8   //!< Number of source nodes traced (see @ref EN_gettracematrix)
 } EN_CountType;
 
 /// Node Types
@@ -359,9 +366,25 @@ typedef enum {
   EN_DEMANDPATTERN  = 23, //!< Name of default demand pattern
   EN_EMITBACKFLOW   = 24, //!< `EN_TRUE` (= 1) if emitters can backflow, `EN_FALSE` (= 0) if not
   EN_PRESS_UNITS    = 25, //!< Pressure units (see @ref EN_PressUnits)
-  EN_STATUS_REPORT  = 26  //!< Type of status report to produce (see @ref EN_StatusReport)
+  EN_STATUS_REPORT  = 26, //!< Type of status report to produce (see @ref EN_StatusReport)
+  EN_THREADS        = 27, //!< Threads used to solve independent zones of a network and route its water quality (1 = serial, 0 = one per processor)
+  EN_TRANSPORT      = 28, //!< Water quality transport method in pipes (see @ref EN_TransportMethod)
+  EN_SEGBUDGET      = 29, //!< Most water quality segments held in pipes and tanks, merging those in pipes as needed (0 = no limit)
+  EN_COURANT        = 30, //!< Volume-weighted Courant number targeted when choosing the water quality time step of each hydraulic period (0 = fixed time step)
+  EN_HYDMEMORY      = 31  //!< Most memory (MB) used to hold scratch hydraulic results before they are moved to a file (0 = always use a file)
 } EN_Option;
 
+/// Water quality transport methods
+/**
+These are the methods of moving water quality through pipes that can be
+selected with @ref EN_setoption using the `EN_TRANSPORT` option. A change
+takes effect when water quality is next initialized.
+*/
+typedef enum {
+  EN_LAGRANGIAN = 0,  //!< Segments of variable volume move with the flow
+  EN_EULERIAN   = 1   //!< Each pipe is a fixed set of cells with upwind fluxes between them
+} EN_TransportMethod;
+
 /// Simple control types
 /**
 These are the different types of simple (single statement) controls that can be applied
@@ -508,6 +531,17 @@ typedef enum {
   EN_R_IS_ACTIVE = 3    //!< Control valve is active
 } EN_RuleStatus;
 
+/// Model parameters whose hydraulic sensitivities can be found
+/**
+These options are used with ::EN_getsensitivity and ::EN_getadjointgradient
+to select the parameter that head and flow sensitivities are found for.
+*/
+typedef enum {
+  EN_SENS_ROUGHNESS = 0, //!< Pipe roughness coefficient
+  EN_SENS_DEMAND    = 1, //!< Junction demand at the current time
+  EN_SENS_EMITTER   = 2  //!< Junction emitter coefficient
+} EN_SensitivityParam;
+
 #define EN_MISSING    -1.E10  //!< Missing value indicator
 #define EN_SET_CLOSED -1.E10  //!< Link set closed indicator
 #define EN_SET_OPEN    1.E10  //!< Link set open indicator
@@ -7,12 +7,32 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 12/07/2018
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "epanet2.h"
+#include "epanet2_2.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#ifdef _WIN32
+#define NULLFILE "NUL"
+#else
+#define NULLFILE "/dev/null"
+#endif
+
+#ifdef USE_MPI
+void  endMPI(void)
+{
+    MPI_Finalize();
+}
+#endif
 
 void  writeConsole(char *s)
 {
@@ -20,6 +40,82 @@ void  writeConsole(char *s)
     fflush(stdout);
 }
 
+int  runBatch(int argc, char *argv[])
+/*--------------------------------------------------------------
+ **  Input:   argc    = number of command line arguments
+ **           *argv[] = array of command line arguments
+ **  Output:  returns 0 if successful, 100 if not
+ **  Purpose: runs a batch of scenarios that modify a network,
+ **           a Monte Carlo analysis of a network, a batch of
+ **           water quality scenarios or a backtracking run
+ **
+ **  Command line for a batch run is:
+ **    progname -b f1  f2  f3  f4  [n]
+ **  for a Monte Carlo analysis is:
+ **    progname -m f1  f2  f3  f4  [n]
+ **  for a water quality batch run is:
+ **    progname -q f1  f2  f3  f4  [n]
+ **  and for a backtracking run is:
+ **    progname -t f1  f2  f3  f4  [n]
+ **  where f1 = name of input file,
+ **  f2 = name of report file,
+ **  f3 = name of scenario file (or Monte Carlo file or sensor
+ **       file),
+ **  f4 = name of summary file (or results file, - for the
+ **       console),
+ **  n = number of threads to use (optional, one per processor
+ **      by default).
+ **--------------------------------------------------------------
+ */
+{
+    EN_Project ph;
+    char errmsg[256] = "";
+    char *f4 = argv[5];
+    int  montecarlo = (strcmp(argv[1], "-m") == 0);
+    int  quality = (strcmp(argv[1], "-q") == 0);
+    int  backtrack = (strcmp(argv[1], "-t") == 0);
+    int  nthreads = 0;
+    int  errcode;
+
+    if (strcmp(f4, "-") == 0) f4 = "";
+    if (argc > 6) nthreads = atoi(argv[6]);
+    if (montecarlo) printf("\n... Running EPANET Monte Carlo analysis\n");
+    else if (quality) printf("\n... Running EPANET water quality scenarios\n");
+    else if (backtrack) printf("\n... Running EPANET backtracking\n");
+    else printf("\n... Running EPANET scenarios\n");
+
+    // Open the base project & run its scenarios
+    EN_createproject(&ph);
+    errcode = EN_open(ph, argv[2], argv[3], "");
+    if (errcode < 100)
+    {
+        if (montecarlo) errcode = EN_runmontecarlo(ph, argv[4], f4, nthreads);
+        else if (quality) errcode = EN_runqualbatch(ph, "", argv[4], f4, nthreads);
+        else if (backtrack) errcode = EN_runbacktrack(ph, "", argv[4], f4, nthreads);
+        else errcode = EN_runbatch(ph, argv[4], f4, nthreads);
+    }
+    EN_close(ph);
+    EN_deleteproject(ph);
+
+    // Check for errors and report accordingly
+    if (errcode < 100)
+    {
+        if (montecarlo)
+            printf("\n... EPANET ran all realizations - check the Results File.\n");
+        else if (backtrack)
+            printf("\n... EPANET traced all samples - check the Results File.\n");
+        else
+            printf("\n... EPANET ran all scenarios - check the Summary File.\n");
+        return 0;
+    }
+    else
+    {
+        ENgeterror(errcode, errmsg, 255);
+        printf("\n... EPANET failed with %s.\n", errmsg);
+        return 100;
+    }
+}
+
 int  main(int argc, char *argv[])
 /*--------------------------------------------------------------
  **  Input:   argc    = number of command line arguments
@@ -33,6 +129,13 @@ int  main(int argc, char *argv[])
  **  f1 = name of input file,
  **  f2 = name of report file
  **  f3 = name of binary output file (optional).
+ **  A batch of scenarios is run when the first argument is -b,
+ **  a Monte Carlo analysis when it is -m, a batch of water
+ **  quality scenarios when it is -q and a backtracking run when
+ **  it is -t (see runBatch).
+ **  When built with MPI and run on several processes (e.g. with
+ **  mpirun -np N), only the process of rank 0 writes files and
+ **  messages.
  **--------------------------------------------------------------
  */
 {
@@ -40,19 +143,53 @@ int  main(int argc, char *argv[])
     char blank[] = "";
     char errmsg[256] = "";
     int  errcode;
+    int  batch;
     int  version;
     int  major;
     int  minor;
     int  patch;
+    int  rank = 0;
     
     // Check for proper number of command line arguments
-    if (argc < 3)
+    batch = (argc > 1 &&
+             (strcmp(argv[1], "-b") == 0 || strcmp(argv[1], "-m") == 0 ||
+              strcmp(argv[1], "-q") == 0 || strcmp(argv[1], "-t") == 0));
+
+#ifdef USE_MPI
+    // Discard the messages & files of all but the first process
+    MPI_Init(&argc, &argv);
+    atexit(endMPI);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank > 0)
+    {
+        freopen(NULLFILE, "w", stdout);
+        if (batch && argc > 5)
+        {
+            argv[3] = NULLFILE;
+            argv[5] = NULLFILE;
+        }
+    }
+#endif
+    if (argc < 3 || (batch && argc < 6))
     {
         printf(
     "\nUsage:\n %s <input_filename> <report_filename> [<binary_filename>]\n",
         argv[0]);
+        printf(
+    " %s -b <input_filename> <report_filename> <scenario_filename>"
+    " <summary_filename> [<threads>]\n", argv[0]);
+        printf(
+    " %s -m <input_filename> <report_filename> <montecarlo_filename>"
+    " <results_filename> [<threads>]\n", argv[0]);
+        printf(
+    " %s -q <input_filename> <report_filename> <scenario_filename>"
+    " <summary_filename> [<threads>]\n", argv[0]);
+        printf(
+    " %s -t <input_filename> <report_filename> <sensor_filename>"
+    " <results_filename> [<threads>]\n", argv[0]);
         return 0;
     }
+    if (batch) return runBatch(argc, argv);
 
     // Get version number and display in Major.Minor.Patch format
     ENgetversion(&version);
@@ -66,6 +203,11 @@ int  main(int argc, char *argv[])
     f2 = argv[2];
     if (argc > 3) f3 = argv[3];
     else          f3 = blank;
+    if (rank > 0)
+    {
+        f2 = NULLFILE;
+        f3 = blank;
+    }
 
     // Run EPANET
     errcode = ENepanet(f1, f2, f3, &writeConsole);
@@ -0,0 +1,855 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       backtrack.c
+ Description:  traces water sampled at sensor nodes back to where it came from
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A backtracking run finds, for each water sample taken at a sensor node at a
+given (alarm) time, the upstream nodes the sampled water passed through and
+when it did so. These are the places and times at which a contaminant could
+have been injected and reached the sensor at the time it was sampled, with
+each node's impact being the fraction of the sample's water that passed
+through it (which is what a TRACE analysis from that node would report at
+the sensor at the alarm time). Water that passes a node more than once, such
+as back and forth through a pipe whose flow reverses or into and out of a
+tank, is counted on each passage, so impacts are upper bounds that can
+exceed 100% in such cases.
+
+Each line of a sensor file describes one sample:
+
+  nodeID  time
+
+where time is in decimal hours or hours:minutes. Text following a
+semicolon is a comment.
+
+The hydraulics, either those saved to a hydraulics file or found by solving
+the base project's hydraulics at the start of the run, are read once on a
+clone of the base project. For each hydraulic period its link flows, tank
+volumes and the topological order in which the water quality solver sorts
+the nodes for the period's flows (see sortnodes() in QUALROUTE.C) are kept.
+A sample is then traced backward through this hydraulic history as parcels
+of its water, each holding a fraction of the sample and the time it left a
+node. Parcels are processed latest first and, within a quality time step,
+in reverse topological order, so that every parcel reaching a node within
+the same time step is merged with the others before being split among the
+node's inflows. A parcel entering a pipe at its downstream end leaves its
+upstream end once the pipe's volume of flow has passed through it, or
+its downstream end again if the pipe's flow reversed in the meantime. Tanks
+are treated as completely mixed over each quality time step, and water that
+was in a pipe or tank at the start of the simulation or that came from a
+reservoir or an external inflow isn't traced any further.
+
+Samples are traced on a pool of worker threads (see WORKPOOL.C) that share
+the hydraulic history, each writing its results to the results file as soon
+as it completes.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runbacktrack(Project *, const char *, const char *, const char *,
+//                     int);
+
+// Smallest fraction of a sample held by a parcel that is traced
+#define MINWEIGHT 1.e-6
+
+// Smallest impact of a node written to the results file
+#define MINIMPACT 1.e-4
+
+// A sample of water taken at a sensor node
+typedef struct {
+    int    node;              // index of sensor node
+    long   time;              // time sample was taken (sec)
+} Ssample;
+
+// Hydraulic conditions over a period of the simulation
+typedef struct {
+    long   start;             // time period starts (sec)
+    REAL4  *flow;             // link flows (0 if negligible)
+    int    *pos;              // position of each node in sorted order
+    double *tankvol;          // tank volumes at start of period
+} Speriod;
+
+// A fraction of a sample's water leaving a node
+typedef struct {
+    int    step;              // quality time step it is processed in
+    int    pos;               // position of node in step's sorted order
+    int    node;              // index of node
+    double w;                 // fraction of sample
+    double t;                 // time it leaves the node (sec)
+} Sparcel;
+
+// The impact a node has on a sample
+typedef struct {
+    int    node;              // index of node
+    double total;             // fraction of sample passing the node
+    double peak;              // largest fraction passing in one step
+    double peaktime;          // time of largest fraction
+    double first;             // earliest time sample passes the node
+    double last;              // latest time sample passes the node
+} Simpact;
+
+// Work space of a worker thread
+typedef struct {
+    Sparcel *heap;            // parcels, latest first
+    int     nparcels;         // number of parcels
+    int     capacity;         // capacity of heap
+    Simpact *impacts;         // impacts of the nodes reached
+    int     nimpacts;         // number of nodes reached
+    int     *slot;            // position of each node in impacts (-1 if none)
+    int     errcode;          // error code
+} Stracker;
+
+// Backtracking run data shared by the worker threads
+typedef struct {
+    Project    *base;         // base project
+    EN_Project hydproject;    // clone of base project that read hydraulics
+    Network    *net;          // network of the clone (with adjacency lists)
+    int        nsamples;      // number of samples
+    Ssample    *samples;      // samples to be traced
+    int        nperiods;      // number of hydraulic periods
+    Speriod    *periods;      // hydraulic periods
+    double     dt;            // quality time step (sec)
+    int        nsteps;        // number of quality time steps
+    int        *stepperiod;   // period giving each step's sorted order
+    Stracker   *trackers;     // each worker's work space
+    FILE       *outfile;      // results file
+    struct Workpool *pool;    // pool of worker threads
+} Sbacktrack;
+
+// Local functions
+static int     readsamples(Sbacktrack *, FILE *, int *);
+static int     readhistory(Sbacktrack *, const char *);
+static int     addperiod(Sbacktrack *, Project *, long);
+static int     periodat(Sbacktrack *, double);
+static void    tracesample(void *, int, int);
+static void    visitnode(Sbacktrack *, Stracker *, Sparcel *);
+static void    traceinflows(Sbacktrack *, Stracker *, Sparcel *, int,
+                            double, double, double);
+static double  pipeentry(Sbacktrack *, int, int, double, int *);
+static void    addparcel(Sbacktrack *, Stracker *, Sparcel *, int, double,
+                         double);
+static int     laterparcel(Sparcel *, Sparcel *);
+static void    popparcel(Stracker *, Sparcel *);
+static void    addimpact(Stracker *, int, double, double);
+static int     compareimpacts(const void *, const void *);
+static void    writeresults(Sbacktrack *, int, Stracker *);
+static void    freebacktrack(Sbacktrack *);
+
+
+int runbacktrack(Project *pr, const char *hydFile, const char *snsFile,
+                 const char *outFile, int nthreads)
+/*----------------------------------------------------------------
+**  Input:   hydFile = name of hydraulics file ("" to solve the
+**                     project's hydraulics)
+**           snsFile = name of sensor file
+**           outFile = name of results file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  returns an error code
+**  Purpose: traces water sampled at sensor nodes back through a
+**           project's network to the nodes it passed through.
+**----------------------------------------------------------------
+*/
+{
+    Sbacktrack b;
+    Stracker *tr;
+    FILE *f;
+    int i, n, line = 0, errcode = 0;
+    char msg[MAXMSG + 1];
+
+    memset(&b, 0, sizeof(Sbacktrack));
+    b.base = pr;
+
+    // Read the sensor file
+    if ((f = fopen(snsFile, "rt")) == NULL) return 319;
+    errcode = readsamples(&b, f, &line);
+    fclose(f);
+    if (errcode)
+    {
+        sprintf(pr->Msg, "Error %d: %s in line %d of sensor file",
+                errcode, geterrmsg(errcode, msg), line);
+        writeline(pr, pr->Msg);
+        freebacktrack(&b);
+        return errcode;
+    }
+
+    // Open the results file
+    if (strlen(outFile) == 0) b.outfile = stdout;
+    else if ((b.outfile = fopen(outFile, "wt")) == NULL)
+    {
+        freebacktrack(&b);
+        return 320;
+    }
+    writeresults(&b, -1, NULL);
+    if (b.nsamples == 0)
+    {
+        freebacktrack(&b);
+        return 0;
+    }
+
+    // Read the hydraulic history
+    errcode = readhistory(&b, hydFile);
+
+    // Create the worker threads and their work spaces
+    if (!errcode)
+    {
+        if (nthreads <= 0) nthreads = workpool_cpucount();
+        nthreads = MIN(nthreads, b.nsamples);
+        b.pool = workpool_create(nthreads);
+        if (b.pool == NULL) errcode = 101;
+    }
+    if (!errcode)
+    {
+        nthreads = workpool_size(b.pool);
+        n = pr->network.Nnodes;
+        b.trackers = (Stracker *)calloc(nthreads, sizeof(Stracker));
+        if (b.trackers == NULL) errcode = 101;
+        for (i = 0; i < nthreads && !errcode; i++)
+        {
+            tr = &b.trackers[i];
+            tr->impacts = (Simpact *)calloc(n + 1, sizeof(Simpact));
+            tr->slot = (int *)malloc((n + 1) * sizeof(int));
+            if (tr->impacts == NULL || tr->slot == NULL) errcode = 101;
+            else memset(tr->slot, -1, (n + 1) * sizeof(int));
+        }
+    }
+
+    // Trace the samples
+    if (!errcode) workpool_run(b.pool, b.nsamples, tracesample, &b);
+    freebacktrack(&b);
+    return errcode;
+}
+
+int readsamples(Sbacktrack *b, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = sensor file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the sensor node and time of each sample.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &b->base->network;
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    double hours;
+    void *p;
+    Ssample sample;
+    int n;
+
+    while (fgets(s, MAXLINE, f) != NULL)
+    {
+        (*line)++;
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        if (n < 2) return 271;
+        sample.node = findnode(net, tok[0]);
+        if (sample.node == 0) return 203;
+        hours = hour(tok[1], "");
+        if (hours < 0.0) return 271;
+        sample.time = (long)(3600.0 * hours + 0.5);
+        if (sample.time > b->base->times.Dur) return 271;
+
+        p = realloc(b->samples, (b->nsamples + 1) * sizeof(Ssample));
+        if (p == NULL) return 101;
+        b->samples = p;
+        b->samples[b->nsamples++] = sample;
+    }
+    return 0;
+}
+
+int readhistory(Sbacktrack *b, const char *hydFile)
+/*----------------------------------------------------------------
+**  Input:   hydFile = name of hydraulics file ("" to solve the
+**                     base project's hydraulics)
+**  Output:  returns an error code
+**  Purpose: keeps the flows, tank volumes and sorted order of the
+**           nodes of each hydraulic period of the base project.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = b->base;
+    EN_Project p = NULL;
+    long t, tstep, dur = pr->times.Dur;
+    int i, errcode;
+
+    // Find the number of quality time steps and the period whose
+    // sorted order each one is processed in (set below)
+    b->dt = (double)MAX(pr->times.Qstep, 1);
+    b->nsteps = (int)(dur / b->dt) + 1;
+    b->stepperiod = (int *)calloc(b->nsteps, sizeof(int));
+    if (b->stepperiod == NULL) return 101;
+
+    // Make a clone of the base project that reads its hydraulics
+    // from the hydraulics file or solves them
+    if (EN_createproject(&b->hydproject) != 0) return 101;
+    p = b->hydproject;
+    errcode = cloneproject(pr, p, NULL, "");
+    if (!errcode)
+    {
+        if (strlen(hydFile) > 0) errcode = EN_usehydfile(p, hydFile);
+        else errcode = EN_solveH(p);
+        if (errcode < 100) errcode = 0;
+    }
+
+    // Age water over a single step per hydraulic period, which has
+    // the clone's quality solver sort its nodes for each period's
+    // flows
+    if (!errcode)
+    {
+        p->hydraul.Threads = 1;
+        p->quality.Courant = 0.0;
+        errcode = EN_setqualtype(p, EN_AGE, "", "", "");
+        p->times.Qstep = MAX(p->times.Hstep, 1);
+    }
+    if (!errcode) errcode = EN_openQ(p);
+    if (!errcode) errcode = EN_initQ(p, EN_NOSAVE);
+    if (!errcode) do
+    {
+        errcode = EN_runQ(p, &t);
+        if (errcode > 100) break;
+        if (t < dur || b->nperiods == 0) errcode = addperiod(b, p, t);
+        if (!errcode) errcode = EN_nextQ(p, &tstep);
+        if (errcode > 100) break;
+        errcode = 0;
+    } while (tstep > 0);
+    EN_closeQ(p);
+    if (errcode) return errcode;
+
+    // Rebuild the clone's node adjacency lists (freed when its
+    // quality solver closed) for tracing water through its nodes
+    b->net = &p->network;
+    errcode = buildadjlists(b->net);
+    if (errcode) return errcode;
+
+    // Each quality time step is processed in the sorted order of
+    // the period in effect at its end
+    for (i = 0; i < b->nsteps; i++)
+    {
+        b->stepperiod[i] = periodat(b, MIN((i + 1) * b->dt, (double)dur));
+    }
+    return 0;
+}
+
+int addperiod(Sbacktrack *b, Project *p, long t)
+/*----------------------------------------------------------------
+**  Input:   p = project whose hydraulics were just read
+**           t = time hydraulic period starts (sec)
+**  Output:  returns an error code
+**  Purpose: adds a project's current hydraulic conditions to the
+**           hydraulic history.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    Hydraul *hyd = &p->hydraul;
+    Quality *qual = &p->quality;
+    Speriod *period;
+    void *q;
+    int i, k;
+
+    q = realloc(b->periods, (b->nperiods + 1) * sizeof(Speriod));
+    if (q == NULL) return 101;
+    b->periods = q;
+    period = &b->periods[b->nperiods++];
+    period->start = t;
+    period->flow = (REAL4 *)calloc(net->Nlinks + 1, sizeof(REAL4));
+    period->pos = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    period->tankvol = (double *)calloc(net->Ntanks + 1, sizeof(double));
+    if (period->flow == NULL || period->pos == NULL ||
+        period->tankvol == NULL) return 101;
+
+    // Keep only the flows the quality solver routes water through
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        if (qual->FlowDir[k] == ZERO_FLOW) continue;
+        if (hyd->LinkStatus[k] <= CLOSED) continue;
+        period->flow[k] = (REAL4)hyd->LinkFlow[k];
+    }
+    for (i = 1; i <= net->Nnodes; i++) period->pos[i] = qual->SortPos[i];
+    for (i = 1; i <= net->Ntanks; i++)
+    {
+        period->tankvol[i] = tankvolume(p, i, hyd->NodeHead[net->Tank[i].Node]);
+    }
+    return 0;
+}
+
+int periodat(Sbacktrack *b, double t)
+/*----------------------------------------------------------------
+**  Input:   t = time (sec)
+**  Output:  returns index of hydraulic period
+**  Purpose: finds the hydraulic period whose flows carry water
+**           into the nodes just before time t.
+**----------------------------------------------------------------
+*/
+{
+    int lo = 0, hi = b->nperiods - 1, mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi + 1) / 2;
+        if (b->periods[mid].start < t) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+void tracesample(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = backtracking run data
+**           worker = index of worker thread
+**           item = index of sample
+**  Output:  none
+**  Purpose: traces a sample's water back through the network on
+**           a worker thread.
+**----------------------------------------------------------------
+*/
+{
+    Sbacktrack *b = (Sbacktrack *)data;
+    Stracker *tr = &b->trackers[worker];
+    Ssample *sample = &b->samples[item];
+    Sparcel start, parcel, next;
+    int i;
+
+    // Clear the impacts of the worker's last sample
+    for (i = 0; i < tr->nimpacts; i++) tr->slot[tr->impacts[i].node] = -1;
+    tr->nimpacts = 0;
+    tr->nparcels = 0;
+    tr->errcode = 0;
+
+    // Start with all of the sample's water at the sensor node
+    start.step = b->nsteps;
+    start.pos = b->base->network.Nnodes + 1;
+    addparcel(b, tr, &start, sample->node, (double)sample->time, 1.0);
+
+    // Take the latest parcel, merge it with any others leaving
+    // the same node in the same quality time step and split it
+    // among the node's inflows
+    while (tr->nparcels > 0 && !tr->errcode)
+    {
+        popparcel(tr, &parcel);
+        while (tr->nparcels > 0 && tr->heap[0].step == parcel.step &&
+               tr->heap[0].node == parcel.node)
+        {
+            popparcel(tr, &next);
+            parcel.t = (parcel.t * parcel.w + next.t * next.w) /
+                       (parcel.w + next.w);
+            parcel.w += next.w;
+        }
+        visitnode(b, tr, &parcel);
+    }
+
+    // Write the sample's results to the results file
+    qsort(tr->impacts, tr->nimpacts, sizeof(Simpact), compareimpacts);
+    workpool_lock(b->pool);
+    writeresults(b, item, tr);
+    workpool_unlock(b->pool);
+}
+
+void visitnode(Sbacktrack *b, Stracker *tr, Sparcel *parcel)
+/*----------------------------------------------------------------
+**  Input:   parcel = parcel of water leaving a node
+**  Output:  none
+**  Purpose: records a parcel's impact on the node it leaves and
+**           traces where its water came from.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = b->net;
+    Speriod *period;
+    Stank *tank;
+    Padjlist alink;
+    int n = parcel->node, i, k, p;
+    double q, qin = 0.0, qout = 0.0, t = parcel->t, w = parcel->w;
+    double h, v, vin, vold, win;
+
+    // Find the flows into and out of the node
+    p = periodat(b, t);
+    period = &b->periods[p];
+    for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+    {
+        k = alink->link;
+        q = period->flow[k];
+        if (net->Link[k].N1 == n) q = -q;
+        if (q > 0.0) qin += q;
+        else qout -= q;
+    }
+
+    // Water from a reservoir isn't traced any further
+    i = n - net->Njuncs;
+    if (i <= 0)
+    {
+        tank = NULL;
+    }
+    else
+    {
+        tank = &net->Tank[i];
+        if (tank->A == 0.0)
+        {
+            addimpact(tr, n, w, t);
+            return;
+        }
+    }
+
+    // A tank's water over the last quality time step is a mix of
+    // the water it held and the water flowing into it
+    if (tank)
+    {
+        h = MIN(b->dt, t);
+        v = period->tankvol[i] + (qin - qout) * (t - period->start);
+        vin = qin * h;
+        vold = MAX(0.0, v - (qin - qout) * h);
+        win = (vin > 0.0) ? w * vin / (vold + vin) : 0.0;
+        if (win > 0.0)
+        {
+            addimpact(tr, n, win, t - h / 2.0);
+            traceinflows(b, tr, parcel, p, win, qin, t - h / 2.0);
+        }
+        if (t <= b->dt) addimpact(tr, n, w - win, 0.0);
+        else addparcel(b, tr, parcel, n, t - h, w - win);
+        return;
+    }
+
+    // A junction's water is a mix of the water flowing into it from
+    // its links and any external inflow
+    addimpact(tr, n, w, t);
+    if (qin > 0.0)
+    {
+        traceinflows(b, tr, parcel, p, w, MAX(qin, qout), t);
+    }
+
+    // Water at a junction without any flow stays there until the
+    // period began
+    else if (qout == 0.0 && p > 0)
+    {
+        addparcel(b, tr, parcel, n, (double)period->start, w);
+    }
+}
+
+void traceinflows(Sbacktrack *b, Stracker *tr, Sparcel *parcel, int p,
+                  double w, double qtotal, double t)
+/*----------------------------------------------------------------
+**  Input:   parcel = parcel of water leaving a node
+**           p = index of hydraulic period
+**           w = fraction of sample flowing into the node
+**           qtotal = total flow into the node
+**           t = time the water flows into the node (sec)
+**  Output:  none
+**  Purpose: splits water flowing into a node among the links it
+**           flows in from in proportion to their flows, tracing
+**           it back to where it entered those links.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = b->net;
+    Padjlist alink;
+    int n = parcel->node, k, dir, from;
+    double q, t1;
+
+    for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+    {
+        k = alink->link;
+        q = b->periods[p].flow[k];
+        dir = (net->Link[k].N2 == n) ? 1 : -1;
+        if (q * dir <= 0.0) continue;
+        t1 = pipeentry(b, k, dir, t, &from);
+        if (t1 < 0.0) continue;
+        addparcel(b, tr, parcel, from, t1, w * q * dir / qtotal);
+    }
+}
+
+double pipeentry(Sbacktrack *b, int k, int dir, double t, int *n)
+/*----------------------------------------------------------------
+**  Input:   k = link index
+**           dir = direction of flow (1 from its start node,
+**                 -1 from its end node)
+**           t = time water leaves the link (sec)
+**  Output:  n = index of node the water entered the link from
+**           returns time the water entered the link (sec), or
+**           -1 if it was in the link at the start of the simulation
+**  Purpose: finds where and when water leaving a pipe entered it.
+**  Note:    water that flowed into the pipe from its downstream
+**           end while its flow was reversed and came back out
+**           came from the downstream node.
+**----------------------------------------------------------------
+*/
+{
+    Slink *link = &b->net->Link[k];
+    Speriod *period;
+    int p;
+    double v, d = 0.0, q, span;
+
+    *n = (dir > 0) ? link->N1 : link->N2;
+    if (link->Type > PIPE) return t;
+
+    // Go back over the hydraulic periods, keeping track of the
+    // volume d that has flowed through the pipe since the water
+    // entered it, until d reaches either the pipe's volume or 0
+    v = PI * SQR(link->Diam) / 4.0 * link->Len;
+    p = periodat(b, t);
+    for (;;)
+    {
+        period = &b->periods[p];
+        q = dir * period->flow[k];
+        span = t - period->start;
+        if (q > 0.0 && d + q * span >= v) return t - (v - d) / q;
+        if (q < 0.0 && d + q * span <= 0.0)
+        {
+            *n = (dir > 0) ? link->N2 : link->N1;
+            return t + d / q;
+        }
+        d += q * span;
+        if (p == 0) return -1.0;
+        t = (double)period->start;
+        p--;
+    }
+}
+
+void addparcel(Sbacktrack *b, Stracker *tr, Sparcel *from, int n,
+               double t, double w)
+/*----------------------------------------------------------------
+**  Input:   from = parcel being split
+**           n = index of node the new parcel leaves
+**           t = time the new parcel leaves node n (sec)
+**           w = fraction of sample held by the new parcel
+**  Output:  none
+**  Purpose: adds a parcel to the heap of parcels still to be
+**           processed.
+**----------------------------------------------------------------
+*/
+{
+    Sparcel parcel, *heap;
+    int i, parent, step;
+
+    if (w < MINWEIGHT) return;
+
+    // The new parcel must be processed after the parcel it comes
+    // from, i.e. in an earlier quality time step or later in
+    // reverse sorted order within the same step
+    step = MIN((int)(t / b->dt), from->step);
+    step = MIN(step, b->nsteps - 1);
+    parcel.pos = b->periods[b->stepperiod[step]].pos[n];
+    if (step == from->step && parcel.pos >= from->pos)
+    {
+        if (--step < 0) return;
+        parcel.pos = b->periods[b->stepperiod[step]].pos[n];
+    }
+    parcel.step = step;
+    parcel.node = n;
+    parcel.w = w;
+    parcel.t = t;
+
+    // Grow the heap if full
+    if (tr->nparcels == tr->capacity)
+    {
+        i = MAX(2 * tr->capacity, 64);
+        heap = (Sparcel *)realloc(tr->heap, i * sizeof(Sparcel));
+        if (heap == NULL)
+        {
+            tr->errcode = 101;
+            return;
+        }
+        tr->heap = heap;
+        tr->capacity = i;
+    }
+
+    // Sift the parcel up the heap
+    i = tr->nparcels++;
+    while (i > 0)
+    {
+        parent = (i - 1) / 2;
+        if (!laterparcel(&parcel, &tr->heap[parent])) break;
+        tr->heap[i] = tr->heap[parent];
+        i = parent;
+    }
+    tr->heap[i] = parcel;
+}
+
+int laterparcel(Sparcel *a, Sparcel *b)
+/*----------------------------------------------------------------
+**  Input:   a, b = parcels
+**  Output:  returns TRUE if parcel a is processed before parcel b
+**  Purpose: orders parcels by quality time step and then by the
+**           position of their nodes in sorted order, latest first.
+**----------------------------------------------------------------
+*/
+{
+    if (a->step != b->step) return a->step > b->step;
+    return a->pos > b->pos;
+}
+
+void popparcel(Stracker *tr, Sparcel *parcel)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  parcel = parcel removed from top of heap
+**  Purpose: removes the next parcel to be processed from the heap.
+**----------------------------------------------------------------
+*/
+{
+    Sparcel last;
+    int i = 0, child;
+
+    *parcel = tr->heap[0];
+    last = tr->heap[--tr->nparcels];
+    for (;;)
+    {
+        child = 2 * i + 1;
+        if (child >= tr->nparcels) break;
+        if (child + 1 < tr->nparcels &&
+            laterparcel(&tr->heap[child + 1], &tr->heap[child])) child++;
+        if (!laterparcel(&tr->heap[child], &last)) break;
+        tr->heap[i] = tr->heap[child];
+        i = child;
+    }
+    tr->heap[i] = last;
+}
+
+void addimpact(Stracker *tr, int n, double w, double t)
+/*----------------------------------------------------------------
+**  Input:   n = node index
+**           w = fraction of sample passing the node
+**           t = time it passes the node (sec)
+**  Output:  none
+**  Purpose: adds a fraction of a sample to a node's impact.
+**----------------------------------------------------------------
+*/
+{
+    Simpact *impact;
+
+    if (w <= 0.0) return;
+    if (tr->slot[n] < 0)
+    {
+        tr->slot[n] = tr->nimpacts;
+        impact = &tr->impacts[tr->nimpacts++];
+        memset(impact, 0, sizeof(Simpact));
+        impact->node = n;
+        impact->first = t;
+        impact->last = t;
+    }
+    else impact = &tr->impacts[tr->slot[n]];
+    impact->total += w;
+    impact->first = MIN(impact->first, t);
+    impact->last = MAX(impact->last, t);
+    if (w > impact->peak)
+    {
+        impact->peak = w;
+        impact->peaktime = t;
+    }
+}
+
+int compareimpacts(const void *a, const void *b)
+/*----------------------------------------------------------------
+**  Input:   a, b = node impacts
+**  Output:  returns -1, 0 or 1
+**  Purpose: orders node impacts from largest to smallest.
+**----------------------------------------------------------------
+*/
+{
+    const Simpact *x = (const Simpact *)a;
+    const Simpact *y = (const Simpact *)b;
+
+    if (x->total > y->total) return -1;
+    if (x->total < y->total) return 1;
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+void writeresults(Sbacktrack *b, int sample, Stracker *tr)
+/*----------------------------------------------------------------
+**  Input:   sample = index of sample (-1 for heading)
+**           tr = work space holding sample's impacts
+**  Output:  none
+**  Purpose: writes the impact of each node a sample's water
+**           passed through to the results file.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &b->base->network;
+    FILE *f = b->outfile;
+    Ssample *s;
+    Simpact *impact;
+    char atime[13], ptime[13], ftime[13], ltime[13];
+    int i;
+
+    if (sample < 0)
+    {
+        fprintf(f, "%-*s %10s %-*s %9s %9s %10s %10s %10s\n",
+                MAXID, "Sensor", "Time", MAXID, "Node", "Impact",
+                "Peak", "Peak Time", "Earliest", "Latest");
+        fprintf(f, "%-*s %10s %-*s %9s %9s %10s %10s %10s\n",
+                MAXID, "", "hrs:min:sec", MAXID, "", "%", "%",
+                "hrs:min:sec", "hrs:min:sec", "hrs:min:sec");
+        fflush(f);
+        return;
+    }
+    s = &b->samples[sample];
+    clocktime(atime, s->time);
+    if (tr->errcode)
+    {
+        fprintf(f, "%-*s %10s %d\n", MAXID, net->Node[s->node].ID, atime,
+                tr->errcode);
+    }
+    else for (i = 0; i < tr->nimpacts; i++)
+    {
+        impact = &tr->impacts[i];
+        if (impact->total < MINIMPACT) break;
+        fprintf(f, "%-*s %10s %-*s %9.3f %9.3f %10s %10s %10s\n",
+                MAXID, net->Node[s->node].ID, atime,
+                MAXID, net->Node[impact->node].ID,
+                100.0 * impact->total, 100.0 * impact->peak,
+                clocktime(ptime, (long)(impact->peaktime + 0.5)),
+                clocktime(ftime, (long)(impact->first + 0.5)),
+                clocktime(ltime, (long)(impact->last + 0.5)));
+    }
+    fflush(f);
+}
+
+void freebacktrack(Sbacktrack *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory and files used by a backtracking run.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    if (b->trackers)
+    {
+        for (i = 0; i < workpool_size(b->pool); i++)
+        {
+            free(b->trackers[i].heap);
+            free(b->trackers[i].impacts);
+            free(b->trackers[i].slot);
+        }
+        free(b->trackers);
+    }
+    workpool_delete(b->pool);
+    for (i = 0; i < b->nperiods; i++)
+    {
+        free(b->periods[i].flow);
+        free(b->periods[i].pos);
+        free(b->periods[i].tankvol);
+    }
+    free(b->periods);
+    free(b->stepperiod);
+    free(b->samples);
+    if (b->hydproject) EN_deleteproject(b->hydproject);
+    if (b->outfile && b->outfile != stdout) fclose(b->outfile);
+}
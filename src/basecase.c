@@ -0,0 +1,159 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       basecase.c
+ Description:  sets up the base case of an analysis run on worker threads
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+Analyses that perturb a network's hydraulics one item at a time (e.g., a fire
+flow drawn from a junction or a link closed) all start from the same base case
+solution at a given time. openbasecase() creates a pool of worker threads (see
+WORKPOOL.C) and gives each worker a clone of the project (see CLONE.C). The
+first clone runs a simulation up to the time of the analysis, its solution is
+saved (see SNAPSHOT.C) and its matrix is factored, and the saved solution is
+then restored into the other clones. A worker restores the saved solution
+again before each item it analyzes. closebasecase() frees all of this.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     openbasecase(Project *, Sbasecase *, long, int, int);
+//void    closebasecase(Sbasecase *);
+
+// Imported functions
+extern int hydfactor(Project *, Sfactor *);   //(see HYDSOLVER.C)
+
+// Local functions
+static int solvebasecase(Sbasecase *, long);
+
+
+int openbasecase(Project *pr, Sbasecase *bc, long time, int nitems,
+                 int nthreads)
+/*----------------------------------------------------------------
+**  Input:   time = time of analysis (sec)
+**           nitems = number of items to be analyzed
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  bc = base case shared by the worker threads
+**           returns an error code
+**  Purpose: creates the worker threads of an analysis, their
+**           clones of a project and the base case solution.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+
+    memset(bc, 0, sizeof(Sbasecase));
+    if (nthreads <= 0) nthreads = workpool_cpucount();
+    nthreads = MAX(MIN(nthreads, nitems), 1);
+    bc->Pool = workpool_create(nthreads);
+    if (bc->Pool == NULL) return 101;
+    bc->Nworkers = workpool_size(bc->Pool);
+    bc->Clones = (Project **)calloc(bc->Nworkers, sizeof(Project *));
+    if (bc->Clones == NULL) return 101;
+    for (i = 0; i < bc->Nworkers && !errcode; i++)
+    {
+        if (EN_createproject(&bc->Clones[i]) != 0) errcode = 101;
+        else errcode = cloneproject(pr, bc->Clones[i], NULL, "");
+    }
+    if (!errcode) errcode = solvebasecase(bc, time);
+    return errcode;
+}
+
+void closebasecase(Sbasecase *bc)
+/*----------------------------------------------------------------
+**  Input:   bc = base case shared by the worker threads
+**  Output:  none
+**  Purpose: frees the worker threads of an analysis, their
+**           clones of a project and the base case solution.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    for (i = 0; i < bc->Nworkers && bc->Clones; i++)
+    {
+        if (bc->Clones[i]) EN_deleteproject(bc->Clones[i]);
+    }
+    free(bc->Clones);
+    workpool_delete(bc->Pool);
+    free(bc->State);
+    free(bc->Factor.Lii);
+    free(bc->Factor.Lij);
+    memset(bc, 0, sizeof(Sbasecase));
+}
+
+int solvebasecase(Sbasecase *bc, long time)
+/*----------------------------------------------------------------
+**  Input:   time = time of analysis (sec)
+**  Output:  returns an error code
+**  Purpose: solves the base case hydraulics, factors its matrix
+**           and gives each worker's clone its solution.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = bc->Clones[0];
+    Network *net = &pr->network;
+    Smatrix *sm = &pr->hydraul.smatrix;
+    Project *p;
+    int i, errcode;
+    long t, tstep;
+
+    // Run a simulation of the base case up to the analysis time
+    errcode = EN_openH(pr);
+    if (!errcode) errcode = EN_initH(pr, EN_NOSAVE);
+    while (errcode <= 100)
+    {
+        errcode = EN_runH(pr, &t);
+        if (errcode > 100 || t >= time) break;
+        errcode = EN_nextH(pr, &tstep);
+        if (errcode > 100 || tstep == 0) break;
+    }
+    if (errcode > 100) return errcode;
+
+    // Save the base case solution
+    bc->StateSize = statesize(pr);
+    bc->State = (char *)malloc(bc->StateSize);
+    if (bc->State == NULL) return 101;
+    errcode = savestate(pr, bc->State, bc->StateSize);
+
+    // Factor the matrix of the base case solution (the factor
+    // is left empty if it's ill-conditioned)
+    if (!errcode)
+    {
+        bc->Factor.Lii = (double *)malloc((net->Njuncs + 1) * sizeof(double));
+        bc->Factor.Lij = (double *)malloc((sm->Ncoeffs + 1) * sizeof(double));
+        ERRCODE(MEMCHECK(bc->Factor.Lii));
+        ERRCODE(MEMCHECK(bc->Factor.Lij));
+        if (!errcode && !hydfactor(pr, &bc->Factor))
+        {
+            free(bc->Factor.Lii);
+            free(bc->Factor.Lij);
+            bc->Factor.Lii = NULL;
+            bc->Factor.Lij = NULL;
+        }
+    }
+
+    // Give the other workers the base case solution
+    for (i = 1; i < bc->Nworkers && !errcode; i++)
+    {
+        p = bc->Clones[i];
+        errcode = EN_openH(p);
+        if (!errcode) errcode = EN_initH(p, EN_NOSAVE);
+        if (!errcode) errcode = restorestate(p, bc->State, bc->StateSize);
+    }
+    return errcode;
+}
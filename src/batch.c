@@ -0,0 +1,512 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       batch.c
+ Description:  runs a batch of scenarios that modify a base project
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A batch run analyzes a set of scenarios, each one a list of changes made to
+the network of an open base project, and writes a one line summary of each
+scenario's hydraulic results to a summary file as soon as it completes.
+
+Each line of a scenario file changes one property of the base network:
+
+  scenario  NODE    nodeID  ELEV | DEMAND | PATTERN | EMITTER | QUAL | LEVEL
+                            value
+  scenario  LINK    linkID  DIAMETER | LENGTH | ROUGHNESS | STATUS | SETTING
+                            value
+  scenario  OPTION  DEMAND | DURATION  value
+
+where scenario is the name of the scenario the change belongs to (a scenario's
+lines need not be contiguous), values are in the base project's units, a
+PATTERN value is the ID of a time pattern, a STATUS value is OPEN or CLOSED,
+the DEMAND option is the global demand multiplier and DURATION is in hours.
+Text following a semicolon is a comment.
+
+Scenarios are run on a pool of worker threads (see WORKPOOL.C). Each worker
+keeps a project of its own that is made a clone of the base project (see
+CLONE.C) before applying a scenario's changes to it, so that only the data
+a scenario changes is copied.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "hash.h"
+#include "text.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runbatch(Project *, const char *, const char *, int);
+
+// A change made to the base network by a scenario
+typedef struct {
+    int    scenario;          // index of scenario making the change
+    int    object;            // NODE, LINK or OPTION
+    int    index;             // index of node or link
+    int    property;          // EN_ property or option code
+    double value;             // new property value
+} Schange;
+
+// A scenario's results
+typedef struct {
+    int    errcode;           // error or warning code
+    double minpress;          // minimum junction pressure
+    int    minnode;           // junction with minimum pressure
+    long   mintime;           // time of minimum pressure
+    double maxvel;            // maximum link velocity
+    int    maxlink;           // link with maximum velocity
+} Ssummary;
+
+// Batch run data shared by the worker threads
+typedef struct {
+    Project     *base;        // base project
+    EN_Project  *workers;     // each worker's project
+    int         nscenarios;   // number of scenarios
+    char        (*names)[MAXID + 1];  // scenario names
+    int         nchanges;     // number of changes
+    Schange     *changes;     // changes sorted by scenario
+    int         *first;       // first change of each scenario
+    FILE        *sumfile;     // summary file
+    struct Workpool *pool;    // pool of worker threads
+} Sbatch;
+
+enum { OPTION = LINK + 1 };
+
+static char *Objects[] = {w_NODE, w_LINK, w_OPTION, NULL};
+static char *NodeWords[] = {w_ELEV, w_DEMAND, w_PATTERN, w_EMITTER,
+                            w_QUALITY, w_LEVEL, NULL};
+static int  NodeProps[] = {EN_ELEVATION, EN_BASEDEMAND, EN_PATTERN,
+                           EN_EMITTER, EN_INITQUAL, EN_TANKLEVEL};
+static char *LinkWords[] = {w_DIAM, w_LENGTH, w_ROUGHNESS, w_STATUS,
+                            w_SETTING, NULL};
+static int  LinkProps[] = {EN_DIAMETER, EN_LENGTH, EN_ROUGHNESS,
+                           EN_INITSTATUS, EN_INITSETTING};
+static char *OptionWords[] = {w_DEMAND, w_DURATION, NULL};
+static char *StatusWords[] = {w_CLOSED, w_OPEN, NULL};
+
+// Local functions
+static int   readscenarios(Sbatch *, FILE *, int *);
+static int   addchange(Sbatch *, HashTable *, char **, int);
+static int   sortchanges(Sbatch *);
+static void  runscenario(void *, int, int);
+static int   applychanges(Sbatch *, EN_Project, int);
+static int   simulate(EN_Project, Ssummary *);
+static void  writeresults(Sbatch *, int, Ssummary *);
+static void  freebatch(Sbatch *);
+
+
+int runbatch(Project *pr, const char *scnFile, const char *sumFile,
+             int nthreads)
+/*----------------------------------------------------------------
+**  Input:   scnFile = name of scenario file
+**           sumFile = name of summary file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  returns an error code
+**  Purpose: runs a batch of scenarios that modify a project.
+**----------------------------------------------------------------
+*/
+{
+    Sbatch b;
+    FILE *f;
+    int i, line = 0, errcode = 0;
+    char msg[MAXMSG + 1];
+
+    memset(&b, 0, sizeof(Sbatch));
+    b.base = pr;
+
+    // Read the scenario file
+    if ((f = fopen(scnFile, "rt")) == NULL) return 310;
+    errcode = readscenarios(&b, f, &line);
+    fclose(f);
+    if (errcode)
+    {
+        sprintf(pr->Msg, "Error %d: %s in line %d of scenario file",
+                errcode, geterrmsg(errcode, msg), line);
+        writeline(pr, pr->Msg);
+        freebatch(&b);
+        return errcode;
+    }
+
+    // Open the summary file
+    if (strlen(sumFile) == 0) b.sumfile = stdout;
+    else if ((b.sumfile = fopen(sumFile, "wt")) == NULL)
+    {
+        freebatch(&b);
+        return 311;
+    }
+    writeresults(&b, -1, NULL);
+    if (b.nscenarios == 0)
+    {
+        freebatch(&b);
+        return 0;
+    }
+
+    // Create the worker threads and their projects
+    if (nthreads <= 0) nthreads = workpool_cpucount();
+    nthreads = MIN(nthreads, b.nscenarios);
+    b.pool = workpool_create(nthreads);
+    if (b.pool == NULL) errcode = 101;
+    else
+    {
+        nthreads = workpool_size(b.pool);
+        b.workers = (EN_Project *)calloc(nthreads, sizeof(EN_Project));
+        if (b.workers == NULL) errcode = 101;
+        for (i = 0; i < nthreads && !errcode; i++)
+        {
+            if (EN_createproject(&b.workers[i]) != 0) errcode = 101;
+        }
+    }
+
+    // Clone the base project once before the workers start
+    // so that they only read from it
+    if (!errcode) errcode = cloneproject(pr, b.workers[0], NULL, "");
+
+    // Run the scenarios
+    if (!errcode) workpool_run(b.pool, b.nscenarios, runscenario, &b);
+    freebatch(&b);
+    return errcode;
+}
+
+int readscenarios(Sbatch *b, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = scenario file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the changes made by each scenario.
+**----------------------------------------------------------------
+*/
+{
+    HashTable *names;
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    int n, errcode = 0;
+
+    names = hashtable_create();
+    if (names == NULL) return 101;
+    while (fgets(s, MAXLINE, f) != NULL)
+    {
+        (*line)++;
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        errcode = addchange(b, names, tok, n);
+        if (errcode) break;
+    }
+    hashtable_free(names);
+    if (!errcode) errcode = sortchanges(b);
+    return errcode;
+}
+
+int addchange(Sbatch *b, HashTable *names, char **tok, int ntoks)
+/*----------------------------------------------------------------
+**  Input:   names = table of scenario names
+**           tok = tokens of a line of the scenario file
+**           ntoks = number of tokens
+**  Output:  returns an error code
+**  Purpose: adds the change on a line of the scenario file to
+**           the list of changes.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &b->base->network;
+    Schange c;
+    int k, n;
+    void *p;
+
+    // Parse the object, property and value being changed
+    if (ntoks < 4 || strlen(tok[0]) > MAXID) return 266;
+    c.object = findmatch(tok[1], Objects);
+    if (c.object == NODE || c.object == LINK)
+    {
+        if (ntoks < 5) return 266;
+        if (c.object == NODE)
+        {
+            c.index = findnode(net, tok[2]);
+            if (c.index == 0) return 203;
+            k = findmatch(tok[3], NodeWords);
+            if (k < 0) return 266;
+            c.property = NodeProps[k];
+        }
+        else
+        {
+            c.index = findlink(net, tok[2]);
+            if (c.index == 0) return 204;
+            k = findmatch(tok[3], LinkWords);
+            if (k < 0) return 266;
+            c.property = LinkProps[k];
+        }
+        if (c.property == EN_PATTERN)
+        {
+            c.value = findpattern(net, tok[4]);
+            if (c.value < 0) return 205;
+        }
+        else if (c.property == EN_INITSTATUS)
+        {
+            c.value = findmatch(tok[4], StatusWords);
+            if (c.value < 0) return 266;
+        }
+        else if (!getfloat(tok[4], &c.value)) return 266;
+    }
+    else if (c.object == OPTION)
+    {
+        c.index = 0;
+        c.property = findmatch(tok[2], OptionWords);
+        if (c.property < 0) return 266;
+        if (!getfloat(tok[3], &c.value)) return 266;
+    }
+    else return 266;
+
+    // Find the scenario the change belongs to
+    c.scenario = hashtable_find(names, tok[0]) - 1;
+    if (c.scenario < 0)
+    {
+        n = b->nscenarios;
+        p = realloc(b->names, (n + 1) * sizeof(b->names[0]));
+        if (p == NULL) return 101;
+        b->names = p;
+        strncpy(b->names[n], tok[0], MAXID);
+        b->names[n][MAXID] = '\0';
+        if (!hashtable_insert(names, b->names[n], n + 1)) return 101;
+        c.scenario = n;
+        b->nscenarios++;
+    }
+
+    // Append the change to the list of changes
+    n = b->nchanges;
+    p = realloc(b->changes, (n + 1) * sizeof(Schange));
+    if (p == NULL) return 101;
+    b->changes = p;
+    b->changes[n] = c;
+    b->nchanges++;
+    return 0;
+}
+
+int sortchanges(Sbatch *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: groups the list of changes by scenario, keeping the
+**           order in which each scenario's changes were read.
+**----------------------------------------------------------------
+*/
+{
+    Schange *sorted;
+    int *next;
+    int i, k;
+
+    b->first = (int *)calloc(b->nscenarios + 1, sizeof(int));
+    next = (int *)calloc(b->nscenarios + 1, sizeof(int));
+    sorted = (Schange *)calloc(b->nchanges + 1, sizeof(Schange));
+    if (b->first == NULL || next == NULL || sorted == NULL)
+    {
+        free(next);
+        free(sorted);
+        return 101;
+    }
+
+    // Count the changes made by each scenario
+    for (i = 0; i < b->nchanges; i++) b->first[b->changes[i].scenario + 1]++;
+    for (k = 0; k < b->nscenarios; k++) b->first[k + 1] += b->first[k];
+
+    // Place each scenario's changes after those of the previous one
+    memcpy(next, b->first, (b->nscenarios + 1) * sizeof(int));
+    for (i = 0; i < b->nchanges; i++)
+    {
+        k = b->changes[i].scenario;
+        sorted[next[k]++] = b->changes[i];
+    }
+    free(next);
+    free(b->changes);
+    b->changes = sorted;
+    return 0;
+}
+
+void runscenario(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = batch run data
+**           worker = index of worker thread
+**           item = index of scenario
+**  Output:  none
+**  Purpose: runs a scenario on a worker thread's project.
+**----------------------------------------------------------------
+*/
+{
+    Sbatch *b = (Sbatch *)data;
+    EN_Project p = b->workers[worker];
+    Ssummary s;
+
+    memset(&s, 0, sizeof(Ssummary));
+    s.errcode = EN_cloneproject(b->base, p, NULL, "");
+    if (!s.errcode) s.errcode = applychanges(b, p, item);
+    if (!s.errcode) s.errcode = simulate(p, &s);
+
+    // Write the scenario's results to the summary file
+    workpool_lock(b->pool);
+    writeresults(b, item, &s);
+    workpool_unlock(b->pool);
+}
+
+int applychanges(Sbatch *b, EN_Project p, int scenario)
+/*----------------------------------------------------------------
+**  Input:   p = project to be changed
+**           scenario = index of scenario
+**  Output:  returns an error code
+**  Purpose: makes a scenario's changes to a project.
+**----------------------------------------------------------------
+*/
+{
+    Schange *c;
+    int i, errcode = 0;
+
+    for (i = b->first[scenario]; i < b->first[scenario + 1]; i++)
+    {
+        c = &b->changes[i];
+        switch (c->object)
+        {
+        case NODE:
+            errcode = EN_setnodevalue(p, c->index, c->property, c->value);
+            break;
+        case LINK:
+            errcode = EN_setlinkvalue(p, c->index, c->property, c->value);
+            break;
+        case OPTION:
+            if (c->property == 0)
+            {
+                errcode = EN_setoption(p, EN_DEMANDMULT, c->value);
+            }
+            else
+            {
+                errcode = EN_settimeparam(p, EN_DURATION,
+                                          (long)(c->value * 3600.0));
+            }
+            break;
+        }
+        if (errcode) break;
+    }
+    return errcode;
+}
+
+int simulate(EN_Project p, Ssummary *s)
+/*----------------------------------------------------------------
+**  Input:   p = project to be analyzed
+**  Output:  s = summary of hydraulic results
+**           returns an error or warning code
+**  Purpose: runs a hydraulic simulation, keeping track of the
+**           lowest junction pressure and highest link velocity.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    int i, errcode, warning = 0;
+    long t, tstep = 0;
+    double v;
+
+    s->minpress = 1.e10;
+    s->maxvel = -1.0;
+    errcode = EN_openH(p);
+    if (!errcode) errcode = EN_initH(p, EN_NOSAVE);
+    if (errcode > 100) return errcode;
+    do
+    {
+        errcode = EN_runH(p, &t);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+        for (i = 1; i <= net->Njuncs; i++)
+        {
+            EN_getnodevalue(p, i, EN_PRESSURE, &v);
+            if (v >= s->minpress) continue;
+            s->minpress = v;
+            s->minnode = i;
+            s->mintime = t;
+        }
+        for (i = 1; i <= net->Nlinks; i++)
+        {
+            EN_getlinkvalue(p, i, EN_VELOCITY, &v);
+            if (v <= s->maxvel) continue;
+            s->maxvel = v;
+            s->maxlink = i;
+        }
+        errcode = EN_nextH(p, &tstep);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+    } while (tstep > 0);
+    EN_closeH(p);
+    return (errcode > 100) ? errcode : warning;
+}
+
+void writeresults(Sbatch *b, int scenario, Ssummary *s)
+/*----------------------------------------------------------------
+**  Input:   scenario = index of scenario (-1 for heading)
+**           s = scenario's results
+**  Output:  none
+**  Purpose: writes a scenario's results to the summary file.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = b->base;
+    Network *net = &pr->network;
+    Report *rpt = &pr->report;
+    FILE *f = b->sumfile;
+    char atime[13];
+
+    if (scenario < 0)
+    {
+        fprintf(f, "%-*s %5s %14s %-*s %10s %14s %-*s\n",
+                MAXID, "Scenario", "Code", "Min Pressure", MAXID, "Node",
+                "Time", "Max Velocity", MAXID, "Link");
+        fprintf(f, "%-*s %5s %14s %-*s %10s %14s %-*s\n", MAXID, "", "",
+                rpt->Field[PRESSURE].Units, MAXID, "", "hrs:min:sec",
+                rpt->Field[VELOCITY].Units, MAXID, "");
+    }
+    else if (s->errcode > 100 || s->minnode == 0 || s->maxlink == 0)
+    {
+        fprintf(f, "%-*s %5d\n", MAXID, b->names[scenario], s->errcode);
+    }
+    else
+    {
+        fprintf(f, "%-*s %5d %14.*f %-*s %10s %14.*f %-*s\n",
+                MAXID, b->names[scenario], s->errcode,
+                rpt->Field[PRESSURE].Precision, s->minpress,
+                MAXID, net->Node[s->minnode].ID, clocktime(atime, s->mintime),
+                rpt->Field[VELOCITY].Precision, s->maxvel,
+                MAXID, net->Link[s->maxlink].ID);
+    }
+    fflush(f);
+}
+
+void freebatch(Sbatch *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory and files used by a batch run.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    if (b->workers)
+    {
+        for (i = 0; i < workpool_size(b->pool); i++)
+        {
+            if (b->workers[i]) EN_deleteproject(b->workers[i]);
+        }
+        free(b->workers);
+    }
+    workpool_delete(b->pool);
+    if (b->sumfile && b->sumfile != stdout) fclose(b->sumfile);
+    free(b->names);
+    free(b->changes);
+    free(b->first);
+}
@@ -0,0 +1,1307 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       calibrate.c
+ Description:  calibration of pipe roughness and junction demands
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A calibration adjusts multipliers applied to the roughness of groups of pipes
+and to the demands of groups of junctions so that an extended period
+simulation best fits a set of field observations, in the least squares sense.
+
+A calibration file contains lines of the following form:
+
+  ROUGHNESS   group  linkID | *  linkID ...
+  DEMAND      group  nodeID | *  nodeID ...
+  LIMITS      group  lower  upper
+  WEIGHT      PRESSURE | FLOW | LEVEL  weight
+  ITERATIONS  n
+  TOLERANCE   t
+
+where a group's multiplier scales the roughness of each of its pipes (or all
+demand categories of each of its junctions), * stands for every pipe (or
+every junction), a link or node may belong to only one group of each kind and
+multipliers are kept between a group's limits (0.1 and 10 by default). The
+weights (1 by default) scale the residuals of each type of observation, which
+are in the project's units. The iterations stop once the relative change in
+the sum of squared residuals or the largest change in a multiplier is below
+the tolerance (1e-4 by default) or after n iterations (20 by default). Text
+following a semicolon is a comment.
+
+An observations file is a CSV file whose lines are:
+
+  time, PRESSURE | FLOW | LEVEL, nodeID | linkID, value
+
+where time is in decimal hours or hours:minutes and LEVEL observations are
+made at tanks. A first line that doesn't start with a time is taken to be a
+heading. An observation is compared with the simulation results in effect at
+its time, as in a project's report.
+
+The multipliers are found with the Levenberg-Marquardt method. The Jacobian
+of the simulated observations is found at each hydraulic time step from the
+factored solution matrix (see SENSITIVITY.C), with the sensitivities of tank
+levels carried forward from one time step to the next, so a simulation and
+its Jacobian cost little more than the simulation alone. The Jacobian leaves
+out the shift in the times at which controls on tank levels are triggered, so
+it is most accurate over short periods (see below).
+
+Wherever every tank has a level observation at the same time, the simulation
+is broken into a new period that starts with the tanks at their observed
+levels (so with a network without tanks each observation time starts a new
+period). The periods are independent of one another and are simulated in
+parallel on a pool of worker threads (see WORKPOOL.C), each starting from the
+state (see SNAPSHOT.C) that the previous accepted simulation had at its start
+time, which sets the status of links under level controls. The first
+simulation runs the periods in sequence, so a calibration's results don't
+depend on the number of threads used.
+
+The project's pipe roughness values and junction demands are updated with the
+calibrated multipliers.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "text.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runcalibration(Project *, const char *, const char *, const char *,
+//                       int);
+
+#define MAXLMITER   20       // Default max. number of iterations
+#define MAXLMTRIES  10       // Max. trial steps per iteration
+#define LMTOL       1.e-4    // Default relative change in sum of squares
+#define LMLAMBDA    1.e-2    // Initial damping factor
+#define MINLIMIT    0.1      // Default lower limit on a multiplier
+#define MAXLIMIT    10.0     // Default upper limit on a multiplier
+
+// Property adjusted by a group's multiplier
+enum CalibType {CALIB_ROUGHNESS, CALIB_DEMAND};
+
+// Observed quantity
+enum ObservType {OBS_PRESSURE, OBS_FLOW, OBS_LEVEL};
+
+// Group of pipes or junctions sharing a multiplier
+typedef struct {
+    char   name[MAXID + 1];  // group name
+    int    type;             // CALIB_ROUGHNESS or CALIB_DEMAND
+    double lower;            // lower limit on multiplier
+    double upper;            // upper limit on multiplier
+    double value;            // current multiplier
+} Scalgroup;
+
+// Field observation
+typedef struct {
+    long   time;             // time of observation (sec)
+    int    type;             // type of quantity observed
+    int    index;            // node or link index
+    double value;            // observed value (user units)
+} Sobserv;
+
+// Worker thread's data
+typedef struct {
+    EN_Project project;      // worker's project
+    double     *dp;          // change in each link's or node's parameter
+    double     **dh;         // change in each node's head for each group
+    double     **dq;         // change in each link's flow for each group
+    double     *tankhead;    // head of each fixed grade node at a solution
+} Scalworker;
+
+// Calibration data shared by the worker threads
+typedef struct {
+    Project    *base;        // base project
+    Scalworker *workers;     // each worker's data
+    int        nworkers;     // number of workers
+    int        ngroups;      // number of groups
+    Scalgroup  *groups;      // groups being calibrated
+    int        *rgroup;      // roughness group of each link (from 1)
+    int        *dgroup;      // demand group of each junction (from 1)
+    double     *coeff;       // base roughness of each link (user units)
+    double     weights[3];   // weight of each type of observation
+    int        maxiter;      // max. number of iterations
+    double     tolerance;    // relative change in sum of squares
+    int        nobs;         // number of observations
+    Sobserv    *obs;         // observations in order of time
+    int        nperiods;     // number of independent periods
+    long       *starttime;   // start time of each period
+    int        *firstobs;    // first observation of each period
+    int        reset0;       // TRUE if tanks are observed at time 0
+    long       statesize;    // size of a period's start state
+    char       **states;     // start state of each period
+    char       **newstates;  // start states found by a trial simulation
+    char       **outstates;  // start states being written to
+    double     *theta;       // multipliers being simulated
+    double     *sim;         // simulated value of each observation
+    double     *jac;         // Jacobian of simulated observations
+    int        *errcodes;    // error code of each period
+    int        iterations;   // number of iterations made
+    double     sse0;         // initial sum of squared residuals
+    double     sse;          // final sum of squared residuals
+    struct Workpool *pool;   // pool of worker threads
+} Scalstudy;
+
+static char *Keywords[] = {w_ROUGHNESS, w_DEMAND, w_LIMITS, w_WEIGHT,
+                           w_ITERATIONS, w_TOLERANCE, NULL};
+static char *ObsWords[] = {w_PRESSURE, w_FLOW, w_LEVEL, NULL};
+
+// Local functions
+static int    readcalibration(Scalstudy *, FILE *, int *);
+static int    addgroup(Scalstudy *, char **, int, int);
+static int    findgroup(Scalstudy *, char *, int);
+static int    readobservations(Scalstudy *, FILE *, int *);
+static int    compareobs(const void *, const void *);
+static int    findperiods(Scalstudy *);
+static int    alloccalstudy(Scalstudy *, int);
+static int    levenberg(Scalstudy *);
+static int    simulate(Scalstudy *, double *, double *, double *, int);
+static void   runsequence(void *, int, int);
+static void   runperiod(void *, int, int);
+static int    simulateperiod(Scalstudy *, Scalworker *, int);
+static int    applygroups(Scalstudy *, EN_Project, double *);
+static void   resettanks(Scalstudy *, Project *, int);
+static int    findjacobian(Scalstudy *, Scalworker *);
+static void   addobservation(Scalstudy *, Scalworker *, int);
+static void   updatetanks(Scalstudy *, Scalworker *, long);
+static double sumofsquares(Scalstudy *, double *, double *, double *);
+static int    solvesystem(int, double *, double *);
+static void   writecalstudy(Scalstudy *, FILE *);
+static void   freecalstudy(Scalstudy *);
+
+
+int runcalibration(Project *pr, const char *calFile, const char *obsFile,
+                   const char *rptFile, int nthreads)
+/*----------------------------------------------------------------
+**  Input:   calFile = name of calibration file
+**           obsFile = name of observations file
+**           rptFile = name of report file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  returns an error code
+**  Purpose: calibrates a project's pipe roughness values and
+**           junction demands against field observations.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Scalstudy cs;
+    FILE *f;
+    int k, line = 0, errcode = 0;
+    char msg[MAXMSG + 1];
+
+    memset(&cs, 0, sizeof(Scalstudy));
+    cs.base = pr;
+    cs.rgroup = (int *)calloc(net->Nlinks + 1, sizeof(int));
+    cs.dgroup = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    cs.coeff = (double *)calloc(net->Nlinks + 1, sizeof(double));
+    ERRCODE(MEMCHECK(cs.rgroup));
+    ERRCODE(MEMCHECK(cs.dgroup));
+    ERRCODE(MEMCHECK(cs.coeff));
+    for (k = 1; k <= net->Nlinks && !errcode; k++)
+    {
+        errcode = EN_getlinkvalue(pr, k, EN_ROUGHNESS, &cs.coeff[k]);
+    }
+    if (errcode)
+    {
+        freecalstudy(&cs);
+        return errcode;
+    }
+
+    // Read the calibration and observations files
+    if ((f = fopen(calFile, "rt")) == NULL) errcode = 316;
+    else
+    {
+        errcode = readcalibration(&cs, f, &line);
+        fclose(f);
+        if (errcode)
+        {
+            sprintf(pr->Msg, "Error %d: %s in line %d of calibration file",
+                    errcode, geterrmsg(errcode, msg), line);
+            writeline(pr, pr->Msg);
+        }
+    }
+    line = 0;
+    if (!errcode)
+    {
+        if ((f = fopen(obsFile, "rt")) == NULL) errcode = 317;
+        else
+        {
+            errcode = readobservations(&cs, f, &line);
+            fclose(f);
+            if (errcode)
+            {
+                sprintf(pr->Msg,
+                        "Error %d: %s in line %d of observations file",
+                        errcode, geterrmsg(errcode, msg), line);
+                writeline(pr, pr->Msg);
+            }
+        }
+    }
+
+    // Split the simulation into independent periods & create
+    // the worker threads that simulate them
+    if (!errcode) errcode = findperiods(&cs);
+    if (!errcode)
+    {
+        if (nthreads <= 0) nthreads = workpool_cpucount();
+        nthreads = MAX(MIN(nthreads, cs.nperiods), 1);
+        cs.pool = workpool_create(nthreads);
+        if (cs.pool == NULL) errcode = 101;
+        else errcode = alloccalstudy(&cs, workpool_size(cs.pool));
+    }
+
+    // Clone the base project once before the workers start
+    // so that they only read from it
+    if (!errcode) errcode = cloneproject(pr, cs.workers[0].project, NULL, "");
+
+    // Find the multipliers & apply them to the project
+    if (!errcode) errcode = levenberg(&cs);
+    for (k = 0; k < cs.nworkers; k++)
+    {
+        EN_deleteproject(cs.workers[k].project);
+        cs.workers[k].project = NULL;
+    }
+    if (!errcode)
+    {
+        for (k = 0; k < cs.ngroups; k++) cs.theta[k] = cs.groups[k].value;
+        errcode = applygroups(&cs, pr, cs.theta);
+    }
+
+    // Report the results
+    if (!errcode)
+    {
+        if (strlen(rptFile) == 0) writecalstudy(&cs, stdout);
+        else if ((f = fopen(rptFile, "wt")) == NULL) errcode = 318;
+        else
+        {
+            writecalstudy(&cs, f);
+            fclose(f);
+        }
+    }
+    freecalstudy(&cs);
+    return errcode;
+}
+
+int readcalibration(Scalstudy *cs, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = calibration file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the groups and options of a calibration.
+**----------------------------------------------------------------
+*/
+{
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    int n, k, key, errcode = 0;
+    double y, z;
+
+    cs->weights[OBS_PRESSURE] = 1.0;
+    cs->weights[OBS_FLOW] = 1.0;
+    cs->weights[OBS_LEVEL] = 1.0;
+    cs->maxiter = MAXLMITER;
+    cs->tolerance = LMTOL;
+    while (fgets(s, MAXLINE, f) != NULL && !errcode)
+    {
+        (*line)++;
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        key = findmatch(tok[0], Keywords);
+        if (n < 2) errcode = 268;
+        else switch (key)
+        {
+        case 0:
+        case 1:
+            errcode = addgroup(cs, tok, n, key);
+            break;
+        case 2:
+            k = -1;
+            if (n >= 4) k = findgroup(cs, tok[1], -1);
+            if (k < 0 || !getfloat(tok[2], &y) || !getfloat(tok[3], &z) ||
+                y <= 0.0 || z < y) errcode = 268;
+            else
+            {
+                cs->groups[k].lower = y;
+                cs->groups[k].upper = z;
+                cs->groups[k].value = MIN(MAX(1.0, y), z);
+            }
+            break;
+        case 3:
+            k = findmatch(tok[1], ObsWords);
+            if (n < 3 || k < 0 || !getfloat(tok[2], &y) || y < 0.0)
+            {
+                errcode = 268;
+            }
+            else cs->weights[k] = y;
+            break;
+        case 4:
+            if (!getfloat(tok[1], &y) || y < 1.0) errcode = 268;
+            else cs->maxiter = (int)y;
+            break;
+        case 5:
+            if (!getfloat(tok[1], &y) || y <= 0.0) errcode = 268;
+            else cs->tolerance = y;
+            break;
+        default:
+            errcode = 268;
+        }
+    }
+    if (!errcode && cs->ngroups == 0) errcode = 268;
+    return errcode;
+}
+
+int addgroup(Scalstudy *cs, char **tok, int ntoks, int type)
+/*----------------------------------------------------------------
+**  Input:   tok = tokens of a line of the calibration file
+**           ntoks = number of tokens
+**           type = type of group
+**  Output:  returns an error code
+**  Purpose: adds the pipes or junctions on a line of the
+**           calibration file to a group.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &cs->base->network;
+    Scalgroup *g;
+    int i, j, k, first, last;
+    int *member = (type == CALIB_ROUGHNESS) ? cs->rgroup : cs->dgroup;
+    void *p;
+
+    if (ntoks < 3 || strlen(tok[1]) > MAXID) return 268;
+
+    // Find the group or create a new one
+    k = findgroup(cs, tok[1], type);
+    if (k == -2) return 268;
+    if (k < 0)
+    {
+        p = realloc(cs->groups, (cs->ngroups + 1) * sizeof(Scalgroup));
+        if (p == NULL) return 101;
+        cs->groups = p;
+        k = cs->ngroups++;
+        g = &cs->groups[k];
+        strcpy(g->name, tok[1]);
+        g->type = type;
+        g->lower = MINLIMIT;
+        g->upper = MAXLIMIT;
+        g->value = 1.0;
+    }
+
+    // Add its pipes or junctions
+    for (i = 2; i < ntoks; i++)
+    {
+        if (strcmp(tok[i], "*") == 0)
+        {
+            first = 1;
+            last = (type == CALIB_ROUGHNESS) ? net->Nlinks : net->Njuncs;
+        }
+        else
+        {
+            if (type == CALIB_ROUGHNESS)
+            {
+                first = findlink(net, tok[i]);
+                if (first == 0) return 204;
+                if (net->Link[first].Type > PIPE) return 268;
+            }
+            else
+            {
+                first = findnode(net, tok[i]);
+                if (first == 0) return 203;
+                if (first > net->Njuncs) return 268;
+            }
+            last = first;
+        }
+        for (j = first; j <= last; j++)
+        {
+            if (type == CALIB_ROUGHNESS && net->Link[j].Type > PIPE) continue;
+            if (member[j] > 0 && member[j] != k + 1) return 268;
+            member[j] = k + 1;
+        }
+    }
+    return 0;
+}
+
+int findgroup(Scalstudy *cs, char *name, int type)
+/*----------------------------------------------------------------
+**  Input:   name = group name
+**           type = type of group (-1 for any type)
+**  Output:  returns index of group, -1 if not found or -2 if
+**           it's of another type
+**  Purpose: finds a calibration group by name.
+**----------------------------------------------------------------
+*/
+{
+    int k;
+
+    for (k = 0; k < cs->ngroups; k++)
+    {
+        if (strcomp(cs->groups[k].name, name))
+        {
+            if (type >= 0 && cs->groups[k].type != type) return -2;
+            return k;
+        }
+    }
+    return -1;
+}
+
+int readobservations(Scalstudy *cs, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = observations file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the field observations of a calibration.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = cs->base;
+    Network *net = &pr->network;
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    char *c;
+    int n, errcode = 0;
+    double hours;
+    Sobserv obs;
+    void *p;
+
+    while (fgets(s, MAXLINE, f) != NULL && !errcode)
+    {
+        (*line)++;
+        for (c = s; *c; c++) if (*c == ',') *c = ' ';
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        hours = hour(tok[0], "");
+        if (hours < 0.0 && cs->nobs == 0 && *line == 1) continue;
+
+        // Parse the observation
+        if (n < 4 || hours < 0.0) return 269;
+        obs.time = (long)(3600.0 * hours + 0.5);
+        obs.type = findmatch(tok[1], ObsWords);
+        if (obs.type < 0 || !getfloat(tok[3], &obs.value)) return 269;
+        if (obs.time > pr->times.Dur) return 269;
+        if (obs.type == OBS_FLOW)
+        {
+            obs.index = findlink(net, tok[2]);
+            if (obs.index == 0) return 204;
+        }
+        else
+        {
+            obs.index = findnode(net, tok[2]);
+            if (obs.index == 0) return 203;
+            if (obs.type == OBS_LEVEL && (obs.index <= net->Njuncs ||
+                net->Tank[obs.index - net->Njuncs].A == 0.0)) return 269;
+        }
+
+        // Append it to the list of observations
+        p = realloc(cs->obs, (cs->nobs + 1) * sizeof(Sobserv));
+        if (p == NULL) return 101;
+        cs->obs = p;
+        cs->obs[cs->nobs++] = obs;
+    }
+    if (cs->nobs == 0) errcode = 269;
+    else qsort(cs->obs, cs->nobs, sizeof(Sobserv), compareobs);
+    return errcode;
+}
+
+int compareobs(const void *a, const void *b)
+/*----------------------------------------------------------------
+**  Input:   a, b = observations
+**  Output:  returns -1, 0 or 1
+**  Purpose: orders observations by time, then by type and object
+**           (so that the order doesn't depend on qsort).
+**----------------------------------------------------------------
+*/
+{
+    const Sobserv *x = (const Sobserv *)a;
+    const Sobserv *y = (const Sobserv *)b;
+
+    if (x->time != y->time) return (x->time < y->time) ? -1 : 1;
+    if (x->type != y->type) return (x->type < y->type) ? -1 : 1;
+    if (x->index != y->index) return (x->index < y->index) ? -1 : 1;
+    if (x->value != y->value) return (x->value < y->value) ? -1 : 1;
+    return 0;
+}
+
+int findperiods(Scalstudy *cs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: splits the simulation into periods that start at
+**           each time that every tank's level is observed.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &cs->base->network;
+    int *seen;
+    int i, j, k, n, ntanks = 0, nseen;
+    long t;
+
+    // Count the tanks (not reservoirs)
+    for (j = 1; j <= net->Ntanks; j++)
+    {
+        if (net->Tank[j].A > 0.0) ntanks++;
+    }
+    seen = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    cs->starttime = (long *)calloc(cs->nobs + 2, sizeof(long));
+    cs->firstobs = (int *)calloc(cs->nobs + 2, sizeof(int));
+    if (seen == NULL || cs->starttime == NULL || cs->firstobs == NULL)
+    {
+        free(seen);
+        return 101;
+    }
+
+    // Period 0 starts at time 0 and others at an observation
+    // time when all tanks are observed
+    n = 1;
+    for (i = 0; i < cs->nobs; i = k)
+    {
+        t = cs->obs[i].time;
+        nseen = 0;
+        for (k = i; k < cs->nobs && cs->obs[k].time == t; k++)
+        {
+            j = cs->obs[k].index;
+            if (cs->obs[k].type == OBS_LEVEL && seen[j] != i + 1)
+            {
+                seen[j] = i + 1;
+                nseen++;
+            }
+        }
+        if (nseen < ntanks) continue;
+        if (t == 0) cs->reset0 = TRUE;
+        else
+        {
+            cs->starttime[n] = t;
+            cs->firstobs[n] = i;
+            n++;
+        }
+    }
+    cs->nperiods = n;
+    cs->firstobs[n] = cs->nobs;
+    free(seen);
+    return 0;
+}
+
+int alloccalstudy(Scalstudy *cs, int nworkers)
+/*----------------------------------------------------------------
+**  Input:   nworkers = number of worker threads
+**  Output:  returns an error code
+**  Purpose: allocates memory used by a calibration.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &cs->base->network;
+    Scalworker *w;
+    int i, k, ng = cs->ngroups, errcode = 0;
+
+    cs->nworkers = nworkers;
+    cs->workers = (Scalworker *)calloc(nworkers, sizeof(Scalworker));
+    cs->states = (char **)calloc(cs->nperiods + 1, sizeof(char *));
+    cs->newstates = (char **)calloc(cs->nperiods + 1, sizeof(char *));
+    cs->theta = (double *)calloc(ng, sizeof(double));
+    cs->errcodes = (int *)calloc(cs->nperiods, sizeof(int));
+    ERRCODE(MEMCHECK(cs->workers));
+    ERRCODE(MEMCHECK(cs->states));
+    ERRCODE(MEMCHECK(cs->newstates));
+    ERRCODE(MEMCHECK(cs->theta));
+    ERRCODE(MEMCHECK(cs->errcodes));
+    for (i = 0; i < nworkers && !errcode; i++)
+    {
+        w = &cs->workers[i];
+        if (EN_createproject(&w->project) != 0) errcode = 101;
+        w->dp = (double *)calloc(net->Nnodes + net->Nlinks + 1,
+                                 sizeof(double));
+        w->tankhead = (double *)calloc(net->Nnodes + 1, sizeof(double));
+        w->dh = (double **)calloc(ng, sizeof(double *));
+        w->dq = (double **)calloc(ng, sizeof(double *));
+        ERRCODE(MEMCHECK(w->dp));
+        ERRCODE(MEMCHECK(w->tankhead));
+        ERRCODE(MEMCHECK(w->dh));
+        ERRCODE(MEMCHECK(w->dq));
+        for (k = 0; k < ng && !errcode; k++)
+        {
+            w->dh[k] = (double *)calloc(net->Nnodes + 1, sizeof(double));
+            w->dq[k] = (double *)calloc(net->Nlinks + 1, sizeof(double));
+            ERRCODE(MEMCHECK(w->dh[k]));
+            ERRCODE(MEMCHECK(w->dq[k]));
+        }
+    }
+    return errcode;
+}
+
+int levenberg(Scalstudy *cs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: finds the multipliers that minimize the sum of
+**           squared residuals with the Levenberg-Marquardt
+**           method.
+**----------------------------------------------------------------
+*/
+{
+    int    i, j, k, tries, accepted, errcode;
+    int    n = cs->ngroups, m = cs->nobs;
+    double lambda = LMLAMBDA, sse, step;
+    double *x, *xnew, *sim, *jac, *simnew, *jacnew, *a, *b, *r;
+    char   **s;
+
+    x = (double *)calloc(n, sizeof(double));
+    xnew = (double *)calloc(n, sizeof(double));
+    sim = (double *)calloc(m, sizeof(double));
+    simnew = (double *)calloc(m, sizeof(double));
+    jac = (double *)calloc((size_t)m * n, sizeof(double));
+    jacnew = (double *)calloc((size_t)m * n, sizeof(double));
+    a = (double *)calloc((size_t)n * n, sizeof(double));
+    b = (double *)calloc(n, sizeof(double));
+    r = (double *)calloc(m, sizeof(double));
+    errcode = 0;
+    ERRCODE(MEMCHECK(x));
+    ERRCODE(MEMCHECK(xnew));
+    ERRCODE(MEMCHECK(sim));
+    ERRCODE(MEMCHECK(simnew));
+    ERRCODE(MEMCHECK(jac));
+    ERRCODE(MEMCHECK(jacnew));
+    ERRCODE(MEMCHECK(a));
+    ERRCODE(MEMCHECK(b));
+    ERRCODE(MEMCHECK(r));
+
+    // Simulate the initial multipliers with the periods in sequence
+    for (k = 0; k < n; k++) x[k] = cs->groups[k].value;
+    if (!errcode) errcode = simulate(cs, x, sim, jac, FALSE);
+    if (!errcode) cs->sse0 = sumofsquares(cs, sim, jac, r);
+    cs->sse = cs->sse0;
+
+    for (cs->iterations = 0; cs->iterations < cs->maxiter && !errcode;
+         cs->iterations++)
+    {
+        // Form the normal equations J'J*dx = -J'r from the
+        // weighted Jacobian and residuals
+        for (j = 0; j < n; j++)
+        {
+            b[j] = 0.0;
+            for (i = 0; i < m; i++) b[j] -= jac[i * n + j] * r[i];
+        }
+
+        // Try damped steps until the sum of squares is reduced
+        accepted = FALSE;
+        for (tries = 0; tries < MAXLMTRIES && !accepted; tries++)
+        {
+            for (j = 0; j < n; j++)
+            {
+                for (k = 0; k < n; k++)
+                {
+                    a[j * n + k] = 0.0;
+                    for (i = 0; i < m; i++)
+                    {
+                        a[j * n + k] += jac[i * n + j] * jac[i * n + k];
+                    }
+                }
+                xnew[j] = b[j];
+                if (a[j * n + j] == 0.0) a[j * n + j] = 1.0;
+                else a[j * n + j] *= 1.0 + lambda;
+            }
+            if (!solvesystem(n, a, xnew)) break;
+
+            // Keep the multipliers within their limits
+            step = 0.0;
+            for (j = 0; j < n; j++)
+            {
+                xnew[j] = MIN(MAX(x[j] + xnew[j], cs->groups[j].lower),
+                              cs->groups[j].upper);
+                step = MAX(step, ABS(xnew[j] - x[j]));
+            }
+            if (step < 1.e-8) break;
+
+            // Accept a step that reduces the sum of squares
+            if (simulate(cs, xnew, simnew, jacnew, TRUE) == 0)
+            {
+                sse = sumofsquares(cs, simnew, jacnew, r);
+                if (sse < cs->sse)
+                {
+                    accepted = TRUE;
+                    memcpy(x, xnew, n * sizeof(double));
+                    memcpy(sim, simnew, m * sizeof(double));
+                    memcpy(jac, jacnew, (size_t)m * n * sizeof(double));
+                    s = cs->states;
+                    cs->states = cs->newstates;
+                    cs->newstates = s;
+                    step = MIN(step, (cs->sse - sse) / MAX(cs->sse, TINY));
+                    cs->sse = sse;
+                    lambda = MAX(lambda / 10.0, 1.e-7);
+                    break;
+                }
+            }
+            lambda *= 10.0;
+        }
+        if (!accepted) break;
+        if (step < cs->tolerance)
+        {
+            cs->iterations++;
+            break;
+        }
+    }
+
+    // Save the final multipliers & simulated observations
+    if (!errcode)
+    {
+        for (k = 0; k < n; k++) cs->groups[k].value = x[k];
+        cs->sim = sim;
+        sim = NULL;
+    }
+    free(x);
+    free(xnew);
+    free(sim);
+    free(simnew);
+    free(jac);
+    free(jacnew);
+    free(a);
+    free(b);
+    free(r);
+    return errcode;
+}
+
+int simulate(Scalstudy *cs, double *x, double *sim, double *jac,
+             int parallel)
+/*----------------------------------------------------------------
+**  Input:   x = multipliers to simulate
+**           parallel = TRUE if periods are run in parallel from
+**                      their saved start states
+**  Output:  sim = simulated value of each observation
+**           jac = Jacobian of simulated observations
+**           returns an error code
+**  Purpose: simulates the observations made with a set of
+**           multipliers.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+
+    memcpy(cs->theta, x, cs->ngroups * sizeof(double));
+    cs->sim = sim;
+    cs->jac = jac;
+    if (parallel)
+    {
+        cs->outstates = cs->newstates;
+        workpool_run(cs->pool, cs->nperiods, runperiod, cs);
+    }
+    else
+    {
+        cs->outstates = cs->states;
+        workpool_run(cs->pool, 1, runsequence, cs);
+    }
+    for (i = 0; i < cs->nperiods; i++)
+    {
+        if (cs->errcodes[i] > 100) errcode = cs->errcodes[i];
+    }
+    cs->sim = NULL;
+    cs->jac = NULL;
+    return errcode;
+}
+
+void runsequence(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = calibration data
+**           worker = index of worker thread
+**           item = not used
+**  Output:  none
+**  Purpose: simulates each period in turn on a worker thread,
+**           each starting from the state the previous one ended
+**           with.
+**----------------------------------------------------------------
+*/
+{
+    Scalstudy *cs = (Scalstudy *)data;
+    int i;
+
+    (void)item;
+    for (i = 0; i < cs->nperiods; i++)
+    {
+        cs->errcodes[i] = simulateperiod(cs, &cs->workers[worker], i);
+        if (cs->errcodes[i] > 100) break;
+    }
+}
+
+void runperiod(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = calibration data
+**           worker = index of worker thread
+**           item = index of period
+**  Output:  none
+**  Purpose: simulates a period on a worker thread.
+**----------------------------------------------------------------
+*/
+{
+    Scalstudy *cs = (Scalstudy *)data;
+
+    cs->errcodes[item] = simulateperiod(cs, &cs->workers[worker], item);
+}
+
+int simulateperiod(Scalstudy *cs, Scalworker *w, int period)
+/*----------------------------------------------------------------
+**  Input:   w = worker thread's data
+**           period = index of period
+**  Output:  returns an error or warning code
+**  Purpose: simulates a period, finding the simulated value of
+**           each of its observations and their Jacobian.
+**----------------------------------------------------------------
+*/
+{
+    Project *p = w->project;
+    Network *net = &p->network;
+    int i, k, last, errcode, warning = 0;
+    long t, tstep, endtime;
+    char **out = cs->outstates;
+
+    // Make the worker's project a clone of the base project
+    // with the multipliers applied, starting from the period's
+    // start state
+    errcode = EN_cloneproject(cs->base, p, NULL, "");
+    if (!errcode) errcode = applygroups(cs, p, cs->theta);
+    if (!errcode) errcode = EN_openH(p);
+    if (!errcode) errcode = EN_initH(p, EN_NOSAVE);
+    if (!errcode && period > 0)
+    {
+        errcode = restorestate(p, cs->states[period], cs->statesize);
+    }
+    if (errcode > 100)
+    {
+        EN_closeH(p);
+        return errcode;
+    }
+    resettanks(cs, p, period);
+    for (k = 0; k < cs->ngroups; k++)
+    {
+        memset(w->dh[k], 0, (net->Nnodes + 1) * sizeof(double));
+    }
+
+    // Simulate the period one hydraulic time step at a time
+    i = cs->firstobs[period];
+    last = cs->firstobs[period + 1];
+    endtime = (period + 1 < cs->nperiods) ? cs->starttime[period + 1] : -1;
+    do
+    {
+        errcode = EN_runH(p, &t);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+
+        // Find the Jacobian of the solution & the time step
+        // during which it applies
+        for (k = net->Njuncs + 1; k <= net->Nnodes; k++)
+        {
+            w->tankhead[k] = p->hydraul.NodeHead[k];
+        }
+        errcode = findjacobian(cs, w);
+        if (errcode) break;
+        errcode = EN_nextH(p, &tstep);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+
+        // Add the observations made during the time step
+        while (i < last && (cs->obs[i].time < t + tstep || tstep == 0))
+        {
+            addobservation(cs, w, i);
+            i++;
+        }
+        updatetanks(cs, w, tstep);
+
+        // Save the start state of the next period
+        if (endtime > 0 && t + tstep >= endtime)
+        {
+            if (cs->statesize == 0) cs->statesize = statesize(p);
+            if (out[period + 1] == NULL)
+            {
+                out[period + 1] = (char *)malloc(cs->statesize);
+            }
+            if (out[period + 1] == NULL) errcode = 101;
+            else errcode = savestate(p, out[period + 1], cs->statesize);
+            break;
+        }
+    } while (tstep > 0 && (i < last || endtime > 0));
+    EN_closeH(p);
+    return (errcode > 100) ? errcode : warning;
+}
+
+int applygroups(Scalstudy *cs, EN_Project p, double *x)
+/*----------------------------------------------------------------
+**  Input:   p = project to be changed (a clone of the base
+**               project or the base project itself)
+**           x = each group's multiplier
+**  Output:  returns an error code
+**  Purpose: scales the roughness values and demands of a
+**           project's groups of pipes and junctions.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    int i, j, ncats, errcode = 0;
+    double v;
+
+    for (i = 1; i <= net->Njuncs && !errcode; i++)
+    {
+        if (cs->dgroup[i] == 0 || x[cs->dgroup[i] - 1] == 1.0) continue;
+        ERRCODE(EN_getnumdemands(p, i, &ncats));
+        for (j = 1; j <= ncats && !errcode; j++)
+        {
+            ERRCODE(EN_getbasedemand(p, i, j, &v));
+            ERRCODE(EN_setbasedemand(p, i, j, v * x[cs->dgroup[i] - 1]));
+        }
+    }
+    for (i = 1; i <= net->Nlinks && !errcode; i++)
+    {
+        if (cs->rgroup[i] == 0 || x[cs->rgroup[i] - 1] == 1.0) continue;
+        ERRCODE(EN_setlinkvalue(p, i, EN_ROUGHNESS,
+                                cs->coeff[i] * x[cs->rgroup[i] - 1]));
+    }
+    return errcode;
+}
+
+void resettanks(Scalstudy *cs, Project *p, int period)
+/*----------------------------------------------------------------
+**  Input:   p = worker's project
+**           period = index of period
+**  Output:  none
+**  Purpose: sets the tank levels at the start of a period to
+**           their observed values.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    Stank *tank;
+    Sobserv *obs;
+    int i, j;
+    double h;
+
+    if (period == 0 && !cs->reset0) return;
+    for (i = cs->firstobs[period]; i < cs->nobs; i++)
+    {
+        obs = &cs->obs[i];
+        if (obs->time > cs->starttime[period]) break;
+        if (obs->type != OBS_LEVEL) continue;
+        j = obs->index - net->Njuncs;
+        tank = &net->Tank[j];
+        h = net->Node[obs->index].El + obs->value / p->Ucf[ELEV];
+        h = MIN(MAX(h, tank->Hmin), tank->Hmax);
+        tank->V = tankvolume(p, j, h);
+        p->hydraul.NodeHead[obs->index] = h;
+    }
+}
+
+int findjacobian(Scalstudy *cs, Scalworker *w)
+/*----------------------------------------------------------------
+**  Input:   w = worker thread's data
+**  Output:  returns an error code
+**  Purpose: finds the change in the current solution's heads
+**           and flows per unit change in each group's
+**           multiplier.
+**----------------------------------------------------------------
+*/
+{
+    Project *p = w->project;
+    Network *net = &p->network;
+    Hydraul *hyd = &p->hydraul;
+    int i, k, param, errcode = 0;
+
+    if (!hyd->Factored) return 109;
+    for (k = 0; k < cs->ngroups && !errcode; k++)
+    {
+        // A multiplier changes the roughness of a group's pipes by
+        // their base values and its junctions' demands by their
+        // current demands divided by the multiplier
+        memset(w->dp, 0, (net->Nnodes + net->Nlinks + 1) * sizeof(double));
+        if (cs->groups[k].type == CALIB_ROUGHNESS)
+        {
+            param = EN_SENS_ROUGHNESS;
+            for (i = 1; i <= net->Nlinks; i++)
+            {
+                if (cs->rgroup[i] == k + 1) w->dp[i] = cs->coeff[i];
+            }
+        }
+        else
+        {
+            param = EN_SENS_DEMAND;
+            for (i = 1; i <= net->Njuncs; i++)
+            {
+                if (cs->dgroup[i] != k + 1) continue;
+                w->dp[i] = hyd->FullDemand[i] * p->Ucf[FLOW] / cs->theta[k];
+            }
+        }
+
+        // The heads of tanks in w->dh[k] carry over from the
+        // previous time step
+        errcode = linearsens(p, param, w->dp, w->dh[k], w->dq[k]);
+    }
+    return errcode;
+}
+
+void addobservation(Scalstudy *cs, Scalworker *w, int i)
+/*----------------------------------------------------------------
+**  Input:   w = worker thread's data
+**           i = index of observation
+**  Output:  none
+**  Purpose: finds the simulated value of an observation and its
+**           row of the Jacobian from the current solution.
+**----------------------------------------------------------------
+*/
+{
+    Project *p = w->project;
+    Network *net = &p->network;
+    Hydraul *hyd = &p->hydraul;
+    Sobserv *obs = &cs->obs[i];
+    int k, n = obs->index;
+    double h, cf;
+
+    if (obs->type == OBS_FLOW)
+    {
+        cf = p->Ucf[FLOW];
+        if (hyd->LinkStatus[n] <= CLOSED) cs->sim[i] = 0.0;
+        else cs->sim[i] = hyd->LinkFlow[n] * cf;
+        for (k = 0; k < cs->ngroups; k++)
+        {
+            cs->jac[i * cs->ngroups + k] = w->dq[k][n] * cf;
+        }
+    }
+    else
+    {
+        cf = (obs->type == OBS_LEVEL) ? p->Ucf[ELEV] : p->Ucf[PRESSURE];
+        h = (n <= net->Njuncs) ? hyd->NodeHead[n] : w->tankhead[n];
+        cs->sim[i] = (h - net->Node[n].El) * cf;
+        for (k = 0; k < cs->ngroups; k++)
+        {
+            cs->jac[i * cs->ngroups + k] = w->dh[k][n] * cf;
+        }
+    }
+}
+
+void updatetanks(Scalstudy *cs, Scalworker *w, long tstep)
+/*----------------------------------------------------------------
+**  Input:   w = worker thread's data
+**           tstep = time step (sec)
+**  Output:  none
+**  Purpose: carries the change in each tank's head per unit
+**           change in each multiplier over a time step.
+**----------------------------------------------------------------
+*/
+{
+    Project *p = w->project;
+    Network *net = &p->network;
+    Stank *tank;
+    int j, k, n, n1, n2;
+    double *dqnet = w->dp, area, h;
+
+    if (tstep == 0) return;
+    for (k = 0; k < cs->ngroups; k++)
+    {
+        // Change in net inflow to each tank
+        memset(dqnet, 0, (net->Nnodes + 1) * sizeof(double));
+        for (j = 1; j <= net->Nlinks; j++)
+        {
+            n1 = net->Link[j].N1;
+            n2 = net->Link[j].N2;
+            if (n1 > net->Njuncs) dqnet[n1] -= w->dq[k][j];
+            if (n2 > net->Njuncs) dqnet[n2] += w->dq[k][j];
+        }
+
+        // Change in tank level = change in volume / area
+        for (j = 1; j <= net->Ntanks; j++)
+        {
+            tank = &net->Tank[j];
+            if (tank->A == 0.0) continue;
+            n = tank->Node;
+            area = tank->A;
+            if (tank->Vcurve > 0)
+            {
+                h = w->tankhead[n];
+                area = (tankvolume(p, j, h + 0.01) -
+                        tankvolume(p, j, h - 0.01)) / 0.02;
+            }
+            if (area > 0.0) w->dh[k][n] += dqnet[n] * tstep / area;
+        }
+    }
+}
+
+double sumofsquares(Scalstudy *cs, double *sim, double *jac, double *r)
+/*----------------------------------------------------------------
+**  Input:   sim = simulated value of each observation
+**           jac = Jacobian of simulated observations
+**  Output:  jac = Jacobian scaled by observation weights
+**           r = weighted residual of each observation
+**           returns sum of squared weighted residuals
+**  Purpose: finds the residuals of a simulation.
+**----------------------------------------------------------------
+*/
+{
+    int i, k;
+    double w, sse = 0.0;
+
+    for (i = 0; i < cs->nobs; i++)
+    {
+        w = cs->weights[cs->obs[i].type];
+        r[i] = w * (sim[i] - cs->obs[i].value);
+        sse += r[i] * r[i];
+        for (k = 0; k < cs->ngroups; k++) jac[i * cs->ngroups + k] *= w;
+    }
+    return sse;
+}
+
+int solvesystem(int n, double *a, double *b)
+/*----------------------------------------------------------------
+**  Input:   n = number of equations
+**           a = n x n coeff. matrix (row by row)
+**           b = right hand side
+**  Output:  b = solution
+**           returns FALSE if a is singular
+**  Purpose: solves a small dense set of linear equations by
+**           Gaussian elimination with partial pivoting.
+**----------------------------------------------------------------
+*/
+{
+    int i, j, k, p;
+    double f, t;
+
+    for (k = 0; k < n; k++)
+    {
+        p = k;
+        for (i = k + 1; i < n; i++)
+        {
+            if (ABS(a[i * n + k]) > ABS(a[p * n + k])) p = i;
+        }
+        if (a[p * n + k] == 0.0) return FALSE;
+        if (p != k)
+        {
+            for (j = 0; j < n; j++)
+            {
+                t = a[k * n + j];
+                a[k * n + j] = a[p * n + j];
+                a[p * n + j] = t;
+            }
+            t = b[k];
+            b[k] = b[p];
+            b[p] = t;
+        }
+        for (i = k + 1; i < n; i++)
+        {
+            f = a[i * n + k] / a[k * n + k];
+            for (j = k; j < n; j++) a[i * n + j] -= f * a[k * n + j];
+            b[i] -= f * b[k];
+        }
+    }
+    for (k = n - 1; k >= 0; k--)
+    {
+        for (j = k + 1; j < n; j++) b[k] -= a[k * n + j] * b[j];
+        b[k] /= a[k * n + k];
+    }
+    return TRUE;
+}
+
+void writecalstudy(Scalstudy *cs, FILE *f)
+/*----------------------------------------------------------------
+**  Input:   f = report file
+**  Output:  none
+**  Purpose: writes the results of a calibration.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = cs->base;
+    Network *net = &pr->network;
+    Report *rpt = &pr->report;
+    Sobserv *obs;
+    Scalgroup *g;
+    int i, field, prec;
+    char atime[13];
+    char *id;
+    static char *typenames[] = {"Pressure", "Flow", "Level"};
+
+    fprintf(f, "Calibration Analysis\n");
+    fprintf(f, "Observations:      %d\n", cs->nobs);
+    fprintf(f, "Periods:           %d\n", cs->nperiods);
+    fprintf(f, "Iterations:        %d\n", cs->iterations);
+    fprintf(f, "Sum of Squares:    %.6g initial, %.6g final\n\n",
+            cs->sse0, cs->sse);
+    fprintf(f, "%-*s %-9s %10s %10s %10s\n", MAXID, "Group", "Type",
+            "Multiplier", "Lower", "Upper");
+    for (i = 0; i < cs->ngroups; i++)
+    {
+        g = &cs->groups[i];
+        fprintf(f, "%-*s %-9s %10.4f %10.4f %10.4f\n", MAXID, g->name,
+                (g->type == CALIB_ROUGHNESS) ? "Roughness" : "Demand",
+                g->value, g->lower, g->upper);
+    }
+
+    fprintf(f, "\n%-10s %-9s %-*s %12s %12s %12s\n", "Time", "Type",
+            MAXID, "Node/Link", "Observed", "Simulated", "Residual");
+    for (i = 0; i < cs->nobs; i++)
+    {
+        obs = &cs->obs[i];
+        if (obs->type == OBS_FLOW)
+        {
+            field = FLOW;
+            id = net->Link[obs->index].ID;
+        }
+        else
+        {
+            field = (obs->type == OBS_LEVEL) ? ELEV : PRESSURE;
+            id = net->Node[obs->index].ID;
+        }
+        prec = rpt->Field[field].Precision;
+        fprintf(f, "%-10s %-9s %-*s %12.*f %12.*f %12.*f\n",
+                clocktime(atime, obs->time), typenames[obs->type], MAXID,
+                id, prec, obs->value, prec, cs->sim[i], prec,
+                cs->sim[i] - obs->value);
+    }
+}
+
+void freecalstudy(Scalstudy *cs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory used by a calibration.
+**----------------------------------------------------------------
+*/
+{
+    Scalworker *w;
+    int i, k;
+
+    for (i = 0; cs->workers && i < cs->nworkers; i++)
+    {
+        w = &cs->workers[i];
+        if (w->project) EN_deleteproject(w->project);
+        for (k = 0; k < cs->ngroups; k++)
+        {
+            if (w->dh) free(w->dh[k]);
+            if (w->dq) free(w->dq[k]);
+        }
+        free(w->dh);
+        free(w->dq);
+        free(w->dp);
+        free(w->tankhead);
+    }
+    for (i = 0; i <= cs->nperiods; i++)
+    {
+        if (cs->states) free(cs->states[i]);
+        if (cs->newstates) free(cs->newstates[i]);
+    }
+    free(cs->workers);
+    workpool_delete(cs->pool);
+    free(cs->states);
+    free(cs->newstates);
+    free(cs->groups);
+    free(cs->rgroup);
+    free(cs->dgroup);
+    free(cs->coeff);
+    free(cs->obs);
+    free(cs->starttime);
+    free(cs->firstobs);
+    free(cs->theta);
+    free(cs->sim);
+    free(cs->errcodes);
+}
@@ -0,0 +1,975 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       clone.c
+ Description:  creates copies of a project that share its network data
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A project can be cloned into another project that shares its network data
+(nodes, links, tanks, pumps, valves, controls, time patterns, data curves,
+rules, ID hash tables and the structure of the sparse hydraulic matrix)
+instead of reading the data again from an input file. Each group of shared
+data (see SharedData in TYPES.H) has a reference count held by all of the
+projects using it, and a project makes its own copy of a group only when it
+is about to change it (copy-on-write):
+
+  - API functions that edit network data call unshare() for the groups they
+    write to, while those that change the network's layout (adding and
+    deleting nodes & links, changing a link's end nodes) call unshareall()
+    and also drop the shared sparse matrix structure.
+  - openhyd() calls unsharehyd() and openqual() calls unsharequal() for the
+    groups written to by the hydraulic and water quality solvers (e.g., link
+    flow resistances, tank volumes & qualities, pump energy usage).
+  - freedata() calls releaseshared() to drop the project's references, with
+    the last project using a group of data freeing it.
+
+Reference counts are updated atomically so that projects sharing data can be
+run from different threads. The vertices, comments and tags of links are a
+group of their own so that the links array, which is written to by the
+hydraulic solver, can be copied without duplicating them.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#include "types.h"
+#include "funcs.h"
+#include "hash.h"
+
+// Imported functions
+extern int  createsparse(Project *);
+extern void freesparse(Project *);
+
+// Atomic reference count operations
+#ifdef _MSC_VER
+#define refcount_add(x)  InterlockedIncrement(x)
+#define refcount_sub(x)  InterlockedDecrement(x)
+#define refcount_get(x)  InterlockedCompareExchange(x, 0, 0)
+#else
+#define refcount_add(x)  __atomic_add_fetch(x, 1, __ATOMIC_ACQ_REL)
+#define refcount_sub(x)  __atomic_sub_fetch(x, 1, __ATOMIC_ACQ_REL)
+#define refcount_get(x)  __atomic_load_n(x, __ATOMIC_ACQUIRE)
+#endif
+
+// Exported functions (declared in funcs.h)
+//int     cloneproject(Project *, Project *, const char *, const char *);
+//int     unshare(Project *, int);
+//int     unshareall(Project *);
+//int     unsharehyd(Project *);
+//int     unsharequal(Project *);
+//int     unshareobject(Project *, int);
+//void    releaseshared(Project *);
+
+// Local functions
+static int   sharesparse(Project *);
+static void  copysettings(Project *, Project *);
+static void  noreportfile(Project *, const char *);
+static int   allocresults(Project *);
+static void  releasepart(Project *, int);
+static int   copypart(Project *, int);
+static int   copynodes(Network *);
+static int   copylinkextras(Network *);
+static int   copypatterns(Network *);
+static int   copycurves(Network *);
+static int   copyrules(Network *);
+static int   copyhashtables(Network *);
+static void  freepart(Project *, Network *, int);
+static void  *duplicate(const void *, size_t, int *);
+static char  *dupstring(const char *, int *);
+
+
+int cloneproject(Project *pr, Project *clone, const char *rptFile,
+                 const char *outFile)
+/*----------------------------------------------------------------
+**  Input:   pr = project being cloned
+**           clone = project that becomes a copy of pr
+**           rptFile = name of clone's report file (NULL if the
+**                     clone writes no report)
+**           outFile = name of clone's binary output file
+**  Output:  returns an error code
+**  Purpose: makes a project a copy of another one that shares
+**           its network data.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    int part, errcode = 0;
+
+    // Set system flags
+    clone->Openflag = FALSE;
+    clone->hydraul.OpenHflag = FALSE;
+    clone->quality.OpenQflag = FALSE;
+    clone->outfile.SaveHflag = FALSE;
+    clone->outfile.SaveQflag = FALSE;
+    clone->Warnflag = FALSE;
+
+    // Build the sparse matrix structure shared by the parent & its clones
+    if (net->Sparse == NULL && net->Nnodes >= 2) ERRCODE(sharesparse(pr));
+
+    // Give each group of the parent's data a reference count
+    for (part = 0; part < MAXSHARED; part++)
+    {
+        if (part == SHARED_MATRIX && net->Sparse == NULL) continue;
+        if (net->Refcount[part] != NULL) continue;
+        net->Refcount[part] = (long *)malloc(sizeof(long));
+        if (net->Refcount[part] == NULL) errcode = 101;
+        else *net->Refcount[part] = 1;
+    }
+    if (errcode) return errcode;
+
+    // Copy the parent's analysis options & open the clone's files
+    copysettings(pr, clone);
+    initpointers(clone);
+    if (rptFile) errcode = openfiles(clone, "", rptFile, outFile);
+    else noreportfile(clone, outFile);
+    if (errcode) return errcode;
+
+    // Share the parent's network data with the clone
+    clone->network = *net;
+    clone->network.Adjlist = NULL;
+    for (part = 0; part < MAXSHARED; part++)
+    {
+        if (net->Refcount[part]) refcount_add(net->Refcount[part]);
+    }
+
+    // Allocate the clone's own arrays of computed results
+    errcode = allocresults(clone);
+
+    // The parent needs its own copies of data being written
+    // to by any of its solvers that are open
+    if (!errcode && pr->hydraul.OpenHflag) errcode = unsharehyd(pr);
+    if (!errcode && pr->quality.OpenQflag) errcode = unsharequal(pr);
+
+    if (errcode) freedata(clone);
+    else clone->Openflag = TRUE;
+    return errcode;
+}
+
+int unshare(Project *pr, int part)
+/*----------------------------------------------------------------
+**  Input:   part = a group of network data (see SharedData)
+**  Output:  returns an error code
+**  Purpose: gives a project its own copy of a group of network
+**           data that it shares with other projects.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Network old;
+    long *count = net->Refcount[part];
+    int errcode = 0;
+
+    if (count == NULL) return 0;
+
+    // The sparse matrix structure is dropped rather than copied
+    if (part == SHARED_MATRIX)
+    {
+        releasepart(pr, part);
+        return 0;
+    }
+
+    // Link extras are copied into the project's own links array
+    if (part == SHARED_LINKEXTRA)
+    {
+        errcode = unshare(pr, SHARED_LINKS);
+        if (errcode) return errcode;
+    }
+
+    // Copy the data if other projects still use it
+    if (refcount_get(count) > 1)
+    {
+        old = *net;
+        errcode = copypart(pr, part);
+        if (errcode) return errcode;
+
+        // Free the original data if the other projects
+        // stopped using it while it was being copied
+        if (refcount_sub(count) > 0) count = NULL;
+        else freepart(pr, &old, part);
+        if (part == SHARED_LINKEXTRA) free(old.Link);
+    }
+    free(count);
+    net->Refcount[part] = NULL;
+    return 0;
+}
+
+int unshareall(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: gives a project its own copy of all of its network
+**           data (but not of the sparse matrix structure).
+**----------------------------------------------------------------
+*/
+{
+    int part, errcode = 0;
+
+    for (part = 0; part < MAXSHARED; part++)
+    {
+        if (part == SHARED_MATRIX) continue;
+        ERRCODE(unshare(pr, part));
+    }
+    return errcode;
+}
+
+int unsharehyd(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: gives a project its own copy of the network data
+**           written to by the hydraulic solver.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    int i, k, errcode = 0;
+
+    // Link flow resistances & minor losses, tank volumes,
+    // and pump curve coeffs. & energy usage
+    ERRCODE(unshare(pr, SHARED_LINKS));
+    ERRCODE(unshare(pr, SHARED_TANKS));
+    ERRCODE(unshare(pr, SHARED_PUMPS));
+
+    // Node result indexes are re-numbered only if they changed
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        if (net->Node[i].ResultIndex == i) continue;
+        ERRCODE(unshare(pr, SHARED_NODES));
+        break;
+    }
+
+    // Types of curves used as pump curves are only assigned once
+    for (i = 1; i <= net->Npumps; i++)
+    {
+        k = net->Pump[i].Hcurve;
+        if (k <= 0 || net->Curve[k].Type == PUMP_CURVE) continue;
+        ERRCODE(unshare(pr, SHARED_CURVES));
+        break;
+    }
+    return errcode;
+}
+
+int unsharequal(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: gives a project its own copy of the network data
+**           written to by the water quality solver.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    int i, errcode = 0;
+
+    // Pipe wall reaction coeffs. and tank qualities
+    ERRCODE(unshare(pr, SHARED_LINKS));
+    ERRCODE(unshare(pr, SHARED_TANKS));
+
+    // Mass inflow rates of water quality sources
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        if (net->Node[i].S == NULL) continue;
+        ERRCODE(unshare(pr, SHARED_NODES));
+        break;
+    }
+    return errcode;
+}
+
+int unshareobject(Project *pr, int object)
+/*----------------------------------------------------------------
+**  Input:   object = a type of network object (see ObjectType)
+**  Output:  returns an error code
+**  Purpose: gives a project its own copy of the data that holds
+**           the comments & tags of a type of object.
+**----------------------------------------------------------------
+*/
+{
+    switch (object)
+    {
+    case NODE:    return unshare(pr, SHARED_NODES);
+    case LINK:    return unshare(pr, SHARED_LINKEXTRA);
+    case TIMEPAT: return unshare(pr, SHARED_PATTERNS);
+    case CURVE:   return unshare(pr, SHARED_CURVES);
+    default:      return 0;
+    }
+}
+
+void releaseshared(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: drops a project's references to network data it
+**           shares with other projects.
+**----------------------------------------------------------------
+*/
+{
+    int part;
+
+    // Link extras are released while the links array is still in place
+    releasepart(pr, SHARED_LINKEXTRA);
+    for (part = 0; part < MAXSHARED; part++) releasepart(pr, part);
+}
+
+int sharesparse(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: builds the structure of the sparse hydraulic matrix
+**           to be shared by a project and its clones.
+**----------------------------------------------------------------
+*/
+{
+    Project *tmp;
+    Smatrix *sm;
+    int errcode;
+
+    // The matrix is built on a scratch project that
+    // refers to the parent's network data
+    tmp = (Project *)calloc(1, sizeof(Project));
+    sm = (Smatrix *)calloc(1, sizeof(Smatrix));
+    if (tmp == NULL || sm == NULL)
+    {
+        free(tmp);
+        free(sm);
+        return 101;
+    }
+    tmp->network = pr->network;
+    tmp->network.Adjlist = NULL;
+    tmp->network.Sparse = NULL;
+    errcode = createsparse(tmp);
+    freeadjlists(&tmp->network);
+
+    // Keep only the matrix structure (freesparse() frees
+    // just the solver's arrays of a borrowed structure)
+    if (!errcode) *sm = tmp->hydraul.smatrix;
+    tmp->hydraul.smatrix.Borrowed = !errcode;
+    freesparse(tmp);
+    free(tmp);
+    if (errcode)
+    {
+        free(sm);
+        return errcode;
+    }
+    sm->Aii = NULL;
+    sm->Aij = NULL;
+    sm->F = NULL;
+    sm->temp = NULL;
+    sm->link = NULL;
+    sm->first = NULL;
+    sm->Borrowed = FALSE;
+    pr->network.Sparse = sm;
+    return 0;
+}
+
+void copysettings(Project *pr, Project *clone)
+/*----------------------------------------------------------------
+**  Input:   pr = project being cloned
+**           clone = project being made a copy of pr
+**  Output:  none
+**  Purpose: copies a project's analysis options to its clone.
+**----------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &clone->hydraul;
+    Quality *qual = &clone->quality;
+
+    clone->parser = pr->parser;
+    clone->parser.PrevPat = NULL;
+    clone->parser.PrevCurve = NULL;
+    clone->parser.X = NULL;
+    clone->times = pr->times;
+    clone->report = pr->report;
+    memcpy(clone->Ucf, pr->Ucf, sizeof(pr->Ucf));
+    memcpy(clone->Title, pr->Title, sizeof(pr->Title));
+    strncpy(clone->MapFname, pr->MapFname, MAXFNAME);
+    clone->MapFname[MAXFNAME] = '\0';
+    clone->outfile.Hydflag = SCRATCH;
+    clone->outfile.Saveflag = FALSE;
+    clone->outfile.HydMemory = pr->outfile.HydMemory;
+
+    // Hydraulic & water quality options are copied along with
+    // solver variables, whose arrays are then cleared
+    // (the rest are cleared by initpointers())
+    *hyd = pr->hydraul;
+    hyd->OpenHflag = FALSE;
+    memset(&hyd->smatrix, 0, sizeof(Smatrix));
+    memset(&hyd->schedule, 0, sizeof(Sschedule));
+    memset(&hyd->dmatrix, 0, sizeof(SdemandMatrix));
+    memset(&hyd->zones, 0, sizeof(Szones));
+    memset(&hyd->domains, 0, sizeof(Sdomains));
+    *qual = pr->quality;
+    qual->OpenQflag = FALSE;
+    qual->InletQual = NULL;
+    qual->SortedNodes = NULL;
+    qual->NewFlows = NULL;
+    qual->SortPos = NULL;
+    qual->SortMark = NULL;
+    qual->SortWork = NULL;
+    qual->Segs = NULL;
+    qual->SegRing = NULL;
+    memset(qual->SegQual, 0, sizeof(qual->SegQual));
+    memset(qual->ConstitQual, 0, sizeof(qual->ConstitQual));
+    qual->NodeMass = NULL;
+    qual->StageNodes = NULL;
+    qual->StageStart = NULL;
+    qual->StageShared = NULL;
+    qual->NodeLevel = NULL;
+    qual->Pool = NULL;
+    qual->FlowDir = NULL;
+}
+
+void noreportfile(Project *pr, const char *outFile)
+/*----------------------------------------------------------------
+**  Input:   outFile = name of binary output file
+**  Output:  none
+**  Purpose: sets up the files of a clone that writes no report
+**           (see openfiles() in PROJECT.C).
+**----------------------------------------------------------------
+*/
+{
+    pr->parser.InFile = NULL;
+    pr->report.RptFile = NULL;
+    pr->outfile.OutFile = NULL;
+    pr->outfile.HydFile = NULL;
+    pr->outfile.HydStore = NULL;
+    pr->outfile.HydData = NULL;
+    pr->outfile.TmpOutFile = NULL;
+    pr->outfile.ConstitFile = NULL;
+    strcpy(pr->parser.InpFname, "");
+    strcpy(pr->report.Rpt1Fname, "");
+    strncpy(pr->outfile.OutFname, outFile, MAXFNAME);
+    if (strlen(outFile) > 0) pr->outfile.Outflag = SAVE;
+    else
+    {
+        pr->outfile.Outflag = SCRATCH;
+        strcpy(pr->outfile.OutFname, pr->TmpOutFname);
+    }
+}
+
+int allocresults(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: allocates a clone's arrays of computed results.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    int n, errcode = 0;
+
+    n = net->Nnodes + 1;
+    hyd->NodeDemand = (double *)calloc(n, sizeof(double));
+    hyd->NodeHead = (double *)calloc(n, sizeof(double));
+    pr->quality.NodeQual = (double *)calloc(n, sizeof(double));
+    hyd->FullDemand = (double *)calloc(n, sizeof(double));
+    hyd->DemandFlow = (double *)calloc(n, sizeof(double));
+    hyd->EmitterFlow = (double *)calloc(n, sizeof(double));
+    hyd->LeakageFlow = (double *)calloc(n, sizeof(double));
+    ERRCODE(MEMCHECK(hyd->NodeDemand));
+    ERRCODE(MEMCHECK(hyd->NodeHead));
+    ERRCODE(MEMCHECK(pr->quality.NodeQual));
+    ERRCODE(MEMCHECK(hyd->FullDemand));
+    ERRCODE(MEMCHECK(hyd->DemandFlow));
+    ERRCODE(MEMCHECK(hyd->EmitterFlow));
+    ERRCODE(MEMCHECK(hyd->LeakageFlow));
+
+    n = net->Nlinks + 1;
+    hyd->LinkFlow = (double *)calloc(n, sizeof(double));
+    hyd->LinkSetting = (double *)calloc(n, sizeof(double));
+    hyd->LinkStatus = (StatusType *)calloc(n, sizeof(StatusType));
+    ERRCODE(MEMCHECK(hyd->LinkFlow));
+    ERRCODE(MEMCHECK(hyd->LinkSetting));
+    ERRCODE(MEMCHECK(hyd->LinkStatus));
+    return errcode;
+}
+
+void releasepart(Project *pr, int part)
+/*----------------------------------------------------------------
+**  Input:   part = a group of network data (see SharedData)
+**  Output:  none
+**  Purpose: drops a project's reference to a group of shared
+**           network data, freeing it if no longer used.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    long *count = net->Refcount[part];
+    int i;
+
+    if (count == NULL) return;
+    if (refcount_sub(count) == 0)
+    {
+        free(count);
+        freepart(pr, net, part);
+    }
+    net->Refcount[part] = NULL;
+
+    // Detach the data from the project
+    switch (part)
+    {
+    case SHARED_NODES:    net->Node = NULL;    break;
+    case SHARED_LINKS:    net->Link = NULL;    break;
+    case SHARED_TANKS:    net->Tank = NULL;    break;
+    case SHARED_PUMPS:    net->Pump = NULL;    break;
+    case SHARED_VALVES:   net->Valve = NULL;   break;
+    case SHARED_CONTROLS: net->Control = NULL; break;
+    case SHARED_PATTERNS: net->Pattern = NULL; break;
+    case SHARED_CURVES:   net->Curve = NULL;   break;
+    case SHARED_RULES:    net->Rule = NULL;    break;
+    case SHARED_MATRIX:   net->Sparse = NULL;  break;
+    case SHARED_HASH:
+        net->NodeHashTable = NULL;
+        net->LinkHashTable = NULL;
+        break;
+
+    // Link extras are cleared only from a links array
+    // that the project doesn't share
+    case SHARED_LINKEXTRA:
+        if (net->Link == NULL || net->Refcount[SHARED_LINKS]) break;
+        for (i = 1; i <= net->Nlinks; i++)
+        {
+            net->Link[i].Vertices = NULL;
+            net->Link[i].Comment = NULL;
+            net->Link[i].Tag = NULL;
+        }
+        break;
+    }
+}
+
+int copypart(Project *pr, int part)
+/*----------------------------------------------------------------
+**  Input:   part = a group of network data (see SharedData)
+**  Output:  returns an error code
+**  Purpose: replaces a group of a project's network data with
+**           a copy of it.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Network copy = *net;
+    int errcode = 0;
+
+    switch (part)
+    {
+    case SHARED_NODES:
+        errcode = copynodes(&copy);
+        break;
+    case SHARED_LINKS:
+        copy.Link = duplicate(net->Link,
+                    (net->Nlinks + 1) * sizeof(Slink), &errcode);
+        break;
+    case SHARED_LINKEXTRA:
+        errcode = copylinkextras(&copy);
+        break;
+    case SHARED_TANKS:
+        copy.Tank = duplicate(net->Tank,
+                    (net->Ntanks + 1) * sizeof(Stank), &errcode);
+        break;
+    case SHARED_PUMPS:
+        copy.Pump = duplicate(net->Pump,
+                    (net->Npumps + 1) * sizeof(Spump), &errcode);
+        break;
+    case SHARED_VALVES:
+        copy.Valve = duplicate(net->Valve,
+                     (net->Nvalves + 1) * sizeof(Svalve), &errcode);
+        break;
+    case SHARED_CONTROLS:
+        copy.Control = duplicate(net->Control,
+                       (net->Ncontrols + 1) * sizeof(Scontrol), &errcode);
+        break;
+    case SHARED_PATTERNS:
+        errcode = copypatterns(&copy);
+        break;
+    case SHARED_CURVES:
+        errcode = copycurves(&copy);
+        break;
+    case SHARED_RULES:
+        errcode = copyrules(&copy);
+        break;
+    case SHARED_HASH:
+        errcode = copyhashtables(&copy);
+        break;
+    }
+
+    // Free a partial copy
+    if (errcode)
+    {
+        freepart(pr, &copy, part);
+        if (part == SHARED_LINKEXTRA) free(copy.Link);
+        return errcode;
+    }
+    *net = copy;
+    return 0;
+}
+
+int copynodes(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose nodes are copied
+**  Output:  returns an error code
+**  Purpose: copies a network's nodes with their demands, water
+**           quality sources, comments and tags.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+    Snode *node;
+    Pdemand demand;
+
+    node = duplicate(net->Node, (net->Nnodes + 1) * sizeof(Snode), &errcode);
+    net->Node = node;
+    if (errcode) return errcode;
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        demand = node[i].D;
+        node[i].D = NULL;
+        for (; demand != NULL; demand = demand->next)
+        {
+            if (!adddemand(&node[i], demand->Base, demand->Pat, demand->Name))
+            {
+                errcode = 101;
+            }
+        }
+        node[i].S = duplicate(node[i].S, sizeof(struct Ssource), &errcode);
+        node[i].Comment = dupstring(node[i].Comment, &errcode);
+        node[i].Tag = dupstring(node[i].Tag, &errcode);
+    }
+    return errcode;
+}
+
+int copylinkextras(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose links are copied
+**  Output:  returns an error code
+**  Purpose: copies a network's links with their vertices,
+**           comments and tags.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+    Slink *link;
+    Pvertices vert;
+
+    link = duplicate(net->Link, (net->Nlinks + 1) * sizeof(Slink), &errcode);
+    net->Link = link;
+    if (errcode) return errcode;
+    for (i = 1; i <= net->Nlinks; i++)
+    {
+        vert = link[i].Vertices;
+        if (vert)
+        {
+            link[i].Vertices = duplicate(vert, sizeof(struct Svertices),
+                                         &errcode);
+            if (link[i].Vertices)
+            {
+                link[i].Vertices->X = duplicate(vert->X,
+                                      vert->Capacity * sizeof(double), &errcode);
+                link[i].Vertices->Y = duplicate(vert->Y,
+                                      vert->Capacity * sizeof(double), &errcode);
+            }
+        }
+        link[i].Comment = dupstring(link[i].Comment, &errcode);
+        link[i].Tag = dupstring(link[i].Tag, &errcode);
+    }
+    return errcode;
+}
+
+int copypatterns(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose time patterns are copied
+**  Output:  returns an error code
+**  Purpose: copies a network's time patterns.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+    Spattern *pattern;
+
+    pattern = duplicate(net->Pattern, (net->Npats + 1) * sizeof(Spattern),
+                        &errcode);
+    net->Pattern = pattern;
+    if (errcode) return errcode;
+    for (i = 0; i <= net->Npats; i++)
+    {
+        pattern[i].F = duplicate(pattern[i].F,
+                       pattern[i].Length * sizeof(double), &errcode);
+        pattern[i].Comment = dupstring(pattern[i].Comment, &errcode);
+    }
+    return errcode;
+}
+
+int copycurves(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose data curves are copied
+**  Output:  returns an error code
+**  Purpose: copies a network's data curves.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+    Scurve *curve;
+
+    curve = duplicate(net->Curve, (net->Ncurves + 1) * sizeof(Scurve),
+                      &errcode);
+    net->Curve = curve;
+    if (errcode) return errcode;
+    for (i = 1; i <= net->Ncurves; i++)
+    {
+        curve[i].X = duplicate(curve[i].X, curve[i].Capacity * sizeof(double),
+                               &errcode);
+        curve[i].Y = duplicate(curve[i].Y, curve[i].Capacity * sizeof(double),
+                               &errcode);
+        curve[i].Comment = dupstring(curve[i].Comment, &errcode);
+    }
+    return errcode;
+}
+
+int copyrules(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose rule-based controls are copied
+**  Output:  returns an error code
+**  Purpose: copies a network's rule-based controls.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+    Srule *rule;
+    Spremise *p, **pnext;
+    Saction *a, **anext;
+
+    rule = duplicate(net->Rule, (net->Nrules + 1) * sizeof(Srule), &errcode);
+    net->Rule = rule;
+    if (errcode) return errcode;
+    for (i = 1; i <= net->Nrules; i++)
+    {
+        // Copy premises
+        p = rule[i].Premises;
+        for (pnext = &rule[i].Premises; p != NULL; p = p->next)
+        {
+            *pnext = duplicate(p, sizeof(Spremise), &errcode);
+            if (*pnext == NULL) break;
+            pnext = &(*pnext)->next;
+        }
+        *pnext = NULL;
+
+        // Copy THEN actions
+        a = rule[i].ThenActions;
+        for (anext = &rule[i].ThenActions; a != NULL; a = a->next)
+        {
+            *anext = duplicate(a, sizeof(Saction), &errcode);
+            if (*anext == NULL) break;
+            anext = &(*anext)->next;
+        }
+        *anext = NULL;
+
+        // Copy ELSE actions
+        a = rule[i].ElseActions;
+        for (anext = &rule[i].ElseActions; a != NULL; a = a->next)
+        {
+            *anext = duplicate(a, sizeof(Saction), &errcode);
+            if (*anext == NULL) break;
+            anext = &(*anext)->next;
+        }
+        *anext = NULL;
+    }
+    return errcode;
+}
+
+int copyhashtables(Network *net)
+/*----------------------------------------------------------------
+**  Input:   net = network whose ID hash tables are copied
+**  Output:  returns an error code
+**  Purpose: builds new node & link ID hash tables for a network.
+**----------------------------------------------------------------
+*/
+{
+    int i, errcode = 0;
+
+    net->NodeHashTable = hashtable_create();
+    net->LinkHashTable = hashtable_create();
+    ERRCODE(MEMCHECK(net->NodeHashTable));
+    ERRCODE(MEMCHECK(net->LinkHashTable));
+    if (errcode) return errcode;
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        if (!hashtable_insert(net->NodeHashTable, net->Node[i].ID, i))
+        {
+            return 101;
+        }
+    }
+    for (i = 1; i <= net->Nlinks; i++)
+    {
+        if (!hashtable_insert(net->LinkHashTable, net->Link[i].ID, i))
+        {
+            return 101;
+        }
+    }
+    return 0;
+}
+
+void freepart(Project *pr, Network *net, int part)
+/*----------------------------------------------------------------
+**  Input:   net = network containing a group of data
+**           part = a group of network data (see SharedData)
+**  Output:  none
+**  Purpose: frees the memory used by a group of network data.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+    Spremise *p;
+    Saction *a;
+    Smatrix *sm;
+    void *next;
+
+    switch (part)
+    {
+    case SHARED_NODES:
+        if (net->Node == NULL) break;
+        for (i = 1; i <= net->Nnodes; i++)
+        {
+            freedemands(&net->Node[i]);
+            free(net->Node[i].S);
+            free(net->Node[i].Comment);
+            free(net->Node[i].Tag);
+        }
+        free(net->Node);
+        break;
+
+    // The links array's vertices, comments & tags are a separate part
+    case SHARED_LINKS:
+        free(net->Link);
+        break;
+
+    case SHARED_LINKEXTRA:
+        if (net->Link == NULL) break;
+        for (i = 1; i <= net->Nlinks; i++)
+        {
+            if (net->Link[i].Vertices)
+            {
+                free(net->Link[i].Vertices->X);
+                free(net->Link[i].Vertices->Y);
+                free(net->Link[i].Vertices);
+            }
+            free(net->Link[i].Comment);
+            free(net->Link[i].Tag);
+        }
+        break;
+
+    case SHARED_TANKS:    free(net->Tank);    break;
+    case SHARED_PUMPS:    free(net->Pump);    break;
+    case SHARED_VALVES:   free(net->Valve);   break;
+    case SHARED_CONTROLS: free(net->Control); break;
+
+    case SHARED_PATTERNS:
+        if (net->Pattern == NULL) break;
+        for (i = 0; i <= net->Npats; i++)
+        {
+            free(net->Pattern[i].F);
+            free(net->Pattern[i].Comment);
+        }
+        free(net->Pattern);
+        break;
+
+    case SHARED_CURVES:
+        if (net->Curve == NULL) break;
+        for (i = 1; i <= net->Ncurves; i++)
+        {
+            free(net->Curve[i].X);
+            free(net->Curve[i].Y);
+            free(net->Curve[i].Comment);
+        }
+        free(net->Curve);
+        break;
+
+    case SHARED_RULES:
+        if (net->Rule == NULL) break;
+        for (i = 1; i <= net->Nrules; i++)
+        {
+            for (p = net->Rule[i].Premises; p != NULL; p = next)
+            {
+                next = p->next;
+                free(p);
+            }
+            for (a = net->Rule[i].ThenActions; a != NULL; a = next)
+            {
+                next = a->next;
+                free(a);
+            }
+            for (a = net->Rule[i].ElseActions; a != NULL; a = next)
+            {
+                next = a->next;
+                free(a);
+            }
+        }
+        free(net->Rule);
+        break;
+
+    case SHARED_HASH:
+        if (net->NodeHashTable) hashtable_free(net->NodeHashTable);
+        if (net->LinkHashTable) hashtable_free(net->LinkHashTable);
+        break;
+
+    // A matrix structure in use by the project's hydraulic
+    // solver becomes owned by the solver
+    case SHARED_MATRIX:
+        sm = net->Sparse;
+        if (sm == NULL) break;
+        if (pr->hydraul.smatrix.Borrowed && pr->hydraul.smatrix.Order == sm->Order)
+        {
+            pr->hydraul.smatrix.Borrowed = FALSE;
+        }
+        else
+        {
+            free(sm->Order);
+            free(sm->Row);
+            free(sm->Ndx);
+            free(sm->XLNZ);
+            free(sm->NZSUB);
+            free(sm->LNZ);
+        }
+        free(sm);
+        break;
+    }
+}
+
+void *duplicate(const void *p, size_t size, int *errcode)
+/*----------------------------------------------------------------
+**  Input:   p = pointer to a block of memory
+**           size = size of the block in bytes
+**  Output:  errcode = 101 if out of memory
+**  Returns: pointer to a copy of the block
+**  Purpose: duplicates a block of memory.
+**----------------------------------------------------------------
+*/
+{
+    void *copy;
+
+    if (p == NULL || size == 0) return NULL;
+    copy = malloc(size);
+    if (copy == NULL) *errcode = 101;
+    else memcpy(copy, p, size);
+    return copy;
+}
+
+char *dupstring(const char *s, int *errcode)
+/*----------------------------------------------------------------
+**  Input:   s = a string
+**  Output:  errcode = 101 if out of memory
+**  Returns: pointer to a copy of the string
+**  Purpose: duplicates a dynamically allocated string.
+**----------------------------------------------------------------
+*/
+{
+    if (s == NULL) return NULL;
+    return (char *)duplicate(s, strlen(s) + 1, errcode);
+}
@@ -0,0 +1,409 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       criticality.c
+ Description:  finds the effect of closing each link of a network
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A criticality analysis closes each link of a network in turn (e.g., to
+isolate a pipe break) and finds the demand that the network then fails to
+supply at a given time, along with the number of junctions whose pressure
+falls below a pressure target.
+
+The hydraulics of the base case (with all links in their normal state) are
+solved once and the matrix of that solution is factored (see BASECASE.C).
+Closing a link only changes its P coeff. (the inverse of its head loss
+gradient) which makes a rank-one change to the matrix. Each link is then
+analyzed on its own, in parallel with the others, as follows:
+
+1. The factored matrix is solved for the link's column of the node-link
+   incidence matrix (one forward & back substitution), which gives the
+   Sherman-Morrison update of the factored matrix for the link's closure.
+
+2. The network's hydraulics with the link closed are solved with
+   chordsolve() (see HYDSOLVER.C), using the updated base case matrix
+   instead of re-factoring a new matrix at each iteration.
+
+3. If chordsolve() fails to converge, or its solution would change the
+   status of another link (e.g., a pump shutting off or a PRV becoming
+   active), or the link's closure disconnects part of the network (which
+   makes the updated matrix singular), a full solution is made with
+   hydsolve() instead.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runcriticality(Project *, double, long, const char *, int,
+//                       double *, int *);
+
+// Imported functions
+extern int  hydsolve(Project *, int *, double *);            //(see HYDSOLVER.C)
+extern int  chordsolve(Project *, Sfactor *, int, int *, double *);
+extern void linsubst(Smatrix *, double *, double *, double *, int); //(see SMATRIX.C)
+
+#define MAXCHORD  5        // Max. iterations of chordsolve()
+#define MAXRELERR 0.1      // Largest error of a warm start for hydsolve()
+#define SMTOL     1.e-6    // Smallest allowed Sherman-Morrison divisor
+
+// Results of a link's criticality analysis
+typedef struct {
+    double shortfall;      // demand not supplied (cfs)
+    int    deficient;      // number of junctions below pressure target
+    double minpress;       // lowest junction pressure (ft)
+    int    minnode;        // junction with lowest pressure
+    int    fullsolve;      // TRUE if a full hydraulic solution was made
+    int    errcode;        // error or warning code
+} Scritical;
+
+// A worker thread's data
+typedef struct {
+    EN_Project  project;     // clone of project being analyzed
+    Sfactor     factor;      // updated base case factored matrix
+} Scritworker;
+
+// Criticality analysis data shared by the worker threads
+typedef struct {
+    Project     *base;       // project being analyzed
+    Sbasecase   bc;          // base case shared by the workers
+    Scritworker *workers;    // each worker's data
+    double      *P;          // base case P coeff. of each link
+    double      target;      // pressure target (ft)
+    long        time;        // time of analysis (sec)
+    int         nfull;       // number of links needing full solutions
+    Scritical   basecase;    // results for the base case
+    Scritical   *results;    // results for each link
+} Scritstudy;
+
+// Local functions
+static int    alloccritstudy(Scritstudy *);
+static void   analyzelink(void *, int, int);
+static int    closelink(Scritstudy *, Scritworker *, int, int *);
+static void   evalsolution(Scritstudy *, Project *, Scritical *);
+static void   writecritstudy(Scritstudy *, FILE *);
+static void   freecritstudy(Scritstudy *);
+
+
+int runcriticality(Project *pr, double pressure, long time,
+                   const char *rptFile, int nthreads, double *shortfalls,
+                   int *deficient)
+/*----------------------------------------------------------------
+**  Input:   pressure = pressure target (user units)
+**           time = time of analysis (sec)
+**           rptFile = name of report file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  shortfalls = demand shortfall with each link closed
+**                        (user units, may be NULL)
+**           deficient = number of junctions below the pressure
+**                       target with each link closed (may be NULL)
+**           returns an error code
+**  Purpose: finds the effect of closing each link of a network.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Scritstudy cs;
+    FILE *f;
+    int k, errcode = 0;
+
+    if (pressure < 0.0 || time < 0) return 202;
+    memset(&cs, 0, sizeof(Scritstudy));
+    cs.base = pr;
+    cs.target = pressure / pr->Ucf[PRESSURE];
+    cs.time = time;
+
+    // Solve the base case on the worker threads & analyze each link
+    errcode = openbasecase(pr, &cs.bc, time, net->Nlinks, nthreads);
+    if (!errcode) errcode = alloccritstudy(&cs);
+    if (!errcode) workpool_run(cs.bc.Pool, net->Nlinks, analyzelink, &cs);
+
+    // Report the results
+    if (!errcode)
+    {
+        if (strlen(rptFile) == 0) writecritstudy(&cs, stdout);
+        else if ((f = fopen(rptFile, "wt")) == NULL) errcode = 315;
+        else
+        {
+            writecritstudy(&cs, f);
+            fclose(f);
+        }
+    }
+    for (k = 1; k <= net->Nlinks && !errcode; k++)
+    {
+        if (shortfalls) shortfalls[k - 1] =
+            cs.results[k - 1].shortfall * pr->Ucf[FLOW];
+        if (deficient) deficient[k - 1] = cs.results[k - 1].deficient;
+    }
+    freecritstudy(&cs);
+    return errcode;
+}
+
+int alloccritstudy(Scritstudy *cs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: allocates memory used by a criticality analysis and
+**           saves the results of the base case.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = cs->bc.Clones[0];
+    Network *net = &cs->base->network;
+    Scritworker *w;
+    int i, errcode = 0;
+
+    cs->workers = (Scritworker *)calloc(cs->bc.Nworkers,
+                                        sizeof(Scritworker));
+    cs->results = (Scritical *)calloc(net->Nlinks + 1, sizeof(Scritical));
+    cs->P = (double *)calloc(net->Nlinks + 1, sizeof(double));
+    ERRCODE(MEMCHECK(cs->workers));
+    ERRCODE(MEMCHECK(cs->results));
+    ERRCODE(MEMCHECK(cs->P));
+    for (i = 0; i < cs->bc.Nworkers && !errcode; i++)
+    {
+        w = &cs->workers[i];
+        w->project = cs->bc.Clones[i];
+        w->factor.z = (double *)calloc(net->Nnodes + 1, sizeof(double));
+        ERRCODE(MEMCHECK(w->factor.z));
+    }
+
+    // The first worker's project still holds the base case solution
+    if (!errcode)
+    {
+        evalsolution(cs, pr, &cs->basecase);
+        memcpy(cs->P, pr->hydraul.P, (net->Nlinks + 1) * sizeof(double));
+    }
+    return errcode;
+}
+
+void analyzelink(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = criticality analysis data
+**           worker = index of worker thread
+**           item = index of link - 1
+**  Output:  none
+**  Purpose: finds the effect of closing a link.
+**----------------------------------------------------------------
+*/
+{
+    Scritstudy *cs = (Scritstudy *)data;
+    Scritworker *w = &cs->workers[worker];
+    Project *pr = w->project;
+    Scritical *r = &cs->results[item];
+    int k = item + 1;
+
+    // A check valve's status is set by the flow through it
+    if (pr->network.Link[k].Type == CVPIPE)
+    {
+        r->errcode = 207;
+        return;
+    }
+
+    // Start from the base case solution & close the link
+    // (a link already closed leaves the base case unchanged)
+    restorestate(pr, cs->bc.State, cs->bc.StateSize);
+    if (pr->hydraul.LinkStatus[k] > CLOSED)
+    {
+        r->errcode = closelink(cs, w, k, &r->fullsolve);
+    }
+    if (r->errcode <= 100) evalsolution(cs, pr, r);
+    if (r->fullsolve)
+    {
+        workpool_lock(cs->bc.Pool);
+        cs->nfull++;
+        workpool_unlock(cs->bc.Pool);
+    }
+}
+
+int closelink(Scritstudy *cs, Scritworker *w, int k, int *fullsolve)
+/*----------------------------------------------------------------
+**  Input:   w = worker's data
+**           k = index of link
+**  Output:  fullsolve = TRUE if a full solution was made
+**           returns an error code
+**  Purpose: solves the hydraulics of a network with a link
+**           closed, starting from the base case solution.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = w->project;
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Sfactor *fac = &w->factor;
+    int n = net->Njuncs;
+    int n1 = net->Link[k].N1;
+    int n2 = net->Link[k].N2;
+    int iter, warm = FALSE, errcode;
+    double dp, uz, relerr;
+
+    setlinkstatus(pr, k, 0, &hyd->LinkStatus[k], &hyd->LinkSetting[k]);
+
+    // Update the base case factored matrix for the drop in the
+    // link's P coeff. (to effectively 0 once closed), with
+    // u = link's column of the incidence matrix & z = A0\u
+    if (cs->bc.Factor.Lii)
+    {
+        fac->Lii = cs->bc.Factor.Lii;
+        fac->Lij = cs->bc.Factor.Lij;
+        fac->link = k;
+        memset(fac->z, 0, (n + 1) * sizeof(double));
+        if (n1 <= n) fac->z[sm->Row[n1]] = 1.0;
+        if (n2 <= n) fac->z[sm->Row[n2]] = -1.0;
+        linsubst(sm, fac->Lii, fac->Lij, fac->z, n);
+        uz = 0.0;
+        if (n1 <= n) uz += fac->z[sm->Row[n1]];
+        if (n2 <= n) uz -= fac->z[sm->Row[n2]];
+        dp = -cs->P[k];
+        if (1.0 + dp * uz > SMTOL)
+        {
+            fac->w = dp / (1.0 + dp * uz);
+            if (chordsolve(pr, fac, MAXCHORD, &iter, &relerr) == 0) return 0;
+            warm = relerr < MAXRELERR;
+        }
+    }
+
+    // Make a full solution, starting from the last iterate of
+    // chordsolve() if it came close or else from the base case
+    *fullsolve = TRUE;
+    if (!warm)
+    {
+        restorestate(pr, cs->bc.State, cs->bc.StateSize);
+        setlinkstatus(pr, k, 0, &hyd->LinkStatus[k], &hyd->LinkSetting[k]);
+    }
+    errcode = hydsolve(pr, &iter, &relerr);
+
+    // Flag an unbalanced or unstable solution as runH() does
+    if (errcode == 0 && iter > hyd->MaxIter)
+    {
+        errcode = (relerr <= hyd->Hacc) ? 2 : 1;
+    }
+    return errcode;
+}
+
+void evalsolution(Scritstudy *cs, Project *pr, Scritical *r)
+/*----------------------------------------------------------------
+**  Input:   pr = project holding a hydraulic solution
+**  Output:  r = results of the solution
+**  Purpose: finds the demand shortfall & pressure deficient
+**           junctions of a hydraulic solution.
+**
+**  Notes:   With pressure driven demands the shortfall is the
+**           demand not delivered. Otherwise it's the demand of
+**           junctions whose pressure is below the target.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    int i;
+    double p;
+
+    r->shortfall = 0.0;
+    r->deficient = 0;
+    r->minpress = 1.e10;
+    r->minnode = 0;
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        p = hyd->NodeHead[i] - net->Node[i].El;
+        if (p < r->minpress)
+        {
+            r->minpress = p;
+            r->minnode = i;
+        }
+        if (p < cs->target) r->deficient++;
+        if (hyd->FullDemand[i] <= 0.0) continue;
+        if (hyd->DemandModel == PDA)
+        {
+            r->shortfall += MAX(hyd->FullDemand[i] - hyd->DemandFlow[i], 0.0);
+        }
+        else if (p < cs->target) r->shortfall += hyd->FullDemand[i];
+    }
+}
+
+void writecritstudy(Scritstudy *cs, FILE *f)
+/*----------------------------------------------------------------
+**  Input:   f = report file
+**  Output:  none
+**  Purpose: writes the results of a criticality analysis.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = cs->base;
+    Network *net = &pr->network;
+    Report *rpt = &pr->report;
+    Scritical *r;
+    int k;
+    int pprec = rpt->Field[PRESSURE].Precision;
+    int qprec = rpt->Field[FLOW].Precision;
+    double pcf = pr->Ucf[PRESSURE];
+    double qcf = pr->Ucf[FLOW];
+    char atime[13];
+
+    fprintf(f, "Criticality Analysis\n");
+    fprintf(f, "Pressure Target:   %.*f %s\n", pprec, cs->target * pcf,
+            rpt->Field[PRESSURE].Units);
+    fprintf(f, "Time:              %s hrs:min:sec\n",
+            clocktime(atime, cs->time));
+    fprintf(f, "Base Case:         %.*f %s shortfall, %d deficient junctions\n",
+            qprec, cs->basecase.shortfall * qcf, rpt->Field[FLOW].Units,
+            cs->basecase.deficient);
+    fprintf(f, "Links:             %d (%d needed full solutions)\n\n",
+            net->Nlinks, cs->nfull);
+    fprintf(f, "%-*s %14s %14s %14s %-*s %5s\n", MAXID, "Link",
+            "Shortfall", "Deficient", "Min Pressure", MAXID, "Node", "Code");
+    fprintf(f, "%-*s %14s %14s %14s %-*s %5s\n", MAXID, "",
+            rpt->Field[FLOW].Units, "Junctions", rpt->Field[PRESSURE].Units,
+            MAXID, "", "");
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        r = &cs->results[k - 1];
+        if (r->errcode > 100)
+        {
+            fprintf(f, "%-*s %14s %14s %14s %-*s %5d\n", MAXID,
+                    net->Link[k].ID, "", "", "", MAXID, "", r->errcode);
+            continue;
+        }
+        fprintf(f, "%-*s %14.*f %14d %14.*f %-*s %5d\n", MAXID,
+                net->Link[k].ID, qprec, r->shortfall * qcf, r->deficient,
+                pprec, r->minpress * pcf, MAXID, net->Node[r->minnode].ID,
+                r->errcode);
+    }
+}
+
+void freecritstudy(Scritstudy *cs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory used by a criticality analysis.
+**----------------------------------------------------------------
+*/
+{
+    Scritworker *w;
+    int i;
+
+    for (i = 0; i < cs->bc.Nworkers && cs->workers; i++)
+    {
+        w = &cs->workers[i];
+        free(w->factor.z);
+    }
+    free(cs->workers);
+    free(cs->P);
+    free(cs->results);
+    closebasecase(&cs->bc);
+}
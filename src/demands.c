@@ -0,0 +1,308 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       demands.c
+ Description:  evaluates junction demands from a sparse demand matrix
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+Junction demands are the product of a sparse (junction x pattern) matrix of
+base demands and the vector of current pattern factors. The matrix is stored
+in compressed sparse row (CSR) form, with one entry per demand category kept
+in the same order as the junctions' demand lists:
+
+  RowStart[i] ... RowStart[i+1]-1 = entries of junction i
+  CatBase[e], CatPat[e]           = base demand & pattern of entry e
+
+An index of the junctions that use each pattern (PatStart, PatRows) allows
+only those junctions whose pattern factors changed since the previous pattern
+period to be re-evaluated. Each category's demand is still computed as
+Base * Factor * Dmult and summed in list order, so results are identical to
+walking each junction's demand list.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "funcs.h"
+
+// Exported functions (declared in funcs.h)
+//int     opendemands(Project *);
+//void    closedemands(Project *);
+//void    resetdemands(Project *);
+//void    junctiondemands(Project *, long);
+
+// Local functions
+static int   build_demand_matrix(Project *pr);
+static void  free_demand_matrix(SdemandMatrix *dm);
+static void  eval_junction_demand(Project *pr, int i);
+
+
+int opendemands(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns an error code
+**   Purpose: builds the sparse junction demand matrix
+**-------------------------------------------------------------
+*/
+{
+    return build_demand_matrix(pr);
+}
+
+void closedemands(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: frees memory used by the junction demand matrix
+**-------------------------------------------------------------
+*/
+{
+    free_demand_matrix(&pr->hydraul.dmatrix);
+}
+
+void resetdemands(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: marks the junction demand matrix as needing to be
+**            re-built after demands or patterns are edited
+**-------------------------------------------------------------
+*/
+{
+    pr->hydraul.dmatrix.Built = FALSE;
+}
+
+void junctiondemands(Project *pr, long p)
+/*-------------------------------------------------------------
+**   Input:   p = number of elapsed pattern periods
+**   Output:  none
+**   Purpose: computes junction demands for the current pattern
+**            period
+**   Note:    the demand matrix must have been built by
+**            opendemands().
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    SdemandMatrix *dm = &hyd->dmatrix;
+
+    int    i, j, e, r, full, nchanged = 0;
+    double f;
+    Spattern *pattern;
+
+    // Re-evaluate demands only if the pattern period or the
+    // demand multiplier changed since they were last evaluated
+    if (p != dm->Period || hyd->Dmult != dm->Dmult)
+    {
+        // Find the current factor of each pattern used by a junction,
+        // noting the junctions whose factors changed (all of them if
+        // the multiplier changed)
+        full = (hyd->Dmult != dm->Dmult);
+        for (j = 0; j <= dm->Npats; j++)
+        {
+            if (dm->PatStart[j] == dm->PatStart[j+1]) continue;
+            pattern = &net->Pattern[j];
+            f = pattern->F[p % (long)pattern->Length];
+            if (f == dm->PatFactor[j] && !full) continue;
+            dm->PatFactor[j] = f;
+            if (full) continue;
+            for (r = dm->PatStart[j]; r < dm->PatStart[j+1]; r++)
+            {
+                i = dm->PatRows[r];
+                if (dm->Changed[i]) continue;
+                dm->Changed[i] = TRUE;
+                dm->ChangedRows[nchanged++] = i;
+            }
+        }
+
+        // Re-evaluate the demands of those junctions
+        if (full)
+        {
+            for (i = 1; i <= net->Njuncs; i++) eval_junction_demand(pr, i);
+        }
+        else for (r = 0; r < nchanged; r++)
+        {
+            i = dm->ChangedRows[r];
+            dm->Changed[i] = FALSE;
+            eval_junction_demand(pr, i);
+        }
+        dm->Period = p;
+        dm->Dmult = hyd->Dmult;
+
+        // Update system-wide demand from the individual categories
+        if (full || nchanged > 0)
+        {
+            hyd->Dsystem = 0.0;
+            for (e = 0; e < dm->Ncats; e++)
+            {
+                if (dm->CatDemand[e] > 0.0) hyd->Dsystem += dm->CatDemand[e];
+            }
+        }
+    }
+
+    // Initialize pressure dependent demand
+    memcpy(&hyd->DemandFlow[1], &hyd->FullDemand[1],
+           net->Njuncs * sizeof(double));
+}
+
+int build_demand_matrix(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns an error code
+**   Purpose: builds the sparse junction demand matrix from the
+**            junctions' demand category lists
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    SdemandMatrix *dm = &hyd->dmatrix;
+
+    int  i, j, e, n, errcode = 0;
+    int  *lastRow;
+    Pdemand demand;
+
+    // Count the demand categories
+    free_demand_matrix(dm);
+    n = 0;
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        for (demand = net->Node[i].D; demand != NULL; demand = demand->next) n++;
+    }
+    dm->Ncats = n;
+    dm->Npats = net->Npats;
+
+    // Allocate memory for the matrix
+    dm->RowStart = (int *)calloc(net->Njuncs + 2, sizeof(int));
+    dm->CatPat = (int *)calloc(n + 1, sizeof(int));
+    dm->CatBase = (double *)calloc(n + 1, sizeof(double));
+    dm->CatDemand = (double *)calloc(n + 1, sizeof(double));
+    dm->PatStart = (int *)calloc(dm->Npats + 2, sizeof(int));
+    dm->PatRows = (int *)calloc(n + 1, sizeof(int));
+    dm->PatFactor = (double *)calloc(dm->Npats + 1, sizeof(double));
+    dm->ChangedRows = (int *)calloc(net->Njuncs + 1, sizeof(int));
+    dm->Changed = (char *)calloc(net->Njuncs + 1, sizeof(char));
+    ERRCODE(MEMCHECK(dm->RowStart));
+    ERRCODE(MEMCHECK(dm->CatPat));
+    ERRCODE(MEMCHECK(dm->CatBase));
+    ERRCODE(MEMCHECK(dm->CatDemand));
+    ERRCODE(MEMCHECK(dm->PatStart));
+    ERRCODE(MEMCHECK(dm->PatRows));
+    ERRCODE(MEMCHECK(dm->PatFactor));
+    ERRCODE(MEMCHECK(dm->ChangedRows));
+    ERRCODE(MEMCHECK(dm->Changed));
+    if (errcode)
+    {
+        free_demand_matrix(dm);
+        return errcode;
+    }
+
+    // Copy each junction's demand categories into its matrix row
+    e = 0;
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        dm->RowStart[i] = e;
+        for (demand = net->Node[i].D; demand != NULL; demand = demand->next)
+        {
+            j = demand->Pat;
+            if (j == 0) j = hyd->DefPat;
+            dm->CatPat[e] = j;
+            dm->CatBase[e] = demand->Base;
+            e++;
+        }
+    }
+    dm->RowStart[net->Njuncs + 1] = e;
+
+    // Index the junctions that use each pattern
+    // (lastRow = last junction found to use each pattern)
+    lastRow = (int *)calloc(dm->Npats + 1, sizeof(int));
+    if (lastRow == NULL)
+    {
+        free_demand_matrix(dm);
+        return 101;
+    }
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        for (e = dm->RowStart[i]; e < dm->RowStart[i+1]; e++)
+        {
+            j = dm->CatPat[e];
+            if (lastRow[j] == i) continue;
+            lastRow[j] = i;
+            dm->PatStart[j+1]++;
+        }
+    }
+    for (j = 1; j <= dm->Npats + 1; j++) dm->PatStart[j] += dm->PatStart[j-1];
+    memset(lastRow, 0, (dm->Npats + 1) * sizeof(int));
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        for (e = dm->RowStart[i]; e < dm->RowStart[i+1]; e++)
+        {
+            j = dm->CatPat[e];
+            if (lastRow[j] == i) continue;
+            lastRow[j] = i;
+            dm->PatRows[dm->PatStart[j]++] = i;
+        }
+    }
+    for (j = dm->Npats + 1; j > 0; j--) dm->PatStart[j] = dm->PatStart[j-1];
+    dm->PatStart[0] = 0;
+    free(lastRow);
+
+    // Force all demands to be evaluated at the next time period
+    dm->Period = -1;
+    dm->Dmult = MISSING;
+    dm->Built = TRUE;
+    return 0;
+}
+
+void free_demand_matrix(SdemandMatrix *dm)
+/*-------------------------------------------------------------
+**   Input:   dm = a junction demand matrix
+**   Output:  none
+**   Purpose: frees memory used by a junction demand matrix
+**-------------------------------------------------------------
+*/
+{
+    FREE(dm->RowStart);
+    FREE(dm->CatPat);
+    FREE(dm->CatBase);
+    FREE(dm->CatDemand);
+    FREE(dm->PatStart);
+    FREE(dm->PatRows);
+    FREE(dm->PatFactor);
+    FREE(dm->ChangedRows);
+    FREE(dm->Changed);
+    dm->Ncats = 0;
+    dm->Npats = 0;
+    dm->Built = FALSE;
+}
+
+void eval_junction_demand(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = junction index
+**   Output:  none
+**   Purpose: computes a junction's demand from its row of the
+**            demand matrix
+**-------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &pr->hydraul;
+    SdemandMatrix *dm = &hyd->dmatrix;
+
+    int    e;
+    double djunc, sum = 0.0;
+
+    for (e = dm->RowStart[i]; e < dm->RowStart[i+1]; e++)
+    {
+        djunc = dm->CatBase[e] * dm->PatFactor[dm->CatPat[e]] * hyd->Dmult;
+        dm->CatDemand[e] = djunc;
+        sum += djunc;
+    }
+    hyd->FullDemand[i] = sum;
+}
@@ -0,0 +1,835 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       domains.c
+ Description:  solves the hydraulic equations of a network divided into
+               domains on separate MPI processes
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+When the library is built with USE_MPI defined and a program that has called
+MPI_Init() is run on more than one process (e.g. with mpirun -np N), each
+process's project divides its network's junctions into one domain per process
+and a set of interface junctions, so that no link joins junctions of two
+different domains. The domains are found by recursive bisection of the
+network's graph along breadth-first level structures, and the interface is
+made of one end of each link cut by the bisection.
+
+The rows of the solution matrix are re-ordered so that each domain's rows come
+together, in the order found by the minimum degree re-ordering of the whole
+matrix, followed by the interface rows. The Cholesky factor of a domain's
+columns then involves no other domain's columns, so at each trial of
+hydsolve() every process:
+  1. factors the columns of its own domain and finds the contributions of
+     these columns to the interface rows (their part of the Schur complement
+     of the interface block and of its right hand side),
+  2. sends these contributions to the process of rank 0, which adds them to
+     the interface block, factors it and solves for the interface heads,
+  3. receives the interface heads and solves for the heads of its domain,
+  4. gathers the heads of all other domains.
+Every process holds the whole network and carries out the rest of the
+analysis itself, so each ends a trial with the full solution and the
+process of rank 0 writes the hydraulics and output files as usual.
+
+Since no process holds the complete factored matrix, a project that solves
+its domains this way can't use the sensitivity functions (see SENSITIVITY.C).
+The projects cloned from a project (see CLONE.C) solve their whole matrix.
+
+The exported functions are:
+  opendomains()   -- called from openhyd() in HYDRAUL.C
+  closedomains()  -- called from closehyd() in HYDRAUL.C
+  orderdomains()  -- called from reordernodes() in SMATRIX.C
+  allocdomains()  -- called from createsparse() in SMATRIX.C
+  domainsolve()   -- called from hydsolve() in HYDSOLVER.C
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include "types.h"
+#include "funcs.h"
+
+#define MINROWS  20    // Min. number of junctions per domain
+#define SPLITTOL 0.05  // Fraction of junctions a bisection can move by
+
+// Exported functions (declared in funcs.h)
+//int     opendomains(Project *);
+//void    closedomains(Project *);
+//int     orderdomains(Project *);
+//int     allocdomains(Project *);
+//int     domainsolve(Project *);
+
+// Local functions
+static void bisect(int *, int *, int *, int *, int *, int *, int, int,
+                   int, int);
+static int  levelorder(int *, int *, int *, int *, int *, int *, int, int,
+                       int);
+static int  factorcolumns(Smatrix *, int, int, int);
+static void forwardcolumns(Smatrix *, int, int, int, double *);
+static void backcolumns(Smatrix *, int, int);
+static void schurcoeffs(Smatrix *, Sdomains *, int, int);
+static int  solveinterface(Smatrix *, Sdomains *, int);
+static int  firstfailed(int);
+static void sumcontributions(Sdomains *, int);
+static int  shareinterface(Sdomains *, int, double *);
+static void gatherdomains(Sdomains *, double *);
+
+
+int opendomains(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns error code
+**  Purpose: decides if a network's hydraulic equations are
+**           solved in domains on separate processes.
+**--------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Sdomains *dm = &pr->hydraul.domains;
+    int nprocs = 1, rank = 0, errcode = 0;
+#ifdef USE_MPI
+    int started = 0, finished = 0;
+#endif
+
+    memset(dm, 0, sizeof(Sdomains));
+#ifdef USE_MPI
+    MPI_Initialized(&started);
+    if (started) MPI_Finalized(&finished);
+    if (started && !finished)
+    {
+        MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+        MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    }
+#endif
+
+    // A matrix structure shared with clones isn't re-ordered
+    if (nprocs < 2 || net->Njuncs < MINROWS * nprocs) return 0;
+    if (net->Sparse != NULL) return 0;
+    dm->Ndomains = nprocs;
+    dm->Rank = rank;
+    dm->Start = (int *)calloc(nprocs + 2, sizeof(int));
+    dm->Counts = (int *)calloc(nprocs, sizeof(int));
+    dm->Displs = (int *)calloc(nprocs, sizeof(int));
+    ERRCODE(MEMCHECK(dm->Start));
+    ERRCODE(MEMCHECK(dm->Counts));
+    ERRCODE(MEMCHECK(dm->Displs));
+    if (errcode) closedomains(pr);
+    return errcode;
+}
+
+void closedomains(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees memory used to solve a network's domains.
+**--------------------------------------------------------------
+*/
+{
+    Sdomains *dm = &pr->hydraul.domains;
+
+    free(dm->Start);
+    free(dm->Counts);
+    free(dm->Displs);
+    free(dm->Work);
+    free(dm->Sum);
+    memset(dm, 0, sizeof(Sdomains));
+}
+
+int orderdomains(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns error code
+**  Purpose: divides the junctions into domains and an interface
+**           and re-orders the rows of the solution matrix so
+**           that each domain's rows come together.
+**
+**  NOTE:    sm->Order & sm->Row hold the minimum degree
+**           re-ordering of the matrix when this is called.
+**--------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Smatrix  *sm = &pr->hydraul.smatrix;
+    Sdomains *dm = &pr->hydraul.domains;
+
+    int i, j, k, m, d, n = net->Njuncs;
+    int nd = dm->Ndomains;
+    int errcode = 0;
+    Padjlist alink;
+
+    // Graph of links between junctions & work arrays
+    int *xadj   = (int *)calloc(n + 2, sizeof(int));
+    int *adjncy = NULL;
+    int *nodes  = (int *)calloc(n + 1, sizeof(int));
+    int *part   = (int *)calloc(n + 1, sizeof(int));
+    int *mark   = (int *)calloc(n + 1, sizeof(int));
+    int *queue  = (int *)calloc(n + 1, sizeof(int));
+    ERRCODE(MEMCHECK(xadj));
+    ERRCODE(MEMCHECK(nodes));
+    ERRCODE(MEMCHECK(part));
+    ERRCODE(MEMCHECK(mark));
+    ERRCODE(MEMCHECK(queue));
+    if (!errcode)
+    {
+        m = 0;
+        for (i = 1; i <= n; i++)
+        {
+            for (alink = net->Adjlist[i]; alink != NULL; alink = alink->next)
+            {
+                if (alink->node > 0 && alink->node <= n) m++;
+            }
+        }
+        adjncy = (int *)calloc(m + 1, sizeof(int));
+        ERRCODE(MEMCHECK(adjncy));
+    }
+
+    if (!errcode)
+    {
+        // Build the graph (with 0-based positions in adjncy)
+        m = 0;
+        for (i = 1; i <= n; i++)
+        {
+            xadj[i] = m;
+            for (alink = net->Adjlist[i]; alink != NULL; alink = alink->next)
+            {
+                j = alink->node;
+                if (j > 0 && j <= n) adjncy[m++] = j;
+            }
+        }
+        xadj[n + 1] = m;
+
+        // Split the junctions into domains
+        for (i = 0; i < n; i++) nodes[i] = i + 1;
+        bisect(xadj, adjncy, nodes, part, mark, queue, 0, n, 0, nd);
+
+        // Move one end of each link joining two domains to the
+        // interface (given a domain of nd)
+        for (i = 1; i <= n; i++)
+        {
+            for (k = xadj[i]; k < xadj[i + 1]; k++)
+            {
+                j = adjncy[k];
+                if (part[i] == nd || part[j] == nd) continue;
+                if (part[i] > part[j]) part[i] = nd;
+                else if (part[j] > part[i]) part[j] = nd;
+            }
+        }
+
+        // Re-order the rows by domain, keeping the minimum degree
+        // order within each domain & the interface
+        memset(dm->Start, 0, (nd + 2) * sizeof(int));
+        for (i = 1; i <= n; i++) dm->Start[part[i] + 1]++;
+        dm->Start[0] = 1;
+        for (d = 1; d <= nd + 1; d++) dm->Start[d] += dm->Start[d - 1];
+        memset(mark, 0, (n + 1) * sizeof(int));
+        for (k = 1; k <= n; k++) queue[k] = sm->Order[k];
+        for (k = 1; k <= n; k++)
+        {
+            i = queue[k];
+            d = part[i];
+            m = dm->Start[d] + mark[d];
+            mark[d]++;
+            sm->Order[m] = i;
+            sm->Row[i] = m;
+        }
+        for (d = 0; d < nd; d++)
+        {
+            dm->Counts[d] = dm->Start[d + 1] - dm->Start[d];
+            dm->Displs[d] = dm->Start[d] - 1;
+        }
+        dm->Nrows = n + 1 - dm->Start[nd];
+    }
+
+    free(xadj);
+    free(adjncy);
+    free(nodes);
+    free(part);
+    free(mark);
+    free(queue);
+    return errcode;
+}
+
+int allocdomains(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns error code
+**  Purpose: allocates memory used to pass the contributions of
+**           the domains to the interface rows between processes.
+**--------------------------------------------------------------
+*/
+{
+    Smatrix  *sm = &pr->hydraul.smatrix;
+    Sdomains *dm = &pr->hydraul.domains;
+    int n = pr->network.Njuncs;
+    int size, errcode = 0;
+
+    if (dm->Ndomains < 2) return 0;
+    dm->Ncoeffs = sm->XLNZ[n + 1] - sm->XLNZ[dm->Start[dm->Ndomains]];
+
+    // Contributions to the interface's diagonal coeffs.,
+    // off-diagonal coeffs. and right hand side
+    size = 2 * dm->Nrows + dm->Ncoeffs + 1;
+    dm->Work = (double *)calloc(size, sizeof(double));
+    ERRCODE(MEMCHECK(dm->Work));
+    if (dm->Rank == 0)
+    {
+        dm->Sum = (double *)calloc(size, sizeof(double));
+        ERRCODE(MEMCHECK(dm->Sum));
+    }
+    return errcode;
+}
+
+int domainsolve(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  sm->F = solution values
+**           returns 0 if solution found, or index of equation
+**           causing system to be ill-conditioned
+**  Purpose: solves the linearized hydraulic equations of the
+**           current trial with each process solving its own
+**           domain.
+**--------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Smatrix  *sm = &pr->hydraul.smatrix;
+    Sdomains *dm = &pr->hydraul.domains;
+
+    int n = net->Njuncs;
+    int s0 = dm->Start[dm->Ndomains];
+    int first = dm->Start[dm->Rank];
+    int last = dm->Start[dm->Rank + 1];
+    int size = 2 * dm->Nrows + dm->Ncoeffs;
+    int errcode;
+
+    // Factor the process's domain & find its contributions
+    // to the interface rows
+    memset(dm->Work, 0, (size + 1) * sizeof(double));
+    memset(sm->temp, 0, (n + 1) * sizeof(double));
+    errcode = factorcolumns(sm, first, last, s0);
+    if (errcode == 0)
+    {
+        schurcoeffs(sm, dm, first, last);
+        forwardcolumns(sm, first, last, s0,
+                       &dm->Work[dm->Nrows + dm->Ncoeffs]);
+    }
+    errcode = firstfailed(errcode);
+    if (errcode) return errcode;
+
+    // Solve for the interface heads on the process of rank 0
+    sumcontributions(dm, size);
+    if (dm->Rank == 0) errcode = solveinterface(sm, dm, n);
+    errcode = shareinterface(dm, errcode, &sm->F[s0]);
+    if (errcode) return errcode;
+
+    // Solve for the heads of the process's domain & gather
+    // those of the other domains
+    backcolumns(sm, first, last);
+    gatherdomains(dm, sm->F);
+    return 0;
+}
+
+void bisect(int *xadj, int *adjncy, int *nodes, int *part, int *mark,
+            int *queue, int lo, int hi, int d, int nd)
+/*
+**--------------------------------------------------------------
+**  Input:   xadj, adjncy = graph of links between junctions
+**           nodes = junctions being divided
+**           part = domain of each junction
+**           mark, queue = work arrays
+**           lo, hi = range of nodes being divided
+**           d = first domain assigned to the range
+**           nd = number of domains assigned to the range
+**  Output:  part = domain of each junction in the range
+**  Purpose: divides a range of junctions into domains of about
+**           equal size by recursive bisection.
+**
+**  NOTE:    The range is ordered by distance from a junction at
+**           one end of it and split in proportion to the number
+**           of domains on each side. The split is moved to the
+**           boundary between two levels of distance that is cut
+**           by the fewest links if one lies within SPLITTOL of
+**           it (e.g. at the mains joining two districts).
+**--------------------------------------------------------------
+*/
+{
+    int i, j, k, kbest, best, l, n1, tol;
+    int *cuts = &queue[lo];
+
+    for (i = lo; i < hi; i++) part[nodes[i]] = d;
+    if (nd < 2 || hi - lo < 2) return;
+
+    // Order the range by level of distance from a junction
+    // at one end of it
+    n1 = nd / 2;
+    k = lo + (int)((double)(hi - lo) * n1 / nd);
+    i = levelorder(xadj, adjncy, nodes, part, mark, queue, lo, hi, 0);
+    levelorder(xadj, adjncy, nodes, part, mark, queue, lo, hi, i);
+
+    // Count the links cut by the boundary after each level
+    // (links only join junctions of the same or next level)
+    memset(cuts, 0, (hi - lo) * sizeof(int));
+    for (i = lo; i < hi; i++)
+    {
+        l = mark[nodes[i]];
+        for (j = xadj[nodes[i]]; j < xadj[nodes[i] + 1]; j++)
+        {
+            if (part[adjncy[j]] == d && mark[adjncy[j]] == l + 1) cuts[l]++;
+        }
+    }
+
+    // Find the least cut level boundary near the split
+    tol = (int)(SPLITTOL * (hi - lo));
+    kbest = k;
+    best = -1;
+    for (i = k - tol; i <= k + tol; i++)
+    {
+        if (i <= lo || i >= hi) continue;
+        l = mark[nodes[i - 1]];
+        if (mark[nodes[i]] == l) continue;
+        if (best < 0 || cuts[l] < best ||
+            (cuts[l] == best && abs(i - k) < abs(kbest - k)))
+        {
+            best = cuts[l];
+            kbest = i;
+        }
+    }
+    k = kbest;
+    bisect(xadj, adjncy, nodes, part, mark, queue, lo, k, d, n1);
+    bisect(xadj, adjncy, nodes, part, mark, queue, k, hi, d + n1, nd - n1);
+}
+
+int levelorder(int *xadj, int *adjncy, int *nodes, int *part, int *mark,
+               int *queue, int lo, int hi, int start)
+/*
+**--------------------------------------------------------------
+**  Input:   xadj, adjncy = graph of links between junctions
+**           nodes = junctions being divided
+**           part = domain of each junction
+**           mark, queue = work arrays
+**           lo, hi = range of nodes being ordered
+**           start = junction to start from (0 for the
+**                   range's first junction)
+**  Output:  nodes = range in breadth-first order
+**           mark = level of each junction in the range
+**           returns the last junction reached
+**  Purpose: orders a range of junctions by the level structure
+**           rooted at one of them.
+**
+**  NOTE:    Junctions in the range all have the same domain in
+**           part[], which marks which neighbors are in range.
+**           Parts of the range not connected to the start are
+**           ordered after it, each from its first junction and
+**           a level past the last one reached.
+**--------------------------------------------------------------
+*/
+{
+    int d = part[nodes[lo]];
+    int i, j, k, head, tail, next = lo;
+
+    if (start < 1) start = nodes[lo];
+    for (i = lo; i < hi; i++) mark[nodes[i]] = 0;
+    head = tail = lo;
+    queue[tail++] = start;
+    mark[start] = 1;
+    while (head < hi)
+    {
+        // Start again from the next junction not reached
+        if (head == tail)
+        {
+            while (mark[nodes[next]]) next++;
+            queue[tail] = nodes[next];
+            mark[nodes[next]] = mark[queue[tail - 1]] + 1;
+            tail++;
+        }
+        i = queue[head++];
+        for (k = xadj[i]; k < xadj[i + 1]; k++)
+        {
+            j = adjncy[k];
+            if (part[j] != d || mark[j]) continue;
+            mark[j] = mark[i] + 1;
+            queue[tail++] = j;
+        }
+    }
+    memcpy(&nodes[lo], &queue[lo], (hi - lo) * sizeof(int));
+    return nodes[hi - 1];
+}
+
+int factorcolumns(Smatrix *sm, int first, int last, int bound)
+/*
+**--------------------------------------------------------------
+**  Input:   sm    = sparse matrix struct
+**           first = first column to factor
+**           last  = column after the last one to factor
+**           bound = first row whose column isn't factored
+**  Output:  sm->Aii, sm->Aij = coeffs. of Cholesky factor L
+**           in the columns factored
+**           returns 0 if factorization found, or index of
+**           equation causing system to be ill-conditioned
+**  Purpose: factors a range of columns of the solution matrix
+**           that are modified by no columns outside of it.
+**
+**  NOTE:    This is linfactor() (see SMATRIX.C) restricted to a
+**           range of columns. The coeffs. of the range's columns
+**           in rows from bound on are computed, but their
+**           modifications of the columns of these rows are
+**           left out.
+**--------------------------------------------------------------
+*/
+{
+    double *Aii  = sm->Aii;
+    double *Aij  = sm->Aij;
+    double *temp = sm->temp;
+    int *LNZ     = sm->LNZ;
+    int *XLNZ    = sm->XLNZ;
+    int *NZSUB   = sm->NZSUB;
+    int *link    = sm->link;
+    int *kstart  = sm->first;
+
+    int    i, istop, istrt, isub, j, k, kfirst, newk;
+    double bj, diagj, ljk;
+
+    for (j = first; j < last; j++)
+    {
+        link[j] = 0;
+        kstart[j] = 0;
+    }
+    for (j = first; j < last; j++)
+    {
+        // For each column L(*,k) that affects L(*,j):
+        diagj = 0.0;
+        newk = link[j];
+        k = newk;
+        while (k != 0)
+        {
+            newk = link[k];
+            kfirst = kstart[k];
+            ljk = Aij[LNZ[kfirst]];
+            diagj += ljk*ljk;
+            istrt = kfirst + 1;
+            istop = XLNZ[k+1] - 1;
+            if (istop >= istrt)
+            {
+                kstart[k] = istrt;
+                isub = NZSUB[istrt];
+                if (isub < bound)
+                {
+                    link[k] = link[isub];
+                    link[isub] = k;
+                }
+                for (i = istrt; i <= istop; i++)
+                {
+                    isub = NZSUB[i];
+                    temp[isub] += Aij[LNZ[i]]*ljk;
+                }
+            }
+            k = newk;
+        }
+
+        // Apply the modifications accumulated
+        // in 'temp' to column L(*,j)
+        diagj = Aii[j] - diagj;
+        if (diagj <= 0.0) return j;
+        diagj = sqrt(diagj);
+        Aii[j] = diagj;
+        istrt = XLNZ[j];
+        istop = XLNZ[j+1] - 1;
+        if (istop >= istrt)
+        {
+            kstart[j] = istrt;
+            isub = NZSUB[istrt];
+            if (isub < bound)
+            {
+                link[j] = link[isub];
+                link[isub] = j;
+            }
+            for (i = istrt; i <= istop; i++)
+            {
+                isub = NZSUB[i];
+                bj = (Aij[LNZ[i]] - temp[isub])/diagj;
+                Aij[LNZ[i]] = bj;
+                temp[isub] = 0.0;
+            }
+        }
+    }
+    return 0;
+}
+
+void forwardcolumns(Smatrix *sm, int first, int last, int bound,
+                    double *rest)
+/*
+**--------------------------------------------------------------
+**  Input:   sm    = sparse matrix struct
+**           first = first column of the range
+**           last  = column after the last one of the range
+**           bound = first row left out of the range's solution
+**  Output:  sm->F = forward substitution of the range's rows
+**           rest  = terms to subtract from the right hand side
+**                   of rows from bound on
+**  Purpose: carries out the forward substitution of a range of
+**           columns factored by factorcolumns().
+**--------------------------------------------------------------
+*/
+{
+    double *Aii = sm->Aii;
+    double *Aij = sm->Aij;
+    double *B   = sm->F;
+    int *LNZ    = sm->LNZ;
+    int *XLNZ   = sm->XLNZ;
+    int *NZSUB  = sm->NZSUB;
+
+    int    i, isub, j;
+    double bj;
+
+    for (j = first; j < last; j++)
+    {
+        bj = B[j]/Aii[j];
+        B[j] = bj;
+        for (i = XLNZ[j]; i < XLNZ[j+1]; i++)
+        {
+            isub = NZSUB[i];
+            if (isub < bound) B[isub] -= Aij[LNZ[i]]*bj;
+            else rest[isub - bound] += Aij[LNZ[i]]*bj;
+        }
+    }
+}
+
+void backcolumns(Smatrix *sm, int first, int last)
+/*
+**--------------------------------------------------------------
+**  Input:   sm    = sparse matrix struct
+**           first = first column of the range
+**           last  = column after the last one of the range
+**  Output:  sm->F = solution values of the range's rows
+**  Purpose: carries out the backward substitution of a range
+**           of columns once the rows following the range have
+**           been solved.
+**--------------------------------------------------------------
+*/
+{
+    double *Aii = sm->Aii;
+    double *Aij = sm->Aij;
+    double *B   = sm->F;
+    int *LNZ    = sm->LNZ;
+    int *XLNZ   = sm->XLNZ;
+    int *NZSUB  = sm->NZSUB;
+
+    int    i, j;
+    double bj;
+
+    for (j = last - 1; j >= first; j--)
+    {
+        bj = B[j];
+        for (i = XLNZ[j]; i < XLNZ[j+1]; i++)
+        {
+            bj -= Aij[LNZ[i]]*B[NZSUB[i]];
+        }
+        B[j] = bj/Aii[j];
+    }
+}
+
+void schurcoeffs(Smatrix *sm, Sdomains *dm, int first, int last)
+/*
+**--------------------------------------------------------------
+**  Input:   sm    = sparse matrix struct
+**           dm    = domains of the solution matrix
+**           first = first column of a domain
+**           last  = column after the domain's last column
+**  Output:  dm->Work = modifications of the interface's
+**           diagonal & off-diagonal coeffs.
+**  Purpose: finds the terms that a domain's factored columns
+**           subtract from the interface block of the solution
+**           matrix.
+**
+**  NOTE:    For each pair of interface rows a < b with non-zero
+**           coeffs. in a domain's column k, L(a,k)*L(b,k) is
+**           subtracted from the coeff. in row b of column a,
+**           which the symbolic factorization has placed among
+**           the column's non-zeros.
+**--------------------------------------------------------------
+*/
+{
+    double *Aij = sm->Aij;
+    int *LNZ    = sm->LNZ;
+    int *XLNZ   = sm->XLNZ;
+    int *NZSUB  = sm->NZSUB;
+
+    int    s0 = dm->Start[dm->Ndomains];
+    int    base = XLNZ[s0];
+    int    a, b, i, istop, k, p, ra, rb;
+    double la;
+    double *diag = dm->Work;
+    double *offdiag = &dm->Work[dm->Nrows];
+
+    for (k = first; k < last; k++)
+    {
+        istop = XLNZ[k+1];
+        i = XLNZ[k];
+        while (i < istop && NZSUB[i] < s0) i++;
+        for (a = i; a < istop; a++)
+        {
+            ra = NZSUB[a];
+            la = Aij[LNZ[a]];
+            diag[ra - s0] += la*la;
+            p = XLNZ[ra];
+            for (b = a + 1; b < istop; b++)
+            {
+                rb = NZSUB[b];
+                while (NZSUB[p] < rb) p++;
+                offdiag[p - base] += la*Aij[LNZ[b]];
+            }
+        }
+    }
+}
+
+int solveinterface(Smatrix *sm, Sdomains *dm, int n)
+/*
+**--------------------------------------------------------------
+**  Input:   sm = sparse matrix struct
+**           dm = domains of the solution matrix
+**           n  = number of equations
+**  Output:  sm->F = solution values of the interface rows
+**           returns 0 if solution found, or index of equation
+**           causing system to be ill-conditioned
+**  Purpose: solves the interface rows of the solution matrix
+**           once the contributions of all domains to them
+**           have been summed in dm->Sum.
+**--------------------------------------------------------------
+*/
+{
+    int    s0 = dm->Start[dm->Ndomains];
+    int    base = sm->XLNZ[s0];
+    int    i, errcode;
+    double *diag = dm->Sum;
+    double *offdiag = &dm->Sum[dm->Nrows];
+    double *rhs = &dm->Sum[dm->Nrows + dm->Ncoeffs];
+
+    // Form the Schur complement of the domains in the
+    // interface block and its right hand side
+    for (i = s0; i <= n; i++)
+    {
+        sm->Aii[i] -= diag[i - s0];
+        sm->F[i] -= rhs[i - s0];
+    }
+    for (i = base; i < sm->XLNZ[n + 1]; i++)
+    {
+        sm->Aij[sm->LNZ[i]] -= offdiag[i - base];
+    }
+
+    // Factor and solve it
+    errcode = factorcolumns(sm, s0, n + 1, n + 1);
+    if (errcode) return errcode;
+    forwardcolumns(sm, s0, n + 1, n + 1, NULL);
+    backcolumns(sm, s0, n + 1);
+    return 0;
+}
+
+int firstfailed(int row)
+/*
+**--------------------------------------------------------------
+**  Input:   row = ill-conditioned row of a process's domain
+**                 (0 if none)
+**  Output:  returns the first ill-conditioned row of all
+**           domains (0 if none)
+**  Purpose: shares the outcome of factoring the domains among
+**           all processes.
+**--------------------------------------------------------------
+*/
+{
+#ifdef USE_MPI
+    int first;
+
+    if (row == 0) row = INT_MAX;
+    MPI_Allreduce(&row, &first, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (first == INT_MAX) first = 0;
+    return first;
+#else
+    return row;
+#endif
+}
+
+void sumcontributions(Sdomains *dm, int size)
+/*
+**--------------------------------------------------------------
+**  Input:   dm   = domains of the solution matrix
+**           size = number of contributions
+**  Output:  dm->Sum = contributions summed over all domains
+**                     (on the process of rank 0)
+**  Purpose: sums the contributions of the domains to the
+**           interface rows.
+**--------------------------------------------------------------
+*/
+{
+#ifdef USE_MPI
+    MPI_Reduce(dm->Work, dm->Sum, size, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+#else
+    memcpy(dm->Sum, dm->Work, size * sizeof(double));
+#endif
+}
+
+int shareinterface(Sdomains *dm, int errcode, double *x)
+/*
+**--------------------------------------------------------------
+**  Input:   dm      = domains of the solution matrix
+**           errcode = outcome of solving the interface rows
+**           x       = solution values of the interface rows
+**                     (both on the process of rank 0)
+**  Output:  x       = solution values of the interface rows
+**           returns outcome of solving the interface rows
+**  Purpose: passes the interface solution from the process of
+**           rank 0 to all others.
+**--------------------------------------------------------------
+*/
+{
+    double *buf = dm->Work;
+
+    if (dm->Rank == 0)
+    {
+        buf[0] = errcode;
+        memcpy(&buf[1], x, dm->Nrows * sizeof(double));
+    }
+#ifdef USE_MPI
+    MPI_Bcast(buf, dm->Nrows + 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#endif
+    memcpy(x, &buf[1], dm->Nrows * sizeof(double));
+    return (int)buf[0];
+}
+
+void gatherdomains(Sdomains *dm, double *F)
+/*
+**--------------------------------------------------------------
+**  Input:   dm = domains of the solution matrix
+**           F  = solution vector with the process's own
+**                domain solved
+**  Output:  F  = solution vector of all domains
+**  Purpose: gathers the solutions of all domains on every
+**           process.
+**--------------------------------------------------------------
+*/
+{
+#ifdef USE_MPI
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &F[1], dm->Counts,
+                   dm->Displs, MPI_DOUBLE, MPI_COMM_WORLD);
+#else
+    (void)dm;
+    (void)F;
+#endif
+}
@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/10/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -84,6 +84,10 @@ char *DemandModelTxt[] = { w_DDA,
                            w_PDA,
                            NULL };
 
+char *TransportTxt[]    = {w_LAGRANGIAN,
+                           w_EULERIAN,
+                           NULL};
+
 char *QualTxt[]         = {w_NONE,
                            w_CHEM,
                            w_AGE,
@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/17/2026
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 
 #include "epanet2_2.h"
@@ -47,6 +48,7 @@ int DLLEXPORT EN_createproject(EN_Project *p)
     getTmpName(project->TmpHydFname);
     getTmpName(project->TmpOutFname);
     getTmpName(project->TmpStatFname);
+    getTmpName(project->TmpConstitFname);
     *p = project;
     return 0;
 }
@@ -67,6 +69,7 @@ int DLLEXPORT EN_deleteproject(EN_Project p)
     remove(p->TmpHydFname);
     remove(p->TmpOutFname);
     remove(p->TmpStatFname);
+    remove(p->TmpConstitFname);
     free(p);
     return 0;
 }
@@ -203,6 +206,155 @@ int DLLEXPORT EN_openX(EN_Project p, const char *inpFile,
     return openproject(p, inpFile, rptFile, outFile, TRUE);
 }    
 
+int DLLEXPORT EN_cloneproject(EN_Project p, EN_Project clone,
+    const char *rptFile, const char *outFile)
+/*----------------------------------------------------------------
+ **  Input:   clone = project that becomes a copy of p
+ **           rptFile = name of clone's report file
+ **           outFile = name of clone's binary output file
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: makes a project a copy of an open project that
+ **           shares its network data (see CLONE.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    if (clone == NULL || clone == p) return 251;
+    if (clone->Openflag) EN_close(clone);
+    return cloneproject(p, clone, rptFile, outFile);
+}
+
+int DLLEXPORT EN_runbatch(EN_Project p, const char *scnFile,
+    const char *sumFile, int nThreads)
+/*----------------------------------------------------------------
+ **  Input:   scnFile = name of scenario file
+ **           sumFile = name of summary file
+ **           nThreads = number of threads to use
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: runs a batch of scenarios that modify a project
+ **           (see BATCH.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runbatch(p, scnFile, sumFile, nThreads);
+}
+
+int DLLEXPORT EN_runmontecarlo(EN_Project p, const char *mcFile,
+    const char *statsFile, int nThreads)
+/*----------------------------------------------------------------
+ **  Input:   mcFile = name of Monte Carlo file
+ **           statsFile = name of results file
+ **           nThreads = number of threads to use
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: runs a Monte Carlo analysis of demand and roughness
+ **           uncertainty (see MONTECARLO.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runmontecarlo(p, mcFile, statsFile, nThreads);
+}
+
+int DLLEXPORT EN_runfireflow(EN_Project p, double pressure, long time,
+    const char *rptFile, int nThreads, double *out_flows)
+/*----------------------------------------------------------------
+ **  Input:   pressure = residual pressure target
+ **           time = time of analysis (sec)
+ **           rptFile = name of report file
+ **           nThreads = number of threads to use
+ **  Output:  out_flows = available fire flow at each node
+ **  Returns: error code
+ **  Purpose: finds the fire flow available at each junction
+ **           (see FIREFLOW.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runfireflow(p, pressure, time, rptFile, nThreads, out_flows);
+}
+
+int DLLEXPORT EN_runcriticality(EN_Project p, double pressure, long time,
+    const char *rptFile, int nThreads, double *out_shortfalls,
+    int *out_deficient)
+/*----------------------------------------------------------------
+ **  Input:   pressure = pressure target
+ **           time = time of analysis (sec)
+ **           rptFile = name of report file
+ **           nThreads = number of threads to use
+ **  Output:  out_shortfalls = demand shortfall with each link closed
+ **           out_deficient = number of deficient junctions with
+ **                           each link closed
+ **  Returns: error code
+ **  Purpose: finds the effect of closing each link of a network
+ **           (see CRITICALITY.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runcriticality(p, pressure, time, rptFile, nThreads,
+                          out_shortfalls, out_deficient);
+}
+
+int DLLEXPORT EN_runcalibration(EN_Project p, const char *calFile,
+    const char *obsFile, const char *rptFile, int nThreads)
+/*----------------------------------------------------------------
+ **  Input:   calFile = name of calibration file
+ **           obsFile = name of observations file
+ **           rptFile = name of report file
+ **           nThreads = number of threads to use
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: calibrates pipe roughness values and junction demands
+ **           against field observations (see CALIBRATE.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runcalibration(p, calFile, obsFile, rptFile, nThreads);
+}
+
+int DLLEXPORT EN_runqualbatch(EN_Project p, const char *hydFile,
+    const char *scnFile, const char *sumFile, int nThreads)
+/*----------------------------------------------------------------
+ **  Input:   hydFile = name of hydraulics file ("" to solve the
+ **                     project's hydraulics)
+ **           scnFile = name of scenario file
+ **           sumFile = name of summary file
+ **           nThreads = number of threads to use
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: runs a batch of water quality scenarios over shared
+ **           hydraulics (see QUALBATCH.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runqualbatch(p, hydFile, scnFile, sumFile, nThreads);
+}
+
+int DLLEXPORT EN_runbacktrack(EN_Project p, const char *hydFile,
+    const char *snsFile, const char *outFile, int nThreads)
+/*----------------------------------------------------------------
+ **  Input:   hydFile = name of hydraulics file ("" to solve the
+ **                     project's hydraulics)
+ **           snsFile = name of sensor file
+ **           outFile = name of results file
+ **           nThreads = number of threads to use
+ **  Output:  none
+ **  Returns: error code
+ **  Purpose: traces water sampled at sensor nodes back to the
+ **           nodes it passed through (see BACKTRACK.C).
+ **----------------------------------------------------------------
+ */
+{
+    if (!p->Openflag) return 102;
+    return runbacktrack(p, hydFile, snsFile, outFile, nThreads);
+}
+
 int DLLEXPORT EN_gettitle(EN_Project p, char *line1, char *line2, char *line3)
 /*----------------------------------------------------------------
 **  Input:   None
@@ -259,6 +411,7 @@ int  DLLEXPORT EN_setcomment(EN_Project p, int object, int index,
 **----------------------------------------------------------------
 */
 {
+    if (unshareobject(p, object)) return 101;
     return setcomment(&p->network, object, index, comment);
 }
 
@@ -286,6 +439,7 @@ int  DLLEXPORT EN_settag(EN_Project p, int object, int index,
 **----------------------------------------------------------------
 */
 {
+    if (unshareobject(p, object)) return 101;
     return settag(&p->network, object, index, tag);
 }
 int DLLEXPORT EN_getcount(EN_Project p, int object, int *count)
@@ -298,6 +452,7 @@ int DLLEXPORT EN_getcount(EN_Project p, int object, int *count)
 */
 {
     Network *net = &p->network;
+    int i;
 
     *count = 0;
     if (!p->Openflag) return 102;
@@ -324,6 +479,16 @@ int DLLEXPORT EN_getcount(EN_Project p, int object, int *count)
     case EN_RULECOUNT:
         *count = net->Nrules;
         break;
+    case EN_CONSTITCOUNT:
+        *count = p->quality.Nconstits;
+        break;
+    case EN_TRACECOUNT:
+        *count = (p->quality.Qualflag == TRACE);
+        for (i = 1; i <= p->quality.Nconstits; i++)
+        {
+            if (p->quality.Constit[i].Type == TRACE) (*count)++;
+        }
+        break;
     default:
         return 251;
     }
@@ -373,11 +538,8 @@ int DLLEXPORT EN_close(EN_Project p)
     }
 
     // Close hydraulics file
-    if (p->outfile.HydFile != NULL)
-    {
-        fclose(p->outfile.HydFile);
-        p->outfile.HydFile = NULL;
-    }
+    closehydfile(p);
+    p->outfile.HydData = NULL;
 
     // Reset system flags
     p->Openflag = FALSE;
@@ -583,6 +745,45 @@ int DLLEXPORT EN_nextH(EN_Project p, long *tStep)
     return errcode;
 }
 
+int DLLEXPORT EN_getsensitivity(EN_Project p, int param, int index,
+    double *headSens, double *flowSens)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter (see EN_SensitivityParam)
+**           index = index of parameter's link or node
+**  Output:  headSens = change in each node's head per unit change
+**                      in the parameter
+**           flowSens = change in each link's flow per unit change
+**                      in the parameter
+**  Returns: error code
+**  Purpose: finds the sensitivity of the current hydraulic
+**           solution to a parameter (see SENSITIVITY.C)
+**----------------------------------------------------------------
+*/
+{
+    if (!p->Openflag) return 102;
+    if (!p->hydraul.OpenHflag) return 103;
+    return sensitivity(p, param, index, headSens, flowSens);
+}
+
+int DLLEXPORT EN_getadjointgradient(EN_Project p, int param,
+    const double *headWeights, const double *flowWeights, double *gradient)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter (see EN_SensitivityParam)
+**           headWeights = weight on each node's head
+**           flowWeights = weight on each link's flow
+**  Output:  gradient = derivative of the weighted sum of heads and
+**                      flows w.r.t. each link's or node's parameter
+**  Returns: error code
+**  Purpose: finds the gradient of an objective function of the
+**           current hydraulic solution (see SENSITIVITY.C)
+**----------------------------------------------------------------
+*/
+{
+    if (!p->Openflag) return 102;
+    if (!p->hydraul.OpenHflag) return 103;
+    return adjointgradient(p, param, headWeights, flowWeights, gradient);
+}
+
 int DLLEXPORT EN_closeH(EN_Project p)
 /*----------------------------------------------------------------
 **  Input:   none
@@ -615,13 +816,24 @@ int DLLEXPORT EN_savehydfile(EN_Project p, const char *filename)
     FILE *f;
     FILE *HydFile;
     int c;
+    int errcode = 0;
 
     // Check that hydraulics results exist
-    if (p->outfile.HydFile == NULL || !p->outfile.SaveHflag) return 104;
+    if (p->outfile.HydFile == NULL && p->outfile.HydStore == NULL) return 104;
+    if (!p->outfile.SaveHflag) return 104;
 
     // Open the permanent hydraulics file
     if ((f = fopen(filename, "w+b")) == NULL) return 305;
 
+    // Write out hydraulics held in memory
+    if (p->outfile.HydStore)
+    {
+        if (fwrite(p->outfile.HydStore, 1, p->outfile.HydSize, f) <
+            p->outfile.HydSize) errcode = 308;
+        fclose(f);
+        return errcode;
+    }
+
     // Copy from the scratch file to f
     HydFile = p->outfile.HydFile;
     fseek(HydFile, 0, SEEK_SET);
@@ -843,6 +1055,59 @@ int DLLEXPORT EN_closeQ(EN_Project p)
     return 0;
 }
 
+/********************************************************************
+
+    Simulation State Functions
+
+********************************************************************/
+
+int DLLEXPORT EN_getstatesize(EN_Project p, long *size)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  size = size of the current simulation state (bytes)
+**  Returns: error code
+**  Purpose: finds the size of a buffer needed to save the current
+**           state of a simulation
+**----------------------------------------------------------------
+*/
+{
+    *size = 0;
+    if (!p->Openflag) return 102;
+    if (!p->hydraul.OpenHflag) return 103;
+    *size = statesize(p);
+    return 0;
+}
+
+int DLLEXPORT EN_savestate(EN_Project p, char *buffer, long size)
+/*----------------------------------------------------------------
+**  Input:   buffer = memory block to receive the simulation state
+**           size = size of buffer (bytes)
+**  Output:  none
+**  Returns: error code
+**  Purpose: saves the current state of a simulation
+**----------------------------------------------------------------
+*/
+{
+    if (!p->Openflag) return 102;
+    if (!p->hydraul.OpenHflag) return 103;
+    return savestate(p, buffer, size);
+}
+
+int DLLEXPORT EN_restorestate(EN_Project p, const char *buffer, long size)
+/*----------------------------------------------------------------
+**  Input:   buffer = memory block holding a saved simulation state
+**           size = size of buffer (bytes)
+**  Output:  none
+**  Returns: error code
+**  Purpose: restores a simulation to a previously saved state
+**----------------------------------------------------------------
+*/
+{
+    if (!p->Openflag) return 102;
+    if (!p->hydraul.OpenHflag) return 103;
+    return restorestate(p, buffer, size);
+}
+
 /********************************************************************
 
     Reporting Functions
@@ -950,6 +1215,7 @@ int DLLEXPORT EN_resetreport(EN_Project p)
     int i;
 
     if (!p->Openflag) return 102;
+    if (unshare(p, SHARED_NODES) || unshare(p, SHARED_LINKS)) return 101;
     initreport(&p->report);
     for (i = 1; i <= p->network.Nnodes; i++)
     {
@@ -975,6 +1241,7 @@ int DLLEXPORT EN_setreport(EN_Project p, const char *format)
 
     if (!p->Openflag) return 102;
     if (strlen(format) >= MAXLINE) return 250;
+    if (unshare(p, SHARED_NODES) || unshare(p, SHARED_LINKS)) return 101;
     strcpy(s1, format);
     strcat(s1, "\n");
     if (setreport(p, s1) > 0) return 250;
@@ -1098,6 +1365,21 @@ int DLLEXPORT EN_getstatistic(EN_Project p, int type, double *value)
     case EN_MASSBALANCE:
         *value = p->quality.MassBalance.ratio;
         break;
+    case EN_FULLSORTS:
+        *value = p->quality.Nfullsorts;
+        break;
+    case EN_LOCALSORTS:
+        *value = p->quality.Nlocalsorts;
+        break;
+    case EN_PEAKSEGMENTS:
+        *value = p->quality.Peaksegs;
+        break;
+    case EN_MERGEERROR:
+        *value = p->quality.MergeError * p->Ucf[QUALITY];
+        break;
+    case EN_QUALSTEPS:
+        *value = p->quality.Nqualsteps;
+        break;
     default:
         *value = 0.0;
         return 251;
@@ -1238,6 +1520,21 @@ int DLLEXPORT EN_getoption(EN_Project p, int option, double *value)
     case EN_STATUS_REPORT:
         v = (double)( p->report.Statflag);
         break;        
+    case EN_THREADS:
+        v = hyd->Threads;
+        break;
+    case EN_TRANSPORT:
+        v = qual->Transport;
+        break;
+    case EN_SEGBUDGET:
+        v = qual->SegBudget;
+        break;
+    case EN_COURANT:
+        v = qual->Courant;
+        break;
+    case EN_HYDMEMORY:
+        v = p->outfile.HydMemory;
+        break;
     default:
         return 251;
     }
@@ -1302,6 +1599,7 @@ int DLLEXPORT EN_setoption(EN_Project p, int option, double value)
 
     case EN_EMITEXPON:
         if (value <= 0.0) return 213;
+        if (unshare(p, SHARED_NODES)) return 101;
         n = 1.0 / value;
         ucf = pow(Ucf[FLOW], n) / Ucf[PRESSURE];
         for (i = 1; i <= Njuncs; i++)
@@ -1406,6 +1704,7 @@ int DLLEXPORT EN_setoption(EN_Project p, int option, double value)
         pat = ROUND(value);
         if (pat < 0 || pat > net->Npats) return 205;
         hyd->DefPat = pat;
+        resetdemands(p);
         break;
 
     case EN_EMITBACKFLOW:
@@ -1416,6 +1715,7 @@ int DLLEXPORT EN_setoption(EN_Project p, int option, double value)
     case EN_PRESS_UNITS:
         unit = ROUND(value);
         if (unit < 0 || unit > FEET) return 205;
+        if (unshare(p, SHARED_RULES)) return 101;
         p->parser.Pressflag = unit;
 
         dfactor = Ucf[DEMAND];
@@ -1438,6 +1738,32 @@ int DLLEXPORT EN_setoption(EN_Project p, int option, double value)
         p->report.Statflag = i;
         break;
 
+    case EN_THREADS:
+        if (value < 0.0) return 213;
+        hyd->Threads = ROUND(value);
+        break;
+
+    case EN_TRANSPORT:
+        i = ROUND(value);
+        if (i < EN_LAGRANGIAN || i > EN_EULERIAN) return 213;
+        qual->Transport = i;
+        break;
+
+    case EN_SEGBUDGET:
+        if (value < 0.0 || value > INT_MAX) return 213;
+        qual->SegBudget = (int)value;
+        break;
+
+    case EN_COURANT:
+        if (value < 0.0) return 213;
+        qual->Courant = value;
+        break;
+
+    case EN_HYDMEMORY:
+        if (value < 0.0) return 213;
+        p->outfile.HydMemory = value;
+        break;
+
     default:
         return 251;
     }
@@ -1477,6 +1803,8 @@ int DLLEXPORT EN_setflowunits(EN_Project p, int units)
 
     if (!p->Openflag) return 102;
 
+    if (unshare(p, SHARED_CURVES) || unshare(p, SHARED_RULES)) return 101;
+
     // Determine unit system based on flow units
     qfactor = Ucf[FLOW];
     vfactor = Ucf[VOLUME];
@@ -1539,6 +1867,8 @@ int DLLEXPORT EN_setflowunits(EN_Project p, int units)
             net->Curve[i].Y[j] = net->Curve[i].Y[j] / yfactor;
         }
     }
+    resetschedule(p);
+    resetdemands(p);
     return 0;
 }
 
@@ -1696,6 +2026,7 @@ int DLLEXPORT EN_settimeparam(EN_Project p, int param, long value)
     case EN_STARTTIME:
         if (value > SECperDAY) return 213;
 	    time->Tstart = value;
+        resetschedule(p);
         break;
 
     default:
@@ -1867,6 +2198,7 @@ int DLLEXPORT EN_setqualtype(EN_Project p, int qualType, const char *chemName,
     // values must be returned to their original ones
     if ((qual->Qualflag == AGE || qual->Qualflag == TRACE) && oldQualFlag == CHEM)
     {
+        if (unshare(p, SHARED_NODES)) return 101;
         for (i = 1; i <= p->network.Nnodes; i++)
         {
             p->network.Node[i].C0 *= Ucf[QUALITY];
@@ -1880,6 +2212,142 @@ int DLLEXPORT EN_setqualtype(EN_Project p, int qualType, const char *chemName,
     return 0;
 }
 
+int DLLEXPORT EN_addconstituent(EN_Project p, int type, const char *traceNode,
+                                int *index)
+/*----------------------------------------------------------------
+**  Input:   type = EN_AGE or EN_TRACE
+**           traceNode = ID name of node being traced (for EN_TRACE)
+**  Output:  index = index of the new constituent
+**  Returns: error code
+**  Purpose: adds a water quality constituent that is routed along
+**           with the one chosen by the QUALITY option
+**----------------------------------------------------------------
+*/
+{
+    Quality *qual = &p->quality;
+    int n = 0;
+
+    *index = 0;
+    if (!p->Openflag) return 102;
+    if (qual->OpenQflag) return 262;
+    if (type != AGE && type != TRACE) return 251;
+    if (type == TRACE)
+    {
+        n = findnode(&p->network, traceNode);
+        if (n == 0) return 212;
+    }
+    if (qual->Nconstits >= MAXCONSTITS) return 270;
+    qual->Nconstits++;
+    qual->Constit[qual->Nconstits].Type = type;
+    qual->Constit[qual->Nconstits].Node = n;
+    *index = qual->Nconstits;
+    return 0;
+}
+
+int DLLEXPORT EN_getconstituent(EN_Project p, int index, int *type,
+                                int *traceNode)
+/*----------------------------------------------------------------
+**  Input:   index = constituent index (1 to number of constituents)
+**  Output:  type = EN_AGE or EN_TRACE
+**           traceNode = index of node being traced (for EN_TRACE)
+**  Returns: error code
+**  Purpose: retrieves the properties of an added quality constituent
+**----------------------------------------------------------------
+*/
+{
+    Quality *qual = &p->quality;
+
+    *type = 0;
+    *traceNode = 0;
+    if (!p->Openflag) return 102;
+    if (index < 1 || index > qual->Nconstits) return 251;
+    *type = qual->Constit[index].Type;
+    *traceNode = qual->Constit[index].Node;
+    return 0;
+}
+
+int DLLEXPORT EN_getconstituentvalue(EN_Project p, int constit, int objectType,
+                                     int index, double *value)
+/*----------------------------------------------------------------
+**  Input:   constit = constituent index (1 to number of constituents)
+**           objectType = EN_NODE or EN_LINK
+**           index = node or link index
+**  Output:  value = current quality of the constituent
+**                   (hours for EN_AGE, percent for EN_TRACE)
+**  Returns: error code
+**  Purpose: retrieves the computed quality of an added constituent
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    Quality *qual = &p->quality;
+
+    *value = 0.0;
+    if (!p->Openflag) return 102;
+    if (!qual->OpenQflag) return 105;
+    if (constit < 1 || constit > qual->Nconstits) return 251;
+    if (objectType == EN_NODE)
+    {
+        if (index <= 0 || index > net->Nnodes) return 203;
+        *value = qual->ConstitQual[constit][index];
+    }
+    else if (objectType == EN_LINK)
+    {
+        if (index <= 0 || index > net->Nlinks) return 204;
+        *value = avgqual(p, constit, index);
+    }
+    else return 251;
+    return 0;
+}
+
+int DLLEXPORT EN_gettracematrix(EN_Project p, int *sources, double *matrix)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  sources = index of each traced source node
+**           matrix = fraction of each node's water that comes from
+**                    each source (node by source, row-major)
+**  Returns: error code
+**  Purpose: retrieves the current contribution of every traced
+**           source node to the water at each network node
+**  Note:    sources are the QUALITY option's trace node (if any)
+**           followed by each added TRACE constituent; sources
+**           may be NULL.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    Quality *qual = &p->quality;
+
+    int i, j, k, nsources = 0;
+    double *c[MAXCONSTITS + 1];
+
+    if (!p->Openflag) return 102;
+    if (!qual->OpenQflag) return 105;
+
+    // Collect the quality array and node of each source
+    if (qual->Qualflag == TRACE)
+    {
+        if (sources) sources[nsources] = qual->TraceNode;
+        c[nsources++] = qual->NodeQual;
+    }
+    for (k = 1; k <= qual->Nconstits; k++)
+    {
+        if (qual->Constit[k].Type != TRACE) continue;
+        if (sources) sources[nsources] = qual->Constit[k].Node;
+        c[nsources++] = qual->ConstitQual[k];
+    }
+
+    // Percent of flow from each source becomes a fraction
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        for (j = 0; j < nsources; j++)
+        {
+            *matrix++ = c[j][i] / 100.0;
+        }
+    }
+    return 0;
+}
+
 /********************************************************************
 
     Node Functions
@@ -1919,6 +2387,10 @@ int DLLEXPORT EN_addnode(EN_Project p, const char *id, int nodeType, int *index)
     // Check for valid node type
     if (nodeType < EN_JUNCTION || nodeType > EN_TANK) return 251;
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p) || unshare(p, SHARED_MATRIX)) return 101;
+
     // Grow node-related arrays to accommodate the new node
     size = (net->Nnodes + 2) * sizeof(Snode);
     net->Node = (Snode *)realloc(net->Node, size);
@@ -2053,6 +2525,10 @@ int DLLEXPORT EN_deletenode(EN_Project p, int index, int actionCode)
 
     // Can't delete a water quality trace node
     if (index == p->quality.TraceNode) return 260;
+    for (i = 1; i <= p->quality.Nconstits; i++)
+    {
+        if (index == p->quality.Constit[i].Node) return 260;
+    }
 
     // Do not delete a node contained in a control or is connected to a link
     if (actionCode == EN_CONDITIONAL)
@@ -2065,6 +2541,10 @@ int DLLEXPORT EN_deletenode(EN_Project p, int index, int actionCode)
         }
     }
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p) || unshare(p, SHARED_MATRIX)) return 101;
+
     // Get a reference to the node & its type
     node = &net->Node[index];
     EN_getnodetype(p, index, &nodeType);
@@ -2086,6 +2566,10 @@ int DLLEXPORT EN_deletenode(EN_Project p, int index, int actionCode)
         hashtable_update(net->NodeHashTable, net->Node[i].ID, i);
     }
     if (index < p->quality.TraceNode) (p->quality.TraceNode)--;
+    for (i = 1; i <= p->quality.Nconstits; i++)
+    {
+        if (index < p->quality.Constit[i].Node) (p->quality.Constit[i].Node)--;
+    }
 
     // If deleted node is a tank, remove it from the Tank array
     if (nodeType != EN_JUNCTION)
@@ -2191,6 +2675,8 @@ int DLLEXPORT EN_setnodeid(EN_Project p, int index, const char *newid)
     // Check if another node with same name exists
     if (hashtable_find(net->NodeHashTable, newid) > 0) return 215;
 
+    if (unshare(p, SHARED_NODES) || unshare(p, SHARED_HASH)) return 101;
+
     // Replace the existing node ID with the new value
     hashtable_delete(net->NodeHashTable, net->Node[index].ID);
     strncpy(net->Node[index].ID, newid, MAXID);
@@ -2491,6 +2977,14 @@ int DLLEXPORT EN_setnodevalue(EN_Project p, int index, int property, double valu
 
     if (!p->Openflag) return 102;
     if (index <= 0 || index > nNodes) return 203;
+    if (unshare(p, SHARED_NODES) || unshare(p, SHARED_TANKS)) return 101;
+    Node = net->Node;
+    Tank = net->Tank;
+
+    // Rules and events that depend on node data must be re-evaluated
+    resetrules(p);
+    resetschedule(p);
+
     switch (property)
     {
     case EN_ELEVATION:
@@ -2512,6 +3006,7 @@ int DLLEXPORT EN_setnodevalue(EN_Project p, int index, int property, double valu
         if (index <= nJuncs)
         {
             if (Node[index].D) Node[index].D->Base = value / Ucf[FLOW];
+            resetdemands(p);
         }
         break;
 
@@ -2522,6 +3017,7 @@ int DLLEXPORT EN_setnodevalue(EN_Project p, int index, int property, double valu
         if (index <= nJuncs)
         {
             if (Node[index].D) Node[index].D->Pat = j;
+            resetdemands(p);
         }
         else Tank[index - nJuncs].Pat = j;
         break;
@@ -2784,6 +3280,8 @@ int DLLEXPORT EN_setjuncdata(EN_Project p, int index, double elev,
         if (EN_getpatternindex(p, dmndpat, &patIndex) > 0) return 205;
     }
 
+    if (unshare(p, SHARED_NODES)) return 101;
+
     // Assign demand parameters to junction's primary demand category
     node = &(p->network.Node[index]);
     dmnd /= p->Ucf[FLOW];
@@ -2795,9 +3293,12 @@ int DLLEXPORT EN_setjuncdata(EN_Project p, int index, double elev,
     }
     // No demand categories exist -- create a new one
     else if (!adddemand(node, dmnd, patIndex, NULL)) return 101;
+    resetdemands(p);
 
     // Assign new elevation value to junction
     node->El = elev / p->Ucf[ELEV];
+    resetrules(p);
+    resetschedule(p);
     return 0;
 }
 
@@ -2860,6 +3361,9 @@ int DLLEXPORT EN_settankdata(EN_Project p, int index, double elev,
     // Tank diameter supplied
     else area = PI * diam * diam / 4.0;
 
+    if (unshare(p, SHARED_NODES) || unshare(p, SHARED_TANKS)) return 101;
+    Tank = net->Tank;
+
     // Assign parameters to tank object
     net->Node[Tank[j].Node].El = elev / Ucf[ELEV];
     Tank[j].A = area / Ucf[ELEV] / Ucf[ELEV];
@@ -2875,6 +3379,8 @@ int DLLEXPORT EN_settankdata(EN_Project p, int index, double elev,
     else Tank[j].Vmin = tankvolume(p, j, Tank[j].Hmin);
     Tank[j].V0 = tankvolume(p, j, Tank[j].H0);
     Tank[j].Vmax = tankvolume(p, j, Tank[j].Hmax);
+    resetrules(p);
+    resetschedule(p);
     return 0;
 }
 
@@ -2920,6 +3426,7 @@ int DLLEXPORT EN_setcoord(EN_Project p, int index, double x, double y)
 
     if (!p->Openflag) return 102;
     if (index < 1 || index > p->network.Nnodes) return 203;
+    if (unshare(p, SHARED_NODES)) return 101;
     node = &net->Node[index];
     node->X = x;
     node->Y = y;
@@ -3005,9 +3512,12 @@ int  DLLEXPORT EN_adddemand(EN_Project p, int nodeIndex, double baseDemand,
     // Do nothing if node is not a junction
     if (nodeIndex > p->network.Njuncs) return 0;
 
+    if (unshare(p, SHARED_NODES)) return 101;
+
     // Add the new demand to the node's demands list
     node = &(p->network.Node[nodeIndex]);
     if (!adddemand(node, baseDemand / p->Ucf[FLOW], patIndex, demandName)) return 101;
+    resetdemands(p);
     return 0;
 }
 
@@ -3031,6 +3541,10 @@ int DLLEXPORT EN_deletedemand(EN_Project p, int nodeIndex, int demandIndex)
     // Only junctions have demands
     if (nodeIndex <= p->network.Njuncs)
     {
+        resetdemands(p);
+
+        if (unshare(p, SHARED_NODES)) return 101;
+
         // Find head of node's list of demands
         node = &p->network.Node[nodeIndex];
         d = node->D;
@@ -3178,12 +3692,15 @@ int DLLEXPORT EN_setbasedemand(EN_Project p, int nodeIndex, int demandIndex,
     if (!p->Openflag) return 102;
     if (nodeIndex <= 0 || nodeIndex > p->network.Nnodes) return 203;
 
+    if (unshare(p, SHARED_NODES)) return 101;
+
     // Locate target demand in node's demands list
     d = finddemand(p->network.Node[nodeIndex].D, demandIndex);
     if (d == NULL) return 253;
 
     // Assign new base value to target demand
     d->Base = baseDemand / p->Ucf[FLOW];
+    resetdemands(p);
     return 0;
 }
 
@@ -3233,6 +3750,8 @@ int DLLEXPORT EN_setdemandname(EN_Project p, int nodeIndex, int demandIndex,
     if (!p->Openflag) return 102;
     if (nodeIndex <= 0 || nodeIndex > p->network.Njuncs) return 203;
 
+    if (unshare(p, SHARED_NODES)) return 101;
+
     // Locate target demand in node's demands list
     d = finddemand(p->network.Node[nodeIndex].D, demandIndex);
     if (d == NULL) return 253;
@@ -3291,12 +3810,15 @@ int  DLLEXPORT EN_setdemandpattern(EN_Project p, int nodeIndex, int demandIndex,
     if (nodeIndex <= 0 || nodeIndex > net->Nnodes) return 203;
     if (patIndex < 0 || patIndex > net->Npats) return 205;
 
+    if (unshare(p, SHARED_NODES)) return 101;
+
     // Locate target demand in node's demand list
     d = finddemand(p->network.Node[nodeIndex].D, demandIndex);
     if (d == NULL) return 253;
 
     // Assign new time pattern to target demand
     d->Pat = patIndex;
+    resetdemands(p);
     return 0;
 }
 
@@ -3341,6 +3863,10 @@ int DLLEXPORT EN_addlink(EN_Project p, const char *id, int linkType,
     // Check for valid link type
     if (linkType < CVPIPE || linkType > PCV) return 251;
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p) || unshare(p, SHARED_MATRIX)) return 101;
+
     // Lookup the link's from and to nodes
     n1 = hashtable_find(net->NodeHashTable, fromNode);
     n2 = hashtable_find(net->NodeHashTable, toNode);
@@ -3490,6 +4016,10 @@ int DLLEXPORT EN_deletelink(EN_Project p, int index, int actionCode)
         if (actionCode > 0) return 261;
     }
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p) || unshare(p, SHARED_MATRIX)) return 101;
+
     // Get references to the link and its type
     link = &net->Link[index];
     EN_getlinktype(p, index, &linkType);
@@ -3619,6 +4149,8 @@ int DLLEXPORT EN_setlinkid(EN_Project p, int index, const char *newid)
     // Check if another link with same name exists
     if (hashtable_find(net->LinkHashTable, newid) > 0) return 215;
 
+    if (unshare(p, SHARED_LINKS) || unshare(p, SHARED_HASH)) return 101;
+
     // Replace the existing link ID with the new value
     hashtable_delete(net->LinkHashTable, net->Link[index].ID);
     strncpy(net->Link[index].ID, newid, MAXID);
@@ -3690,6 +4222,8 @@ int DLLEXPORT EN_setlinktype(EN_Project p, int *index, int linkType, int actionC
         if (actionCode > 0) return 261;
     }
 
+    if (unshare(p, SHARED_LINKS)) return 101;
+
     // Pipe changing from or to having a check valve
     if (oldType <= PIPE && linkType <= PIPE)
     {
@@ -3773,6 +4307,10 @@ int DLLEXPORT EN_setlinknodes(EN_Project p, int index, int node1, int node2)
         if (errcode) return errcode;
     }
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p) || unshare(p, SHARED_MATRIX)) return 101;
+
     // Assign new end nodes to link
     net->Link[index].N1 = node1;
     net->Link[index].N2 = node2;
@@ -3926,7 +4464,7 @@ int DLLEXPORT EN_getlinkvalue(EN_Project p, int index, int property, double *val
         break;
 
     case EN_LINKQUAL:
-        v = avgqual(p, index) * Ucf[LINKQUAL];
+        v = avgqual(p, 0, index) * Ucf[LINKQUAL];
         break;
 
     case EN_LINKPATTERN:
@@ -4076,6 +4614,8 @@ int DLLEXPORT EN_setlinkvalue(EN_Project p, int index, int property, double valu
 
     if (!p->Openflag) return 102;
     if (index <= 0 || index > net->Nlinks) return 204;
+    if (unshare(p, SHARED_LINKS) || unshare(p, SHARED_PUMPS) || unshare(p, SHARED_VALVES)) return 101;
+    Link = net->Link;
     switch (property)
     {
     case EN_DIAMETER:
@@ -4332,6 +4872,9 @@ int DLLEXPORT EN_setpipedata(EN_Project p, int index, double length,
     // Check for valid parameters
     if (length <= 0.0 || diam <= 0.0 || rough <= 0.0 || mloss < 0.0) return 211;
 
+    if (unshare(p, SHARED_LINKS)) return 101;
+    Link = net->Link;
+
     // Assign parameters to pipe
     Link[index].Len = length / Ucf[ELEV];
     diameter /= Ucf[DIAM];
@@ -4425,6 +4968,9 @@ int DLLEXPORT EN_setvertex(EN_Project p, int index, int vertex, double x, double
     if (!p->Openflag) return 102;
     if (index <= 0 || index > net->Nlinks) return 204;
 
+    if (unshare(p, SHARED_LINKEXTRA)) return 101;
+    Link = net->Link;
+
     // Check that vertex exists
     vertices = Link[index].Vertices;
     if (vertices == NULL) return 255;
@@ -4454,6 +5000,7 @@ int DLLEXPORT EN_setvertices(EN_Project p, int index, double *x, double *y, int
     // Check that link exists
     if (!p->Openflag) return 102;
     if (index <= 0 || index > net->Nlinks) return 204;
+    if (unshare(p, SHARED_LINKEXTRA)) return 101;
     link = &net->Link[index];
 
     // Delete existing set of vertices
@@ -4543,6 +5090,8 @@ int DLLEXPORT EN_setheadcurveindex(EN_Project p, int linkIndex, int curveIndex)
     if (PUMP != net->Link[linkIndex].Type) return 0;
     if (curveIndex < 0 || curveIndex > net->Ncurves) return 206;
 
+    if (unshare(p, SHARED_LINKS) || unshare(p, SHARED_PUMPS)) return 101;
+
     // Assign the new curve to the pump
     pumpIndex = findpump(net, linkIndex);
     pump = &net->Pump[pumpIndex];
@@ -4579,6 +5128,8 @@ int DLLEXPORT EN_addpattern(EN_Project p, const char *id)
     // Check if id name contains invalid characters
     if (!namevalid(id)) return 252;
 
+    if (unshare(p, SHARED_PATTERNS)) return 101;
+
     // Expand the project's array of patterns
     n = net->Npats + 1;
     net->Pattern = (Spattern *)realloc(net->Pattern, (n + 1) * sizeof(Spattern));
@@ -4691,6 +5242,10 @@ int  DLLEXPORT EN_deletepattern(EN_Project p, int index)
     // Check that pattern exists
     if (index < 1 || index > p->network.Npats) return 205;
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p)) return 101;
+
     // Adjust references by other objects to patterns
     adjustpatterns(net, index);
 
@@ -4775,6 +5330,7 @@ int DLLEXPORT EN_setpatternid(EN_Project p, int index, const char *id)
     {
         if (i != index && strcmp(id, p->network.Pattern[i].ID) == 0) return 215;
     }
+    if (unshare(p, SHARED_PATTERNS)) return 101;
     strcpy(p->network.Pattern[index].ID, id);
     return 0;
 }
@@ -4831,7 +5387,10 @@ int DLLEXPORT EN_setpatternvalue(EN_Project p, int index, int period, double val
     if (!p->Openflag) return  102;
     if (index <= 0 || index > net->Npats) return 205;
     if (period <= 0 || period > Pattern[index].Length) return 251;
+    if (unshare(p, SHARED_PATTERNS)) return 101;
+    Pattern = net->Pattern;
     Pattern[index].F[period - 1] = value;
+    resetdemands(p);
     return 0;
 }
 
@@ -4882,6 +5441,9 @@ int DLLEXPORT EN_setpattern(EN_Project p, int index, double *values, int len)
     if (values == NULL) return 205;
     if (len <= 0) return 202;
 
+    if (unshare(p, SHARED_PATTERNS)) return 101;
+    Pattern = net->Pattern;
+
     // Re-set number of time periods & reallocate memory for multipliers
     Pattern[index].Length = len;
     Pattern[index].F = (double *)realloc(Pattern[index].F, len * sizeof(double));
@@ -4889,6 +5451,7 @@ int DLLEXPORT EN_setpattern(EN_Project p, int index, double *values, int len)
 
     // Load multipliers into pattern
     for (j = 0; j < len; j++) Pattern[index].F[j] = values[j];
+    resetdemands(p);
     return 0;
 }
 
@@ -4919,6 +5482,8 @@ int DLLEXPORT EN_addcurve(EN_Project p, const char *id)
     // Check if id name contains invalid characters
     if (!namevalid(id)) return 252;
 
+    if (unshare(p, SHARED_CURVES)) return 101;
+
     // Expand the array of curves
     n = net->Ncurves + 1;
     net->Curve = (Scurve *) realloc(net->Curve, (n + 1) * sizeof(Scurve));
@@ -4975,6 +5540,10 @@ int  DLLEXPORT EN_deletecurve(EN_Project p, int index)
     // Check that curve exists
     if (index < 1 || index > p->network.Ncurves) return 205;
 
+    // Use the project's own copy of any network data shared with
+    // its clones (see CLONE.C)
+    if (unshareall(p)) return 101;
+
     // Adjust references by other objects to curves
     adjustcurves(net, index);
 
@@ -5043,6 +5612,7 @@ int DLLEXPORT EN_setcurveid(EN_Project p, int index, const char *id)
     {
         if (i != index && strcmp(id, p->network.Curve[i].ID) == 0) return 215;
     }
+    if (unshare(p, SHARED_CURVES)) return 101;
     strcpy(p->network.Curve[index].ID, id);
     return 0;
 }
@@ -5091,6 +5661,7 @@ int DLLEXPORT EN_setcurvetype(EN_Project p, int index, int type)
     if (!p->Openflag) return 102;
     if (index < 1 || index > net->Ncurves) return 206;
     if (type < 0 || type > EN_VALVE_CURVE) return 251;
+    if (unshare(p, SHARED_CURVES)) return 101;
     net->Curve[index].Type = type;
     return 0;
 }
@@ -5139,6 +5710,7 @@ int DLLEXPORT EN_setcurvevalue(EN_Project p, int curveIndex, int pointIndex,
     // Check for valid input
     if (!p->Openflag) return 102;
     if (curveIndex <= 0 || curveIndex > net->Ncurves) return 206;
+    if (unshare(p, SHARED_CURVES)) return 101;
     curve = &net->Curve[curveIndex];
     if (pointIndex <= 0) return 251;
 
@@ -5164,6 +5736,7 @@ int DLLEXPORT EN_setcurvevalue(EN_Project p, int curveIndex, int pointIndex,
     // Insert new point into curve
     curve->X[n] = x;
     curve->Y[n] = y;
+    resetschedule(p);
     return 0;
 }
 
@@ -5226,6 +5799,7 @@ int DLLEXPORT EN_setcurve(EN_Project p, int index, double *xValues,
     for (j = 1; j < nPoints; j++) if (xValues[j-1] >= xValues[j]) return 230;
 
     // Expand size of curve's data arrays if need be
+    if (unshare(p, SHARED_CURVES)) return 101;
     curve = &net->Curve[index];
     if (resizecurve(curve, nPoints) > 0) return 101;
 
@@ -5236,6 +5810,7 @@ int DLLEXPORT EN_setcurve(EN_Project p, int index, double *xValues,
         curve->X[j] = xValues[j];
         curve->Y[j] = yValues[j];
     }
+    resetschedule(p);
     return 0;
 }
 
@@ -5276,6 +5851,8 @@ int DLLEXPORT EN_addcontrol(EN_Project p, int type, int linkIndex, double settin
     err = setcontrol(p, type, linkIndex, setting, nodeIndex, level, &ctrl);
     if (err > 0) return err;
 
+    if (unshare(p, SHARED_CONTROLS)) return 101;
+
     // Expand project's array of controls
     n = net->Ncontrols + 1;
     net->Control = (Scontrol *)realloc(net->Control, (n + 1) * sizeof(Scontrol));
@@ -5286,6 +5863,7 @@ int DLLEXPORT EN_addcontrol(EN_Project p, int type, int linkIndex, double settin
     // Update number of controls
     net->Ncontrols = n;
     p->parser.MaxControls = n;
+    resetschedule(p);
 
     // Replace the control's index
     *index = n;
@@ -5305,11 +5883,13 @@ int DLLEXPORT EN_deletecontrol(EN_Project p, int index)
     int i;
 
     if (index <= 0 || index > net->Ncontrols) return 241;
+    if (unshare(p, SHARED_CONTROLS)) return 101;
     for (i = index; i <= net->Ncontrols - 1; i++)
     {
         net->Control[i] = net->Control[i + 1];
     }
     net->Ncontrols--;
+    resetschedule(p);
     return 0;
 }
 
@@ -5423,10 +6003,13 @@ int DLLEXPORT EN_setcontrol(EN_Project p, int index, int type, int linkIndex,
     // Check that control exists
     if (index <= 0 || index > net->Ncontrols) return 241;
 
+    if (unshare(p, SHARED_CONTROLS)) return 101;
+
     // Check that controlled link exists (0 index de-activates the control)
     if (linkIndex == 0)
     {
         net->Control[index].Link = 0;
+        resetschedule(p);
         return 0;
     }
     if (linkIndex < 0 || linkIndex > net->Nlinks) return 204;
@@ -5435,6 +6018,7 @@ int DLLEXPORT EN_setcontrol(EN_Project p, int index, int type, int linkIndex,
     err = setcontrol(p, type, linkIndex, setting, nodeIndex, level, &ctrl);
     if (err > 0) return err;
     net->Control[index] = ctrl;
+    resetschedule(p);
     return 0;
 }
 
@@ -5469,6 +6053,7 @@ int  DLLEXPORT EN_setcontrolenabled(EN_Project p, int index, int enabled)
     if (index <= 0 || index > net->Ncontrols) 
         return 241;
 
+    if (unshare(p, SHARED_CONTROLS)) return 101;
     control = &net->Control[index];
     control->isEnabled = enabled;
     return 0;
@@ -5498,6 +6083,8 @@ int DLLEXPORT EN_addrule(EN_Project p, char *rule)
     char *nextline;
     char line2[MAXLINE+1];
 
+    if (unshare(p, SHARED_RULES)) return 101;
+
     // Resize rules array
     net->Rule = (Srule *)realloc(net->Rule, (net->Nrules + 2)*sizeof(Srule));
     rules->Errcode = 0;
@@ -5546,6 +6133,7 @@ int DLLEXPORT EN_deleterule(EN_Project p, int index)
 */
 {
     if (index < 1 || index > p->network.Nrules) return 257;
+    if (unshare(p, SHARED_RULES)) return 101;
     deleterule(p, index);
     return 0;
 }
@@ -5680,6 +6268,7 @@ int DLLEXPORT EN_setpremise(EN_Project p, int ruleIndex, int premiseIndex,
 
     if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     premises = p->network.Rule[ruleIndex].Premises;
     premise = getpremise(premises, premiseIndex);
     if (premise == NULL)  return 258;
@@ -5691,6 +6280,7 @@ int DLLEXPORT EN_setpremise(EN_Project p, int ruleIndex, int premiseIndex,
     premise->relop = relop;
     premise->status = status;
     premise->value = value;
+    p->rules.Compiled = FALSE;
     return 0;
 }
 
@@ -5711,11 +6301,13 @@ int DLLEXPORT EN_setpremiseindex(EN_Project p, int ruleIndex, int premiseIndex,
 
     if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     premises = p->network.Rule[ruleIndex].Premises;
     premise = getpremise(premises, premiseIndex);
     if (premise == NULL)  return 258;
 
     premise->index = objIndex;
+    p->rules.Compiled = FALSE;
     return 0;
 }
 
@@ -5737,11 +6329,13 @@ int DLLEXPORT EN_setpremisestatus(EN_Project p, int ruleIndex, int premiseIndex,
 
     if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     premises = p->network.Rule[ruleIndex].Premises;
     premise = getpremise(premises, premiseIndex);
     if (premise == NULL) return 258;
 
     premise->status = status;
+    p->rules.Compiled = FALSE;
     return 0;
 }
 
@@ -5762,11 +6356,13 @@ int DLLEXPORT EN_setpremisevalue(EN_Project p, int ruleIndex, int premiseIndex,
 
     if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     premises = p->network.Rule[ruleIndex].Premises;
     premise = getpremise(premises, premiseIndex);
     if (premise == NULL) return 258;
 
     premise->value = value;
+    p->rules.Compiled = FALSE;
     return 0;
 }
 
@@ -5816,6 +6412,7 @@ int DLLEXPORT EN_setthenaction(EN_Project p, int ruleIndex, int actionIndex,
 
     if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     actions = p->network.Rule[ruleIndex].ThenActions;
     action = getaction(actions, actionIndex);
     if (action == NULL) return 258;
@@ -5823,6 +6420,7 @@ int DLLEXPORT EN_setthenaction(EN_Project p, int ruleIndex, int actionIndex,
     action->link = linkIndex;
     action->status = status;
     action->setting = setting;
+    p->rules.Compiled = FALSE;
     return 0;
 }
 
@@ -5872,6 +6470,7 @@ int DLLEXPORT EN_setelseaction(EN_Project p, int ruleIndex, int actionIndex,
 
   if (ruleIndex < 1 || ruleIndex > p->network.Nrules) return 257;
 
+  if (unshare(p, SHARED_RULES)) return 101;
   actions = p->network.Rule[ruleIndex].ElseActions;
   action = getaction(actions, actionIndex);
   if (action == NULL) return 258;
@@ -5879,6 +6478,7 @@ int DLLEXPORT EN_setelseaction(EN_Project p, int ruleIndex, int actionIndex,
   action->link = linkIndex;
   action->status = status;
   action->setting = setting;
+  p->rules.Compiled = FALSE;
   return 0;
 }
 
@@ -5893,6 +6493,7 @@ int DLLEXPORT EN_setrulepriority(EN_Project p, int index, double priority)
 */
 {
     if (index <= 0 || index > p->network.Nrules)  return 257;
+    if (unshare(p, SHARED_RULES)) return 101;
     p->network.Rule[index].priority = priority;
     return 0;
 }
@@ -5928,6 +6529,7 @@ int  DLLEXPORT EN_setruleenabled(EN_Project p, int index, int enabled)
     if (index <= 0 || index > net->Nrules) 
         return 241;
 
+    if (unshare(p, SHARED_RULES)) return 101;
     rule = &net->Rule[index];
     rule->isEnabled = enabled;
     return 0;
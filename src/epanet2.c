@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/14/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -32,6 +32,7 @@ void createtmpfiles()
     getTmpName(_defaultProject->TmpHydFname);
     getTmpName(_defaultProject->TmpOutFname);
     getTmpName(_defaultProject->TmpStatFname);
+    getTmpName(_defaultProject->TmpConstitFname);
 }
 
 void removetmpfiles()
@@ -39,6 +40,7 @@ void removetmpfiles()
     remove(_defaultProject->TmpHydFname);
     remove(_defaultProject->TmpOutFname);
     remove(_defaultProject->TmpStatFname);
+    remove(_defaultProject->TmpConstitFname);
 }
 
 
@@ -203,6 +205,24 @@ int DLLEXPORT ENstepQ(long *timeLeft) { return EN_stepQ(_defaultProject, timeLef
 
 int DLLEXPORT ENcloseQ() { return EN_closeQ(_defaultProject); }
 
+/********************************************************************
+
+    Simulation State Functions
+
+********************************************************************/
+
+int DLLEXPORT ENgetstatesize(long *size) { return EN_getstatesize(_defaultProject, size); }
+
+int DLLEXPORT ENsavestate(char *buffer, long size)
+{
+    return EN_savestate(_defaultProject, buffer, size);
+}
+
+int DLLEXPORT ENrestorestate(const char *buffer, long size)
+{
+    return EN_restorestate(_defaultProject, buffer, size);
+}
+
 /********************************************************************
 
     Reporting Functions
@@ -0,0 +1,393 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       fireflow.c
+ Description:  finds the fire flow available at each junction of a network
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A fire flow analysis finds, for each junction of a network, the largest
+extra flow (the fire flow) that can be drawn from it at a given time while
+keeping its pressure at or above a residual pressure target.
+
+The hydraulics of the base case (with no fire flow) are solved once and the
+matrix of that solution is factored (see BASECASE.C). Each junction is then
+analyzed on its own, in parallel with the others, as follows:
+
+1. The sensitivity of its head to a flow drawn from it is found from the
+   factored matrix (one forward & back substitution) and gives a first
+   estimate of the fire flow that brings its pressure down to the target.
+
+2. Secant iterations on the fire flow (falling back on bisection once the
+   fire flow is bracketed) refine the estimate, each one solving the
+   network's hydraulics with chordsolve() (see HYDSOLVER.C), which re-uses
+   the factored base case matrix instead of re-factoring a new one at each
+   iteration.
+
+3. If chordsolve() fails to converge (a fire flow far larger than the base
+   case flows makes the base case matrix a poor approximation), or its
+   solution would change the status of a link (e.g., a check valve closing or
+   a PRV becoming active), a full solution is made with hydsolve() instead and
+   the matrix of that solution is factored for the secant iterations that
+   follow, which usually lie close to it.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runfireflow(Project *, double, long, const char *, int, double *);
+
+// Imported functions
+extern int  hydsolve(Project *, int *, double *);            //(see HYDSOLVER.C)
+extern int  chordsolve(Project *, Sfactor *, int, int *, double *);
+extern int  hydfactor(Project *, Sfactor *);
+extern void linsubst(Smatrix *, double *, double *, double *, int); //(see SMATRIX.C)
+
+#define MAXSECANT 40       // Max. secant iterations on fire flow
+#define MAXCHORD  10       // Max. iterations of chordsolve()
+#define PTOL      0.01     // Tolerance on residual pressure (ft)
+#define QRTOL     1.e-4    // Relative tolerance on fire flow
+
+// Results of a junction's fire flow analysis
+typedef struct {
+    double pressure;       // static pressure (ft)
+    double flow;           // available fire flow (cfs)
+    double minpress;       // lowest junction pressure at fire flow (ft)
+    int    minnode;        // junction with lowest pressure
+    int    fullsolves;     // number of full hydraulic solutions made
+    int    errcode;        // error or warning code
+} Sfireflow;
+
+// A worker thread's data
+typedef struct {
+    EN_Project  project;     // clone of project being analyzed
+    double      *work;       // work vector
+    Sfactor     factor;      // factored matrix of last full solution
+    int         factored;    // TRUE if factor is in use
+} Sfireworker;
+
+// Fire flow analysis data shared by the worker threads
+typedef struct {
+    Project     *base;       // project being analyzed
+    Sbasecase   bc;          // base case shared by the workers
+    Sfireworker *workers;    // each worker's data
+    double      target;      // residual pressure target (ft)
+    long        time;        // time of analysis (sec)
+    int         nfull;       // number of junctions needing full solutions
+    Sfireflow   *results;    // results for each junction
+} Sfirestudy;
+
+// Local functions
+static int    allocfirestudy(Sfirestudy *);
+static void   analyzejunction(void *, int, int);
+static int    solvefireflow(Sfirestudy *, Sfireworker *, int, double, int *);
+static void   writefirestudy(Sfirestudy *, FILE *);
+static void   freefirestudy(Sfirestudy *);
+
+
+int runfireflow(Project *pr, double pressure, long time, const char *rptFile,
+                int nthreads, double *flows)
+/*----------------------------------------------------------------
+**  Input:   pressure = residual pressure target (user units)
+**           time = time of analysis (sec)
+**           rptFile = name of report file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  flows = available fire flow at each node (user
+**                   units, may be NULL)
+**           returns an error code
+**  Purpose: finds the fire flow available at each junction.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Sfirestudy fs;
+    FILE *f;
+    int i, errcode = 0;
+
+    if (pressure < 0.0 || time < 0) return 202;
+    memset(&fs, 0, sizeof(Sfirestudy));
+    fs.base = pr;
+    fs.target = pressure / pr->Ucf[PRESSURE];
+    fs.time = time;
+
+    // Solve the base case on the worker threads & analyze each junction
+    errcode = openbasecase(pr, &fs.bc, time, net->Njuncs, nthreads);
+    if (!errcode) errcode = allocfirestudy(&fs);
+    if (!errcode) workpool_run(fs.bc.Pool, net->Njuncs, analyzejunction, &fs);
+
+    // Report the results
+    if (!errcode)
+    {
+        if (strlen(rptFile) == 0) writefirestudy(&fs, stdout);
+        else if ((f = fopen(rptFile, "wt")) == NULL) errcode = 314;
+        else
+        {
+            writefirestudy(&fs, f);
+            fclose(f);
+        }
+    }
+    if (!errcode && flows)
+    {
+        for (i = 1; i <= net->Nnodes; i++)
+        {
+            if (i <= net->Njuncs) flows[i - 1] =
+                fs.results[i - 1].flow * pr->Ucf[FLOW];
+            else flows[i - 1] = 0.0;
+        }
+    }
+    freefirestudy(&fs);
+    return errcode;
+}
+
+int allocfirestudy(Sfirestudy *fs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: allocates memory used by a fire flow analysis.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &fs->base->network;
+    Smatrix *sm = &fs->bc.Clones[0]->hydraul.smatrix;
+    Sfireworker *w;
+    int i, errcode = 0;
+
+    fs->workers = (Sfireworker *)calloc(fs->bc.Nworkers,
+                                        sizeof(Sfireworker));
+    fs->results = (Sfireflow *)calloc(net->Njuncs + 1, sizeof(Sfireflow));
+    ERRCODE(MEMCHECK(fs->workers));
+    ERRCODE(MEMCHECK(fs->results));
+    for (i = 0; i < fs->bc.Nworkers && !errcode; i++)
+    {
+        w = &fs->workers[i];
+        w->project = fs->bc.Clones[i];
+        w->work = (double *)calloc(net->Nnodes + 1, sizeof(double));
+        w->factor.Lii = (double *)calloc(net->Nnodes + 1, sizeof(double));
+        w->factor.Lij = (double *)calloc(sm->Ncoeffs + 1, sizeof(double));
+        ERRCODE(MEMCHECK(w->work));
+        ERRCODE(MEMCHECK(w->factor.Lii));
+        ERRCODE(MEMCHECK(w->factor.Lij));
+    }
+    return errcode;
+}
+
+void analyzejunction(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = fire flow analysis data
+**           worker = index of worker thread
+**           item = index of junction - 1
+**  Output:  none
+**  Purpose: finds the fire flow available at a junction.
+**----------------------------------------------------------------
+*/
+{
+    Sfirestudy *fs = (Sfirestudy *)data;
+    Sfireworker *w = &fs->workers[worker];
+    Project *pr = w->project;
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Sfireflow *r = &fs->results[item];
+    double *s = w->work;
+    int i, j = item + 1, n, errcode = 0;
+    double q0, q1, q2, f0, f1, qlo, qhi;
+
+    // Start from the base case solution
+    restorestate(pr, fs->bc.State, fs->bc.StateSize);
+    w->factored = FALSE;
+    hyd->FireNode = 0;
+    hyd->FireFlow = 0.0;
+    r->pressure = hyd->NodeHead[j] - net->Node[j].El;
+    q1 = 0.0;
+    f1 = r->pressure - fs->target;
+    if (f1 > 0.0)
+    {
+        // Estimate the fire flow from the sensitivity of the
+        // junction's head to a flow drawn from it
+        q0 = 0.0;
+        f0 = f1;
+        q1 = 1.0;
+        if (fs->bc.Factor.Lii)
+        {
+            memset(s, 0, (net->Njuncs + 1) * sizeof(double));
+            s[sm->Row[j]] = 1.0;
+            linsubst(sm, fs->bc.Factor.Lii, fs->bc.Factor.Lij, s,
+                     net->Njuncs);
+            if (s[sm->Row[j]] > 0.0) q1 = f0 / s[sm->Row[j]];
+        }
+
+        // Refine the estimate with secant iterations, keeping the
+        // fire flow within the range known to hold the answer
+        qlo = 0.0;
+        qhi = -1.0;
+        for (n = 1; n <= MAXSECANT; n++)
+        {
+            errcode = solvefireflow(fs, w, j, q1, &r->fullsolves);
+            if (errcode > 100) break;
+            f1 = hyd->NodeHead[j] - net->Node[j].El - fs->target;
+            if (fabs(f1) <= PTOL) break;
+            if (f1 > 0.0) qlo = q1;
+            else qhi = q1;
+
+            // A pressure that jumps past the target (e.g., when a
+            // pump shuts off) makes the range shrink onto the jump,
+            // with the largest fire flow meeting the target at qlo
+            if (qhi > 0.0 && qhi - qlo <= QRTOL * qhi)
+            {
+                q1 = qlo;
+                errcode = solvefireflow(fs, w, j, q1, &r->fullsolves);
+                break;
+            }
+            q2 = (f1 != f0) ? q1 - f1 * (q1 - q0) / (f1 - f0) : -1.0;
+            if (qhi < 0.0)
+            {
+                if (q2 <= q1) q2 = 2.0 * q1;
+            }
+            else if (q2 <= qlo || q2 >= qhi) q2 = (qlo + qhi) / 2.0;
+            q0 = q1;
+            f0 = f1;
+            q1 = q2;
+        }
+        if (n > MAXSECANT) errcode = 1;
+    }
+
+    // Save the fire flow & the lowest junction pressure it produces
+    r->errcode = errcode;
+    r->flow = (errcode > 100) ? 0.0 : q1;
+    r->minpress = 1.e10;
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        if (hyd->NodeHead[i] - net->Node[i].El >= r->minpress) continue;
+        r->minpress = hyd->NodeHead[i] - net->Node[i].El;
+        r->minnode = i;
+    }
+    if (r->fullsolves > 0)
+    {
+        workpool_lock(fs->bc.Pool);
+        fs->nfull++;
+        workpool_unlock(fs->bc.Pool);
+    }
+}
+
+int solvefireflow(Sfirestudy *fs, Sfireworker *w, int j, double q,
+                  int *fullsolves)
+/*----------------------------------------------------------------
+**  Input:   w = worker's data
+**           j = index of junction
+**           q = fire flow drawn from junction (cfs)
+**  Output:  fullsolves = updated number of full solutions
+**           returns an error code
+**  Purpose: solves the hydraulics of a network with a fire flow,
+**           starting from its current solution.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = w->project;
+    Hydraul *hyd = &pr->hydraul;
+    Sfactor *fac = (w->factored) ? &w->factor : &fs->bc.Factor;
+    int iter, errcode;
+    double relerr;
+
+    // Re-use the factored matrix of the nearest full solution
+    hyd->FireNode = j;
+    hyd->FireFlow = q;
+    if (fac->Lii && chordsolve(pr, fac, MAXCHORD, &iter, &relerr) == 0)
+    {
+        return 0;
+    }
+
+    // Make a full solution starting from the base case
+    // & factor its matrix for use with nearby fire flows
+    (*fullsolves)++;
+    restorestate(pr, fs->bc.State, fs->bc.StateSize);
+    hyd->FireNode = j;
+    hyd->FireFlow = q;
+    errcode = hydsolve(pr, &iter, &relerr);
+    if (errcode <= 100) w->factored = hydfactor(pr, &w->factor);
+    return errcode;
+}
+
+void writefirestudy(Sfirestudy *fs, FILE *f)
+/*----------------------------------------------------------------
+**  Input:   f = report file
+**  Output:  none
+**  Purpose: writes the results of a fire flow analysis.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = fs->base;
+    Network *net = &pr->network;
+    Report *rpt = &pr->report;
+    Sfireflow *r;
+    int i;
+    int pprec = rpt->Field[PRESSURE].Precision;
+    int qprec = rpt->Field[FLOW].Precision;
+    double pcf = pr->Ucf[PRESSURE];
+    char atime[13];
+
+    fprintf(f, "Fire Flow Analysis\n");
+    fprintf(f, "Residual Pressure: %.*f %s\n", pprec, fs->target * pcf,
+            rpt->Field[PRESSURE].Units);
+    fprintf(f, "Time:              %s hrs:min:sec\n",
+            clocktime(atime, fs->time));
+    fprintf(f, "Junctions:         %d (%d needed full solutions)\n\n",
+            net->Njuncs, fs->nfull);
+    fprintf(f, "%-*s %14s %14s %14s %-*s %5s\n", MAXID, "Node",
+            "Static Press.", "Fire Flow", "Min Pressure", MAXID, "Node",
+            "Code");
+    fprintf(f, "%-*s %14s %14s %14s %-*s %5s\n", MAXID, "",
+            rpt->Field[PRESSURE].Units, rpt->Field[FLOW].Units,
+            rpt->Field[PRESSURE].Units, MAXID, "", "");
+    for (i = 1; i <= net->Njuncs; i++)
+    {
+        r = &fs->results[i - 1];
+        if (r->errcode > 100)
+        {
+            fprintf(f, "%-*s %14.*f %14s %14s %-*s %5d\n", MAXID,
+                    net->Node[i].ID, pprec, r->pressure * pcf, "", "",
+                    MAXID, "", r->errcode);
+            continue;
+        }
+        fprintf(f, "%-*s %14.*f %14.*f %14.*f %-*s %5d\n", MAXID,
+                net->Node[i].ID, pprec, r->pressure * pcf,
+                qprec, r->flow * pr->Ucf[FLOW], pprec, r->minpress * pcf,
+                MAXID, net->Node[r->minnode].ID, r->errcode);
+    }
+}
+
+void freefirestudy(Sfirestudy *fs)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory used by a fire flow analysis.
+**----------------------------------------------------------------
+*/
+{
+    Sfireworker *w;
+    int i;
+
+    for (i = 0; i < fs->bc.Nworkers && fs->workers; i++)
+    {
+        w = &fs->workers[i];
+        free(w->work);
+        free(w->factor.Lii);
+        free(w->factor.Lij);
+    }
+    free(fs->workers);
+    free(fs->results);
+    closebasecase(&fs->bc);
+}
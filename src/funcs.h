@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/17/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 #ifndef FUNCS_H
@@ -22,6 +22,7 @@ void    freedata(Project *);
 int     openproject(Project *, const char *, const char *, const char *, int);
 int     openfiles(Project *, const char *, const char *,const char *);
 int     openhydfile(Project *);
+void    closehydfile(Project *);
 int     openoutfile(Project *);
 void    closeoutfile(Project *);
 
@@ -129,6 +130,8 @@ void    adjusttankrules(Project *, int);
 Spremise *getpremise(Spremise *, int);
 Saction  *getaction(Saction *, int);
 int     writerule(Project *, FILE *, int);
+int     compilerules(Project *);
+void    resetrules(Project *);
 int     checkrules(Project *, long);
 void    updateruleunits(Project *pr, double dcf, double pcf, double hcf, double qcf);
 
@@ -162,8 +165,6 @@ int     nexthyd(Project *, long *);
 void    closehyd(Project *);
 void    setlinkstatus(Project *, int, char, StatusType *, double *);
 void    setlinksetting(Project *, int, double, StatusType *, double *);
-int     tanktimestep(Project *, long *);
-int     controltimestep(Project *, long *);
 void    getenergy(Project *, int, double *, double *);
 double  tankvolume(Project *, int, double);
 double  tankgrade(Project *, int, double);
@@ -176,6 +177,7 @@ void    matrixcoeffs(Project *);
 void    emitterheadloss(Project *, int, double *, double *);
 void    demandheadloss(Project *, int, double, double, double *, double *);
 double  pcvlosscoeff(Project *, int, double);
+double  roughnessgrad(Project *, int);
 
 // ------- QUALITY.C --------------------
 
@@ -185,13 +187,14 @@ int     runqual(Project *, long *);
 int     nextqual(Project *, long *);
 int     stepqual(Project *, long *);
 int     closequal(Project *);
-double  avgqual(Project *, int);
+double  avgqual(Project *, int, int);
 
 // ------- OUTPUT.C ---------------------
 
 int     savenetdata(Project *);
 int     savehyd(Project *, long *);
 int     savehydstep(Project *, long *);
+int     writehyd(Project *, const void *, size_t);
 int     saveenergy(Project *);
 int     readhyd(Project *, long *);
 int     readhydstep(Project *, long *);
@@ -211,10 +214,101 @@ void    leakagecoeffs(Project *);
 double  leakageflowchange(Project *, int);
 int     leakagehasconverged(Project *);
 
+// ------- SCHEDULE.C -------------------
+
+int     openschedule(Project *);
+void    closeschedule(Project *);
+void    resetschedule(Project *);
+int     firedcontrols(Project *);
+int     tanktimestep(Project *, long *);
+int     controltimestep(Project *, long *);
+
+// ------- DEMANDS.C --------------------
+
+int     opendemands(Project *);
+void    closedemands(Project *);
+void    resetdemands(Project *);
+void    junctiondemands(Project *, long);
+
+// ------- ZONES.C ----------------------
+
+int     openzones(Project *);
+void    closezones(Project *);
+int     zonesolve(Project *);
+int     factorzones(Project *);
+
+// ------- DOMAINS.C --------------------
+
+int     opendomains(Project *);
+void    closedomains(Project *);
+int     orderdomains(Project *);
+int     allocdomains(Project *);
+int     domainsolve(Project *);
+
 // ------- FLOWBALANCE.C-----------------
 
 void    startflowbalance(Project *);
 void    updateflowbalance(Project *, long);
 void    endflowbalance(Project *);
 
+// ------- SNAPSHOT.C -------------------
+
+long    statesize(Project *);
+int     savestate(Project *, char *, long);
+int     restorestate(Project *, const char *, long);
+
+// ------- CLONE.C ----------------------
+
+int     cloneproject(Project *, Project *, const char *, const char *);
+int     unshare(Project *, int);
+int     unshareall(Project *);
+int     unsharehyd(Project *);
+int     unsharequal(Project *);
+int     unshareobject(Project *, int);
+void    releaseshared(Project *);
+
+// ------- BATCH.C ----------------------
+
+int     runbatch(Project *, const char *, const char *, int);
+
+// ------- MONTECARLO.C -----------------
+
+int     runmontecarlo(Project *, const char *, const char *, int);
+
+// ------- BASECASE.C -------------------
+
+int     openbasecase(Project *, Sbasecase *, long, int, int);
+void    closebasecase(Sbasecase *);
+
+// ------- FIREFLOW.C -------------------
+
+int     runfireflow(Project *, double, long, const char *, int, double *);
+
+// ------- CRITICALITY.C ----------------
+
+int     runcriticality(Project *, double, long, const char *, int,
+                       double *, int *);
+
+// ------- SENSITIVITY.C ----------------
+
+int     sensitivity(Project *, int, int, double *, double *);
+int     linearsens(Project *, int, const double *, double *, double *);
+int     adjointgradient(Project *, int, const double *, const double *,
+                        double *);
+
+// ------- CALIBRATE.C ------------------
+
+int     runcalibration(Project *, const char *, const char *, const char *,
+                       int);
+
+// ------- QUALBATCH.C ------------------
+
+int     runqualbatch(Project *, const char *, const char *, const char *,
+                     int);
+
+// ------- BACKTRACK.C ------------------
+
+int     runbacktrack(Project *, const char *, const char *, const char *,
+                     int);
+
 #endif
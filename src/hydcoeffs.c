@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 06/15/2024
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -41,6 +41,7 @@ const double CBIG   = 1.e8;
 //void   matrixcoeffs(Project *);
 //void   emitterheadloss(Project *, int, double *, double *);
 //void   demandheadloss(Project *, int, double, double, double *, double *);
+//double roughnessgrad(Project *, int);
 
 // Local functions
 static void    linkcoeffs(Project *pr);
@@ -402,6 +403,14 @@ void  nodecoeffs(Project *pr)
         hyd->Xflow[i] -= hyd->DemandFlow[i];
         sm->F[sm->Row[i]] += hyd->Xflow[i];
     }
+
+    // Subtract any fire flow being drawn (see FIREFLOW.C)
+    i = hyd->FireNode;
+    if (i > 0)
+    {
+        hyd->Xflow[i] -= hyd->FireFlow;
+        sm->F[sm->Row[i]] -= hyd->FireFlow;
+    }
 }
 
 
@@ -784,6 +793,50 @@ double frictionFactor(double q, double e, double s, double *dfdq)
 }
 
 
+double  roughnessgrad(Project *pr, int k)
+/*
+**--------------------------------------------------------------
+**   Input:   k = link index
+**   Output:  returns derivative of head loss w.r.t. roughness
+**   Purpose: computes the derivative of a pipe's friction head
+**            loss at its current flow with respect to its
+**            roughness coeff.
+**--------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &pr->hydraul;
+    Slink   *link = &pr->network.Link[k];
+
+    double q = hyd->LinkFlow[k];
+    double e, s, de, df, dfdq;
+
+    if (link->Type > PIPE || link->Kc <= 0.0) return 0.0;
+    if (hyd->LinkStatus[k] <= CLOSED) return 0.0;
+    switch (hyd->Formflag)
+    {
+    // Resistance varies as roughness^-Hexp for H-W
+    case HW:
+        return -hyd->Hexp * link->R * pow(ABS(q), hyd->Hexp) * SGN(q) /
+               link->Kc;
+
+    // Resistance varies as roughness^2 for C-M
+    case CM:
+        return 2.0 * link->R * q * ABS(q) / link->Kc;
+
+    // Friction factor varies with relative roughness for D-W
+    // (except for laminar flow)
+    default:
+        s = hyd->Viscos * link->Diam;
+        if (ABS(q) <= A2 * s) return 0.0;
+        e = link->Kc / link->Diam;
+        de = 1.e-4 * e;
+        df = frictionFactor(ABS(q), e + de, s, &dfdq) -
+             frictionFactor(ABS(q), e - de, s, &dfdq);
+        return df / (2.0 * de) / link->Diam * link->R * q * ABS(q);
+    }
+}
+
+
 void  pumpcoeff(Project *pr, int k)
 /*
 **--------------------------------------------------------------
@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 01/28/2026
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -34,8 +34,8 @@ void    freematrix(Project *);
 void    initlinkflow(Project *, int, char, double);
 void    demands(Project *);
 int     controls(Project *);
-long    timestep(Project *);
-void    ruletimestep(Project *, long *);
+int     timestep(Project *, long *);
+int     ruletimestep(Project *, long *);
 void    addenergy(Project *, long);
 void    tanklevels(Project *, long);
 void    resetpumpflow(Project *, int);
@@ -55,15 +55,35 @@ int  openhyd(Project *pr)
     int  errcode = 0;
     Slink *link;
     
+    // Make own copies of network data shared with
+    // other projects that is written to (see CLONE.C)
+    errcode = unsharehyd(pr);
+    if (errcode > 0) return errcode;
+
     // Check for valid project data (see VALIDATE.C)
     errcode = validateproject(pr);
     if (errcode > 0) return errcode;
 
+    // Decide if the network is divided among processes (see DOMAINS.C)
+    ERRCODE(opendomains(pr));
+
     // Allocate memory for sparse matrix structures (see SMATRIX.C)
     ERRCODE(createsparse(pr));
 
     // Allocate memory for hydraulic variables
     ERRCODE(allocmatrix(pr));
+
+    // Compile rule-based controls for evaluation (see RULES.C)
+    ERRCODE(compilerules(pr));
+
+    // Build schedule of simple control & tank events (see SCHEDULE.C)
+    ERRCODE(openschedule(pr));
+
+    // Build matrix of junction demands (see DEMANDS.C)
+    ERRCODE(opendemands(pr));
+
+    // Set up parallel solution of independent zones (see ZONES.C)
+    ERRCODE(openzones(pr));
     
     // Check for unconnected nodes
     ERRCODE(unlinked(pr));
@@ -108,13 +128,17 @@ void inithyd(Project *pr, int initflag)
         hyd->OldStatus[net->Nlinks+i] = TEMPCLOSED;
     }
 
-    // Initialize node outflows
+    // Initialize node outflows (result indexes are only written if
+    // changed since the nodes may be shared with clones of the project)
     memset(hyd->DemandFlow,0,(net->Nnodes+1)*sizeof(double));
     memset(hyd->EmitterFlow,0,(net->Nnodes+1)*sizeof(double));
     memset(hyd->LeakageFlow,0,(net->Nnodes+1)*sizeof(double));
+    hyd->FireNode = 0;
+    hyd->FireFlow = 0.0;
+    hyd->Factored = FALSE;
     for (i = 1; i <= net->Nnodes; i++)
     {
-        net->Node[i].ResultIndex = i;
+        if (net->Node[i].ResultIndex != i) net->Node[i].ResultIndex = i;
         if (net->Node[i].Ke > 0.0) hyd->EmitterFlow[i] = 1.0;
     }
 
@@ -172,10 +196,19 @@ void inithyd(Project *pr, int initflag)
     // Initialize flow balance
     startflowbalance(pr);
 
+    // Have all rule-based controls re-evaluated
+    resetrules(pr);
+
+    // Have the control & tank event schedule and the
+    // junction demand matrix re-built
+    resetschedule(pr);
+    resetdemands(pr);
+
     // Re-position hydraulics file
     if (pr->outfile.Saveflag)
     {
-        fseek(out->HydFile,out->HydOffset,SEEK_SET);
+        if (out->HydStore) out->HydSize = out->HydOffset;
+        else fseek(out->HydFile,out->HydOffset,SEEK_SET);
     }
 
     // Initialize current time
@@ -204,6 +237,20 @@ int   runhyd(Project *pr, long *t)
     int   errcode;       // Error code
     double relerr;       // Solution accuracy
 
+    // Re-build event schedule if controls or tanks were edited
+    if (!hyd->schedule.Built)
+    {
+        errcode = openschedule(pr);
+        if (errcode) return errcode;
+    }
+
+    // Re-build demand matrix if demands or patterns were edited
+    if (!hyd->dmatrix.Built)
+    {
+        errcode = opendemands(pr);
+        if (errcode) return errcode;
+    }
+
     // Find new demands & control actions
     *t = time->Htime;
     demands(pr);
@@ -246,6 +293,10 @@ int  nexthyd(Project *pr, long *tstep)
     long  hydstep;         // Actual time step
     int   errcode = 0;     // Error code
 
+    // Re-compile rules that were edited after the solver was opened
+    if (!pr->rules.Compiled) errcode = compilerules(pr);
+    if (errcode) return errcode;
+
     // Compute current power and efficiency of all pumps
     getallpumpsenergy(pr);
 
@@ -257,7 +308,11 @@ int  nexthyd(Project *pr, long *tstep)
     // Compute next time step & update tank levels
     *tstep = 0;
     hydstep = 0;
-    if (time->Htime < time->Dur) hydstep = timestep(pr);
+    if (time->Htime < time->Dur)
+    {
+        errcode = timestep(pr, &hydstep);
+        if (errcode) return errcode;
+    }
     if (pr->outfile.Saveflag) errcode = savehydstep(pr,&hydstep);
 
     // Accumulate pumping energy
@@ -301,6 +356,10 @@ void  closehyd(Project *pr)
 {
     freesparse(pr);
     freematrix(pr);
+    closeschedule(pr);
+    closedemands(pr);
+    closezones(pr);
+    closedomains(pr);
     freeadjlists(&pr->network);
 }
 
@@ -488,33 +547,12 @@ void  demands(Project *pr)
 
     int  i ,j, n;
     long k, p;
-    double djunc, sum;
-    Pdemand demand;
 
     // Determine total elapsed number of pattern periods
     p = (time->Htime + time->Pstart) / time->Pstep;
 
-    // Update demand at each node according to its assigned pattern
-    hyd->Dsystem = 0.0;          // System-wide demand
-    for (i = 1; i <= net->Njuncs; i++)
-    {
-        sum = 0.0;
-        for (demand = net->Node[i].D; demand != NULL; demand = demand->next)
-        {
-            // pattern period (k) = (elapsed periods) modulus (periods per pattern)
-            j = demand->Pat;
-            if (j == 0)
-                j = hyd->DefPat;
-            k = p % (long)net->Pattern[j].Length;
-            djunc = (demand->Base) * net->Pattern[j].F[k] * hyd->Dmult;
-            if (djunc > 0.0) hyd->Dsystem += djunc;
-            sum += djunc;
-        }
-        hyd->FullDemand[i] = sum;
-
-        // Initialize pressure dependent demand
-        hyd->DemandFlow[i] = sum;
-    }
+    // Update demand at each junction (see DEMANDS.C)
+    junctiondemands(pr, p);
 
     // Update head at fixed grade nodes with time patterns
     for (n = 1; n <= net->Ntanks; n++)
@@ -559,89 +597,56 @@ int  controls(Project *pr)
 {
     Network *net = &pr->network;
     Hydraul *hyd = &pr->hydraul;
-    Times   *time = &pr->times;
 
-    int i, k, n, reset, setsum;
-    double h, vplus;
-    double v1, v2;
+    int i, k, m, nfired, setsum;
     double k1, k2;
     char  s1, s2;
     Slink *link;
     Scontrol *control;
 
-    // Examine each control statement
+    // Find the controls activated at the current time (see SCHEDULE.C)
+    nfired = firedcontrols(pr);
+
+    // Examine each activated control in order
     setsum = 0;
-    for (i=1; i <= net->Ncontrols; i++)
+    for (m = 0; m < nfired; m++)
     {
-        // Make sure that link is defined
+        i = hyd->schedule.Fired[m];
         control = &net->Control[i];
-        if (!control->isEnabled)
-        {
-            continue;
-        }
-        reset = 0;
-        if ( (k = control->Link) <= 0) continue;
+        k = control->Link;
         link = &net->Link[k];
 
-        // Link is controlled by tank level
-        if ((n = control->Node) > 0 && n > net->Njuncs)
-        {
-            h = hyd->NodeHead[n];
-            vplus = ABS(hyd->NodeDemand[n]);
-            v1 = tankvolume(pr,n - net->Njuncs,h);
-            v2 = tankvolume(pr,n - net->Njuncs, control->Grade);
-            if (control->Type == LOWLEVEL && v1 <= v2 + vplus) reset = 1;
-            if (control->Type == HILEVEL && v1 >= v2 - vplus)  reset = 1;
-        }
-
-        // Link is time-controlled
-        if (control->Type == TIMER)
-        {
-            if (control->Time == time->Htime) reset = 1;
-        }
-
-        //* Link is time-of-day controlled
-        if (control->Type == TIMEOFDAY)
-        {
-            if ((time->Htime + time->Tstart) % SECperDAY == control->Time)
-            {
-            reset = 1;
-            }
-        }
-
         // Update link status & pump speed or valve setting
-        if (reset == 1)
+        if (hyd->LinkStatus[k] <= CLOSED) s1 = CLOSED;
+        else s1 = OPEN;
+        s2 = control->Status;
+        k1 = hyd->LinkSetting[k];
+        k2 = k1;
+        if (link->Type > PIPE) k2 = control->Setting;
+
+        // Check if a re-opened pump needs its flow reset
+        if (link->Type == PUMP && s1 == CLOSED && s2 == OPEN)
+            resetpumpflow(pr, k);
+
+        if (s1 != s2 || k1 != k2)
         {
-            if (hyd->LinkStatus[k] <= CLOSED) s1 = CLOSED;
-            else s1 = OPEN;
-            s2 = control->Status;
-            k1 = hyd->LinkSetting[k];
-            k2 = k1;
-            if (link->Type > PIPE) k2 = control->Setting;
-
-            // Check if a re-opened pump needs its flow reset
-            if (link->Type == PUMP && s1 == CLOSED && s2 == OPEN)
-                resetpumpflow(pr, k);
-
-            if (s1 != s2 || k1 != k2)
-            {
-                hyd->LinkStatus[k] = s2;
-                hyd->LinkSetting[k] = k2;
-                if (link->Type == PCV) link->R = pcvlosscoeff(pr, k, k2);
-                if (pr->report.Statflag) writecontrolaction(pr,k,i);
-                setsum++;
-            }
+            hyd->LinkStatus[k] = s2;
+            hyd->LinkSetting[k] = k2;
+            if (link->Type == PCV) link->R = pcvlosscoeff(pr, k, k2);
+            if (pr->report.Statflag) writecontrolaction(pr,k,i);
+            setsum++;
         }
     }
     return setsum;
 }
 
 
-long  timestep(Project *pr)
+int  timestep(Project *pr, long *hydstep)
 /*
 **----------------------------------------------------------------
 **  Input:   none
-**  Output:  returns time step until next change in hydraulics
+**  Output:  *hydstep = time step until next change in hydraulics
+**           returns error code
 **  Purpose: computes time step to advance hydraulic simulation
 **----------------------------------------------------------------
 */
@@ -649,6 +654,7 @@ long  timestep(Project *pr)
     Network *net = &pr->network;
     Times   *time = &pr->times;
 
+    int  errcode = 0;
     long n, t, tstep;
 
     // Normal time step is hydraulic time step
@@ -671,151 +677,19 @@ long  timestep(Project *pr)
     controltimestep(pr, &tstep);
 
     // Evaluate rule-based controls (which will also update tank levels)
-    if (net->Nrules > 0) ruletimestep(pr, &tstep);
+    if (net->Nrules > 0) errcode = ruletimestep(pr, &tstep);
     else tanklevels(pr, tstep);
-    return tstep;
-}
-
-
-int  tanktimestep(Project *pr, long *tstep)
-/*
-**-----------------------------------------------------------------
-**  Input:   *tstep = current time step
-**  Output:  *tstep = modified current time step
-**  Purpose: revises time step based on shortest time to fill or
-**           drain a tank
-**-----------------------------------------------------------------
-*/
-{
-    Network *net = &pr->network;
-    Hydraul *hyd = &pr->hydraul;
-
-    int     i, n, tankIdx = 0;
-    double  h, q, v, xt;
-    long    t;
-    Stank   *tank;
-
-    // Examine each tank
-    for (i = 1; i <= net->Ntanks; i++)
-    {
-        // Skip reservoirs
-        tank = &net->Tank[i];
-        if (tank->A == 0.0) continue;
-
-        // Get current tank grade (h) & inflow (q)
-        n = tank->Node;
-        h = hyd->NodeHead[n];
-        q = hyd->NodeDemand[n];
-        if (ABS(q) <= QZERO) continue;
-
-        // Find volume to fill/drain tank
-        if      (q > 0.0 && h < tank->Hmax) v = tank->Vmax - tank->V;
-        else if (q < 0.0 && h > tank->Hmin) v = tank->Vmin - tank->V;
-        else continue;
-
-        // Find time to fill/drain tank
-        xt = v / q;
-        if (ABS(xt) > *tstep + 1) continue;
-        t = (long)ROUND(xt);
-        if (t > 0 && t < *tstep)
-        {
-            *tstep = t;
-            tankIdx = n;
-        }
-    }
-    return tankIdx;
-}
-
-
-int  controltimestep(Project *pr, long *tstep)
-/*
-**------------------------------------------------------------------
-**  Input:   *tstep = current time step
-**  Output:  *tstep = modified current time step
-**  Purpose: revises time step based on shortest time to activate
-**           a simple control
-**------------------------------------------------------------------
-*/
-{
-    Network *net = &pr->network;
-    Hydraul *hyd = &pr->hydraul;
-
-    int    i, j, k, n, controlIndex = 0;
-    double h, q, v;
-    long   t, t1, t2;
-    Slink  *link;
-    Scontrol *control;
-
-    // Examine each control
-    for (i = 1; i <= net->Ncontrols; i++)
-    {
-        t = 0;
-        control = &net->Control[i];
-        if (!control->isEnabled)
-        {
-            continue;
-        }
-        // Control depends on a tank level
-        if ( (n = control->Node) > 0)
-        {
-            // Skip node if not a tank or reservoir
-            if ((j = n - net->Njuncs) <= 0) continue;
-
-            // Find current head and flow into tank
-            h = hyd->NodeHead[n];
-            q = hyd->NodeDemand[n];
-            if (ABS(q) <= QZERO) continue;
-
-            // Find time to reach upper or lower control level
-           if ( (h < control->Grade && control->Type == HILEVEL && q > 0.0)
-           ||   (h > control->Grade && control->Type == LOWLEVEL && q < 0.0) )
-           {
-               v = tankvolume(pr, j, control->Grade) - net->Tank[j].V;
-               t = (long)ROUND(v/q);
-           }
-        }
-
-        // Control is based on elapsed time
-        if (control->Type == TIMER)
-        {
-            if (control->Time > pr->times.Htime)
-            {
-                t = control->Time - pr->times.Htime;
-            }
-        }
-
-        // Control is based on time of day
-        if (control->Type == TIMEOFDAY)
-        {
-            t1 = (pr->times.Htime + pr->times.Tstart) % SECperDAY;
-            t2 = control->Time;
-            if (t2 >= t1) t = t2 - t1;
-            else          t = SECperDAY - t1 + t2;
-        }
-
-        // Revise the current estimated next time step
-        if (t > 0 && t < *tstep)
-        {
-            // Check if rule actually changes link status or setting
-            k = control->Link;
-            link = &net->Link[k];
-            if ( (link->Type > PIPE && hyd->LinkSetting[k] != control->Setting)
-              || (hyd->LinkStatus[k] != control->Status) )
-            {
-              *tstep = t;
-              controlIndex = i;
-            }
-        }
-    }
-    return controlIndex;
+    *hydstep = tstep;
+    return errcode;
 }
 
 
-void  ruletimestep(Project *pr, long *tstep)
+int  ruletimestep(Project *pr, long *tstep)
 /*
 **--------------------------------------------------------------
 **  Input:   *tstep = current time step (sec)
 **  Output:  *tstep = modified time step
+**           returns error code
 **  Purpose: updates next time step by checking if any rules
 **           will fire before then; also updates tank levels.
 **--------------------------------------------------------------
@@ -824,11 +698,19 @@ void  ruletimestep(Project *pr, long *tstep)
     Network *net = &pr->network;
     Times   *time = &pr->times;
 
+    int  errcode = 0;
     long tnow,      // Start of time interval for rule evaluation
          tmax,      // End of time interval for rule evaluation
          dt,        // Normal time increment for rule evaluation
          dt1;       // Actual time increment for rule evaluation
 
+    // Make sure that rules have been compiled
+    if (!pr->rules.Compiled)
+    {
+        errcode = compilerules(pr);
+        if (errcode) return errcode;
+    }
+
     // Find interval of time for rule evaluation
     tnow = time->Htime;
     tmax = tnow + *tstep;
@@ -878,6 +760,7 @@ void  ruletimestep(Project *pr, long *tstep)
     // and return simulation time to its original value
     *tstep = time->Htime - tnow;
     time->Htime = tnow;
+    return errcode;
 }
 
 
@@ -8,7 +8,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 06/26/2024
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -33,9 +33,13 @@ typedef struct {
 
 // Exported functions
 int  hydsolve(Project *, int *, double *);
+int  chordsolve(Project *, Sfactor *, int, int *, double *);
+int  hydfactor(Project *, Sfactor *);
 
 // Imported functions
 extern int  linsolve(Smatrix *, int);  //(see SMATRIX.C)
+extern int  linfactor(Smatrix *, int);
+extern void linsubst(Smatrix *, double *, double *, double *, int);
 extern int  valvestatus(Project *);    //(see HYDSTATUS.C)
 extern int  linkstatus(Project *);     //(see HYDSTATUS.C)
 
@@ -77,7 +81,10 @@ int  hydsolve(Project *pr, int *iter, double *relerr)
 **           another ExtraIter trials are made with no status changes
 **           made to any links and a warning message is generated.
 **
-**   This procedure calls linsolve() which appears in SMATRIX.C.
+**   This procedure calls linsolve() which appears in SMATRIX.C,
+**   or zonesolve() (see ZONES.C) if the network's independent
+**   zones are solved in parallel, or domainsolve() (see DOMAINS.C)
+**   if its domains are solved on separate processes.
 **-------------------------------------------------------------------
 */
 {
@@ -120,7 +127,9 @@ int  hydsolve(Project *pr, int *iter, double *relerr)
 
         headlosscoeffs(pr);
         matrixcoeffs(pr);
-        errcode = linsolve(sm, net->Njuncs);
+        if (hyd->domains.Ndomains > 1) errcode = domainsolve(pr);
+        else if (hyd->zones.Pool) errcode = zonesolve(pr);
+        else errcode = linsolve(sm, net->Njuncs);
 
         // Matrix ill-conditioning problem - if control valve causing problem,
         // fix its status & continue, otherwise quit with no solution.
@@ -195,6 +204,12 @@ int  hydsolve(Project *pr, int *iter, double *relerr)
         errcode = 110;
     }
 
+    // The matrix of the last iteration is left factored
+    // (see SENSITIVITY.C) unless its domains were solved
+    // on separate processes
+    hyd->Factored = (errcode == 0 && hyd->domains.Ndomains < 2);
+    if (hyd->Factored && hyd->zones.Pool) hyd->Factored = factorzones(pr);
+
     // Save total outflow (NodeDemand) at each junction
     for (i = 1; i <= net->Njuncs; i++)
     {
@@ -202,6 +217,7 @@ int  hydsolve(Project *pr, int *iter, double *relerr)
                              hyd->EmitterFlow[i] +
                              hyd->LeakageFlow[i];
     }
+    if (hyd->FireNode > 0) hyd->NodeDemand[hyd->FireNode] += hyd->FireFlow;
 
     // Save convergence info
     hyd->RelativeError = *relerr;
@@ -212,6 +228,140 @@ int  hydsolve(Project *pr, int *iter, double *relerr)
 }
 
 
+int  chordsolve(Project *pr, Sfactor *fac, int maxiter, int *iter,
+                double *relerr)
+/*
+**-------------------------------------------------------------------
+**  Input:   fac     = factored matrix of coeffs. of a previous
+**                     solution (see hydfactor())
+**           maxiter = max. number of iterations
+**  Output:  *iter   = # of iterations to reach solution
+**           *relerr = convergence error in solution
+**           returns 0 if a solution was found or 1 if not
+**  Purpose: solves network nodal equations for heads and flows
+**           starting from a nearby solution, re-using the factored
+**           matrix of that solution instead of re-factoring one
+**           for each iteration.
+**
+**  Notes:   Each iteration updates the current heads H by solving
+**           A0*dH = A*H - F, where A and F are the coeffs. that
+**           hydsolve() would use and A0 is the factored matrix,
+**           and then updates flows as hydsolve() does. Link status
+**           is held fixed. A solution is rejected (and 1 returned)
+**           if it would change the status of any link, since the
+**           previous solution's matrix is then no longer a good
+**           approximation and hydsolve() should be used instead.
+**
+**           If fac->link > 0 then A0 is the factored matrix plus
+**           the rank-one update w*u*u', where u is the link's
+**           column of the node-link incidence matrix, and is
+**           solved with the Sherman-Morrison formula using
+**           fac->z, the factored matrix's solution for u, and
+**           fac->w = dp / (1 + dp*u'z) for a change of dp in the
+**           link's P coeff.
+**-------------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+
+    int    i, j, k, r, n = net->Njuncs;
+    double a, h;
+    Hydbalance hydbal;
+
+    hyd->RelaxFactor = 1.0;
+    hyd->Factored = FALSE;
+    hydbal.maxheaderror = 0.0;
+    hydbal.maxflowchange = 0.0;
+    hyd->DeficientNodes = 0;
+    hyd->DemandReduction = 0.0;
+    for (*iter = 1; *iter <= maxiter; (*iter)++)
+    {
+        headlosscoeffs(pr);
+        matrixcoeffs(pr);
+
+        // Find the residual A*H - F of the current heads
+        // (stored in F, with A's off-diagonal coeffs. found
+        // from the positions of the factor's coeffs.)
+        for (j = 1; j <= n; j++)
+        {
+            sm->F[j] = sm->Aii[j] * hyd->NodeHead[sm->Order[j]] - sm->F[j];
+        }
+        for (j = 1; j <= n; j++)
+        {
+            h = hyd->NodeHead[sm->Order[j]];
+            for (k = sm->XLNZ[j]; k < sm->XLNZ[j + 1]; k++)
+            {
+                a = sm->Aij[sm->LNZ[k]];
+                if (a == 0.0) continue;
+                r = sm->NZSUB[k];
+                sm->F[r] += a * h;
+                sm->F[j] += a * hyd->NodeHead[sm->Order[r]];
+            }
+        }
+
+        // Correct the heads & update flows
+        linsubst(sm, fac->Lii, fac->Lij, sm->F, n);
+        if (fac->link > 0)
+        {
+            i = net->Link[fac->link].N1;
+            j = net->Link[fac->link].N2;
+            a = (i <= n) ? sm->F[sm->Row[i]] : 0.0;
+            if (j <= n) a -= sm->F[sm->Row[j]];
+            a *= fac->w;
+            for (r = 1; r <= n; r++) sm->F[r] -= a * fac->z[r];
+        }
+        for (i = 1; i <= n; i++) hyd->NodeHead[i] -= sm->F[sm->Row[i]];
+        *relerr = newflows(pr, &hydbal);
+        if (!(*relerr < 1.e10)) return 1;
+
+        // Check for convergence & status changes
+        if (hasconverged(pr, relerr, &hydbal))
+        {
+            if (valvestatus(pr) || linkstatus(pr) || pswitch(pr)) return 1;
+            for (i = 1; i <= n; i++)
+            {
+                hyd->NodeDemand[i] = hyd->DemandFlow[i] +
+                                     hyd->EmitterFlow[i] +
+                                     hyd->LeakageFlow[i];
+            }
+            if (hyd->FireNode > 0)
+            {
+                hyd->NodeDemand[hyd->FireNode] += hyd->FireFlow;
+            }
+            hyd->RelativeError = *relerr;
+            hyd->Iterations = *iter;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+int  hydfactor(Project *pr, Sfactor *fac)
+/*
+**-------------------------------------------------------------------
+**  Input:   fac = factored matrix with Lii & Lij allocated
+**  Output:  returns TRUE if matrix could be factored
+**  Purpose: saves the Cholesky factor of the matrix of coeffs. of
+**           the current hydraulic solution for use by chordsolve().
+**-------------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Smatrix *sm = &pr->hydraul.smatrix;
+
+    fac->link = 0;
+    headlosscoeffs(pr);
+    matrixcoeffs(pr);
+    if (linfactor(sm, net->Njuncs) != 0) return FALSE;
+    memcpy(fac->Lii, sm->Aii, (net->Njuncs + 1) * sizeof(double));
+    memcpy(fac->Lij, sm->Aij, (sm->Ncoeffs + 1) * sizeof(double));
+    return TRUE;
+}
+
+
 int  badvalve(Project *pr, int n)
 /*
 **-----------------------------------------------------------------
@@ -7,7 +7,7 @@ Description:  saves network data to an EPANET formatted text file
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 04/19/2025
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -34,6 +34,7 @@ extern char *TstatTxt[];
 extern char *RptFlagTxt[];
 extern char *SectTxt[];
 extern char *BackflowTxt[];
+extern char *TransportTxt[];
 extern char *CurveTypeTxt[];
 
 void saveauxdata(Project *pr, FILE *f)
@@ -693,6 +694,10 @@ int saveinpfile(Project *pr, const char *fname)
           fprintf(f, "\n HYDRAULICS SAVE     %s", out->HydFname);
           break;
     }
+    if (out->HydMemory != HYDMEMORY)
+    {
+        fprintf(f, "\n HYDRAULICS MEMORY   %-.4f", out->HydMemory);
+    }
     if (hyd->ExtraIter == -1)
     {
         fprintf(f, "\n UNBALANCED          STOP");
@@ -719,6 +724,17 @@ int saveinpfile(Project *pr, const char *fname)
           fprintf(f, "\n QUALITY             NONE");
           break;
     }
+    for (i = 1; i <= qual->Nconstits; i++)
+    {
+        if (qual->Constit[i].Type == TRACE)
+            fprintf(f, "\n CONSTITUENT         TRACE %-31s",
+                    net->Node[qual->Constit[i].Node].ID);
+        else fprintf(f, "\n CONSTITUENT         AGE");
+    }
+    if (qual->Transport != LAGRANGIAN)
+    {
+        fprintf(f, "\n TRANSPORT           %s", TransportTxt[qual->Transport]);
+    }
 
     if (hyd->DefPat > 0)
         fprintf(f, "\n PATTERN             %s", net->Pattern[hyd->DefPat].ID);
@@ -731,9 +747,21 @@ int saveinpfile(Project *pr, const char *fname)
     fprintf(f, "\n TRIALS              %-d", hyd->MaxIter);
     fprintf(f, "\n ACCURACY            %-.8f", hyd->Hacc);
     fprintf(f, "\n TOLERANCE           %-.8f", qual->Ctol * pr->Ucf[QUALITY]);
+    if (qual->Courant > 0.0)
+    {
+        fprintf(f, "\n COURANT             %-.4f", qual->Courant);
+    }
+    if (qual->SegBudget > 0)
+    {
+        fprintf(f, "\n SEGMENT BUDGET      %-d", qual->SegBudget);
+    }
     fprintf(f, "\n CHECKFREQ           %-d", hyd->CheckFreq);
     fprintf(f, "\n MAXCHECK            %-d", hyd->MaxCheck);
     fprintf(f, "\n DAMPLIMIT           %-.8f", hyd->DampLimit);
+    if (hyd->Threads != 1)
+    {
+        fprintf(f, "\n THREADS             %-d", hyd->Threads);
+    }
     if (hyd->HeadErrorLimit > 0.0)
     {
         fprintf(f, "\n HEADERROR           %-.8f",
@@ -7,7 +7,7 @@ Description:  retrieves network data from an EPANET input file
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 01/28/2026
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -106,6 +106,7 @@ void setdefaults(Project *pr)
     parser->Flowflag = GPM;     // Flow units are gpm
     parser->Pressflag = DEFAULTUNIT; // Pressure units set based on unit system
     out->Hydflag = SCRATCH;     // No external hydraulics file
+    out->HydMemory = HYDMEMORY; // Scratch hydraulics held in memory
     rpt->Tstatflag = SERIES;    // Generate time series output
 
     hyd->Formflag = HW;         // Use Hazen-Williams formula
@@ -135,10 +136,15 @@ void setdefaults(Project *pr)
     hyd->CheckFreq = CHECKFREQ;
     hyd->MaxCheck = MAXCHECK;
     hyd->DampLimit = DAMPLIMIT;
+    hyd->Threads = 1;           // Solve network as a whole
 
     qual->Qualflag = NONE;      // No quality simulation
     qual->Ctol = MISSING;       // No pre-set quality tolerance
     qual->TraceNode = 0;        // No source tracing
+    qual->Nconstits = 0;        // No additional constituents
+    qual->Transport = LAGRANGIAN; // Pipes hold moving segments
+    qual->SegBudget = 0;        // No limit on segments held
+    qual->Courant = 0.0;        // Fixed quality time step
     qual->BulkOrder = 1.0;      // 1st-order bulk reaction rate
     qual->WallOrder = 1.0;      // 1st-order wall reaction rate
     qual->TankOrder = 1.0;      // 1st-order tank reaction rate
@@ -7,7 +7,7 @@ Description:  parses network data from a line of an EPANET input file
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 04/19/2025
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -26,6 +26,7 @@ extern char *MixTxt[];
 extern char *Fldname[];
 extern char *DemandModelTxt[];
 extern char *BackflowTxt[];
+extern char *TransportTxt[];
 extern char *CurveTypeTxt[];
 
 // Imported Functions
@@ -42,8 +43,38 @@ static int  optionvalue(Project *, int);
 static int  getpumpcurve(Project *, int);
 static void changestatus(Network *, int, StatusType, double);
 static int  setError(Parser *, int, int);
+static int  addtraces(Project *, int, int);
 
 
+int addtraces(Project *pr, int first, int n)
+/*
+**--------------------------------------------------------------
+**  Input:   first = index of first trace node's token
+**           n = index of last input token
+**  Output:  returns error code
+**  Purpose: adds a TRACE quality constituent for each node
+**           listed from token first to token n
+**--------------------------------------------------------------
+*/
+{
+    Network *net    = &pr->network;
+    Quality *qual   = &pr->quality;
+    Parser  *parser = &pr->parser;
+
+    int i, j;
+
+    for (j = first; j <= n; j++)
+    {
+        if (qual->Nconstits >= MAXCONSTITS) return setError(parser, j, 270);
+        i = qual->Nconstits + 1;
+        qual->Constit[i].Type = TRACE;
+        qual->Constit[i].Node = findnode(net, parser->Tok[j]);
+        if (qual->Constit[i].Node == 0) return setError(parser, j, 212);
+        qual->Nconstits = i;
+    }
+    return 0;
+}
+
 int setError(Parser *parser, int tokindex, int errcode)
 /*
 **--------------------------------------------------------------
@@ -1888,13 +1919,16 @@ int optionchoice(Project *pr, int n)
 **    PRESSURE            PSI/KPA/METERS/BAR/FEET
 **    HEADLOSS            H-W/D-W/C-M
 **    HYDRAULICS          USE/SAVE  filename
-**    QUALITY             NONE/AGE/TRACE/CHEMICAL  (TraceNode)
+**    HYDRAULICS          MEMORY    value
+**    QUALITY             NONE/AGE/TRACE/CHEMICAL  (TraceNode ...)
+**    CONSTITUENT         AGE/TRACE  (TraceNode ...)
 **    MAP                 filename
 **    VERIFY              filename
 **    UNBALANCED          STOP/CONTINUE {Niter}
 **    PATTERN             id
 **    DEMAND MODEL        DDA/PDA
 **    BACKFLOW ALLOWED    YES/NO
+**    TRANSPORT           LAGRANGIAN/EULERIAN
 **--------------------------------------------------------------
 */
 {
@@ -1904,7 +1938,8 @@ int optionchoice(Project *pr, int n)
     Parser  *parser = &pr->parser;
     Outfile *out    = &pr->outfile;
 
-    int choice;
+    int i, choice;
+    double y;
 
     // Check if 1st token matches a parameter name and
     // process the input for the matched parameter
@@ -1939,10 +1974,18 @@ int optionchoice(Project *pr, int n)
             return setError(parser, 1, 213);
     }
 
-    // HYDRUALICS USE/SAVE file option
+    // HYDRUALICS USE/SAVE file option or MEMORY (in MB) that holds
+    // scratch hydraulics
     else if (match(parser->Tok[0], w_HYDRAULIC))
     {
         if (n < 2) return 0;
+        else if (match(parser->Tok[1], w_MEMORY))
+        {
+            if (!getfloat(parser->Tok[2], &y)) return setError(parser, 2, 202);
+            if (y < 0.0) return setError(parser, 2, 213);
+            out->HydMemory = y;
+            return 0;
+        }
         else if (match(parser->Tok[1], w_USE))  out->Hydflag = USE;
         else if (match(parser->Tok[1], w_SAVE)) out->Hydflag = SAVE;
         else return setError(parser, 1, 213);
@@ -1970,6 +2013,9 @@ int optionchoice(Project *pr, int n)
             if (qual->TraceNode == 0) return setError(parser, 2, 212);
             strncpy(qual->ChemName, u_PERCENT, MAXID);
             strncpy(qual->ChemUnits, parser->Tok[2], MAXID);
+
+            // ... any further nodes are traced as added constituents
+            if (n > 2) return addtraces(pr, 3, n);
         }
         if (qual->Qualflag == AGE)
         {
@@ -1978,6 +2024,25 @@ int optionchoice(Project *pr, int n)
         }
     }
 
+    // Additional quality CONSTITUENT routed along with the QUALITY one
+    else if (match(parser->Tok[0], w_CONSTIT))
+    {
+        if (n < 1) return 0;
+        if (match(parser->Tok[1], w_AGE))
+        {
+            if (qual->Nconstits >= MAXCONSTITS) return setError(parser, 1, 270);
+            i = ++qual->Nconstits;
+            qual->Constit[i].Type = AGE;
+            qual->Constit[i].Node = 0;
+        }
+        else if (match(parser->Tok[1], w_TRACE))
+        {
+            if (n < 2) return 201;
+            return addtraces(pr, 2, n);
+        }
+        else return setError(parser, 1, 213);
+    }
+
     // MAP file name
     else if (match(parser->Tok[0], w_MAP))
     {
@@ -2030,6 +2095,15 @@ int optionchoice(Project *pr, int n)
         hyd->EmitBackFlag = choice;
     }
 
+    // Water quality TRANSPORT method
+    else if (match(parser->Tok[0], w_TRANSPORT))
+    {
+        if (n < 1) return 0;
+        choice = findmatch(parser->Tok[1], TransportTxt);
+        if (choice < 0) return setError(parser, 1, 213);
+        pr->quality.Transport = choice;
+    }
+
     // Return -1 if keyword did not match any option
     else return -1;
     return 0;
@@ -2057,6 +2131,8 @@ int optionvalue(Project *pr, int n)
 **    PRESSURE EXPONENT   value
 
 **    TOLERANCE           value
+**    COURANT             value
+**    SEGMENT BUDGET      value
 **    SEGMENTS            value  (not used)
 **  ------ Undocumented Options -----
 **    HTOL                value
@@ -2065,6 +2141,7 @@ int optionvalue(Project *pr, int n)
 **    CHECKFREQ           value
 **    MAXCHECK            value
 **    DAMPLIMIT           value
+**    THREADS             value
 **--------------------------------------------------------------
 */
 {
@@ -2076,8 +2153,16 @@ int optionvalue(Project *pr, int n)
     double y;
     char* tok0 = parser->Tok[0];
 
-    // Check for deprecated SEGMENTS keyword
-    if (match(tok0, w_SEGMENTS)) return 0;
+    // Most segments held in pipes & tanks (the SEGMENTS keyword
+    // without BUDGET is deprecated)
+    if (match(tok0, w_SEGMENTS))
+    {
+        if (n < 2 || !match(parser->Tok[1], w_BUDGET)) return 0;
+        if (!getfloat(parser->Tok[2], &y)) return setError(parser, 2, 202);
+        if (y < 0.0) return setError(parser, 2, 213);
+        qual->SegBudget = (int)y;
+        return 0;
+    }
 
     // Check for missing value (which is permissible)
     if (match(tok0, w_SPECGRAV) || match(tok0, w_EMITTER) ||
@@ -2098,6 +2183,15 @@ int optionvalue(Project *pr, int n)
         return 0;
     }
 
+    // Courant number targeted by adaptive quality steps (0 for
+    // a fixed quality time step)
+    if (match(tok0, w_COURANT))
+    {
+        if (y < 0.0) return setError(parser, nvalue, 213);
+        qual->Courant = y;
+        return 0;
+    }
+
     // Diffusivity
     if (match(tok0, w_DIFFUSIVITY))
     {
@@ -2157,6 +2251,15 @@ int optionvalue(Project *pr, int n)
         return 0;
     }
 
+    // Threads used to solve independent zones & route water quality
+    // (0 for one per processor)
+    else if (match(tok0, w_THREADS))
+    {
+        if (y < 0.0) return setError(parser, nvalue, 213);
+        hyd->Threads = (int)y;
+        return 0;
+    }
+
     // All other options must be > 0
     if (y <= 0.0) return setError(parser, nvalue, 213);
 
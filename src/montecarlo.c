@@ -0,0 +1,809 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       montecarlo.c
+ Description:  Monte Carlo analysis of demand and roughness uncertainty
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A Monte Carlo analysis runs many realizations of an open base project's
+hydraulics, each with junction demands and pipe roughness values scaled by
+randomly drawn multipliers, and reports the distribution of each node's
+minimum pressure and each link's maximum velocity over all realizations.
+
+A Monte Carlo file contains lines of the following form:
+
+  REALIZATIONS  n
+  SEED          s
+  QUANTILES     p1  p2  ...
+  DEMAND        nodeID | *  distribution  parameters
+  ROUGHNESS     linkID | *  distribution  parameters
+
+where * stands for every junction (or every pipe), each of which is given
+its own multiplier, and a distribution is one of:
+
+  NORMAL      mean  std. deviation
+  LOGNORMAL   mean  std. deviation
+  UNIFORM     low   high
+  TRIANGULAR  low   mode  high
+
+Multipliers are drawn from distributions truncated at zero and those of a
+node or link named on several lines are multiplied together. A DEMAND
+multiplier scales all of a junction's demand categories. Quantiles are
+fractions between 0 and 1. Text following a semicolon is a comment.
+
+Realizations are run in blocks on a pool of worker threads (see WORKPOOL.C),
+each worker keeping a project that is made a clone of the base project (see
+CLONE.C) for every realization. Once a block is complete its results are
+added, in order of realization, to streaming statistics that take the same
+amount of memory no matter how many realizations are run: a running mean and
+variance (Welford's method) and a P-square estimate of each quantile (Jain &
+Chlamtac, 1985). Each realization draws its multipliers from a random number
+stream of its own that's seeded from the analysis seed and its realization
+number, so an analysis always gives the same results however many threads
+it's run on. No binary output or hydraulics files are written.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "text.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runmontecarlo(Project *, const char *, const char *, int);
+
+#define MAXQUANTILES 10     // Max. number of quantiles estimated
+#define BLOCKSIZE    16     // Realizations per worker in a block
+#define MAXTRIES     100    // Max. draws of a truncated distribution
+
+// Uncertain property
+enum UncertainType {UNCERTAIN_DEMAND, UNCERTAIN_ROUGHNESS};
+
+// Probability distribution
+enum DistribType {NORMAL_DIST, LOGNORMAL_DIST, UNIFORM_DIST,
+                  TRIANGULAR_DIST};
+
+// Random multiplier applied to a property of a node or link
+typedef struct {
+    int    type;              // UNCERTAIN_DEMAND or UNCERTAIN_ROUGHNESS
+    int    index;             // node or link index (0 for all)
+    int    dist;             // distribution type
+    double p[3];              // distribution parameters
+} Suncertain;
+
+// Running statistics of a result
+typedef struct {
+    double mean;              // mean value
+    double m2;                // sum of squared deviations from mean
+    double min;               // minimum value
+    double max;               // maximum value
+} Sstats;
+
+// P-square quantile estimate
+typedef struct {
+    double q[5];              // marker heights
+    double n[5];              // actual marker positions
+    double np[5];             // desired marker positions
+} Squantile;
+
+// Monte Carlo analysis data shared by the worker threads
+typedef struct {
+    Project     *base;        // base project
+    EN_Project  *workers;     // each worker's project
+    int         nworkers;     // number of workers
+    double      **mult;       // each worker's demand & roughness multipliers
+    long        nrealize;     // number of realizations
+    unsigned long long seed;  // random number seed
+    int         nquantiles;   // number of quantiles
+    double      quantiles[MAXQUANTILES]; // quantile fractions
+    int         nuncertain;   // number of uncertain properties
+    Suncertain  *uncertain;   // uncertain properties
+    int         nresults;     // number of results per realization
+    long        first;        // first realization of current block
+    double      *results;     // results of a block of realizations
+    int         *errcodes;    // error codes of a block of realizations
+    long        count;        // number of realizations in statistics
+    long        nfailed;      // number of failed realizations
+    long        nwarned;      // number of realizations with warnings
+    Sstats      *stats;       // statistics of each result
+    Squantile   *sketches;    // quantile estimates of each result
+    struct Workpool *pool;    // pool of worker threads
+} Smontecarlo;
+
+static char *Keywords[] = {w_REALIZE, w_SEED, w_QUANTILE, w_DEMAND,
+                           w_ROUGHNESS, NULL};
+static char *DistWords[] = {w_NORMAL, w_LOGNORMAL, w_UNIFORM, w_TRIANGULAR,
+                            NULL};
+
+// Local functions
+static int    readmontecarlo(Smontecarlo *, FILE *, int *);
+static int    adduncertain(Smontecarlo *, char **, int, int);
+static int    allocmontecarlo(Smontecarlo *, int);
+static void   runrealization(void *, int, int);
+static int    applymultipliers(Smontecarlo *, EN_Project, double *, long);
+static int    simulate(EN_Project, double *);
+static void   addresults(Smontecarlo *, double *);
+static void   addquantile(Squantile *, double, double, long);
+static double getquantile(Squantile *, double, long);
+static void   writestats(Smontecarlo *, FILE *);
+static void   freemontecarlo(Smontecarlo *);
+static double drawvalue(unsigned long long *, Suncertain *);
+static double randuniform(unsigned long long *);
+static double randnormal(unsigned long long *);
+
+
+int runmontecarlo(Project *pr, const char *mcFile, const char *statsFile,
+                  int nthreads)
+/*----------------------------------------------------------------
+**  Input:   mcFile = name of Monte Carlo file
+**           statsFile = name of results file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  returns an error code
+**  Purpose: runs a Monte Carlo analysis of a project.
+**----------------------------------------------------------------
+*/
+{
+    Smontecarlo mc;
+    FILE *f;
+    long n;
+    int k, line = 0, errcode = 0;
+    char msg[MAXMSG + 1];
+
+    memset(&mc, 0, sizeof(Smontecarlo));
+    mc.base = pr;
+    mc.nresults = pr->network.Nnodes + pr->network.Nlinks;
+
+    // Read the Monte Carlo file
+    if ((f = fopen(mcFile, "rt")) == NULL) return 312;
+    errcode = readmontecarlo(&mc, f, &line);
+    fclose(f);
+    if (errcode)
+    {
+        sprintf(pr->Msg, "Error %d: %s in line %d of Monte Carlo file",
+                errcode, geterrmsg(errcode, msg), line);
+        writeline(pr, pr->Msg);
+        freemontecarlo(&mc);
+        return errcode;
+    }
+
+    // Create the worker threads and their projects
+    if (nthreads <= 0) nthreads = workpool_cpucount();
+    if (nthreads > mc.nrealize) nthreads = (int)MAX(mc.nrealize, 1);
+    mc.pool = workpool_create(nthreads);
+    if (mc.pool == NULL) errcode = 101;
+    else errcode = allocmontecarlo(&mc, workpool_size(mc.pool));
+
+    // Clone the base project once before the workers start
+    // so that they only read from it
+    if (!errcode) errcode = cloneproject(pr, mc.workers[0], NULL, "");
+
+    // Run the realizations a block at a time, adding each
+    // block's results to the statistics in order
+    for (mc.first = 0; mc.first < mc.nrealize && !errcode; mc.first += n)
+    {
+        n = MIN(mc.nrealize - mc.first, (long)BLOCKSIZE * mc.nworkers);
+        workpool_run(mc.pool, (int)n, runrealization, &mc);
+        for (k = 0; k < n; k++)
+        {
+            if (mc.errcodes[k] > 100) mc.nfailed++;
+            else
+            {
+                if (mc.errcodes[k] > 0) mc.nwarned++;
+                addresults(&mc, &mc.results[(long)k * mc.nresults]);
+            }
+        }
+    }
+
+    // Write the statistics to the results file
+    if (!errcode)
+    {
+        if (strlen(statsFile) == 0) writestats(&mc, stdout);
+        else if ((f = fopen(statsFile, "wt")) == NULL) errcode = 313;
+        else
+        {
+            writestats(&mc, f);
+            fclose(f);
+        }
+    }
+    freemontecarlo(&mc);
+    return errcode;
+}
+
+int readmontecarlo(Smontecarlo *mc, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = Monte Carlo file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the options and uncertain properties of a
+**           Monte Carlo analysis.
+**----------------------------------------------------------------
+*/
+{
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    int i, n, key, errcode = 0;
+    double y;
+
+    mc->nrealize = 100;
+    mc->seed = 1;
+    while (fgets(s, MAXLINE, f) != NULL && !errcode)
+    {
+        (*line)++;
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        key = findmatch(tok[0], Keywords);
+        if (n < 2) errcode = 267;
+        else switch (key)
+        {
+        case 0:
+            if (!getfloat(tok[1], &y) || y < 1.0 || y > 1.e9) errcode = 267;
+            else mc->nrealize = (long)y;
+            break;
+        case 1:
+            if (!getfloat(tok[1], &y) || y < 0.0) errcode = 267;
+            else mc->seed = (unsigned long long)y;
+            break;
+        case 2:
+            if (n - 1 > MAXQUANTILES) errcode = 267;
+            mc->nquantiles = 0;
+            for (i = 1; i < n && !errcode; i++)
+            {
+                if (!getfloat(tok[i], &y) || y <= 0.0 || y >= 1.0)
+                {
+                    errcode = 267;
+                }
+                else mc->quantiles[mc->nquantiles++] = y;
+            }
+            break;
+        case 3:
+        case 4:
+            errcode = adduncertain(mc, tok, n, key - 3);
+            break;
+        default:
+            errcode = 267;
+        }
+    }
+    return errcode;
+}
+
+int adduncertain(Smontecarlo *mc, char **tok, int ntoks, int type)
+/*----------------------------------------------------------------
+**  Input:   tok = tokens of a line of the Monte Carlo file
+**           ntoks = number of tokens
+**           type = type of uncertain property
+**  Output:  returns an error code
+**  Purpose: adds an uncertain property to a Monte Carlo analysis.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &mc->base->network;
+    Suncertain u;
+    int i, nparams;
+    void *p;
+
+    // Find the node or link whose property is uncertain
+    if (ntoks < 3) return 267;
+    u.type = type;
+    u.index = 0;
+    if (strcmp(tok[1], "*") != 0)
+    {
+        if (type == UNCERTAIN_DEMAND)
+        {
+            u.index = findnode(net, tok[1]);
+            if (u.index == 0) return 203;
+            if (u.index > net->Njuncs) return 267;
+        }
+        else
+        {
+            u.index = findlink(net, tok[1]);
+            if (u.index == 0) return 204;
+            if (net->Link[u.index].Type > PIPE) return 267;
+        }
+    }
+
+    // Parse the multiplier's distribution
+    u.dist = findmatch(tok[2], DistWords);
+    if (u.dist < 0) return 267;
+    nparams = (u.dist == TRIANGULAR_DIST) ? 3 : 2;
+    if (ntoks < 3 + nparams) return 267;
+    for (i = 0; i < nparams; i++)
+    {
+        if (!getfloat(tok[3 + i], &u.p[i])) return 267;
+    }
+    switch (u.dist)
+    {
+    case NORMAL_DIST:
+    case LOGNORMAL_DIST:
+        if (u.p[0] <= 0.0 || u.p[1] < 0.0) return 267;
+        break;
+    case UNIFORM_DIST:
+        if (u.p[0] > u.p[1] || u.p[1] <= 0.0) return 267;
+        break;
+    case TRIANGULAR_DIST:
+        if (u.p[0] > u.p[1] || u.p[1] > u.p[2] || u.p[2] <= 0.0) return 267;
+        break;
+    }
+
+    // Convert a lognormal's mean & std. deviation to those of its log
+    if (u.dist == LOGNORMAL_DIST)
+    {
+        u.p[1] = log(1.0 + SQR(u.p[1] / u.p[0]));
+        u.p[0] = log(u.p[0]) - u.p[1] / 2.0;
+        u.p[1] = sqrt(u.p[1]);
+    }
+
+    // Append the property to the list of uncertain properties
+    p = realloc(mc->uncertain, (mc->nuncertain + 1) * sizeof(Suncertain));
+    if (p == NULL) return 101;
+    mc->uncertain = p;
+    mc->uncertain[mc->nuncertain++] = u;
+    return 0;
+}
+
+int allocmontecarlo(Smontecarlo *mc, int nworkers)
+/*----------------------------------------------------------------
+**  Input:   nworkers = number of worker threads
+**  Output:  returns an error code
+**  Purpose: allocates memory used by a Monte Carlo analysis.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &mc->base->network;
+    long nblock = (long)BLOCKSIZE * nworkers;
+    int i, errcode = 0;
+
+    mc->nworkers = nworkers;
+    mc->workers = (EN_Project *)calloc(nworkers, sizeof(EN_Project));
+    mc->mult = (double **)calloc(nworkers, sizeof(double *));
+    mc->results = (double *)calloc(nblock * mc->nresults, sizeof(double));
+    mc->errcodes = (int *)calloc(nblock, sizeof(int));
+    mc->stats = (Sstats *)calloc(mc->nresults, sizeof(Sstats));
+    mc->sketches = (Squantile *)calloc((size_t)mc->nresults *
+                   MAX(mc->nquantiles, 1), sizeof(Squantile));
+    ERRCODE(MEMCHECK(mc->workers));
+    ERRCODE(MEMCHECK(mc->mult));
+    ERRCODE(MEMCHECK(mc->results));
+    ERRCODE(MEMCHECK(mc->errcodes));
+    ERRCODE(MEMCHECK(mc->stats));
+    ERRCODE(MEMCHECK(mc->sketches));
+    for (i = 0; i < nworkers && !errcode; i++)
+    {
+        if (EN_createproject(&mc->workers[i]) != 0) errcode = 101;
+        mc->mult[i] = (double *)calloc(net->Nnodes + net->Nlinks + 2,
+                                       sizeof(double));
+        ERRCODE(MEMCHECK(mc->mult[i]));
+    }
+    return errcode;
+}
+
+void runrealization(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = Monte Carlo analysis data
+**           worker = index of worker thread
+**           item = index of realization within current block
+**  Output:  none
+**  Purpose: runs a realization on a worker thread's project.
+**----------------------------------------------------------------
+*/
+{
+    Smontecarlo *mc = (Smontecarlo *)data;
+    EN_Project p = mc->workers[worker];
+    int errcode;
+
+    errcode = EN_cloneproject(mc->base, p, NULL, "");
+    if (!errcode) errcode = applymultipliers(mc, p, mc->mult[worker],
+                                             mc->first + item);
+    if (!errcode) errcode = simulate(p,
+                            &mc->results[(long)item * mc->nresults]);
+    mc->errcodes[item] = errcode;
+}
+
+int applymultipliers(Smontecarlo *mc, EN_Project p, double *mult,
+                     long realization)
+/*----------------------------------------------------------------
+**  Input:   p = project to be changed
+**           mult = work array of multipliers
+**           realization = index of realization
+**  Output:  returns an error code
+**  Purpose: draws a realization's demand & roughness multipliers
+**           and applies them to a project.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    Suncertain *u;
+    double *dmult = mult;
+    double *rmult = mult + net->Nnodes + 1;
+    double v;
+    unsigned long long state;
+    int i, j, k, first, last, ncats, errcode = 0;
+
+    // Seed the realization's random number stream
+    state = mc->seed ^ (0x9E3779B97F4A7C15ULL * (realization + 1));
+
+    // Draw each uncertain property's multipliers in a fixed order
+    for (i = 0; i <= net->Nnodes + net->Nlinks + 1; i++) mult[i] = 1.0;
+    for (k = 0; k < mc->nuncertain; k++)
+    {
+        u = &mc->uncertain[k];
+        if (u->type == UNCERTAIN_DEMAND)
+        {
+            first = (u->index) ? u->index : 1;
+            last = (u->index) ? u->index : net->Njuncs;
+            for (i = first; i <= last; i++) dmult[i] *= drawvalue(&state, u);
+        }
+        else
+        {
+            first = (u->index) ? u->index : 1;
+            last = (u->index) ? u->index : net->Nlinks;
+            for (i = first; i <= last; i++)
+            {
+                if (net->Link[i].Type > PIPE) continue;
+                rmult[i] *= drawvalue(&state, u);
+            }
+        }
+    }
+
+    // Scale the demands & roughness values being changed
+    for (i = 1; i <= net->Njuncs && !errcode; i++)
+    {
+        if (dmult[i] == 1.0) continue;
+        ERRCODE(EN_getnumdemands(p, i, &ncats));
+        for (j = 1; j <= ncats && !errcode; j++)
+        {
+            ERRCODE(EN_getbasedemand(p, i, j, &v));
+            ERRCODE(EN_setbasedemand(p, i, j, v * dmult[i]));
+        }
+    }
+    for (i = 1; i <= net->Nlinks && !errcode; i++)
+    {
+        if (rmult[i] == 1.0) continue;
+        ERRCODE(EN_getlinkvalue(p, i, EN_ROUGHNESS, &v));
+        ERRCODE(EN_setlinkvalue(p, i, EN_ROUGHNESS, v * rmult[i]));
+    }
+    return errcode;
+}
+
+int simulate(EN_Project p, double *x)
+/*----------------------------------------------------------------
+**  Input:   p = project to be analyzed
+**  Output:  x = each node's minimum pressure followed by each
+**               link's maximum velocity
+**           returns an error or warning code
+**  Purpose: runs a hydraulic simulation of a realization.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    double *vmax = x + net->Nnodes - 1;
+    int i, errcode, warning = 0;
+    long t, tstep = 0;
+    double v;
+
+    for (i = 1; i <= net->Nnodes; i++) x[i - 1] = 1.e10;
+    for (i = 1; i <= net->Nlinks; i++) vmax[i] = 0.0;
+    errcode = EN_openH(p);
+    if (!errcode) errcode = EN_initH(p, EN_NOSAVE);
+    if (errcode > 100) return errcode;
+    do
+    {
+        errcode = EN_runH(p, &t);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+        for (i = 1; i <= net->Nnodes; i++)
+        {
+            EN_getnodevalue(p, i, EN_PRESSURE, &v);
+            x[i - 1] = MIN(x[i - 1], v);
+        }
+        for (i = 1; i <= net->Nlinks; i++)
+        {
+            EN_getlinkvalue(p, i, EN_VELOCITY, &v);
+            vmax[i] = MAX(vmax[i], v);
+        }
+        errcode = EN_nextH(p, &tstep);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+    } while (tstep > 0);
+    EN_closeH(p);
+    return (errcode > 100) ? errcode : warning;
+}
+
+void addresults(Smontecarlo *mc, double *x)
+/*----------------------------------------------------------------
+**  Input:   x = results of a realization
+**  Output:  none
+**  Purpose: adds a realization's results to the statistics.
+**----------------------------------------------------------------
+*/
+{
+    Sstats *s;
+    double d;
+    int i, k;
+
+    mc->count++;
+    for (i = 0; i < mc->nresults; i++)
+    {
+        s = &mc->stats[i];
+        if (mc->count == 1)
+        {
+            s->min = x[i];
+            s->max = x[i];
+        }
+        d = x[i] - s->mean;
+        s->mean += d / mc->count;
+        s->m2 += d * (x[i] - s->mean);
+        s->min = MIN(s->min, x[i]);
+        s->max = MAX(s->max, x[i]);
+        for (k = 0; k < mc->nquantiles; k++)
+        {
+            addquantile(&mc->sketches[(long)i * mc->nquantiles + k],
+                        mc->quantiles[k], x[i], mc->count);
+        }
+    }
+}
+
+void addquantile(Squantile *e, double p, double x, long count)
+/*----------------------------------------------------------------
+**  Input:   p = quantile fraction
+**           x = new value
+**           count = number of values including x
+**  Output:  none
+**  Purpose: updates a P-square estimate of a quantile with a new
+**           value.
+**----------------------------------------------------------------
+*/
+{
+    double dn[5] = {0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0};
+    double d, qp;
+    int i, j, k;
+
+    // Keep the first 5 values in sorted order
+    if (count <= 5)
+    {
+        for (i = (int)count - 1; i > 0 && e->q[i - 1] > x; i--)
+        {
+            e->q[i] = e->q[i - 1];
+        }
+        e->q[i] = x;
+        if (count == 5)
+        {
+            for (i = 0; i < 5; i++) e->n[i] = i + 1;
+            e->np[0] = 1.0;
+            e->np[1] = 1.0 + 2.0 * p;
+            e->np[2] = 1.0 + 4.0 * p;
+            e->np[3] = 3.0 + 2.0 * p;
+            e->np[4] = 5.0;
+        }
+        return;
+    }
+
+    // Find the cell containing x & shift the markers above it
+    if (x < e->q[0])
+    {
+        e->q[0] = x;
+        k = 0;
+    }
+    else if (x >= e->q[4])
+    {
+        e->q[4] = x;
+        k = 3;
+    }
+    else for (k = 0; k < 3 && x >= e->q[k + 1]; k++);
+    for (i = k + 1; i < 5; i++) e->n[i] += 1.0;
+    for (i = 0; i < 5; i++) e->np[i] += dn[i];
+
+    // Move the middle markers toward their desired positions
+    for (i = 1; i <= 3; i++)
+    {
+        d = e->np[i] - e->n[i];
+        if ((d >= 1.0 && e->n[i + 1] - e->n[i] > 1.0) ||
+            (d <= -1.0 && e->n[i - 1] - e->n[i] < -1.0))
+        {
+            j = (d > 0.0) ? 1 : -1;
+            qp = e->q[i] + j / (e->n[i + 1] - e->n[i - 1]) *
+                 ((e->n[i] - e->n[i - 1] + j) * (e->q[i + 1] - e->q[i]) /
+                  (e->n[i + 1] - e->n[i]) +
+                  (e->n[i + 1] - e->n[i] - j) * (e->q[i] - e->q[i - 1]) /
+                  (e->n[i] - e->n[i - 1]));
+            if (qp <= e->q[i - 1] || qp >= e->q[i + 1])
+            {
+                qp = e->q[i] + j * (e->q[i + j] - e->q[i]) /
+                     (e->n[i + j] - e->n[i]);
+            }
+            e->q[i] = qp;
+            e->n[i] += j;
+        }
+    }
+}
+
+double getquantile(Squantile *e, double p, long count)
+/*----------------------------------------------------------------
+**  Input:   p = quantile fraction
+**           count = number of values
+**  Output:  returns estimated quantile
+**  Purpose: retrieves the estimate of a quantile.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    if (count >= 5) return e->q[2];
+    i = (int)(p * count);
+    return e->q[MIN(i, (int)count - 1)];
+}
+
+void writestats(Smontecarlo *mc, FILE *f)
+/*----------------------------------------------------------------
+**  Input:   f = results file
+**  Output:  none
+**  Purpose: writes the statistics of a Monte Carlo analysis.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &mc->base->network;
+    Report *rpt = &mc->base->report;
+    Sstats *s;
+    char *id;
+    char heading[16];
+    int i, k, type, field, prec;
+    double sd;
+
+    fprintf(f, "Monte Carlo Analysis\n");
+    fprintf(f, "Realizations: %ld (%ld failed, %ld with warnings)\n",
+            mc->nrealize, mc->nfailed, mc->nwarned);
+    fprintf(f, "Seed:         %llu\n", mc->seed);
+    for (type = NODE; type <= LINK; type++)
+    {
+        field = (type == NODE) ? PRESSURE : VELOCITY;
+        prec = rpt->Field[field].Precision;
+        fprintf(f, "\n%s (%s)\n", (type == NODE) ?
+                "Minimum Node Pressure" : "Maximum Link Velocity",
+                rpt->Field[field].Units);
+        fprintf(f, "%-*s %12s %12s %12s %12s", MAXID,
+                (type == NODE) ? "Node" : "Link", "Mean", "Std Dev",
+                "Min", "Max");
+        for (k = 0; k < mc->nquantiles; k++)
+        {
+            sprintf(heading, "P%g", mc->quantiles[k] * 100.0);
+            fprintf(f, " %12s", heading);
+        }
+        fprintf(f, "\n");
+        if (mc->count == 0) continue;
+
+        for (i = 0; i < mc->nresults; i++)
+        {
+            if ((type == NODE) != (i < net->Nnodes)) continue;
+            if (type == NODE) id = net->Node[i + 1].ID;
+            else id = net->Link[i - net->Nnodes + 1].ID;
+            s = &mc->stats[i];
+            sd = (mc->count > 1) ? sqrt(s->m2 / (mc->count - 1)) : 0.0;
+            fprintf(f, "%-*s %12.*f %12.*f %12.*f %12.*f", MAXID, id,
+                    prec, s->mean, prec, sd, prec, s->min, prec, s->max);
+            for (k = 0; k < mc->nquantiles; k++)
+            {
+                fprintf(f, " %12.*f", prec, getquantile(
+                        &mc->sketches[(long)i * mc->nquantiles + k],
+                        mc->quantiles[k], mc->count));
+            }
+            fprintf(f, "\n");
+        }
+    }
+}
+
+void freemontecarlo(Smontecarlo *mc)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory used by a Monte Carlo analysis.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    for (i = 0; i < mc->nworkers; i++)
+    {
+        if (mc->workers && mc->workers[i]) EN_deleteproject(mc->workers[i]);
+        if (mc->mult) free(mc->mult[i]);
+    }
+    free(mc->workers);
+    free(mc->mult);
+    workpool_delete(mc->pool);
+    free(mc->uncertain);
+    free(mc->results);
+    free(mc->errcodes);
+    free(mc->stats);
+    free(mc->sketches);
+}
+
+double drawvalue(unsigned long long *state, Suncertain *u)
+/*----------------------------------------------------------------
+**  Input:   state = state of random number stream
+**           u = uncertain property
+**  Output:  returns a random multiplier
+**  Purpose: draws a multiplier from a distribution truncated
+**           at zero.
+**----------------------------------------------------------------
+*/
+{
+    double x = 0.0, r;
+    int i;
+
+    for (i = 0; i < MAXTRIES; i++)
+    {
+        switch (u->dist)
+        {
+        case NORMAL_DIST:
+            x = u->p[0] + u->p[1] * randnormal(state);
+            break;
+        case LOGNORMAL_DIST:
+            x = exp(u->p[0] + u->p[1] * randnormal(state));
+            break;
+        case UNIFORM_DIST:
+            x = u->p[0] + (u->p[1] - u->p[0]) * randuniform(state);
+            break;
+        case TRIANGULAR_DIST:
+            r = randuniform(state);
+            if (u->p[2] == u->p[0]) x = u->p[0];
+            else if (r < (u->p[1] - u->p[0]) / (u->p[2] - u->p[0]))
+            {
+                x = u->p[0] + sqrt(r * (u->p[2] - u->p[0]) *
+                                   (u->p[1] - u->p[0]));
+            }
+            else
+            {
+                x = u->p[2] - sqrt((1.0 - r) * (u->p[2] - u->p[0]) *
+                                   (u->p[2] - u->p[1]));
+            }
+            break;
+        }
+        if (x > 0.0) return x;
+    }
+    return 0.0;
+}
+
+double randuniform(unsigned long long *state)
+/*----------------------------------------------------------------
+**  Input:   state = state of random number stream
+**  Output:  returns a random number in [0, 1)
+**  Purpose: draws the next number of a SplitMix64 random number
+**           stream.
+**----------------------------------------------------------------
+*/
+{
+    unsigned long long z;
+
+    *state += 0x9E3779B97F4A7C15ULL;
+    z = *state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double randnormal(unsigned long long *state)
+/*----------------------------------------------------------------
+**  Input:   state = state of random number stream
+**  Output:  returns a standard normal random number
+**  Purpose: draws a normal random number (Box-Muller method).
+**----------------------------------------------------------------
+*/
+{
+    double u1, u2;
+
+    u1 = 1.0 - randuniform(state);
+    u2 = randuniform(state);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
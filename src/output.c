@@ -7,7 +7,7 @@ Description:  binary file read/write routines
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 08/13/2022
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -24,9 +24,14 @@ Last Updated: 08/13/2022
 // Local functions
 static int  nodeoutput(Project *, int, REAL4 *, double);
 static int  linkoutput(Project *, int, REAL4 *, double);
+static int  constitoutput(Project *, REAL4 *);
+static int  saveconstits(Project *);
 static int  savetimestat(Project *, REAL4 *, HdrType);
 static int  savenetreacts(Project *, double, double, double, double);
 static int  saveepilog(Project *);
+static int  readhydmap(Project *, long *);
+static int  growhydstore(Outfile *, size_t);
+static int  spillhyd(Project *);
 
 // Functions to write/read x[1] to x[n] to/from binary file
 size_t f_save(REAL4 *x, int n, FILE *file)
@@ -168,36 +173,34 @@ int savehyd(Project *pr, long *htime)
 **   Input:   *htime   = current time
 **   Output:  returns error code
 **   Purpose: saves current hydraulic solution to file HydFile
-**            in binary format
+**            (or to memory, see writehyd) in binary format
 **--------------------------------------------------------------
 */
 {
     Network *net = &pr->network;
-    Outfile *out = &pr->outfile;
     Hydraul *hyd = &pr->hydraul;
 
     int i;
     INT4 t;
     int errcode = 0;
     REAL4 *x;
-    FILE  *HydFile = out->HydFile;
+    size_t nodebytes = net->Nnodes * sizeof(REAL4);
+    size_t linkbytes = net->Nlinks * sizeof(REAL4);
 
     x = (REAL4 *)calloc(MAX(net->Nnodes, net->Nlinks) + 1, sizeof(REAL4));
     if (x == NULL) return 101;
 
     // Save current time (htime)
     t = (INT4)(*htime);
-    fwrite(&t, sizeof(INT4), 1, HydFile);
+    if (!writehyd(pr, &t, sizeof(INT4))) errcode = 308;
 
     // Save current nodal demands (D)
     for (i = 1; i <= net->Nnodes; i++) x[i] = (REAL4)hyd->NodeDemand[i];
-    fwrite(x + 1, sizeof(REAL4), net->Nnodes, HydFile);
-    //f_save(x, net->Nnodes, HydFile);
+    if (!writehyd(pr, x + 1, nodebytes)) errcode = 308;
 
     // Save current nodal heads
     for (i = 1; i <= net->Nnodes; i++) x[i] = (REAL4)hyd->NodeHead[i];
-    fwrite(x + 1, sizeof(REAL4), net->Nnodes, HydFile);
-    //f_save(x, net->Nnodes, HydFile);
+    if (!writehyd(pr, x + 1, nodebytes)) errcode = 308;
 
     // Force flow in closed links to be zero then save flows
     for (i = 1; i <= net->Nlinks; i++)
@@ -205,24 +208,16 @@ int savehyd(Project *pr, long *htime)
         if (hyd->LinkStatus[i] <= CLOSED) x[i] = 0.0f;
         else x[i] = (REAL4)hyd->LinkFlow[i];
     }
-    fwrite(x + 1, sizeof(REAL4), net->Nlinks, HydFile);
-    //f_save(x, net->Nlinks, HydFile);
+    if (!writehyd(pr, x + 1, linkbytes)) errcode = 308;
 
     // Save link status
     for (i = 1; i <= net->Nlinks; i++) x[i] = (REAL4)hyd->LinkStatus[i];
-    fwrite(x + 1, sizeof(REAL4), net->Nlinks, HydFile);
-    //f_save(x, net->Nlinks, HydFile);
+    if (!writehyd(pr, x + 1, linkbytes)) errcode = 308;
 
-    // Save link settings & check for successful write-to-disk
-    // (We assume that if any of the previous fwrites failed,
-    // then this one will also fail.)
+    // Save link settings
     for (i = 1; i <= net->Nlinks; i++) x[i] = (REAL4)hyd->LinkSetting[i];
-    if (fwrite(x + 1, sizeof(REAL4), net->Nlinks, HydFile) <
-        (unsigned)net->Nlinks
-       ) errcode = 308;
-    //if (f_save(x, net->Nlinks, HydFile) < (unsigned)net->Nlinks) errcode = 308;
+    if (!writehyd(pr, x + 1, linkbytes)) errcode = 308;
     free(x);
-    fflush(HydFile);
     return errcode;
 }
 
@@ -232,22 +227,109 @@ int savehydstep(Project *pr, long *hydstep)
 **   Input:   *hydstep = next time step
 **   Output:  returns error code
 **   Purpose: saves next hydraulic timestep to file HydFile
-**            in binary format
+**            (or to memory, see writehyd) in binary format
 **--------------------------------------------------------------
 */
 {
     Outfile *out = &pr->outfile;
 
     INT4 t;
+    char eof = EOFMARK;
     int errcode = 0;
 
     t = (INT4)(*hydstep);
-    if (fwrite(&t, sizeof(INT4), 1, out->HydFile) < 1) errcode = 308;
-    if (t == 0) fputc(EOFMARK, out->HydFile);
-    fflush(out->HydFile);
+    if (!writehyd(pr, &t, sizeof(INT4))) errcode = 308;
+    if (t == 0)
+    {
+        if (!writehyd(pr, &eof, 1)) errcode = 308;
+        if (out->HydFile) fflush(out->HydFile);
+    }
     return errcode;
 }
 
+int writehyd(Project *pr, const void *x, size_t n)
+/*
+**--------------------------------------------------------------
+**   Input:   x = data to be saved
+**            n = size of data in bytes
+**   Output:  returns 1 if successful, 0 if not
+**   Purpose: appends data to the hydraulics file
+**
+**   NOTE: Scratch hydraulics are held in memory, where they
+**         can be read in place (see readhydmap), until they
+**         would grow beyond the HYDRAULICS MEMORY option. They
+**         are then moved to the scratch hydraulics file, which
+**         is written to from then on.
+**--------------------------------------------------------------
+*/
+{
+    Outfile *out = &pr->outfile;
+
+    if (out->HydStore)
+    {
+        if (growhydstore(out, out->HydSize + n))
+        {
+            memcpy(out->HydStore + out->HydSize, x, n);
+            out->HydSize += n;
+            return 1;
+        }
+        if (!spillhyd(pr)) return 0;
+    }
+    if (out->HydFile == NULL) return 0;
+    return fwrite(x, 1, n, out->HydFile) == n;
+}
+
+int growhydstore(Outfile *out, size_t size)
+/*
+**--------------------------------------------------------------
+**   Input:   size = bytes needed to hold the hydraulics
+**   Output:  returns 1 if successful, 0 if not
+**   Purpose: makes room for hydraulics held in memory, doubling
+**            the memory allocated to them up to the HYDRAULICS
+**            MEMORY limit.
+**--------------------------------------------------------------
+*/
+{
+    size_t limit = (size_t)(out->HydMemory * 1048576.0);
+    size_t capacity = out->HydCapacity;
+    char *store;
+
+    if (size > limit) return 0;
+    if (size <= capacity) return 1;
+    while (capacity < size) capacity *= 2;
+    capacity = MIN(capacity, limit);
+    store = (char *)realloc(out->HydStore, capacity);
+    if (store == NULL) return 0;
+    out->HydStore = store;
+    out->HydData = store;
+    out->HydCapacity = capacity;
+    return 1;
+}
+
+int spillhyd(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns 1 if successful, 0 if not
+**   Purpose: moves the hydraulics held in memory to the scratch
+**            hydraulics file.
+**--------------------------------------------------------------
+*/
+{
+    Outfile *out = &pr->outfile;
+    int result;
+
+    out->HydFile = fopen(out->HydFname, "w+b");
+    if (out->HydFile == NULL) return 0;
+    result = fwrite(out->HydStore, 1, out->HydSize, out->HydFile) ==
+             out->HydSize;
+    FREE(out->HydStore);
+    out->HydData = NULL;
+    out->HydSize = 0;
+    out->HydCapacity = 0;
+    return result;
+}
+
 int saveenergy(Project *pr)
 /*
 **--------------------------------------------------------------
@@ -351,6 +433,7 @@ int readhyd(Project *pr, long *hydtime)
     REAL4 *x;
     FILE *HydFile = out->HydFile;
 
+    if (out->HydData) return readhydmap(pr, hydtime);
     x = (REAL4 *)calloc(MAX(net->Nnodes, net->Nlinks) + 1, sizeof(REAL4));
     if (x == NULL) return 0;
 
@@ -386,14 +469,63 @@ int readhydstep(Project *pr, long *hydstep)
 **--------------------------------------------------------------
 */
 {
-    FILE *hydFile = pr->outfile.HydFile;
+    Outfile *out = &pr->outfile;
+    FILE *hydFile = out->HydFile;
     INT4 t;
 
-    if (fread(&t, sizeof(INT4), 1, hydFile) < 1) return 0;
+    if (out->HydData)
+    {
+        if (out->HydPos + sizeof(INT4) > out->HydSize) return 0;
+        memcpy(&t, out->HydData + out->HydPos, sizeof(INT4));
+        out->HydPos += sizeof(INT4);
+    }
+    else if (fread(&t, sizeof(INT4), 1, hydFile) < 1) return 0;
     *hydstep = t;
     return 1;
 }
 
+int readhydmap(Project *pr, long *hydtime)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  *hydtime = time of hydraulic solution
+**   Returns: 1 if successful, 0 if not
+**   Purpose: reads hydraulic solution from a memory-mapped
+**            hydraulics file or from hydraulics held in memory
+**            (see readhyd).
+**
+**   NOTE: The results are read in place, so that projects
+**         sharing the same mapped file don't need buffers
+**         of their own and no file I/O is needed.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Outfile *out = &pr->outfile;
+
+    int i;
+    INT4 t;
+    const REAL4 *x;
+    size_t n = 1 + 2 * (size_t)net->Nnodes + 3 * (size_t)net->Nlinks;
+
+    if (out->HydPos + n * sizeof(REAL4) > out->HydSize) return 0;
+    memcpy(&t, out->HydData + out->HydPos, sizeof(INT4));
+    *hydtime = t;
+    x = (const REAL4 *)(out->HydData + out->HydPos + sizeof(INT4)) - 1;
+    for (i = 1; i <= net->Nnodes; i++) hyd->NodeDemand[i] = x[i];
+    x += net->Nnodes;
+    for (i = 1; i <= net->Nnodes; i++) hyd->NodeHead[i] = x[i];
+    x += net->Nnodes;
+    for (i = 1; i <= net->Nlinks; i++) hyd->LinkFlow[i] = x[i];
+    x += net->Nlinks;
+    for (i = 1; i <= net->Nlinks; i++) hyd->LinkStatus[i] = (char)x[i];
+    x += net->Nlinks;
+    for (i = 1; i <= net->Nlinks; i++) hyd->LinkSetting[i] = x[i];
+    out->HydPos += n * sizeof(REAL4);
+    return 1;
+}
+
 int saveoutput(Project *pr)
 /*
 **--------------------------------------------------------------
@@ -415,6 +547,7 @@ int saveoutput(Project *pr)
     // Write out node results, then link results
     for (j = DEMAND; j <= QUALITY; j++) ERRCODE(nodeoutput(pr, j, x, pr->Ucf[j]));
     for (j = FLOW; j <= FRICTION; j++) ERRCODE(linkoutput(pr, j, x, pr->Ucf[j]));
+    if (pr->outfile.ConstitFile != NULL) ERRCODE(constitoutput(pr, x));
     free(x);
     return errcode;
 }
@@ -538,7 +671,7 @@ int linkoutput(Project *pr, int j, REAL4 *x, double ucf)
       case LINKQUAL:
         for (i = 1; i <= net->Nlinks; i++)
         {
-            x[i] = (REAL4)(avgqual(pr,i) * ucf);
+            x[i] = (REAL4)(avgqual(pr, 0, i) * ucf);
         }
         break;
 
@@ -610,6 +743,38 @@ int linkoutput(Project *pr, int j, REAL4 *x, double ucf)
     return 0;
 }
 
+int constitoutput(Project *pr, REAL4 *x)
+/*
+**--------------------------------------------------------------
+**   Input:   *x  = buffer for node or link values
+**   Output:  returns error code
+**   Purpose: writes node and link results of each added quality
+**            constituent to the constituents' temporary file
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+    FILE *f = pr->outfile.ConstitFile;
+
+    int i, k;
+
+    for (i = 1; i <= qual->Nconstits; i++)
+    {
+        for (k = 1; k <= net->Nnodes; k++)
+        {
+            x[k] = (REAL4)qual->ConstitQual[i][k];
+        }
+        if (f_save(x, net->Nnodes, f) < (unsigned)net->Nnodes) return 308;
+        for (k = 1; k <= net->Nlinks; k++)
+        {
+            x[k] = (REAL4)avgqual(pr, i, k);
+        }
+        if (f_save(x, net->Nlinks, f) < (unsigned)net->Nlinks) return 308;
+    }
+    return 0;
+}
+
 int savefinaloutput(Project *pr)
 /*
 **--------------------------------------------------------------
@@ -642,9 +807,11 @@ int savefinaloutput(Project *pr)
         free(x);
     }
 
-    // Save avg. reaction rates & file epilog
+    // Save results of added quality constituents, avg. reaction
+    // rates & file epilog
     if (outFile != NULL)
     {
+        ERRCODE(saveconstits(pr));
         ERRCODE(savenetreacts(pr, qual->Wbulk, qual->Wwall, qual->Wtank,
                               qual->Wsource));
         ERRCODE(saveepilog(pr));
@@ -652,6 +819,65 @@ int savefinaloutput(Project *pr)
     return errcode;
 }
 
+int saveconstits(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns error code
+**  Purpose: copies the results of added quality constituents
+**           from their temporary file to the output file.
+**  Note:    the section follows all reporting periods so that
+**           readers locating the reaction rates and epilog from
+**           the end of the file are unaffected. It holds the
+**           number of constituents, the type and trace node of
+**           each one, the number of periods saved and then for
+**           each period and constituent its node qualities
+**           followed by its link qualities. Periods are saved
+**           as a time series even when the other results hold
+**           a time statistic.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+    Outfile *out = &pr->outfile;
+
+    int i, errcode = 0;
+    long nbytes, period;
+    size_t n;
+    INT4 ibuf[3];
+    char buf[4096];
+    FILE *f = out->ConstitFile;
+
+    if (f == NULL) return 0;
+
+    // Write the section's header
+    ibuf[0] = qual->Nconstits;
+    if (fwrite(ibuf, sizeof(INT4), 1, out->OutFile) < 1) errcode = 308;
+    for (i = 1; i <= qual->Nconstits; i++)
+    {
+        ibuf[0] = qual->Constit[i].Type;
+        ibuf[1] = qual->Constit[i].Node;
+        if (fwrite(ibuf, sizeof(INT4), 2, out->OutFile) < 2) errcode = 308;
+    }
+    fseek(f, 0, SEEK_END);
+    nbytes = ftell(f);
+    period = (long)qual->Nconstits * (net->Nnodes + net->Nlinks) *
+             sizeof(REAL4);
+    ibuf[0] = (INT4)(nbytes / period);
+    if (fwrite(ibuf, sizeof(INT4), 1, out->OutFile) < 1) errcode = 308;
+
+    // Copy the saved periods
+    fseek(f, 0, SEEK_SET);
+    while (!errcode && (n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        if (fwrite(buf, 1, n, out->OutFile) < n) errcode = 308;
+    }
+    fclose(f);
+    out->ConstitFile = NULL;
+    return errcode;
+}
+
 int savetimestat(Project *pr, REAL4 *x, HdrType objtype)
 /*
 **--------------------------------------------------------------
@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 04/23/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -117,7 +117,10 @@ int openfiles(Project *pr, const char *f1, const char *f2, const char *f3)
     pr->report.RptFile = NULL;
     pr->outfile.OutFile = NULL;
     pr->outfile.HydFile = NULL;
+    pr->outfile.HydStore = NULL;
+    pr->outfile.HydData = NULL;
     pr->outfile.TmpOutFile = NULL;
+    pr->outfile.ConstitFile = NULL;
 
     // Save file names
     strncpy(pr->parser.InpFname, f1, MAXFNAME);
@@ -155,6 +158,10 @@ int openhydfile(Project *pr)
 ** Output:  none
 ** Returns: error code
 ** Purpose: opens file that saves hydraulics solution
+**
+** NOTE: Scratch hydraulics are held in memory rather than in a
+**       file until they outgrow the HYDRAULICS MEMORY option
+**       (see writehyd() in OUTPUT.C).
 **----------------------------------------------------------------
 */
 {
@@ -170,20 +177,23 @@ int openhydfile(Project *pr)
     int errcode = 0;
 
     // If HydFile currently open, then close it
-    if (pr->outfile.HydFile != NULL)
-    {
-        fclose(pr->outfile.HydFile);
-        pr->outfile.HydFile = NULL;
-    }
+    closehydfile(pr);
 
     // Use Hydflag to determine the type of hydraulics file to use.
     // Write error message if the file cannot be opened.
-    pr->outfile.HydFile = NULL;
     switch (pr->outfile.Hydflag)
     {
       case SCRATCH:
         strcpy(pr->outfile.HydFname, pr->TmpHydFname);
-        pr->outfile.HydFile = fopen(pr->outfile.HydFname, "w+b");
+        if (pr->outfile.HydMemory > 0.0)
+        {
+            pr->outfile.HydCapacity = 1024;
+            pr->outfile.HydStore = (char *)malloc(pr->outfile.HydCapacity);
+            if (pr->outfile.HydStore == NULL) return 101;
+            pr->outfile.HydData = pr->outfile.HydStore;
+            pr->outfile.HydSize = 0;
+        }
+        else pr->outfile.HydFile = fopen(pr->outfile.HydFname, "w+b");
         break;
       case SAVE:
         pr->outfile.HydFile = fopen(pr->outfile.HydFname, "w+b");
@@ -192,7 +202,10 @@ int openhydfile(Project *pr)
         pr->outfile.HydFile = fopen(pr->outfile.HydFname, "rb");
         break;
     }
-    if (pr->outfile.HydFile == NULL) return 305;
+    if (pr->outfile.HydFile == NULL && pr->outfile.HydStore == NULL)
+    {
+        return 305;
+    }
 
     // If a previous hydraulics solution is not being used, then
     // save the current network size parameters to the file.
@@ -206,9 +219,9 @@ int openhydfile(Project *pr)
         nsize[3] = Npumps;
         nsize[4] = Nvalves;
         nsize[5] = (int)pr->times.Dur;
-        fwrite(&magic, sizeof(INT4), 1, pr->outfile.HydFile);
-        fwrite(&version, sizeof(INT4), 1, pr->outfile.HydFile);
-        fwrite(nsize, sizeof(INT4), 6, pr->outfile.HydFile);
+        if (!writehyd(pr, &magic, sizeof(INT4)) ||
+            !writehyd(pr, &version, sizeof(INT4)) ||
+            !writehyd(pr, nsize, 6 * sizeof(INT4))) return 308;
     }
 
     // If a previous hydraulics solution is being used, then
@@ -230,10 +243,34 @@ int openhydfile(Project *pr)
 
     // Save current position in hydraulics file
     // where storage of hydraulic results begins
-    pr->outfile.HydOffset = ftell(pr->outfile.HydFile);
+    if (pr->outfile.HydStore) pr->outfile.HydOffset = (long)pr->outfile.HydSize;
+    else pr->outfile.HydOffset = ftell(pr->outfile.HydFile);
     return errcode;
 }
 
+void closehydfile(Project *pr)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: closes hydraulics file and frees any hydraulics
+**           held in memory.
+**----------------------------------------------------------------
+*/
+{
+    if (pr->outfile.HydFile != NULL)
+    {
+        fclose(pr->outfile.HydFile);
+        pr->outfile.HydFile = NULL;
+    }
+    if (pr->outfile.HydStore != NULL)
+    {
+        FREE(pr->outfile.HydStore);
+        pr->outfile.HydData = NULL;
+        pr->outfile.HydSize = 0;
+        pr->outfile.HydCapacity = 0;
+    }
+}
+
 int openoutfile(Project *pr)
 /*----------------------------------------------------------------
 **  Input:   none
@@ -268,6 +305,13 @@ int openoutfile(Project *pr)
         }
         else pr->outfile.TmpOutFile = pr->outfile.OutFile;
     }
+
+    // Open temporary file for the results of added quality constituents
+    if (!errcode && pr->quality.Qualflag != NONE && pr->quality.Nconstits > 0)
+    {
+        pr->outfile.ConstitFile = fopen(pr->TmpConstitFname, "w+b");
+        if (pr->outfile.ConstitFile == NULL) errcode = 304;
+    }
     return errcode;
 }
 
@@ -287,6 +331,11 @@ void closeoutfile(Project *pr)
             pr->outfile.TmpOutFile = NULL;
         }
     }
+    if (pr->outfile.ConstitFile != NULL)
+    {
+        fclose(pr->outfile.ConstitFile);
+        pr->outfile.ConstitFile = NULL;
+    }
     if (pr->outfile.OutFile != NULL)
     {
         if (pr->outfile.OutFile == pr->outfile.TmpOutFile)
@@ -489,6 +538,9 @@ void freedata(Project *pr)
     // Free memory used for nodal adjacency lists
     freeadjlists(&pr->network);
 
+    // Release network data shared with other projects (see CLONE.C)
+    releaseshared(pr);
+
     // Free memory for node data
     if (pr->network.Node != NULL)
     {
@@ -0,0 +1,676 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       qualbatch.c
+ Description:  runs a batch of water quality scenarios over shared hydraulics
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A water quality batch run analyzes a set of contamination scenarios, each one
+a list of injections of a chemical into the network of an open base project,
+over the same hydraulics. It writes a one line summary of each scenario's
+water quality results to a summary file as soon as it completes.
+
+Each line of a scenario file describes one injection:
+
+  scenario  nodeID  CONCEN | MASS | SETPOINT | FLOWPACED  strength
+            (start)  (duration)
+
+where scenario is the name of the scenario the injection belongs to (a
+scenario's lines need not be contiguous), strength is in the base project's
+units for a water quality source of the given type, and start and duration
+are in decimal hours or hours:minutes (the injection starts at time 0 and
+lasts for the rest of the simulation by default). Injections replace any
+source the base project has at a node, with those made at the same node
+sharing the source type of the last one. Text following a semicolon is a
+comment. If the base project isn't set up for a chemical analysis, the
+chemical injected is one that is initially absent from the network.
+
+The hydraulics file, either one saved from the base project or one written
+by solving the base project's hydraulics at the start of the run, is mapped
+into memory once and read in place by every scenario (see readhydmap() in
+OUTPUT.C). Solved hydraulics that are still held in memory are read in place
+without being mapped. Scenarios are run on a pool of worker threads (see WORKPOOL.C),
+each worker keeping a project of its own that is made a clone of the base
+project (see CLONE.C), so that a scenario only holds its own water quality
+segments and results.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+#include "hash.h"
+#include "text.h"
+#include "workpool.h"
+
+// Exported functions (declared in funcs.h)
+//int     runqualbatch(Project *, const char *, const char *, const char *,
+//                     int);
+
+// An injection made by a scenario
+typedef struct {
+    int    scenario;          // index of scenario making the injection
+    int    node;              // index of node injected into
+    int    type;              // type of source (see SourceType)
+    double strength;          // source strength
+    long   start;             // time injection starts (sec)
+    long   stop;              // time injection stops (sec)
+} Sinjection;
+
+// A scenario's results
+typedef struct {
+    int    errcode;           // error or warning code
+    int    nreached;          // number of nodes reached
+    double peakqual;          // highest node quality
+    int    peaknode;          // node with highest quality
+    long   peaktime;          // time of highest quality
+} Ssummary;
+
+// Water quality batch run data shared by the worker threads
+typedef struct {
+    Project     *base;        // base project
+    EN_Project  hydproject;   // project whose hydraulics were solved
+    const char  *hyddata;     // memory-mapped hydraulics file
+    size_t      hydsize;      // size of hydraulics file in bytes
+    int         hydmapped;    // TRUE if hyddata was mapped from a file
+    EN_Project  *workers;     // each worker's project
+    int         nscenarios;   // number of scenarios
+    char        (*names)[MAXID + 1];  // scenario names
+    int         ninjections;  // number of injections
+    Sinjection  *injections;  // injections sorted by scenario
+    int         *first;       // first injection of each scenario
+    FILE        *sumfile;     // summary file
+    char        *units;       // concentration units
+    struct Workpool *pool;    // pool of worker threads
+} Sqbatch;
+
+// Size of a hydraulics file's header (see openhydfile() in PROJECT.C)
+#define HYDHDRSIZE (8 * sizeof(INT4))
+
+static char *SourceWords[] = {w_CONCEN, w_MASS, w_SETPOINT, w_FLOWPACED,
+                              NULL};
+
+// Local functions
+static int   readinjections(Sqbatch *, FILE *, int *);
+static int   addinjection(Sqbatch *, HashTable *, char **, int);
+static int   sortinjections(Sqbatch *);
+static int   openhydmap(Sqbatch *, const char *);
+static int   maphydfile(Sqbatch *, const char *);
+static void  unmaphydfile(Sqbatch *);
+static void  runscenario(void *, int, int);
+static int   applyinjections(Sqbatch *, EN_Project, int);
+static int   simulate(Sqbatch *, EN_Project, int, Ssummary *);
+static void  setinjections(Sqbatch *, EN_Project, int, long);
+static void  writeresults(Sqbatch *, int, Ssummary *);
+static void  freeqbatch(Sqbatch *);
+
+
+int runqualbatch(Project *pr, const char *hydFile, const char *scnFile,
+                 const char *sumFile, int nthreads)
+/*----------------------------------------------------------------
+**  Input:   hydFile = name of hydraulics file ("" to solve the
+**                     project's hydraulics)
+**           scnFile = name of scenario file
+**           sumFile = name of summary file ("" for stdout)
+**           nthreads = number of worker threads (0 for one
+**                      per processor)
+**  Output:  returns an error code
+**  Purpose: runs a batch of water quality scenarios that inject
+**           a chemical into a project's network.
+**----------------------------------------------------------------
+*/
+{
+    Sqbatch b;
+    FILE *f;
+    int i, line = 0, errcode = 0;
+    char msg[MAXMSG + 1];
+
+    memset(&b, 0, sizeof(Sqbatch));
+    b.base = pr;
+    if (pr->quality.Qualflag == CHEM) b.units = pr->quality.ChemUnits;
+    else b.units = u_MGperL;
+
+    // Read the scenario file
+    if ((f = fopen(scnFile, "rt")) == NULL) return 310;
+    errcode = readinjections(&b, f, &line);
+    fclose(f);
+    if (errcode)
+    {
+        sprintf(pr->Msg, "Error %d: %s in line %d of scenario file",
+                errcode, geterrmsg(errcode, msg), line);
+        writeline(pr, pr->Msg);
+        freeqbatch(&b);
+        return errcode;
+    }
+
+    // Open the summary file
+    if (strlen(sumFile) == 0) b.sumfile = stdout;
+    else if ((b.sumfile = fopen(sumFile, "wt")) == NULL)
+    {
+        freeqbatch(&b);
+        return 311;
+    }
+    writeresults(&b, -1, NULL);
+    if (b.nscenarios == 0)
+    {
+        freeqbatch(&b);
+        return 0;
+    }
+
+    // Map the hydraulics file into memory
+    errcode = openhydmap(&b, hydFile);
+
+    // Create the worker threads and their projects
+    if (!errcode)
+    {
+        if (nthreads <= 0) nthreads = workpool_cpucount();
+        nthreads = MIN(nthreads, b.nscenarios);
+        b.pool = workpool_create(nthreads);
+        if (b.pool == NULL) errcode = 101;
+    }
+    if (!errcode)
+    {
+        nthreads = workpool_size(b.pool);
+        b.workers = (EN_Project *)calloc(nthreads, sizeof(EN_Project));
+        if (b.workers == NULL) errcode = 101;
+        for (i = 0; i < nthreads && !errcode; i++)
+        {
+            if (EN_createproject(&b.workers[i]) != 0) errcode = 101;
+        }
+    }
+
+    // Clone the base project once before the workers start
+    // so that they only read from it
+    if (!errcode) errcode = cloneproject(pr, b.workers[0], NULL, "");
+
+    // Run the scenarios
+    if (!errcode) workpool_run(b.pool, b.nscenarios, runscenario, &b);
+    freeqbatch(&b);
+    return errcode;
+}
+
+int readinjections(Sqbatch *b, FILE *f, int *line)
+/*----------------------------------------------------------------
+**  Input:   f = scenario file
+**  Output:  line = number of last line read
+**           returns an error code
+**  Purpose: reads the injections made by each scenario.
+**----------------------------------------------------------------
+*/
+{
+    HashTable *names;
+    char s[MAXLINE + 1];
+    char comment[MAXMSG + 1];
+    char *tok[MAXTOKS];
+    int n, errcode = 0;
+
+    names = hashtable_create();
+    if (names == NULL) return 101;
+    while (fgets(s, MAXLINE, f) != NULL)
+    {
+        (*line)++;
+        n = gettokens(s, tok, MAXTOKS, comment);
+        if (n == 0) continue;
+        errcode = addinjection(b, names, tok, n);
+        if (errcode) break;
+    }
+    hashtable_free(names);
+    if (!errcode) errcode = sortinjections(b);
+    return errcode;
+}
+
+int addinjection(Sqbatch *b, HashTable *names, char **tok, int ntoks)
+/*----------------------------------------------------------------
+**  Input:   names = table of scenario names
+**           tok = tokens of a line of the scenario file
+**           ntoks = number of tokens
+**  Output:  returns an error code
+**  Purpose: adds the injection on a line of the scenario file to
+**           the list of injections.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &b->base->network;
+    Times *time = &b->base->times;
+    Sinjection c;
+    double start = 0.0, duration = -1.0;
+    int n;
+    void *p;
+
+    // Parse the node, source type, strength and timing of the injection
+    if (ntoks < 4 || strlen(tok[0]) > MAXID) return 266;
+    c.node = findnode(net, tok[1]);
+    if (c.node == 0) return 203;
+    c.type = findmatch(tok[2], SourceWords);
+    if (c.type < 0) return 266;
+    if (!getfloat(tok[3], &c.strength) || c.strength < 0.0) return 266;
+    if (ntoks > 4 && (start = hour(tok[4], "")) < 0.0) return 266;
+    if (ntoks > 5 && (duration = hour(tok[5], "")) < 0.0) return 266;
+    c.start = (long)(3600.0 * start + 0.5);
+    if (duration < 0.0) c.stop = time->Dur + 1;
+    else c.stop = c.start + (long)(3600.0 * duration + 0.5);
+
+    // Find the scenario the injection belongs to
+    c.scenario = hashtable_find(names, tok[0]) - 1;
+    if (c.scenario < 0)
+    {
+        n = b->nscenarios;
+        p = realloc(b->names, (n + 1) * sizeof(b->names[0]));
+        if (p == NULL) return 101;
+        b->names = p;
+        strncpy(b->names[n], tok[0], MAXID);
+        b->names[n][MAXID] = '\0';
+        if (!hashtable_insert(names, b->names[n], n + 1)) return 101;
+        c.scenario = n;
+        b->nscenarios++;
+    }
+
+    // Append the injection to the list of injections
+    n = b->ninjections;
+    p = realloc(b->injections, (n + 1) * sizeof(Sinjection));
+    if (p == NULL) return 101;
+    b->injections = p;
+    b->injections[n] = c;
+    b->ninjections++;
+    return 0;
+}
+
+int sortinjections(Sqbatch *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  returns an error code
+**  Purpose: groups the list of injections by scenario, keeping
+**           the order in which each scenario's injections were
+**           read.
+**----------------------------------------------------------------
+*/
+{
+    Sinjection *sorted;
+    int *next;
+    int i, k;
+
+    b->first = (int *)calloc(b->nscenarios + 1, sizeof(int));
+    next = (int *)calloc(b->nscenarios + 1, sizeof(int));
+    sorted = (Sinjection *)calloc(b->ninjections + 1, sizeof(Sinjection));
+    if (b->first == NULL || next == NULL || sorted == NULL)
+    {
+        free(next);
+        free(sorted);
+        return 101;
+    }
+
+    // Count the injections made by each scenario
+    for (i = 0; i < b->ninjections; i++)
+    {
+        b->first[b->injections[i].scenario + 1]++;
+    }
+    for (k = 0; k < b->nscenarios; k++) b->first[k + 1] += b->first[k];
+
+    // Place each scenario's injections after those of the previous one
+    memcpy(next, b->first, (b->nscenarios + 1) * sizeof(int));
+    for (i = 0; i < b->ninjections; i++)
+    {
+        k = b->injections[i].scenario;
+        sorted[next[k]++] = b->injections[i];
+    }
+    free(next);
+    free(b->injections);
+    b->injections = sorted;
+    return 0;
+}
+
+int openhydmap(Sqbatch *b, const char *hydFile)
+/*----------------------------------------------------------------
+**  Input:   hydFile = name of hydraulics file ("" to solve the
+**                     base project's hydraulics)
+**  Output:  returns an error code
+**  Purpose: maps a hydraulics file into memory and checks that
+**           it was saved for the base project's network.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &b->base->network;
+    INT4 hdr[8];
+    int errcode;
+
+    // Solve the base project's hydraulics on a clone of it,
+    // which saves them in memory or to a scratch hydraulics file
+    if (strlen(hydFile) == 0)
+    {
+        if (EN_createproject(&b->hydproject) != 0) return 101;
+        errcode = cloneproject(b->base, b->hydproject, NULL, "");
+        if (!errcode) errcode = EN_solveH(b->hydproject);
+        if (errcode > 100) return errcode;
+        hydFile = b->hydproject->outfile.HydFname;
+        if (b->hydproject->outfile.HydStore)
+        {
+            b->hyddata = b->hydproject->outfile.HydStore;
+            b->hydsize = b->hydproject->outfile.HydSize;
+        }
+    }
+
+    // Check the file's header (see openhydfile() in PROJECT.C)
+    if (b->hyddata == NULL)
+    {
+        errcode = maphydfile(b, hydFile);
+        if (errcode) return errcode;
+        b->hydmapped = TRUE;
+    }
+    if (b->hydsize < HYDHDRSIZE) return 306;
+    memcpy(hdr, b->hyddata, HYDHDRSIZE);
+    if (hdr[0] != MAGICNUMBER || hdr[1] != ENGINE_VERSION) return 306;
+    if (hdr[2] != net->Nnodes || hdr[3] != net->Nlinks ||
+        hdr[4] != net->Ntanks || hdr[5] != net->Npumps ||
+        hdr[6] != net->Nvalves || hdr[7] != b->base->times.Dur) return 306;
+    return 0;
+}
+
+int maphydfile(Sqbatch *b, const char *fname)
+/*----------------------------------------------------------------
+**  Input:   fname = name of hydraulics file
+**  Output:  returns an error code
+**  Purpose: maps the contents of a hydraulics file into memory
+**           for reading.
+**----------------------------------------------------------------
+*/
+{
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+
+    file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 305;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return 306;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return 307;
+
+    // The view keeps the file mapped after its handles are closed
+    b->hyddata = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (b->hyddata == NULL) return 307;
+    b->hydsize = (size_t)size.QuadPart;
+#else
+    int fd;
+    struct stat st;
+    void *data;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) return 305;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 306;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 307;
+    b->hyddata = (const char *)data;
+    b->hydsize = (size_t)st.st_size;
+#endif
+    return 0;
+}
+
+void unmaphydfile(Sqbatch *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: unmaps a hydraulics file from memory.
+**----------------------------------------------------------------
+*/
+{
+    if (b->hyddata == NULL || !b->hydmapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(b->hyddata);
+#else
+    munmap((void *)b->hyddata, b->hydsize);
+#endif
+    b->hyddata = NULL;
+    b->hydsize = 0;
+}
+
+void runscenario(void *data, int worker, int item)
+/*----------------------------------------------------------------
+**  Input:   data = water quality batch run data
+**           worker = index of worker thread
+**           item = index of scenario
+**  Output:  none
+**  Purpose: runs a scenario on a worker thread's project.
+**----------------------------------------------------------------
+*/
+{
+    Sqbatch *b = (Sqbatch *)data;
+    EN_Project p = b->workers[worker];
+    Ssummary s;
+
+    memset(&s, 0, sizeof(Ssummary));
+    s.errcode = EN_cloneproject(b->base, p, NULL, "");
+    if (!s.errcode) s.errcode = applyinjections(b, p, item);
+    if (!s.errcode) s.errcode = simulate(b, p, item, &s);
+
+    // Write the scenario's results to the summary file
+    workpool_lock(b->pool);
+    writeresults(b, item, &s);
+    workpool_unlock(b->pool);
+}
+
+int applyinjections(Sqbatch *b, EN_Project p, int scenario)
+/*----------------------------------------------------------------
+**  Input:   p = project to be changed
+**           scenario = index of scenario
+**  Output:  returns an error code
+**  Purpose: sets up a project to analyze a scenario's injections
+**           over the shared hydraulics file.
+**----------------------------------------------------------------
+*/
+{
+    Outfile *out = &p->outfile;
+    Sinjection *c;
+    int i, errcode = 0;
+
+    // Run a chemical analysis on the scenario's own thread, with a
+    // chemical that is absent from the network unless the project
+    // was already set up to analyze one
+    if (p->quality.Qualflag != CHEM)
+    {
+        errcode = EN_setqualtype(p, EN_CHEM, t_CHEMICAL, u_MGperL, "");
+        for (i = 1; i <= p->network.Nnodes && !errcode; i++)
+        {
+            errcode = EN_setnodevalue(p, i, EN_INITQUAL, 0.0);
+            if (!errcode && p->network.Node[i].S)
+            {
+                errcode = EN_setnodevalue(p, i, EN_SOURCEQUAL, 0.0);
+            }
+        }
+        if (errcode) return errcode;
+    }
+    p->hydraul.Threads = 1;
+
+    // Give each node injected into a source that is switched
+    // on and off over the course of the simulation
+    for (i = b->first[scenario]; i < b->first[scenario + 1]; i++)
+    {
+        c = &b->injections[i];
+        errcode = EN_setnodevalue(p, c->node, EN_SOURCETYPE, c->type);
+        if (!errcode) errcode = EN_setnodevalue(p, c->node, EN_SOURCEPAT, 0);
+        if (!errcode) errcode = EN_setnodevalue(p, c->node, EN_SOURCEQUAL, 0);
+        if (errcode) return errcode;
+    }
+
+    // Read hydraulics from the mapped file
+    out->HydData = b->hyddata;
+    out->HydSize = b->hydsize;
+    out->HydOffset = HYDHDRSIZE;
+    out->SaveHflag = TRUE;
+    return 0;
+}
+
+int simulate(Sqbatch *b, EN_Project p, int scenario, Ssummary *s)
+/*----------------------------------------------------------------
+**  Input:   p = project to be analyzed
+**           scenario = index of scenario
+**  Output:  s = summary of water quality results
+**           returns an error or warning code
+**  Purpose: runs a water quality simulation, keeping track of the
+**           nodes reached by the injected chemical and its highest
+**           concentration.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &p->network;
+    int i, errcode, warning = 0;
+    long t, tleft = 0;
+    double c, ctol;
+    char *reached;
+
+    reached = (char *)calloc(net->Nnodes + 1, sizeof(char));
+    if (reached == NULL) return 101;
+    ctol = p->quality.Ctol * p->Ucf[QUALITY];
+    s->peakqual = -1.0;
+    errcode = EN_openQ(p);
+    if (!errcode) errcode = EN_initQ(p, EN_NOSAVE);
+    if (errcode > 100)
+    {
+        free(reached);
+        return errcode;
+    }
+    do
+    {
+        errcode = EN_runQ(p, &t);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+        for (i = 1; i <= net->Nnodes; i++)
+        {
+            EN_getnodevalue(p, i, EN_QUALITY, &c);
+            if (c > ctol && !reached[i])
+            {
+                reached[i] = 1;
+                s->nreached++;
+            }
+            if (c <= s->peakqual) continue;
+            s->peakqual = c;
+            s->peaknode = i;
+            s->peaktime = t;
+        }
+        setinjections(b, p, scenario, t);
+        errcode = EN_stepQ(p, &tleft);
+        if (errcode > 100) break;
+        if (errcode > 0) warning = errcode;
+    } while (tleft > 0);
+    EN_closeQ(p);
+    free(reached);
+    return (errcode > 100) ? errcode : warning;
+}
+
+void setinjections(Sqbatch *b, EN_Project p, int scenario, long t)
+/*----------------------------------------------------------------
+**  Input:   p = project being analyzed
+**           scenario = index of scenario
+**           t = current simulation time (sec)
+**  Output:  none
+**  Purpose: sets the strength of the sources of a scenario's
+**           injections over the next water quality time step.
+**----------------------------------------------------------------
+*/
+{
+    Snode *node = p->network.Node;
+    Sinjection *c;
+    int i;
+
+    for (i = b->first[scenario]; i < b->first[scenario + 1]; i++)
+    {
+        node[b->injections[i].node].S->C0 = 0.0;
+    }
+    for (i = b->first[scenario]; i < b->first[scenario + 1]; i++)
+    {
+        c = &b->injections[i];
+        if (t >= c->start && t < c->stop) node[c->node].S->C0 += c->strength;
+    }
+}
+
+void writeresults(Sqbatch *b, int scenario, Ssummary *s)
+/*----------------------------------------------------------------
+**  Input:   scenario = index of scenario (-1 for heading)
+**           s = scenario's results
+**  Output:  none
+**  Purpose: writes a scenario's results to the summary file.
+**----------------------------------------------------------------
+*/
+{
+    Project *pr = b->base;
+    Network *net = &pr->network;
+    FILE *f = b->sumfile;
+    char atime[13];
+
+    if (scenario < 0)
+    {
+        fprintf(f, "%-*s %5s %8s %14s %-*s %10s\n",
+                MAXID, "Scenario", "Code", "Nodes", "Peak Quality",
+                MAXID, "Node", "Time");
+        fprintf(f, "%-*s %5s %8s %14s %-*s %10s\n", MAXID, "", "",
+                "Reached", b->units, MAXID, "", "hrs:min:sec");
+    }
+    else if (s->errcode > 100 || s->peaknode == 0)
+    {
+        fprintf(f, "%-*s %5d\n", MAXID, b->names[scenario], s->errcode);
+    }
+    else
+    {
+        fprintf(f, "%-*s %5d %8d %14.*f %-*s %10s\n",
+                MAXID, b->names[scenario], s->errcode, s->nreached,
+                pr->report.Field[QUALITY].Precision, s->peakqual,
+                MAXID, net->Node[s->peaknode].ID,
+                clocktime(atime, s->peaktime));
+    }
+    fflush(f);
+}
+
+void freeqbatch(Sqbatch *b)
+/*----------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees the memory and files used by a water quality
+**           batch run.
+**----------------------------------------------------------------
+*/
+{
+    int i;
+
+    if (b->workers)
+    {
+        for (i = 0; i < workpool_size(b->pool); i++)
+        {
+            if (b->workers[i]) EN_deleteproject(b->workers[i]);
+        }
+        free(b->workers);
+    }
+    workpool_delete(b->pool);
+    unmaphydfile(b);
+    if (b->hydproject) EN_deleteproject(b->hydproject);
+    if (b->sumfile && b->sumfile != stdout) fclose(b->sumfile);
+    free(b->names);
+    free(b->injections);
+    free(b->first);
+}
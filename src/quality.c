@@ -7,7 +7,7 @@ Description:  implements EPANET's water quality engine
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 02/14/2025
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -16,9 +16,9 @@ Last Updated: 02/14/2025
 #include <string.h>
 #include <math.h>
 
-#include "mempool.h"
 #include "types.h"
 #include "funcs.h"
+#include "workpool.h"
 
 // Stagnant flow tolerance
 const double Q_STAGNANT = 0.005 / GPMperCFS;     // 0.005 gpm = 1.114e-5 cfs
@@ -28,11 +28,15 @@ double  findsourcequal(Project *, int, double, long);
 
 // Imported functions
 extern char    setreactflag(Project *);
+extern int     setreactkernel(Project *);
 extern double  getucf(double);
 extern void    ratecoeffs(Project *);
+extern double  reacttime(Project *, double);
 extern void    initsegs(Project *);
 extern void    reversesegs(Project *, int);
-extern int     sortnodes(Project *);
+extern int     resortnodes(Project *);
+extern int     gridpipes(Project *);
+extern double  traveltime(Project *);
 extern void    transport(Project *, long);
 
 // Local functions
@@ -40,6 +44,7 @@ static double  sourcequal(Project *, Psource);
 static void    evalmassbalance(Project *);
 static double  findstoredmass(Project *);
 static int     flowdirchanged(Project *);
+static long    qualstep(Project *);
 
 
 int openqual(Project *pr)
@@ -55,7 +60,12 @@ int openqual(Project *pr)
     Quality *qual = &pr->quality;
 
     int errcode = 0;
-    int n;
+    int i, n, nc, nthreads;
+
+    // Make own copies of network data shared with
+    // other projects that is written to (see CLONE.C)
+    errcode = unsharequal(pr);
+    if (errcode) return errcode;
 
     // Return if no quality analysis requested
     if (qual->Qualflag == NONE) return errcode;
@@ -75,29 +85,91 @@ int openqual(Project *pr)
         if (errcode = unlinked(pr)) return errcode;
     }
 
-    // Create a memory pool for water quality segments
     qual->OutOfMemory = FALSE;
-    qual->SegPool = mempool_create();
-    if (qual->SegPool == NULL) errcode = 101;
 
     // Allocate arrays for link flow direction & reaction rates
     n = net->Nlinks + 1;
     qual->FlowDir = (FlowDirection *)calloc(n, sizeof(FlowDirection));
     qual->PipeRateCoeff = (double *)calloc(n, sizeof(double));
 
-    // Allocate arrays used for volume segments in links & tanks
+    // Allocate a ring of volume segments for each link & tank
+    // and an arena to hold the rings
     n = net->Nlinks + net->Ntanks + 1;
-    qual->FirstSeg = (Pseg *)calloc(n, sizeof(Pseg));
-    qual->LastSeg = (Pseg *)calloc(n, sizeof(Pseg));
+    qual->SegRing = (Sring *)calloc(n, sizeof(Sring));
+    qual->SegCapacity = 8 * n;
+    qual->SegTop = 0;
+    qual->Segs = (Pseg)calloc(qual->SegCapacity, sizeof(struct Sseg));
+
+    // Allocate the segment quality of each constituent (one array
+    // per constituent) and the node quality of each additional one
+    nc = qual->Nconstits + 1;
+    qual->SegQual[0] = (double *)calloc((size_t)nc * qual->SegCapacity,
+                                        sizeof(double));
+    ERRCODE(MEMCHECK(qual->SegQual[0]));
+    qual->ConstitQual[0] = qual->NodeQual;
+    if (qual->Nconstits > 0)
+    {
+        qual->ConstitQual[1] = (double *)calloc((size_t)qual->Nconstits *
+                               (net->Nnodes + 1), sizeof(double));
+        ERRCODE(MEMCHECK(qual->ConstitQual[1]));
+    }
+    if (!errcode) for (i = 1; i < nc; i++)
+    {
+        qual->SegQual[i] = qual->SegQual[0] + (size_t)i * qual->SegCapacity;
+        qual->ConstitQual[i] = qual->ConstitQual[1] +
+                               (size_t)(i - 1) * (net->Nnodes + 1);
+    }
+
+    // Allocate the quality of each constituent entering each pipe
+    // (used by the Eulerian transport method)
+    qual->InletQual = (double *)calloc((size_t)nc * (net->Nlinks + 1),
+                                       sizeof(double));
 
-    // Allocate memory for topologically sorted nodes
+    // Allocate memory for topologically sorted nodes, their
+    // positions and the work space used to sort them
     qual->SortedNodes = (int *)calloc(n, sizeof(int));
+    qual->NewFlows = (int *)calloc(net->Nlinks + 1, sizeof(int));
+    qual->SortPos = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    qual->SortMark = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    qual->SortWork = (int *)calloc(4 * (net->Nnodes + 1), sizeof(int));
+
+    // Allocate memory for the mass carried through each node
+    qual->NodeMass = (SnodeMass *)calloc(net->Nnodes + 1, sizeof(SnodeMass));
 
     ERRCODE(MEMCHECK(qual->FlowDir));
     ERRCODE(MEMCHECK(qual->PipeRateCoeff));
-    ERRCODE(MEMCHECK(qual->FirstSeg));
-    ERRCODE(MEMCHECK(qual->LastSeg));
+    ERRCODE(MEMCHECK(qual->SegRing));
+    ERRCODE(MEMCHECK(qual->Segs));
+    ERRCODE(MEMCHECK(qual->InletQual));
     ERRCODE(MEMCHECK(qual->SortedNodes));
+    ERRCODE(MEMCHECK(qual->NewFlows));
+    ERRCODE(MEMCHECK(qual->SortPos));
+    ERRCODE(MEMCHECK(qual->SortMark));
+    ERRCODE(MEMCHECK(qual->SortWork));
+    ERRCODE(MEMCHECK(qual->NodeMass));
+
+    // Unless the Threads option is 1, create a pool of worker
+    // threads that route flow through levels of sorted nodes
+    qual->Nstages = 0;
+    if (!errcode && pr->hydraul.Threads != 1)
+    {
+        n = net->Nnodes + 2;
+        qual->StageNodes = (int *)calloc(n, sizeof(int));
+        qual->StageStart = (int *)calloc(n, sizeof(int));
+        qual->StageShared = (int *)calloc(n, sizeof(int));
+        qual->NodeLevel = (int *)calloc(n, sizeof(int));
+        ERRCODE(MEMCHECK(qual->StageNodes));
+        ERRCODE(MEMCHECK(qual->StageStart));
+        ERRCODE(MEMCHECK(qual->StageShared));
+        ERRCODE(MEMCHECK(qual->NodeLevel));
+        if (!errcode)
+        {
+            nthreads = pr->hydraul.Threads;
+            if (nthreads <= 0) nthreads = workpool_cpucount();
+            qual->Pool = workpool_create(nthreads);
+            if (qual->Pool == NULL) errcode = 101;
+        }
+    }
     return errcode;
 }
 
@@ -116,18 +188,21 @@ int initqual(Project *pr)
     Quality *qual = &pr->quality;
     Times   *time = &pr->times;
 
-    int i;
+    int i, j;
     int errcode = 0;
+    Sconstit *constit;
 
     // Re-position hydraulics file
     if (!hyd->OpenHflag)
     {
-        fseek(pr->outfile.HydFile, pr->outfile.HydOffset, SEEK_SET);
+        if (pr->outfile.HydData) pr->outfile.HydPos = pr->outfile.HydOffset;
+        else fseek(pr->outfile.HydFile, pr->outfile.HydOffset, SEEK_SET);
     }
 
     // Set elapsed times to zero
     time->Qtime = 0;
     time->Htime = 0;
+    time->Qualstep = time->Qstep;
     time->Rtime = time->Rstart;
     pr->report.Nperiods = 0;
 
@@ -149,6 +224,21 @@ int initqual(Project *pr)
     // Initialize quality at trace node (if applicable)
     if (qual->Qualflag == TRACE) qual->NodeQual[qual->TraceNode] = 100.0;
 
+    // Initialize quality of additional constituents (ages start at
+    // 0 and traced flow at 0% except at the source node), whose
+    // tolerance is in reported units
+    constit = &qual->Constit[0];
+    constit->Type = qual->Qualflag;
+    constit->Node = qual->TraceNode;
+    constit->Ctol = qual->Ctol;
+    for (j = 1; j <= qual->Nconstits; j++)
+    {
+        constit = &qual->Constit[j];
+        constit->Ctol = qual->Ctol * pr->Ucf[QUALITY];
+        for (i = 1; i <= net->Nnodes; i++) qual->ConstitQual[j][i] = 0.0;
+        if (constit->Type == TRACE) qual->ConstitQual[j][constit->Node] = 100.0;
+    }
+
     // Compute Schmidt number
     if (qual->Diffus > 0.0) qual->Sc = hyd->Viscos / qual->Diffus;
     else                    qual->Sc = 0.0;
@@ -159,16 +249,23 @@ int initqual(Project *pr)
 
     // Check if modeling a reactive substance
     qual->Reactflag = setreactflag(pr);
+    qual->ReactKernel = setreactkernel(pr);
 
-    // Reset memory pool used for pipe & tank segments
-    qual->FreeSeg = NULL;
-    mempool_reset(qual->SegPool);
-
-    // Create initial set of pipe & tank segments
+    // Create initial set of pipe & tank segments (a change of
+    // transport method takes effect here)
+    qual->Eulerflag = (qual->Transport == EULERIAN);
+    qual->Nstages = 0;
     initsegs(pr);
 
-    // Initialize link flow direction indicator
+    // Initialize link flow direction indicator (the nodes get
+    // fully sorted once flows are known)
     for (i = 1; i <= net->Nlinks; i++) qual->FlowDir[i] = ZERO_FLOW;
+    qual->Sortedflag = FALSE;
+    qual->Nfullsorts = 0;
+    qual->Nlocalsorts = 0;
+    qual->Nqualsteps = 0;
+    qual->Peaksegs = 0;
+    qual->MergeError = 0.0;
 
     // Initialize avg. reaction rates
     qual->Wbulk = 0.0;
@@ -239,11 +336,24 @@ int runqual(Project *pr, long *t)
             // ... compute reaction rate coeffs.
             if (qual->Reactflag && qual->Qualflag != AGE) ratecoeffs(pr);
 
-            // ... topologically sort network nodes if flow directions change
+            // ... re-sort network nodes if flow directions change
             if (flowdirchanged(pr) == TRUE)
             {
-                errcode = sortnodes(pr);
+                errcode = resortnodes(pr);
             }
+
+            // ... divide pipes that carry flow for the first time
+            //     into cells for Eulerian transport
+            if (!errcode && qual->Eulerflag && !gridpipes(pr))
+            {
+                errcode = 101;
+            }
+
+            // ... nodes must be re-grouped into stages for the new flows
+            qual->Nstages = 0;
+
+            // ... choose the quality time step for the new flows
+            time->Qualstep = qualstep(pr);
         }
         if (!hyd->OpenHflag) time->Htime = hydtime + hydstep;
     }
@@ -281,7 +391,7 @@ int nextqual(Project *pr, long *tstep)
         qtime = 0;
         while (!qual->OutOfMemory && qtime < hydstep)
         {
-            dt = MIN(time->Qstep, hydstep - qtime);
+            dt = MIN(time->Qualstep, hydstep - qtime);
             qtime += dt;
             transport(pr, dt);
         }
@@ -328,7 +438,7 @@ int stepqual(Project *pr, long *tleft)
     long dt, hstep, t, tstep;
     int errcode = 0;
 
-    tstep = time->Qstep;
+    tstep = time->Qualstep;
     do
     {
         // Set local time step to quality time step
@@ -362,8 +472,10 @@ int stepqual(Project *pr, long *tleft)
             time->Qtime += dt;
         }
 
-        // Reduce quality time step by local time step
+        // Reduce quality time step by local time step (keeping
+        // within the step chosen for any new hydraulic period)
         tstep -= dt;
+        tstep = MIN(tstep, time->Qualstep);
         if (qual->OutOfMemory) errcode = 101;
 
     } while (!errcode && tstep > 0);
@@ -404,44 +516,63 @@ int closequal(Project *pr)
 
     if (qual->Qualflag != NONE)
     {
-        if (qual->SegPool) mempool_delete(qual->SegPool);
-        FREE(qual->FirstSeg);
-        FREE(qual->LastSeg);
+        FREE(qual->Segs);
+        FREE(qual->SegQual[0]);
+        if (qual->Nconstits > 0) FREE(qual->ConstitQual[1]);
+        memset(qual->SegQual, 0, sizeof(qual->SegQual));
+        memset(qual->ConstitQual, 0, sizeof(qual->ConstitQual));
+        FREE(qual->SegRing);
+        FREE(qual->NodeMass);
+        FREE(qual->StageNodes);
+        FREE(qual->StageStart);
+        FREE(qual->StageShared);
+        FREE(qual->NodeLevel);
+        workpool_delete(qual->Pool);
+        qual->Pool = NULL;
         FREE(qual->PipeRateCoeff);
         FREE(qual->FlowDir);
+        FREE(qual->InletQual);
         FREE(qual->SortedNodes);
+        FREE(qual->NewFlows);
+        FREE(qual->SortPos);
+        FREE(qual->SortMark);
+        FREE(qual->SortWork);
     }
     freeadjlists(&pr->network);
     return errcode;
 }
 
 
-double avgqual(Project *pr, int k)
+double avgqual(Project *pr, int i, int k)
 /*
 **--------------------------------------------------------------
-**   Input:   k = link index
+**   Input:   i = constituent index (0 for the QUALITY option's)
+**            k = link index
 **   Output:  returns quality concentration
-**   Purpose: computes current average quality in link k
+**   Purpose: computes current average quality of constituent i
+**            in link k
 **--------------------------------------------------------------
 */
 {
     Network  *net = &pr->network;
     Quality  *qual = &pr->quality;
 
-    double vsum = 0.0, msum = 0.0;
+    int j;
+    double vsum = 0.0, msum = 0.0, *nodequal;
     Pseg seg;
+    Sring *ring;
 
     if (qual->Qualflag == NONE) return 0.0;
 
     // Sum up the quality and volume in each segment of the link
-    if (qual->FirstSeg != NULL)
+    if (qual->SegRing != NULL)
     {
-        seg = qual->FirstSeg[k];
-        while (seg != NULL)
+        ring = &qual->SegRing[k];
+        for (j = 0; j < ring->count; j++)
         {
+            seg = SEGMENT(qual, ring, j);
             vsum += seg->v;
-            msum += (seg->c) * (seg->v);
-            seg = seg->prev;
+            msum += SEGQUAL(qual, i, seg) * (seg->v);
         }
     }
 
@@ -451,8 +582,9 @@ double avgqual(Project *pr, int k)
     // Otherwise use the average quality of the link's end nodes
     else
     {
-        return ((qual->NodeQual[net->Link[k].N1] +
-            qual->NodeQual[net->Link[k].N2]) / 2.);
+        nodequal = (i == 0) ? qual->NodeQual : qual->ConstitQual[i];
+        return ((nodequal[net->Link[k].N1] +
+            nodequal[net->Link[k].N2]) / 2.);
     }
 }
 
@@ -528,10 +660,10 @@ double findsourcequal(Project *pr, int n, double volout, long tstep)
     // Update source's total mass added
     source->Smass += massadded;
 
-    // Update Wsource
+    // Update Wsource (via the mass carried through the node)
     if (time->Htime >= time->Rstart)
     {
-        qual->Wsource += massadded;
+        qual->NodeMass[n].source += massadded;
     }
     return c;
 }
@@ -614,19 +746,20 @@ double  findstoredmass(Project *pr)
     Network  *net = &pr->network;
     Quality  *qual = &pr->quality;
 
-    int    i, k;
+    int    i, j, k;
     double totalmass = 0.0;
     Pseg   seg;
+    Sring  *ring;
 
     // Mass residing in each pipe
     for (k = 1; k <= net->Nlinks; k++)
     {
         // Sum up the quality and volume in each segment of the link
-        seg = qual->FirstSeg[k];
-        while (seg != NULL)
+        ring = &qual->SegRing[k];
+        for (j = 0; j < ring->count; j++)
         {
-            totalmass += (seg->c) * (seg->v);
-            seg = seg->prev;
+            seg = SEGMENT(qual, ring, j);
+            totalmass += SEGQUAL(qual, 0, seg) * (seg->v);
         }
     }
 
@@ -639,12 +772,11 @@ double  findstoredmass(Project *pr)
         // ... add up mass in each volume segment
         else
         {
-            k = net->Nlinks + i;
-            seg = qual->FirstSeg[k];
-            while (seg != NULL)
+            ring = &qual->SegRing[net->Nlinks + i];
+            for (j = 0; j < ring->count; j++)
             {
-                totalmass += seg->c * seg->v;
-                seg = seg->prev;
+                seg = SEGMENT(qual, ring, j);
+                totalmass += SEGQUAL(qual, 0, seg) * seg->v;
             }
         }
     }
@@ -657,6 +789,8 @@ int flowdirchanged(Project *pr)
 **   Input:   none
 **   Output:  returns TRUE if flow direction changes in any link
 **   Purpose: finds new flow directions for each network link.
+**   Note:    links whose flow takes a new (non-negligible)
+**            direction are listed in NewFlows for resortnodes().
 **--------------------------------------------------------------
 */
 {
@@ -670,6 +804,7 @@ int flowdirchanged(Project *pr)
     double q;
 
     // Examine each network link
+    qual->Nnewflows = 0;
     for (k = 1; k <= pr->network.Nlinks; k++)
     {
         // Determine sign (+1 or -1) of new flow rate
@@ -686,10 +821,57 @@ int flowdirchanged(Project *pr)
         // If flow direction changes either sign or magnitude then set
         // result to true (e.g., if a link's positive flow becomes
         // negligible then the network still needs to be re-sorted)
-        if (newdir != olddir) result = TRUE;
+        if (newdir != olddir)
+        {
+            result = TRUE;
+            if (newdir != 0) qual->NewFlows[qual->Nnewflows++] = k;
+        }
 
         // ... replace old flow direction with the new direction
         qual->FlowDir[k] = newdir;
     }
     return result;
 }
+
+
+long qualstep(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns time step (sec) for routing quality under
+**            the current hydraulics
+**   Purpose: chooses the largest multiple of the quality time
+**            step that keeps both the mean Courant number of the
+**            pipes and the change made by reactions over a step
+**            within the COURANT option.
+**   Note:    the quality time step is used as is when the
+**            COURANT option is 0.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+    Times   *time = &pr->times;
+
+    int i;
+    long dt;
+    double t, c = 0.0;
+
+    if (qual->Courant <= 0.0) return time->Qstep;
+
+    // Find the time for flow to pass through the pipes and for
+    // reactions to use up the highest quality found at the nodes
+    t = traveltime(pr);
+    if (qual->Reactflag)
+    {
+        for (i = 1; i <= net->Nnodes; i++) c = MAX(c, qual->NodeQual[i]);
+        c = MAX(c, qual->Climit);
+        t = MIN(t, reacttime(pr, c));
+    }
+
+    // Take whole multiples of the quality time step within that
+    // fraction of the time
+    t = MIN(qual->Courant * t, (double)time->Dur);
+    dt = (long)(t / time->Qstep) * time->Qstep;
+    return MAX(dt, time->Qstep);
+}
@@ -7,7 +7,7 @@ Description:  computes water quality reactions within pipes and tanks
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 12/16/2024
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
@@ -18,27 +18,35 @@ Last Updated: 12/16/2024
 
 // Exported functions
 char    setreactflag(Project *);
+int     setreactkernel(Project *);
 double  getucf(double);
 void    ratecoeffs(Project *);
+double  reacttime(Project *, double);
 void    reactpipes(Project *, long);
 void    reacttanks(Project *, long);
-double  mixtank(Project *, int, double, double ,double);
+void    ageconstits(Project *, long);
+void    mixtank(Project *, int, double, double *, double);
 
 // Imported functions
-extern  void addseg(Project *, int, double, double);
+extern  void addseg(Project *, int, double, double *);
+extern  int  samequal(Project *, Pseg, double *);
 extern  void reversesegs(Project *, int);
+extern  void removeseg(Project *, int);
 
 // Local functions
 static double  piperate(Project *, int);
+static int     ringstart(Sring *);
+static void    agepipe(Project *, int, long);
+static int     decaypipe(Project *, int, long);
 static double  pipereact(Project *, int, double, double, long);
 static double  tankreact(Project *, double, double, double, long);
 static double  bulkrate(Project *, double, double, double);
 static double  wallrate(Project *, double, double, double, double);
 
-static void    tankmix1(Project *, int, double, double, double);
-static void    tankmix2(Project *, int, double, double, double);
-static void    tankmix3(Project *, int, double, double, double);
-static void    tankmix4(Project *, int, double, double, double);
+static void    tankmix1(Project *, int, double, double *, double, double *);
+static void    tankmix2(Project *, int, double, double *, double, double *);
+static void    tankmix3(Project *, int, double, double *, double, double *);
+static void    tankmix4(Project *, int, double, double *, double, double *);
 
 
 char setreactflag(Project *pr)
@@ -73,6 +81,26 @@ char setreactflag(Project *pr)
 }
 
 
+int setreactkernel(Project *pr)
+/*
+**-----------------------------------------------------------
+**   Input:   none
+**   Output:  returns the kernel used to react pipe segments
+**            (see ReactKernelType)
+**   Purpose: chooses a specialized pipe reaction kernel for
+**            the reaction kinetics being modeled
+**-----------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+
+    if (qual->Qualflag == AGE) return AGING;
+    if (qual->BulkOrder == 1.0 && qual->WallOrder == 1.0 &&
+        qual->Climit == 0.0) return FIRST_ORDER;
+    return ANY_ORDER;
+}
+
+
 double getucf(double order)
 /*
 **--------------------------------------------------------------
@@ -114,6 +142,53 @@ void ratecoeffs(Project *pr)
 }
 
 
+double reacttime(Project *pr, double c)
+/*
+**--------------------------------------------------------------
+**   Input:   c = reference concentration (mass/ft3)
+**   Output:  returns shortest reaction time (sec)
+**   Purpose: finds the shortest time over which the reactions
+**            stepped explicitly in time would use up (or add)
+**            a concentration of c in any pipe or tank.
+**   Note:    pipes are skipped when reacted with the exact
+**            first-order kernel. BIG is returned if no such
+**            reactions occur.
+**--------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Quality  *qual = &pr->quality;
+
+    int i, k;
+    double r, rmax = 0.0;
+
+    if (qual->Qualflag != CHEM || c <= 0.0) return BIG;
+
+    // Fastest rate of pipe reactions
+    if (qual->ReactKernel != FIRST_ORDER)
+    {
+        for (k = 1; k <= net->Nlinks; k++)
+        {
+            if (net->Link[k].Type > PIPE) continue;
+            r = bulkrate(pr, c, net->Link[k].Kb, qual->BulkOrder) * qual->Bucf +
+                wallrate(pr, c, net->Link[k].Diam, net->Link[k].Kw,
+                         net->Link[k].Rc);
+            rmax = MAX(rmax, fabs(r));
+        }
+    }
+
+    // Fastest rate of tank reactions
+    for (i = 1; i <= net->Ntanks; i++)
+    {
+        if (net->Tank[i].A == 0.0) continue;
+        r = bulkrate(pr, c, net->Tank[i].Kb, qual->TankOrder) * qual->Tucf;
+        rmax = MAX(rmax, fabs(r));
+    }
+    if (rmax <= 0.0) return BIG;
+    return c / rmax;
+}
+
+
 void reactpipes(Project *pr, long dt)
 /*
 **--------------------------------------------------------------
@@ -126,36 +201,46 @@ void reactpipes(Project *pr, long dt)
     Network  *net = &pr->network;
     Quality  *qual = &pr->quality;
 
-    int k;
+    int i, k;
     Pseg seg;
-    double cseg, rsum, vsum;
+    Sring *ring;
+    double cseg, rsum, vsum, *c;
 
     // Examine each link in network
     for (k = 1; k <= net->Nlinks; k++)
     {
         // Skip non-pipe links (pumps & valves)
         if (net->Link[k].Type != PIPE) continue;
+
+        // Use a specialized kernel for water age and 1st-order kinetics
+        if (qual->ReactKernel == AGING)
+        {
+            agepipe(pr, k, dt);
+            continue;
+        }
+        if (qual->ReactKernel == FIRST_ORDER && decaypipe(pr, k, dt)) continue;
         rsum = 0.0;
         vsum = 0.0;
 
         // Examine each segment of the pipe
-        seg = qual->FirstSeg[k];
-        while (seg != NULL)
+        ring = &qual->SegRing[k];
+        for (i = 0; i < ring->count; i++)
         {
             // React segment over time dt
-            cseg = seg->c;
-            seg->c = pipereact(pr, k, seg->c, seg->v, dt);
+            seg = SEGMENT(qual, ring, i);
+            c = &SEGQUAL(qual, 0, seg);
+            cseg = *c;
+            *c = pipereact(pr, k, *c, seg->v, dt);
 
             // Update reaction component of mass balance
-            qual->MassBalance.reacted += (cseg - seg->c) * seg->v;
+            qual->MassBalance.reacted += (cseg - *c) * seg->v;
 
             // Accumulate volume-weighted reaction rate
             if (qual->Qualflag == CHEM)
             {
-                rsum += fabs(seg->c - cseg) * seg->v;
+                rsum += fabs(*c - cseg) * seg->v;
                 vsum += seg->v;
             }
-            seg = seg->prev;
         }
 
         // Normalize volume-weighted reaction rate
@@ -165,6 +250,121 @@ void reactpipes(Project *pr, long dt)
 }
 
 
+int ringstart(Sring *ring)
+/*
+**--------------------------------------------------------------
+**   Input:   ring = a pipe's ring of segments
+**   Output:  returns buffer position of the ring's segment that
+**            lies lowest in the segment arena
+**   Purpose: locates the start of the contiguous span(s) of the
+**            arena that hold a pipe's segments.
+**--------------------------------------------------------------
+*/
+{
+    int p = ring->head;
+    if (ring->dir < 0) p -= ring->count - 1;
+    return p & (ring->size - 1);
+}
+
+
+void agepipe(Project *pr, int k, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   k = link index
+**            dt = time step
+**   Output:  none
+**   Purpose: ages the water in each segment of pipe k over a
+**            time step.
+**--------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+
+    int i, j, n, p;
+    double age = (double)dt / 3600.0, vsum = 0.0, *c;
+    Pseg seg;
+    Sring *ring = &qual->SegRing[k];
+
+    // Sweep each contiguous span of the pipe's segments
+    p = ringstart(ring);
+    for (i = 0; i < ring->count; i += n, p = 0)
+    {
+        n = MIN(ring->count - i, ring->size - p);
+        seg = qual->Segs + ring->base + p;
+        c = &SEGQUAL(qual, 0, seg);
+        for (j = 0; j < n; j++) vsum += seg[j].v;
+        for (j = 0; j < n; j++) c[j] += age;
+    }
+    qual->MassBalance.reacted -= age * vsum;
+    qual->PipeRateCoeff[k] = 0.0;
+}
+
+
+int decaypipe(Project *pr, int k, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   k = link index
+**            dt = time step
+**   Output:  returns FALSE if pipe k can't use this kernel
+**   Purpose: reacts the water in each segment of pipe k over a
+**            time step under 1st-order bulk & wall kinetics.
+**   Note:    each segment's quality c changes by c*fb from bulk
+**            and c*fw from wall reaction, so the pipe's factor
+**            1 + fb + fw is applied to all of its segments and
+**            the mass reacted follows from the pipe's mass.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, j, n, p;
+    double fb, fw, f, m = 0.0, vsum = 0.0, *c;
+    Pseg seg;
+    Slink *link = &net->Link[k];
+    Sring *ring = &qual->SegRing[k];
+
+    // Find the pipe's bulk & wall decay over the time step
+    fb = link->Kb * qual->Bucf * (double)dt;
+    if (link->Kw == 0.0 || link->Diam == 0.0) fw = 0.0;
+    else fw = link->Rc * (double)dt;
+    f = 1.0 + fb + fw;
+
+    // A factor below 0 would need each segment clipped at 0
+    if (f < 0.0) return FALSE;
+
+    // Sweep each contiguous span of the pipe's segments
+    p = ringstart(ring);
+    for (i = 0; i < ring->count; i += n, p = 0)
+    {
+        n = MIN(ring->count - i, ring->size - p);
+        seg = qual->Segs + ring->base + p;
+        c = &SEGQUAL(qual, 0, seg);
+        for (j = 0; j < n; j++)
+        {
+            m += c[j] * seg[j].v;
+            vsum += seg[j].v;
+        }
+        for (j = 0; j < n; j++) c[j] *= f;
+    }
+
+    // Update mass balance, cumulative mass reacted & the
+    // volume-weighted reaction rate
+    qual->MassBalance.reacted -= (fb + fw) * m;
+    if (pr->times.Htime >= pr->times.Rstart)
+    {
+        qual->Wbulk += fabs(fb) * m;
+        qual->Wwall += fabs(fw) * m;
+    }
+    if (vsum > 0.0)
+    {
+        qual->PipeRateCoeff[k] = fabs(fb + fw) * m / vsum / dt * SECperDAY;
+    }
+    else qual->PipeRateCoeff[k] = 0.0;
+    return TRUE;
+}
+
+
 void  reacttanks(Project *pr, long dt)
 /*
 **--------------------------------------------------------------
@@ -177,9 +377,10 @@ void  reacttanks(Project *pr, long dt)
     Network  *net = &pr->network;
     Quality  *qual = &pr->quality;
 
-    int i, k;
-    double c;
+    int i, j, k;
+    double c, *cseg;
     Pseg seg;
+    Sring *ring;
     Stank *tank;
 
     // Examine each tank in network
@@ -193,18 +394,46 @@ void  reacttanks(Project *pr, long dt)
         k = net->Nlinks + i;
 
         // React each volume segment in the chain
-        seg = qual->FirstSeg[k];
-        while (seg != NULL)
+        ring = &qual->SegRing[k];
+        for (j = 0; j < ring->count; j++)
         {
-            c = seg->c;
-            seg->c = tankreact(pr, seg->c, seg->v, tank->Kb, dt);
-            qual->MassBalance.reacted += (c - seg->c) * seg->v;
-            seg = seg->prev;
+            seg = SEGMENT(qual, ring, j);
+            cseg = &SEGQUAL(qual, 0, seg);
+            c = *cseg;
+            *cseg = tankreact(pr, *cseg, seg->v, tank->Kb, dt);
+            qual->MassBalance.reacted += (c - *cseg) * seg->v;
         }
     }
 }
 
 
+void ageconstits(Project *pr, long dt)
+/*
+**--------------------------------------------------------------
+**   Input:   dt = time step
+**   Output:  none
+**   Purpose: ages the water held in every pipe and tank segment
+**            for each additional water age constituent.
+**   Note:    the whole arena is aged in one pass over each
+**            constituent's contiguous array of segment qualities
+**            (positions not holding a segment are never read).
+**--------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+
+    int i, p;
+    double age = (double)dt / 3600.0, *c;
+
+    for (i = 1; i <= qual->Nconstits; i++)
+    {
+        if (qual->Constit[i].Type != AGE) continue;
+        c = qual->SegQual[i];
+        for (p = 0; p < qual->SegTop; p++) c[p] += age;
+    }
+}
+
+
 double piperate(Project *pr, int k)
 /*
 **--------------------------------------------------------------
@@ -434,43 +663,50 @@ double wallrate(Project *pr, double c, double d, double kw, double kf)
 }
 
 
-double mixtank(Project *pr, int n, double volin, double massin, double volout)
+void mixtank(Project *pr, int n, double volin, double *massin, double volout)
 /*
 **------------------------------------------------------------
 **   Input:   n      = node index
 **            volin  = inflow volume to tank over time step
-**            massin = mass inflow to tank over time step
+**            massin = mass inflow of each constituent to tank
+**                     over time step
 **            volout = outflow volume from tank over time step
-**   Output:  returns new quality for tank
-**   Purpose: mixes inflow with tank's contents to update its quality.
+**   Output:  none
+**   Purpose: mixes inflow with tank's contents to update the
+**            quality of each constituent in the tank.
 **------------------------------------------------------------
 */
 {
     Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, j;
+    double vnet, c[MAXCONSTITS + 1];
 
-    int i;
-    double vnet;
     i = n - net->Njuncs;
     vnet = volin - volout;
+    for (j = 0; j <= qual->Nconstits; j++) c[j] = qual->ConstitQual[j][n];
     switch (net->Tank[i].MixModel)
     {
-        case MIX1: tankmix1(pr, i, volin, massin, vnet); break;
-        case MIX2: tankmix2(pr, i, volin, massin, vnet); break;
-        case FIFO: tankmix3(pr, i, volin, massin, vnet); break;
-        case LIFO: tankmix4(pr, i, volin, massin, vnet); break;
+        case MIX1: tankmix1(pr, i, volin, massin, vnet, c); break;
+        case MIX2: tankmix2(pr, i, volin, massin, vnet, c); break;
+        case FIFO: tankmix3(pr, i, volin, massin, vnet, c); break;
+        case LIFO: tankmix4(pr, i, volin, massin, vnet, c); break;
     }
-    return net->Tank[i].C;
+    for (j = 1; j <= qual->Nconstits; j++) qual->ConstitQual[j][n] = c[j];
+    qual->NodeQual[n] = net->Tank[i].C;
 }
 
 
-void tankmix1(Project *pr, int i, double vin, double win, double vnet)
+void tankmix1(Project *pr, int i, double vin, double *win, double vnet,
+              double *c)
 /*
 **---------------------------------------------
 **   Input:   i = tank index
 **            vin = inflow volume
-**            win = mass inflow
+**            win = mass inflow of each constituent
 **            vnet = inflow - outflow
-**   Output:  none
+**   Output:  c = tank quality of each constituent
 **   Purpose: updates quality in a complete mix tank model
 **---------------------------------------------
 */
@@ -478,39 +714,46 @@ void tankmix1(Project *pr, int i, double vin, double win, double vnet)
     Network *net = &pr->network;
     Quality *qual = &pr->quality;
 
-    int k;
-    double vnew;
+    int j, k;
+    double vnew, *cseg;
     Pseg seg;
     Stank *tank = &net->Tank[i];
 
     k = net->Nlinks + i;
-    seg = qual->FirstSeg[k];
+    seg = FIRSTSEG(qual, k);
     if (seg)
     {
        vnew = seg->v + vin;
-       if (vnew > 0.0) seg->c = (seg->c * seg->v + win) / vnew;
+       for (j = 0; j <= qual->Nconstits; j++)
+       {
+           cseg = &SEGQUAL(qual, j, seg);
+           if (vnew > 0.0) *cseg = (*cseg * seg->v + win[j]) / vnew;
+           c[j] = *cseg;
+       }
        seg->v += vnet;
        seg->v = MAX(0.0, seg->v);
-       tank->C = seg->c;
-       
+       tank->C = c[0];
+
         // Account for mass lost in tank overflow
         if (seg->v > tank->Vmax)
         {
-            qual->MassBalance.outflow += ((seg->v) - tank->Vmax) * tank->C;
+            qual->NodeMass[tank->Node].outflow +=
+                ((seg->v) - tank->Vmax) * tank->C;
             seg->v = tank->Vmax;
         }
     }
 }
 
 
-void tankmix2(Project *pr, int i, double vin, double win, double vnet)
+void tankmix2(Project *pr, int i, double vin, double *win, double vnet,
+              double *c)
 /*
 **------------------------------------------------
 **   Input:   i = tank index
 **            vin = inflow volume
-**            win = mass inflow
+**            win = mass inflow of each constituent
 **            vnet = inflow - outflow
-**   Output:  none
+**   Output:  c = tank quality of each constituent
 **   Purpose: updates quality in a 2-compartment tank model
 **------------------------------------------------
 */
@@ -518,18 +761,20 @@ void tankmix2(Project *pr, int i, double vin, double win, double vnet)
     Network  *net = &pr->network;
     Quality  *qual = &pr->quality;
 
-    int    k;
+    int    j, k;
     double vt,          // Transferred volume
            vmz,         // Full mixing zone volume
-           vsz;         // Full stagnant zone volume
+           vsz,         // Full stagnant zone volume
+           *cmz,        // Mixing zone quality
+           *csz;        // Stagnant zone quality
     Pseg   mixzone,     // Mixing zone segment
            stagzone;    // Stagnant zone segment
     Stank  *tank = &pr->network.Tank[i];
 
     // Identify segments for each compartment
     k = net->Nlinks + i;
-    mixzone = qual->LastSeg[k];
-    stagzone = qual->FirstSeg[k];
+    mixzone = LASTSEG(qual, k);
+    stagzone = FIRSTSEG(qual, k);
     if (mixzone == NULL || stagzone == NULL) return;
 
     // Full mixing zone volume
@@ -540,15 +785,20 @@ void tankmix2(Project *pr, int i, double vin, double win, double vnet)
     if (vnet > 0.0)
     {
         vt = MAX(0.0, (mixzone->v + vnet - vmz));
-        if (vin > 0.0)
-        {
-            mixzone->c = ((mixzone->c) * (mixzone->v) + win) /
-                         (mixzone->v + vin);
-        }
-        if (vt > 0.0)
+        for (j = 0; j <= qual->Nconstits; j++)
         {
-            stagzone->c = ((stagzone->c) * (stagzone->v) +
-                           (mixzone->c) * vt) / (stagzone->v + vt);
+            cmz = &SEGQUAL(qual, j, mixzone);
+            csz = &SEGQUAL(qual, j, stagzone);
+            if (vin > 0.0)
+            {
+                *cmz = ((*cmz) * (mixzone->v) + win[j]) /
+                       (mixzone->v + vin);
+            }
+            if (vt > 0.0)
+            {
+                *csz = ((*csz) * (stagzone->v) +
+                        (*cmz) * vt) / (stagzone->v + vt);
+            }
         }
     }
 
@@ -556,10 +806,12 @@ void tankmix2(Project *pr, int i, double vin, double win, double vnet)
     else if (vnet < 0.0)
     {
         if (stagzone->v > 0.0) vt = MIN(stagzone->v, (-vnet));
-        if (vin + vt > 0.0)
+        if (vin + vt > 0.0) for (j = 0; j <= qual->Nconstits; j++)
         {
-            mixzone->c = ((mixzone->c) * (mixzone->v) + win +
-                          (stagzone->c) * vt) / (mixzone->v + vin + vt);
+            cmz = &SEGQUAL(qual, j, mixzone);
+            csz = &SEGQUAL(qual, j, stagzone);
+            *cmz = ((*cmz) * (mixzone->v) + win[j] +
+                    (*csz) * vt) / (mixzone->v + vin + vt);
         }
     }
 
@@ -570,12 +822,13 @@ void tankmix2(Project *pr, int i, double vin, double win, double vnet)
         {
            mixzone->v = vmz;
            stagzone->v += vt;
-            
+
             // Account for mass lost in overflow from stagnant zone
             vsz = (tank->Vmax) - vmz;
             if (stagzone->v > vsz)
             {
-                qual->MassBalance.outflow += ((stagzone->v) - vsz) * stagzone->c;
+                qual->NodeMass[tank->Node].outflow +=
+                    ((stagzone->v) - vsz) * SEGQUAL(qual, 0, stagzone);
                 stagzone->v = vsz;
             }
         }
@@ -595,18 +848,20 @@ void tankmix2(Project *pr, int i, double vin, double win, double vnet)
 
     // Use quality of mixing zone to represent quality of
     // tank since this is where outflow begins to flow from
-    tank->C = mixzone->c;
+    for (j = 0; j <= qual->Nconstits; j++) c[j] = SEGQUAL(qual, j, mixzone);
+    tank->C = c[0];
 }
 
 
-void tankmix3(Project *pr, int i, double vin, double win, double vnet)
+void tankmix3(Project *pr, int i, double vin, double *win, double vnet,
+              double *c)
 /*
 **----------------------------------------------------------
 **   Input:   i = tank index
 **            vin = inflow volume
-**            win = mass inflow
+**            win = mass inflow of each constituent
 **            vnet = inflow - outflow
-**   Output:  none
+**   Output:  c = tank quality of each constituent
 **   Purpose: Updates quality in a First-In-First-Out (FIFO) tank model.
 **----------------------------------------------------------
 */
@@ -614,25 +869,29 @@ void tankmix3(Project *pr, int i, double vin, double win, double vnet)
     Network *net = &pr->network;
     Quality *qual = &pr->quality;
 
-    int k;
+    int j, k, nc = qual->Nconstits;
     double vout, vseg;
-    double cin, vsum, wsum;
+    double vsum, cin[MAXCONSTITS + 1], wsum[MAXCONSTITS + 1];
     Pseg seg;
     Stank *tank = &pr->network.Tank[i];
 
     k = net->Nlinks + i;
-    if (qual->LastSeg[k] == NULL || qual->FirstSeg[k] == NULL) return;
+    if (qual->SegRing[k].count == 0) return;
 
     // Add new last segment for flow entering the tank
     if (vin > 0.0)
     {
         // ... increase segment volume if inflow has same quality as segment
-        cin = win / vin;
-        seg = qual->LastSeg[k];
-        if (fabs(seg->c - cin) < qual->Ctol) seg->v += vin;
+        for (j = 0; j <= nc; j++) cin[j] = win[j] / vin;
+        seg = LASTSEG(qual, k);
+        if (samequal(pr, seg, cin)) seg->v += vin;
 
         // ... otherwise add a new last segment to the tank
-        else addseg(pr, k, vin, cin);
+        else
+        {
+            addseg(pr, k, vin, cin);
+            qual->NodeMass[tank->Node].segs++;
+        }
     }
 
     // Find volume leaving tank, adjusted so its volume doesn't exceed Vmax
@@ -641,49 +900,49 @@ void tankmix3(Project *pr, int i, double vin, double win, double vnet)
 
     // Withdraw outflow from first segment
     vsum = 0.0;
-    wsum = 0.0;
+    for (j = 0; j <= nc; j++) wsum[j] = 0.0;
     while (vout > 0.0)
     {
-        seg = qual->FirstSeg[k];
+        seg = FIRSTSEG(qual, k);
         if (seg == NULL)  break;
         vseg = seg->v;            // Flow volume from leading seg
         vseg = MIN(vseg, vout);
-        if (seg == qual->LastSeg[k]) vseg = vout;
+        if (qual->SegRing[k].count == 1) vseg = vout;
         vsum += vseg;
-        wsum += (seg->c) * vseg;
+        for (j = 0; j <= nc; j++) wsum[j] += SEGQUAL(qual, j, seg) * vseg;
         vout -= vseg;                       // Remaining flow volume
         if (vout >= 0.0 && vseg >= seg->v)  // Seg used up
         {
-            if (seg->prev)
-            {
-                qual->FirstSeg[k] = seg->prev;
-                seg->prev = qual->FreeSeg;
-                qual->FreeSeg = seg;
-            }
+            if (qual->SegRing[k].count > 1) removeseg(pr, k);
         }
         else seg->v -= vseg;      // Remaining volume in segment
     }
 
     // Use quality withdrawn from 1st segment
     // to represent overall quality of tank
-    if      (vsum > 0.0)                tank->C = wsum / vsum;
-    else if (qual->FirstSeg[k] == NULL) tank->C = 0.0;
-    else                                tank->C = qual->FirstSeg[k]->c;
-    
+    for (j = 0; j <= nc; j++)
+    {
+        if      (vsum > 0.0)                  c[j] = wsum[j] / vsum;
+        else if (qual->SegRing[k].count == 0) c[j] = 0.0;
+        else    c[j] = SEGQUAL(qual, j, FIRSTSEG(qual, k));
+    }
+    tank->C = c[0];
+
     // Account for mass lost in overflow from 1st segment
     if (tank->V >= tank->Vmax && vnet > 0.0)
-        qual->MassBalance.outflow += vnet * tank->C;
+        qual->NodeMass[tank->Node].outflow += vnet * tank->C;
 }
 
 
-void tankmix4(Project *pr, int i, double vin, double win, double vnet)
+void tankmix4(Project *pr, int i, double vin, double *win, double vnet,
+              double *c)
 /*
 **----------------------------------------------------------
 **   Input:   i = tank index
 **            vin = inflow volume
-**            win = mass inflow
+**            win = mass inflow of each constituent
 **            vnet = inflow - outflow
-**   Output:  none
+**   Output:  c = tank quality of each constituent
 **   Purpose: Updates quality in a Last In-First Out (LIFO) tank model.
 **----------------------------------------------------------
 */
@@ -691,58 +950,61 @@ void tankmix4(Project *pr, int i, double vin, double win, double vnet)
     Network *net  = &pr->network;
     Quality *qual = &pr->quality;
 
-    int k;
-    double cin, vsum, wsum, vseg;
+    int j, k, nc = qual->Nconstits;
+    double vsum, vseg, cin[MAXCONSTITS + 1], wsum[MAXCONSTITS + 1];
     Pseg seg;
     Stank *tank = &pr->network.Tank[i];
 
     k = net->Nlinks + i;
-    if (qual->LastSeg[k] == NULL || qual->FirstSeg[k] == NULL) return;
+    if (qual->SegRing[k].count == 0) return;
 
     // Find inflow concentration
-    if (vin > 0.0) cin = win / vin;
-    else           cin = 0.0;
+    for (j = 0; j <= nc; j++)
+    {
+        if (vin > 0.0) cin[j] = win[j] / vin;
+        else           cin[j] = 0.0;
+    }
 
     // If tank filling, then create new last seg
-    tank->C = qual->LastSeg[k]->c;
-    seg = qual->LastSeg[k];
+    seg = LASTSEG(qual, k);
+    for (j = 0; j <= nc; j++) c[j] = SEGQUAL(qual, j, seg);
     if (vnet > 0.0)
     {
         // ... inflow quality is same as last segment's quality,
         //     so just add inflow volume to last segment
-        if (fabs(seg->c - cin) < qual->Ctol) seg->v += vnet;
+        if (samequal(pr, seg, cin)) seg->v += vnet;
 
         // ... otherwise add a new last segment with inflow quality
-        else addseg(pr, k, vnet, cin);
+        else
+        {
+            addseg(pr, k, vnet, cin);
+            qual->NodeMass[tank->Node].segs++;
+        }
 
         // Update reported tank quality
-        tank->C = qual->LastSeg[k]->c;
-        
+        seg = LASTSEG(qual, k);
+        for (j = 0; j <= nc; j++) c[j] = SEGQUAL(qual, j, seg);
+
         // If tank full then remove vnet from leading segments
         if (tank->V >= tank->Vmax)
         {
-            wsum = 0.0;
+            wsum[0] = 0.0;
             while (vnet > 0.0)
             {
-                seg = qual->FirstSeg[k];
+                seg = FIRSTSEG(qual, k);
                 if (seg == NULL)  break;
                 vseg = seg->v;               // Flow volume from leading seg
                 vseg = MIN(vseg, vnet);
-                if (seg == qual->LastSeg[k]) vseg = vnet;
-                wsum += (seg->c) * vseg;
+                if (qual->SegRing[k].count == 1) vseg = vnet;
+                wsum[0] += SEGQUAL(qual, 0, seg) * vseg;
                 vnet -= vseg;               // Remaining flow volume
                 if (vnet >= 0.0 && vseg >= seg->v)  // Seg used up
                 {
-                    if (seg->prev)
-                    {
-                        qual->FirstSeg[k] = seg->prev;
-                        seg->prev = qual->FreeSeg;
-                        qual->FreeSeg = seg;
-                    }
+                    if (qual->SegRing[k].count > 1) removeseg(pr, k);
                 }
                 else seg->v -= vseg;   // Remaining volume in segment
             }
-            qual->MassBalance.outflow += wsum;
+            qual->NodeMass[tank->Node].outflow += wsum[0];
         }
     }
 
@@ -750,7 +1012,7 @@ void tankmix4(Project *pr, int i, double vin, double win, double vnet)
     else if (vnet < 0.0)
     {
         vsum = 0.0;
-        wsum = 0.0;
+        for (j = 0; j <= nc; j++) wsum[j] = 0.0;
         vnet = -vnet;
 
         // Reverse segment chain so segments are processed from last to first
@@ -760,17 +1022,17 @@ void tankmix4(Project *pr, int i, double vin, double win, double vnet)
         while (vnet > 0.0)
         {
             // ... start with reversed first segment
-            seg = qual->FirstSeg[k];
+            seg = FIRSTSEG(qual, k);
             if (seg == NULL) break;
 
             // ... find volume to remove from it
             vseg = seg->v;
             vseg = MIN(vseg, vnet);
-            if (seg == qual->LastSeg[k]) vseg = vnet;
+            if (qual->SegRing[k].count == 1) vseg = vnet;
 
             // ... update total volume & mass removed
             vsum += vseg;
-            wsum += (seg->c) * vseg;
+            for (j = 0; j <= nc; j++) wsum[j] += SEGQUAL(qual, j, seg) * vseg;
 
             // ... update remaining volume to remove
             vnet -= vseg;
@@ -779,12 +1041,7 @@ void tankmix4(Project *pr, int i, double vin, double win, double vnet)
             if (vnet >= 0.0 && vseg >= seg->v)
             {
                 // ... replace current segment with previous one
-                if (seg->prev)
-                {
-                    qual->FirstSeg[k] = seg->prev;
-                    seg->prev = qual->FreeSeg;
-                    qual->FreeSeg = seg;
-                }
+                if (qual->SegRing[k].count > 1) removeseg(pr, k);
             }
 
             // ... otherwise reduce volume of current segment
@@ -795,6 +1052,7 @@ void tankmix4(Project *pr, int i, double vin, double win, double vnet)
         reversesegs(pr, k);
 
         // Reported tank quality is mixture of flow released and any inflow
-        tank->C = (wsum + win) / (vsum + vin);
+        for (j = 0; j <= nc; j++) c[j] = (wsum[j] + win[j]) / (vsum + vin);
     }
+    tank->C = c[0];
 }
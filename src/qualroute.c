@@ -7,16 +7,18 @@ Description:  computes water quality transport over a single time step
 Authors:      see AUTHORS
 Copyright:    see AUTHORS
 License:      see LICENSE
-Last Updated: 02/14/2025
+Last Updated: 10/18/2026
 ******************************************************************************
 */
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 #include <math.h>
 
-#include "mempool.h"
 #include "types.h"
+#include "workpool.h"
 
 // Macro to compute the volume of a link
 #define LINKVOL(k) (0.785398 * net->Link[(k)].Len * SQR(net->Link[(k)].Diam))
@@ -24,26 +26,88 @@ Last Updated: 02/14/2025
 // Macro to get link flow compatible with flow saved to hydraulics file
 #define LINKFLOW(k) ((hyd->LinkStatus[k] <= CLOSED) ? 0.0 : hyd->LinkFlow[k])
 
+// Smallest capacity of a segment ring
+#define MINRING 4
+
+// Most cells a pipe is divided into for Eulerian transport
+#define MAXCELLS 64
+
+// Fractions of the segment budget at which pipe segments start
+// being merged and down to which they are merged
+#define BUDGETHIGH 0.90
+#define BUDGETLOW  0.75
+
+// Tolerance relaxed from when merging segments of a constituent
+// whose tolerance is 0
+#define MINMERGETOL 1.e-6
+
+// Largest fraction of links taking a new flow direction for which
+// the sorted nodes are repaired locally rather than fully re-sorted
+#define MAXRESORT 0.1
+
+// Fewest nodes in a level whose quality is routed by worker threads
+// and number of nodes routed by a worker at a time
+#define MINLEVEL  128
+#define NODECHUNK 16
+
+// Nodes of a level being routed by worker threads
+typedef struct
+{
+    Project *pr;
+    long    tstep;           // time step (sec)
+    int     first;           // position of level's first node in StageNodes
+    int     last;            // position of level's last node in StageNodes
+} Slevel;
+
+// Number of segments held in a pipe
+typedef struct
+{
+    int     count;
+    int     link;
+} Spipesegs;
+
 // Exported functions
-int     sortnodes(Project *);
+int     resortnodes(Project *);
+int     gridpipes(Project *);
+double  traveltime(Project *);
 void    transport(Project *, long);
 void    initsegs(Project *);
+void    resetsegs(Project *);
 void    reversesegs(Project *, int);
-void    addseg(Project *, int, double, double);
+void    addseg(Project *, int, double, double *);
+void    removeseg(Project *, int);
+int     samequal(Project *, Pseg, double *);
 
 // Imported functions
 extern double  findsourcequal(Project *, int, double, long);
 extern void    reactpipes(Project *, long);
 extern void    reacttanks(Project *, long);
-extern double  mixtank(Project *, int, double, double, double);
+extern void    ageconstits(Project *, long);
+extern void    mixtank(Project *, int, double, double *, double);
 
 // Local functions
-static void    evalnodeinflow(Project *, int, long, double *, double *);
-static void    evalnodeoutflow(Project *, int, double, long);
-static double  findnodequal(Project *, int, double, double, double, long);
-static double  noflowqual(Project *, int);
-static void    updatemassbalance(Project *, int, double, double, long);
+static void    routenode(Project *, int, long);
+static void    routechunk(void *, int, int);
+static int     evalnodeinflow(Project *, int, long, double *, double *);
+static int     evalnodeoutflow(Project *, int, double *, long);
+static void    advancecells(Project *, int, long, double *, double *);
+static double  fluxcells(double *, int, double, double, double *);
+static void    findnodequal(Project *, int, double, double *, double, long,
+                            double *, double *);
+static double  noflowqual(Project *, int, int);
+static void    updatemassbalance(Project *, int, double, double, double,
+                                 long);
+static int     sortnodes(Project *);
+static int     reordernodes(Project *, int, int);
+static int     compareints(const void *, const void *);
 static int     selectnonstacknode(Project *, int, int *);
+static void    levelnodes(Project *);
+static int     reservesegs(Project *);
+static int     growring(Project *, int, int);
+static int     compactsegs(Project *, int);
+static void    limitsegs(Project *);
+static int     mergesegs(Project *, int, double);
+static int     comparepipesegs(const void *, const void *);
 
 
 void transport(Project *pr, long tstep)
@@ -53,16 +117,23 @@ void transport(Project *pr, long tstep)
 **   Output:  none
 **   Purpose: transports constituent mass through the pipe network
 **            under a period of constant hydraulic conditions.
+**   Note:    with a pool of worker threads, the nodes of each
+**            stage (see levelnodes()) made of a level large enough
+**            to be worth sharing out are routed by the workers. The mass each
+**            node adds to the mass balance is totaled afterwards
+**            in topological order, so results don't depend on the
+**            number of threads.
 **--------------------------------------------------------------
 */
 {
     Network *net = &pr->network;
-    Hydraul *hyd = &pr->hydraul;
     Quality *qual = &pr->quality;
 
-    int j, k, m, n;
-    double volin, massin, volout, nodequal;
-    Padjlist  alink;
+    int i, j, n, reserved = FALSE;
+    Slevel level;
+    SnodeMass *mass;
+
+    qual->Nqualsteps++;
 
     // React contents of each pipe and tank
     if (qual->Reactflag)
@@ -70,74 +141,176 @@ void transport(Project *pr, long tstep)
         reactpipes(pr, tstep);
         reacttanks(pr, tstep);
     }
+    ageconstits(pr, tstep);
+
+    // Group nodes into stages if using worker threads and this
+    // hasn't been done since the hydraulics last changed
+    if (qual->Pool && qual->Nstages == 0) levelnodes(pr);
 
     // Analyze each node in topological order
-    for (j = 1; j <= net->Nnodes; j++)
+    if (qual->Nstages == 0)
     {
-        // ... index of node to be processed
-        n = qual->SortedNodes[j];
-
-        // ... zero out mass & flow volumes for this node
-        volin = 0.0;
-        massin = 0.0;
-        volout = 0.0;
-
-        // ... examine each link with flow into the node
-        for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+        for (j = 1; j <= net->Nnodes; j++)
         {
-            // ... k is index of next link incident on node n
-            k = alink->link;
+            routenode(pr, qual->SortedNodes[j], tstep);
+        }
+    }
 
-            // ... link has flow into node - add it to node's inflow
-            //     (m is index of link's downstream node)
-            m = net->Link[k].N2;
-            if (qual->FlowDir[k] < 0) m = net->Link[k].N1;
-            if (m == n)
+    // Or analyze each stage of nodes in turn, sharing out the
+    // nodes of a stage made of a single large level among the
+    // worker threads
+    else
+    {
+        level.pr = pr;
+        level.tstep = tstep;
+        for (i = 0; i < qual->Nstages; i++)
+        {
+            level.first = qual->StageStart[i];
+            level.last = qual->StageStart[i + 1] - 1;
+            if (qual->StageShared[i])
             {
-                evalnodeinflow(pr, k, tstep, &volin, &massin);
+                // ... make room for any segment rings that fill up
+                if (!reserved && reservesegs(pr) == FALSE)
+                {
+                    qual->OutOfMemory = TRUE;
+                    return;
+                }
+                reserved = TRUE;
+                n = level.last - level.first + 1;
+                workpool_run(qual->Pool, (n + NODECHUNK - 1) / NODECHUNK,
+                             routechunk, &level);
+            }
+            else for (j = level.first; j <= level.last; j++)
+            {
+                routenode(pr, qual->StageNodes[j], tstep);
             }
-
-            // ... link has flow out of node - add it to node's outflow
-            else volout += fabs(LINKFLOW(k));
         }
+    }
 
-        // ... if node is a junction, add on any external outflow (e.g., demands)
-        if (net->Node[n].Type == JUNCTION)
+    // Add the mass carried through each node onto the mass balance
+    for (j = 1; j <= net->Nnodes; j++)
+    {
+        mass = &qual->NodeMass[qual->SortedNodes[j]];
+        qual->MassBalance.inflow += mass->inflow;
+        qual->MassBalance.outflow += mass->outflow;
+        qual->MassBalance.segCount += mass->segs;
+        qual->Wsource += mass->source;
+    }
+
+    // Keep the segments held within budget
+    limitsegs(pr);
+}
+
+
+void routenode(Project *pr, int n, long tstep)
+/*
+**--------------------------------------------------------------
+**   Input:   n = node index
+**            tstep = length of current time step
+**   Output:  none
+**   Purpose: mixes the flow entering a node over a time step and
+**            releases it into the links leaving the node.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Quality *qual = &pr->quality;
+
+    int i, k, m;
+    double volin, volout, sourcequal;
+    double massin[MAXCONSTITS + 1], nodequal[MAXCONSTITS + 1];
+    Padjlist  alink;
+    SnodeMass *mass = &qual->NodeMass[n];
+
+    // Zero out mass & flow volumes for this node
+    volin = 0.0;
+    for (i = 0; i <= qual->Nconstits; i++) massin[i] = 0.0;
+    volout = 0.0;
+    memset(mass, 0, sizeof(SnodeMass));
+
+    // Examine each link with flow into the node
+    for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+    {
+        // ... k is index of next link incident on node n
+        k = alink->link;
+
+        // ... link has flow into node - add it to node's inflow
+        //     (m is index of link's downstream node)
+        m = net->Link[k].N2;
+        if (qual->FlowDir[k] < 0) m = net->Link[k].N1;
+        if (m == n)
         {
-            volout += MAX(0.0, hyd->NodeDemand[n]);
+            mass->segs -= evalnodeinflow(pr, k, tstep, &volin, massin);
         }
 
-        // ... convert from outflow rate to volume
-        volout *= tstep;
+        // ... link has flow out of node - add it to node's outflow
+        else volout += fabs(LINKFLOW(k));
+    }
 
-        // ... find the concentration of flow leaving the node
-        nodequal = findnodequal(pr, n, volin, massin, volout, tstep);
+    // If node is a junction, add on any external outflow (e.g., demands)
+    if (net->Node[n].Type == JUNCTION)
+    {
+        volout += MAX(0.0, hyd->NodeDemand[n]);
+    }
 
-        // ... examine each link with flow out of the node
-        for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+    // Convert from outflow rate to volume
+    volout *= tstep;
+
+    // Find the concentration of each constituent in flow leaving the node
+    findnodequal(pr, n, volin, massin, volout, tstep, nodequal, &sourcequal);
+
+    // Examine each link with flow out of the node
+    for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+    {
+        // ... link k incident on node n has upstream node m equal to n
+        k = alink->link;
+        m = net->Link[k].N1;
+        if (qual->FlowDir[k] < 0) m = net->Link[k].N2;
+        if (m == n)
         {
-            // ... link k incident on node n has upstream node m equal to n
-            k = alink->link;
-            m = net->Link[k].N1;
-            if (qual->FlowDir[k] < 0) m = net->Link[k].N2;
-            if (m == n)
-            {
-                // ... send flow at new node concen. into link
-                evalnodeoutflow(pr, k, nodequal, tstep);
-            }
+            // ... send flow at new node concen. into link
+            mass->segs += evalnodeoutflow(pr, k, nodequal, tstep);
         }
-        updatemassbalance(pr, n, massin, volout, tstep);
     }
+    updatemassbalance(pr, n, massin[0], volout, sourcequal, tstep);
 }
 
-void  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
-                     double *massin)
+
+void routechunk(void *data, int worker, int item)
+/*
+**--------------------------------------------------------------
+**   Input:   data = level of nodes being routed
+**            worker = index of worker thread
+**            item = index of a chunk of the level's nodes
+**   Output:  none
+**   Purpose: routes flow through a chunk of a level's nodes
+**            (called by a worker thread).
+**--------------------------------------------------------------
+*/
+{
+    Slevel *level = (Slevel *)data;
+    Quality *qual = &level->pr->quality;
+    int j, first, last;
+
+    (void)worker;
+    first = level->first + item * NODECHUNK;
+    last = MIN(first + NODECHUNK - 1, level->last);
+    for (j = first; j <= last; j++)
+    {
+        routenode(level->pr, qual->StageNodes[j], level->tstep);
+    }
+}
+
+int  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
+                    double *massin)
 /*
 **--------------------------------------------------------------
 **   Input:   k = link index
 **            tstep = quality routing time step
 **   Output:  volin = flow volume entering a node
-**            massin = constituent mass entering a node
+**            massin = mass of each constituent entering a node
+**            returns the number of segments used up
 **   Purpose: adds the contribution of a link's outflow volume
 **            and constituent mass to the total inflow into its
 **            downstream node over a time step.
@@ -147,9 +320,18 @@ void  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
     Hydraul *hyd = &pr->hydraul;
     Quality *qual = &pr->quality;
 
+    int i, nsegs = 0;
     double q, v, vseg;
     Pseg seg;
 
+    // A pipe divided into cells releases the flow leaving its
+    // downstream cell
+    if (qual->Eulerflag && pr->network.Link[k].Type == PIPE)
+    {
+        advancecells(pr, k, tstep, volin, massin);
+        return 0;
+    }
+
     // Get flow rate (q) and flow volume (v) through link
     q = LINKFLOW(k);
     v = fabs(q) * tstep;
@@ -158,7 +340,7 @@ void  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
     // node, removing segments once their full volume is consumed
     while (v > 0.0)
     {
-        seg = qual->FirstSeg[k];
+        seg = FIRSTSEG(qual, k);
         if (!seg) break;
 
         // ... volume transported from first segment is smaller of
@@ -168,7 +350,10 @@ void  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
 
         // ... update total volume & mass entering downstream node
         *volin += vseg;
-        *massin += vseg * seg->c;
+        for (i = 0; i <= qual->Nconstits; i++)
+        {
+            massin[i] += vseg * SEGQUAL(qual, i, seg);
+        }
 
         // ... reduce remaining flow volume by amount transported
         v -= vseg;
@@ -177,31 +362,28 @@ void  evalnodeinflow(Project *pr, int k, long tstep, double *volin,
         if (v >= 0.0 && vseg >= seg->v)
         {
             // ... replace this leading segment with the one behind it
-            qual->FirstSeg[k] = seg->prev;
-            if (qual->FirstSeg[k] == NULL) qual->LastSeg[k] = NULL;
-
-            // ... recycle the used up segment
-            seg->prev = qual->FreeSeg;
-            qual->FreeSeg = seg;
-            qual->MassBalance.segCount--;                                         
+            removeseg(pr, k);
+            nsegs++;
         }
 
         // ... otherwise just reduce this segment's volume
         else seg->v -= vseg;
     }
+    return nsegs;
 }
 
 
-double  findnodequal(Project *pr, int n, double volin,
-                     double massin, double volout, long tstep)
+void  findnodequal(Project *pr, int n, double volin, double *massin,
+                   double volout, long tstep, double *c, double *sourcequal)
 /*
 **--------------------------------------------------------------
 **   Input:   n = node index
 **            volin = flow volume entering node
-**            massin = mass entering node
+**            massin = mass of each constituent entering node
 **            volout = flow volume leaving node
 **            tstep = length of current time step
-**   Output:  returns water quality in a node's outflow
+**   Output:  c = quality of each constituent in node's outflow
+**            sourcequal = quality added by an external source
 **   Purpose: computes a node's new quality from its inflow
 **            volume and mass, including any source contribution.
 **--------------------------------------------------------------
@@ -211,27 +393,49 @@ double  findnodequal(Project *pr, int n, double volin,
     Hydraul *hyd = &pr->hydraul;
     Quality *qual = &pr->quality;
 
+    int i;
+    Sconstit *constit;
+
     // Node is a junction - update its water quality
     if (net->Node[n].Type == JUNCTION)
     {
         // ... dilute inflow with any external negative demand
         volin -= MIN(0.0, hyd->NodeDemand[n]) * tstep;
 
-        // ... new concen. is mass inflow / volume inflow
-        if (volin > 0.0) qual->NodeQual[n] = massin / volin;
+        for (i = 0; i <= qual->Nconstits; i++)
+        {
+            // ... new concen. is mass inflow / volume inflow
+            if (volin > 0.0) qual->ConstitQual[i][n] = massin[i] / volin;
 
-        // ... if no inflow adjust quality for reaction in connecting pipes
-        else if (qual->Reactflag) qual->NodeQual[n] = noflowqual(pr, n);
+            // ... if no inflow adjust quality for reaction in connecting pipes
+            else if (i == 0 ? qual->Reactflag : qual->Constit[i].Type == AGE)
+            {
+                qual->ConstitQual[i][n] = noflowqual(pr, n, i);
+            }
+        }
     }
 
     // Node is a tank - use its mixing model to update its quality
     else if (net->Node[n].Type == TANK)
     {
-        qual->NodeQual[n] = mixtank(pr, n, volin, massin, volout);
+        mixtank(pr, n, volin, massin, volout);
+    }
+
+    // Additional constituents leave the node at its quality, with
+    // flow from a traced source node always at 100%
+    for (i = 1; i <= qual->Nconstits; i++)
+    {
+        constit = &qual->Constit[i];
+        if (constit->Type == TRACE && constit->Node == n)
+        {
+            qual->ConstitQual[i][n] = 100.0;
+        }
+        c[i] = qual->ConstitQual[i][n];
     }
 
     // Add any external quality source onto node's concen.
-    qual->SourceQual = 0.0;
+    *sourcequal = 0.0;
+    c[0] = qual->NodeQual[n];
 
     // For source tracing analysis find tracer added at source node
     if (qual->Qualflag == TRACE)
@@ -240,43 +444,47 @@ double  findnodequal(Project *pr, int n, double volin,
         {
             // ... quality added to network is difference between tracer
             //     concentration (100 mg/L) and current node quality
-            if (net->Node[n].Type == RESERVOIR) qual->SourceQual = 100.0;
-            else qual->SourceQual = MAX(100.0 - qual->NodeQual[n], 0.0);
+            if (net->Node[n].Type == RESERVOIR) *sourcequal = 100.0;
+            else *sourcequal = MAX(100.0 - qual->NodeQual[n], 0.0);
             qual->NodeQual[n] = 100.0;
+            c[0] = 100.0;
         }
-        return qual->NodeQual[n];
+        return;
     }
 
     // Find quality contributed by any external chemical source
-    else qual->SourceQual = findsourcequal(pr, n, volout, tstep);
-    if (qual->SourceQual == 0.0) return qual->NodeQual[n];
+    else *sourcequal = findsourcequal(pr, n, volout, tstep);
+    if (*sourcequal == 0.0) return;
 
     // Combine source quality with node quality
     switch (net->Node[n].Type)
     {
     case JUNCTION:
-        qual->NodeQual[n] += qual->SourceQual;
-        return qual->NodeQual[n];
+        qual->NodeQual[n] += *sourcequal;
+        c[0] = qual->NodeQual[n];
+        break;
 
     case TANK:
-        return qual->NodeQual[n] + qual->SourceQual;
+        c[0] = qual->NodeQual[n] + *sourcequal;
+        break;
 
     case RESERVOIR:
-        qual->NodeQual[n] = qual->SourceQual;
-        return qual->SourceQual;
+        qual->NodeQual[n] = *sourcequal;
+        c[0] = *sourcequal;
+        break;
     }
-    return qual->NodeQual[n];
 }
 
 
-double  noflowqual(Project *pr, int n)
+double  noflowqual(Project *pr, int n, int i)
 /*
 **--------------------------------------------------------------
 **   Input:   n = node index
+**            i = constituent index
 **   Output:  quality for node n
-**   Purpose: sets the quality for a junction node that has no
-**            inflow to the average of the quality in its
-**            adjoining link segments.
+**   Purpose: sets the quality of a constituent for a junction
+**            node that has no inflow to the average of its
+**            quality in the node's adjoining link segments.
 **   Note:    this function is only used for reactive substances.
 **--------------------------------------------------------------
 */
@@ -301,17 +509,17 @@ double  noflowqual(Project *pr, int n)
         if (net->Link[k].N2 == n && dir >= 0) inflow = TRUE;
         else if (net->Link[k].N1 == n && dir < 0)  inflow = TRUE;
         else inflow = FALSE;
-        if (inflow == TRUE && qual->FirstSeg[k] != NULL)
+        if (inflow == TRUE && qual->SegRing[k].count > 0)
         {
-            c += qual->FirstSeg[k]->c;
+            c += SEGQUAL(qual, i, FIRSTSEG(qual, k));
             kount++;
         }
 
         // Node n is link's upstream node - add quality
         // of link's last segment to average
-        else if (inflow == FALSE && qual->LastSeg[k] != NULL)
+        else if (inflow == FALSE && qual->SegRing[k].count > 0)
         {
-            c += qual->LastSeg[k]->c;
+            c += SEGQUAL(qual, i, LASTSEG(qual, k));
             kount++;
         }
     }
@@ -320,13 +528,13 @@ double  noflowqual(Project *pr, int n)
 }
 
 
-void evalnodeoutflow(Project *pr, int k, double c, long tstep)
+int evalnodeoutflow(Project *pr, int k, double *c, long tstep)
 /*
 **--------------------------------------------------------------
 **   Input:   k = link index
-**            c = quality from upstream node
+**            c = quality of each constituent from upstream node
 **            tstep = time step
-**   Output:  none
+**   Output:  returns the number of segments added
 **   Purpose: releases flow volume and mass from the upstream
 **            node of a link over a time step.
 **--------------------------------------------------------------
@@ -335,47 +543,264 @@ void evalnodeoutflow(Project *pr, int k, double c, long tstep)
     Hydraul *hyd = &pr->hydraul;
     Quality *qual = &pr->quality;
 
-    double v;
+    int i;
+    double v, *cseg;
     Pseg seg;
 
+    // A pipe divided into cells takes in flow at the node's quality
+    // when its cells are next advanced (see advancecells())
+    if (qual->Eulerflag && pr->network.Link[k].Type == PIPE)
+    {
+        cseg = qual->InletQual + (size_t)k * (qual->Nconstits + 1);
+        for (i = 0; i <= qual->Nconstits; i++) cseg[i] = c[i];
+        return 0;
+    }
+
     // Find flow volume (v) released over time step
     v = fabs(LINKFLOW(k)) * tstep;
-    if (v == 0.0) return;
+    if (v == 0.0) return 0;
 
     // Release flow and mass into upstream end of the link
 
     // ... case where link has a last (most upstream) segment
-    seg = qual->LastSeg[k];
+    seg = LASTSEG(qual, k);
     if (seg)
     {
         // ... if node quality close to segment quality then mix
         //     the nodal outflow volume with the segment's volume
-        if (fabs(seg->c - c) < qual->Ctol)
+        if (samequal(pr, seg, c))
         {
-            seg->c = (seg->c*seg->v + c*v) / (seg->v + v);
+            for (i = 0; i <= qual->Nconstits; i++)
+            {
+                cseg = &SEGQUAL(qual, i, seg);
+                *cseg = (*cseg * seg->v + c[i] * v) / (seg->v + v);
+            }
             seg->v += v;
+            return 0;
         }
+    }
 
-        // ... otherwise add a new segment at upstream end of link
-        else addseg(pr, k, v, c);
+    // Otherwise add a new segment at upstream end of link
+    addseg(pr, k, v, c);
+    return 1;
+}
+
+
+void advancecells(Project *pr, int k, long tstep, double *volin,
+                  double *massin)
+/*
+**--------------------------------------------------------------
+**   Input:   k = index of a pipe divided into cells
+**            tstep = quality routing time step
+**   Output:  volin = flow volume entering a node
+**            massin = mass of each constituent entering a node
+**   Purpose: moves flow through a pipe's cells over a time step,
+**            adding the flow leaving the pipe to the inflow into
+**            its downstream node.
+**   Note:    the time step is split so that the flow through a
+**            cell in each part is within the cell's volume. A pipe
+**            whose whole volume is displaced is simply flushed
+**            with the water entering it.
+**--------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &pr->hydraul;
+    Quality *qual = &pr->quality;
+    Sring *ring = &qual->SegRing[k];
+
+    int i, j, nsteps;
+    int n = ring->count;
+    int nc = qual->Nconstits + 1;
+    double v, vcell, vstep, cr, cout, *c, *cin;
+    double face[MAXCELLS + 1];
+
+    v = fabs(LINKFLOW(k)) * tstep;
+    if (n == 0 || v == 0.0) return;
+    *volin += v;
+
+    // The cells lie from the downstream to the upstream end of
+    // the ring's buffer and share the pipe's volume
+    vcell = qual->Segs[ring->base].v;
+    cin = qual->InletQual + (size_t)k * nc;
+    if (v >= n * vcell)
+    {
+        for (i = 0; i < nc; i++)
+        {
+            c = qual->SegQual[i] + ring->base;
+            cout = (v - n * vcell) * cin[i];
+            for (j = 0; j < n; j++)
+            {
+                cout += vcell * c[j];
+                c[j] = cin[i];
+            }
+            massin[i] += cout;
+        }
+        return;
+    }
+
+    // Otherwise sum up the flux leaving the downstream cell over
+    // each part of the time step
+    nsteps = (int)ceil(v / vcell);
+    vstep = v / nsteps;
+    cr = vstep / vcell;
+    for (i = 0; i < nc; i++)
+    {
+        c = qual->SegQual[i] + ring->base;
+        cout = 0.0;
+        for (j = 0; j < nsteps; j++)
+        {
+            cout += fluxcells(c, n, cin[i], cr, face);
+        }
+        massin[i] += vstep * cout;
+    }
+}
+
+
+double fluxcells(double *c, int n, double cin, double cr, double *face)
+/*
+**--------------------------------------------------------------
+**   Input:   c = quality in each of a pipe's cells, from its
+**                downstream to its upstream end
+**            n = number of cells
+**            cin = quality of flow entering the upstream cell
+**            cr = Courant number (flow volume / cell volume <= 1)
+**            face = work array of n+1 values
+**   Output:  c = updated quality in each cell
+**            returns the quality of flow leaving the pipe
+**   Purpose: updates a pipe's cell qualities with the upwind
+**            fluxes between them, corrected to second order
+**            with a van Leer limiter (a TVD scheme).
+**--------------------------------------------------------------
+*/
+{
+    int j;
+    double s1, s2, d, a = 0.5 * (1.0 - cr);
+    double up;
+
+    // Quality leaving the downstream end of each cell (the flux
+    // out of the pipe and into its upstream cell are first order)
+    face[0] = c[0];
+    face[n] = cin;
+    for (j = 1; j < n; j++)
+    {
+        up = (j + 1 < n) ? c[j + 1] : cin;
+        s1 = c[j] - up;
+        s2 = c[j - 1] - c[j];
+        d = fabs(s1) + fabs(s2);
+        face[j] = c[j] + (d > 0.0 ? a * (s1 * fabs(s2) + fabs(s1) * s2) / d : 0.0);
+    }
+
+    // Each cell gains the flux entering its upstream face and
+    // loses the one leaving its downstream face
+    for (j = 0; j < n; j++) c[j] += cr * (face[j + 1] - face[j]);
+    return face[0];
+}
+
+
+int gridpipes(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns FALSE if out of memory
+**   Purpose: divides each pipe that carries flow for the first
+**            time into cells of equal volume for Eulerian
+**            transport.
+**   Note:    a pipe gets the most cells (up to MAXCELLS) for which
+**            its current flow over a quality time step fits in a
+**            cell (a Courant number of at most 1). Its cells then
+**            stay fixed for the rest of the run.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Quality *qual = &pr->quality;
+
+    int i, j, k, n, size;
+    double v, q;
+    Sring *ring;
+
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        // Skip pipes without flow or already divided into cells
+        ring = &qual->SegRing[k];
+        if (net->Link[k].Type != PIPE || qual->FlowDir[k] == ZERO_FLOW ||
+            ring->count != 1) continue;
+
+        // Find the number of cells that meets the Courant limit
+        v = LINKVOL(k);
+        q = fabs(LINKFLOW(k)) * pr->times.Qstep;
+        n = MAXCELLS;
+        if (q * MAXCELLS > v) n = MAX(1, (int)(v / q));
+        if (n == 1) continue;
+
+        // Make room for the cells at the start of the pipe's ring
+        for (size = MINRING; size < n; size *= 2);
+        size = MAX(size, ring->size);
+        if ((size > ring->size || ring->head != 0) &&
+            !growring(pr, k, size)) return FALSE;
+
+        // Fill the cells with the quality of the pipe's segment
+        for (i = 0; i < n; i++)
+        {
+            qual->Segs[ring->base + i].v = v / n;
+            for (j = 0; j <= qual->Nconstits; j++)
+            {
+                qual->SegQual[j][ring->base + i] =
+                    qual->SegQual[j][ring->base];
+            }
+        }
+        ring->count = n;
     }
+    return TRUE;
+}
+
+
+double traveltime(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns mean travel time (sec) through the pipes
+**   Purpose: finds the volume-weighted mean time that flow
+**            takes to pass through the network's pipes under
+**            the current hydraulics.
+**   Note:    a time step of dt moves on average dt divided by
+**            this time of each pipe's contents (its volume-
+**            weighted Courant number). Pipes without flow add
+**            their volume but no flow, and BIG is returned if
+**            no pipe carries flow.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+
+    int k;
+    double v = 0.0, q = 0.0;
 
-    // ... link has no segments so add one
-    else addseg(pr, k, v, c);
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        if (net->Link[k].Type > PIPE) continue;
+        v += LINKVOL(k);
+        q += fabs(LINKFLOW(k));
+    }
+    if (q <= 0.0) return BIG;
+    return v / q;
 }
 
 
 void updatemassbalance(Project *pr, int n, double massin,
-                       double volout, long tstep)
+                       double volout, double sourcequal, long tstep)
 /*
 **--------------------------------------------------------------
 **   Input:   n = node index
 **            massin = mass inflow to node
 **            volout = outflow volume from node
+**            sourcequal = quality added by an external source
 **   Output:  none
 **   Purpose: Adds a node's external mass inflow and outflow
-**            over the current time step to the network's
-**            overall mass balance.
+**            over the current time step to the mass carried
+**            through the node.
 **--------------------------------------------------------------
 */
 {
@@ -391,24 +816,86 @@ void updatemassbalance(Project *pr, int n, double massin,
         // Junctions lose mass from outflow demand & gain it from source inflow
     case JUNCTION:
         masslost = MAX(0.0, hyd->NodeDemand[n]) * tstep * qual->NodeQual[n];
-        massadded = qual->SourceQual * volout;
+        massadded = sourcequal * volout;
         break;
 
         // Reservoirs add mass from quality source if specified or from a fixed
         // initial quality
     case RESERVOIR:
         masslost = massin;
-        if (qual->SourceQual > 0.0) massadded = qual->SourceQual * volout;
-        else                        massadded = qual->NodeQual[n] * volout;
+        if (sourcequal > 0.0) massadded = sourcequal * volout;
+        else                  massadded = qual->NodeQual[n] * volout;
         break;
 
         // Tanks add mass only from external source inflow
     case TANK:
-        massadded = qual->SourceQual * volout;
+        massadded = sourcequal * volout;
         break;
     }
-    qual->MassBalance.outflow += masslost;
-    qual->MassBalance.inflow += massadded;
+    qual->NodeMass[n].outflow += masslost;
+    qual->NodeMass[n].inflow += massadded;
+}
+
+
+int resortnodes(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns an error code
+**   Purpose: re-sorts nodes from upstream to downstream after
+**            flow directions have changed.
+**   Note:    each link in NewFlows is inserted into the existing
+**            order, moving only the nodes lying between its end
+**            nodes (Pearce & Kelly, 2006). The nodes are fully
+**            sorted when no valid order exists yet, when many
+**            links changed or when a new flow creates a cycle.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, k, u, v;
+
+    if (!qual->Sortedflag ||
+        qual->Nnewflows > MAXRESORT * net->Nlinks) return sortnodes(pr);
+
+    // Remove the new flows from the flow network, saving their
+    // directions in the signs of their link indexes
+    for (i = 0; i < qual->Nnewflows; i++)
+    {
+        k = qual->NewFlows[i];
+        qual->NewFlows[i] = k * qual->FlowDir[k];
+        qual->FlowDir[k] = ZERO_FLOW;
+    }
+
+    // Add each new flow back, repairing the sort order around it
+    for (i = 0; i < qual->Nnewflows; i++)
+    {
+        k = ABS(qual->NewFlows[i]);
+        qual->FlowDir[k] = SGN(qual->NewFlows[i]);
+        u = net->Link[k].N1;
+        v = net->Link[k].N2;
+        if (qual->FlowDir[k] == NEGATIVE)
+        {
+            u = net->Link[k].N2;
+            v = net->Link[k].N1;
+        }
+        if (u == v || qual->SortPos[u] < qual->SortPos[v]) continue;
+        if (!reordernodes(pr, u, v))
+        {
+            // ... a cycle exists so restore the remaining flows
+            //     and sort all nodes
+            for (i++; i < qual->Nnewflows; i++)
+            {
+                k = ABS(qual->NewFlows[i]);
+                qual->FlowDir[k] = SGN(qual->NewFlows[i]);
+            }
+            return sortnodes(pr);
+        }
+    }
+    qual->Nlocalsorts++;
+    return 0;
 }
 
 
@@ -427,98 +914,226 @@ int sortnodes(Project *pr)
     Quality *qual = &pr->quality;
 
     int i, j, k, n;
-    int *indegree = NULL;
-    int *stack = NULL;
+    int *indegree = qual->SortWork;
+    int *stack = qual->SortWork + net->Nnodes + 1;
     int stacksize = 0;
     int numsorted = 0;
     int errcode = 0;
     FlowDirection dir;
     Padjlist  alink;
 
-    // Allocate an array to count # links with inflow to each node
+    // Use the work space to count # links with inflow to each node
     // and for a stack to hold nodes waiting to be processed
-    indegree = (int *)calloc(net->Nnodes + 1, sizeof(int));
-    stack = (int *)calloc(net->Nnodes + 1, sizeof(int));
-    if (indegree && stack)
+    memset(indegree, 0, (net->Nnodes + 1) * sizeof(int));
+    qual->Sortedflag = TRUE;
+
+    // Count links with "non-negligible" inflow to each node
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        dir = qual->FlowDir[k];
+        if (dir == POSITIVE) n = net->Link[k].N2;
+        else if (dir == NEGATIVE) n = net->Link[k].N1;
+        else continue;
+        indegree[n]++;
+    }
+
+    // Place nodes with no inflow onto a stack
+    for (i = 1; i <= net->Nnodes; i++)
     {
-        // Count links with "non-negligible" inflow to each node
-        for (k = 1; k <= net->Nlinks; k++)
+        if (indegree[i] == 0)
         {
-            dir = qual->FlowDir[k];
-            if (dir == POSITIVE) n = net->Link[k].N2;
-            else if (dir == NEGATIVE) n = net->Link[k].N1;
-            else continue;
-            indegree[n]++;
+            stacksize++;
+            stack[stacksize] = i;
         }
+    }
 
-        // Place nodes with no inflow onto a stack
-        for (i = 1; i <= net->Nnodes; i++)
+    // Examine each node on the stack until none are left
+    while (numsorted < net->Nnodes)
+    {
+        // ... if stack is empty then a cycle exists
+        if (stacksize == 0)
         {
-            if (indegree[i] == 0)
-            {
-                stacksize++;
-                stack[stacksize] = i;
-            }
+            //  ... add a non-sorted node connected to a sorted one to stack
+            j = selectnonstacknode(pr, numsorted, indegree);
+            if (j == 0) break;  // This shouldn't happen.
+            indegree[j] = 0;
+            stacksize++;
+            stack[stacksize] = j;
+
+            // ... the order can't be repaired locally later on
+            qual->Sortedflag = FALSE;
         }
 
-        // Examine each node on the stack until none are left
-        while (numsorted < net->Nnodes)
+        // ... make the last node added to the stack the next
+        //     in sorted order & remove it from the stack
+        i = stack[stacksize];
+        stacksize--;
+        numsorted++;
+        qual->SortedNodes[numsorted] = i;
+        qual->SortPos[i] = numsorted;
+
+        // ... for each outflow link from this node reduce the in-degree
+        //     of its downstream node
+        for (alink = net->Adjlist[i]; alink != NULL; alink = alink->next)
         {
-            // ... if stack is empty then a cycle exists
-            if (stacksize == 0)
-            {
-                //  ... add a non-sorted node connected to a sorted one to stack
-                j = selectnonstacknode(pr, numsorted, indegree);
-                if (j == 0) break;  // This shouldn't happen.
-                indegree[j] = 0;
-                stacksize++;
-                stack[stacksize] = j;
-            }
-
-            // ... make the last node added to the stack the next
-            //     in sorted order & remove it from the stack
-            i = stack[stacksize];
-            stacksize--;
-            numsorted++;
-            qual->SortedNodes[numsorted] = i;
+            // ... k is the index of the next link incident on node i
+            k = alink->link;
 
-            // ... for each outflow link from this node reduce the in-degree
-            //     of its downstream node
-            for (alink = net->Adjlist[i]; alink != NULL; alink = alink->next)
-            {
-                // ... k is the index of the next link incident on node i
-                k = alink->link;
+            // ... skip link if flow is negligible
+            if (qual->FlowDir[k] == 0) continue;
 
-                // ... skip link if flow is negligible
-                if (qual->FlowDir[k] == 0) continue;
+            // ... link has flow out of node (downstream node n not equal to i)
+            n = net->Link[k].N2;
+            if (qual->FlowDir[k] < 0) n = net->Link[k].N1;
 
-                // ... link has flow out of node (downstream node n not equal to i)
-                n = net->Link[k].N2;
-                if (qual->FlowDir[k] < 0) n = net->Link[k].N1;
+            // ... reduce degree of node n
+            if (n != i && indegree[n] > 0)
+            {
+                indegree[n]--;
 
-                // ... reduce degree of node n
-                if (n != i && indegree[n] > 0)
+                // ... no more degree left so add node n to stack
+                if (indegree[n] == 0)
                 {
-                    indegree[n]--;
-
-                    // ... no more degree left so add node n to stack
-                    if (indegree[n] == 0)
-                    {
-                        stacksize++;
-                        stack[stacksize] = n;
-                    }
+                    stacksize++;
+                    stack[stacksize] = n;
                 }
             }
         }
     }
-    else errcode = 101;
-    if (numsorted < net->Nnodes) errcode = 120;
-    FREE(indegree);
-    FREE(stack);
+    if (numsorted < net->Nnodes)
+    {
+        errcode = 120;
+        qual->Sortedflag = FALSE;
+    }
+    qual->Nfullsorts++;
     return errcode;
 }
 
 
+int reordernodes(Project *pr, int u, int v)
+/*
+**--------------------------------------------------------------
+**   Input:   u = upstream node of a new flow
+**            v = downstream node of a new flow
+**   Output:  returns FALSE if the new flow creates a cycle
+**   Purpose: moves the nodes lying between v and u in sorted
+**            order so that u comes before v.
+**   Note:    v is sorted ahead of u on entry.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, j, k, m, n, mark;
+    int nf = 0, nb = 0, stacksize = 0;
+    int lower = qual->SortPos[v];
+    int upper = qual->SortPos[u];
+    int *pos = qual->SortPos;
+    int *posf = qual->SortWork;
+    int *posb = posf + net->Nnodes + 1;
+    int *stack = posb + net->Nnodes + 1;
+    int *merged = stack + net->Nnodes + 1;
+    Padjlist alink;
+
+    // Get a new pair of visit marks (forward & backward)
+    if (qual->SortMark[0] > INT_MAX - 2)
+    {
+        memset(qual->SortMark, 0, (net->Nnodes + 1) * sizeof(int));
+    }
+    qual->SortMark[0] += 2;
+    mark = qual->SortMark[0];
+
+    // Find the nodes downstream of v sorted ahead of u
+    qual->SortMark[v] = mark;
+    stack[stacksize++] = v;
+    while (stacksize > 0)
+    {
+        m = stack[--stacksize];
+        posf[nf++] = pos[m];
+        for (alink = net->Adjlist[m]; alink != NULL; alink = alink->next)
+        {
+            k = alink->link;
+            if (qual->FlowDir[k] == 0) continue;
+            n = net->Link[k].N2;
+            if (qual->FlowDir[k] < 0) n = net->Link[k].N1;
+            if (n == m) continue;
+
+            // ... reaching u means the new flow closes a cycle
+            if (n == u) return FALSE;
+            if (qual->SortMark[n] != mark && pos[n] < upper)
+            {
+                qual->SortMark[n] = mark;
+                stack[stacksize++] = n;
+            }
+        }
+    }
+
+    // Find the nodes upstream of u sorted behind v
+    qual->SortMark[u] = mark + 1;
+    stack[stacksize++] = u;
+    while (stacksize > 0)
+    {
+        m = stack[--stacksize];
+        posb[nb++] = pos[m];
+        for (alink = net->Adjlist[m]; alink != NULL; alink = alink->next)
+        {
+            k = alink->link;
+            if (qual->FlowDir[k] == 0) continue;
+            n = net->Link[k].N1;
+            if (qual->FlowDir[k] < 0) n = net->Link[k].N2;
+            if (n == m) continue;
+            if (qual->SortMark[n] == mark) return FALSE;
+            if (qual->SortMark[n] != mark + 1 && pos[n] > lower)
+            {
+                qual->SortMark[n] = mark + 1;
+                stack[stacksize++] = n;
+            }
+        }
+    }
+
+    // List the upstream nodes followed by the downstream ones,
+    // each in their current order
+    qsort(posf, nf, sizeof(int), compareints);
+    qsort(posb, nb, sizeof(int), compareints);
+    for (i = 0; i < nb; i++) stack[i] = qual->SortedNodes[posb[i]];
+    for (i = 0; i < nf; i++) stack[nb + i] = qual->SortedNodes[posf[i]];
+
+    // Merge the positions they occupied
+    i = 0;
+    j = 0;
+    for (k = 0; k < nf + nb; k++)
+    {
+        if (j >= nb || (i < nf && posf[i] < posb[j])) merged[k] = posf[i++];
+        else merged[k] = posb[j++];
+    }
+
+    // Place the listed nodes into these positions
+    for (k = 0; k < nf + nb; k++)
+    {
+        n = stack[k];
+        qual->SortedNodes[merged[k]] = n;
+        pos[n] = merged[k];
+    }
+    return TRUE;
+}
+
+
+int compareints(const void *a, const void *b)
+/*
+**--------------------------------------------------------------
+**   Input:   a, b = pointers to two integers
+**   Output:  returns -1, 0 or 1
+**   Purpose: compares two integers for qsort().
+**--------------------------------------------------------------
+*/
+{
+    int i = *(const int *)a;
+    int j = *(const int *)b;
+    return (i > j) - (i < j);
+}
+
+
 int selectnonstacknode(Project *pr, int numsorted, int *indegree)
 /*
 **--------------------------------------------------------------
@@ -562,6 +1177,133 @@ int selectnonstacknode(Project *pr, int numsorted, int *indegree)
 }
 
 
+void levelnodes(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: groups the topologically sorted nodes into stages
+**            that are routed one after another.
+**   Note:    a node's level is one above the highest level of
+**            the nodes sorted ahead of it that it shares a link
+**            carrying flow with. So no two nodes of a level touch
+**            the same link's segments and nodes joined by such a
+**            link are still routed in their sorted order. Links
+**            without flow are only read by noflowqual().
+**
+**            Each level with enough nodes to share out among the
+**            worker threads makes a stage of its own. The levels
+**            between them are merged into a single stage whose
+**            nodes keep their sorted order, which routes them
+**            serially with the better memory locality of that
+**            order.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Quality *qual = &pr->quality;
+
+    int i, j, m, n, level, nlevels = 0, nstages = 0, small = FALSE;
+    int *nodelevel = qual->NodeLevel;
+    int *start = qual->StageStart;
+    int *stage;
+    Padjlist alink;
+
+    // Nodes are only sorted once some link carries flow
+    if (qual->SortedNodes[1] == 0) return;
+
+    // Assign each node a level in sorted order
+    for (i = 1; i <= net->Nnodes; i++) nodelevel[i] = -1;
+    for (j = 1; j <= net->Nnodes; j++)
+    {
+        n = qual->SortedNodes[j];
+        level = 0;
+        for (alink = net->Adjlist[n]; alink != NULL; alink = alink->next)
+        {
+            m = alink->node;
+            if (nodelevel[m] < 0 || LINKFLOW(alink->link) == 0.0) continue;
+            level = MAX(level, nodelevel[m] + 1);
+        }
+        nodelevel[n] = level;
+        nlevels = MAX(nlevels, level + 1);
+    }
+
+    // Count the nodes in each level (nodes are then routed serially
+    // in their sorted order if there's no memory for this)
+    stage = (int *)calloc(nlevels, sizeof(int));
+    if (stage == NULL) return;
+    for (i = 1; i <= net->Nnodes; i++) stage[nodelevel[i]]++;
+
+    // Assign each level to a stage, counting the nodes in each stage
+    for (i = 0; i < nlevels; i++)
+    {
+        n = stage[i];
+        if (n >= MINLEVEL || !small)
+        {
+            nstages++;
+            start[nstages] = 0;
+            qual->StageShared[nstages - 1] = (n >= MINLEVEL);
+        }
+        small = (n < MINLEVEL);
+        start[nstages] += n;
+        stage[i] = nstages - 1;
+    }
+
+    // Find where each stage starts in the list of nodes by stage
+    start[0] = 1;
+    for (i = 1; i <= nstages; i++) start[i] += start[i - 1];
+
+    // List the nodes of each stage in their sorted order
+    for (j = 1; j <= net->Nnodes; j++)
+    {
+        n = qual->SortedNodes[j];
+        qual->StageNodes[start[stage[nodelevel[n]]]++] = n;
+    }
+    for (i = nstages; i > 0; i--) start[i] = start[i - 1];
+    start[0] = 1;
+    qual->Nstages = nstages;
+    free(stage);
+}
+
+
+int reservesegs(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  returns TRUE if successful, FALSE if out of memory
+**   Purpose: makes sure the segment arena has room for every
+**            full segment ring to grow once.
+**   Note:    a link or tank gains at most one segment per time
+**            step, so the arena never needs compacting while
+**            worker threads are routing flow.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int k, n, need = 0;
+    Sring *ring;
+
+    n = net->Nlinks + net->Ntanks;
+    for (k = 1; k <= n; k++)
+    {
+        // (pipes divided into cells never grow)
+        if (qual->Eulerflag && k <= net->Nlinks &&
+            net->Link[k].Type == PIPE) continue;
+        ring = &qual->SegRing[k];
+        if (ring->count == ring->size)
+        {
+            if (need > INT_MAX / 2 - ring->size) return FALSE;
+            need += MAX(2 * ring->size, MINRING);
+        }
+    }
+    if (need <= qual->SegCapacity - qual->SegTop) return TRUE;
+    return compactsegs(pr, need);
+}
+
+
 void initsegs(Project *pr)
 /*
 **--------------------------------------------------------------
@@ -575,19 +1317,27 @@ void initsegs(Project *pr)
     Network *net = &pr->network;
     Quality *qual = &pr->quality;
 
-    int j, k;
-    double c, v, v1;
+    int i, j, k;
+    double c[MAXCONSTITS + 1], v, v1;
+
+    // Empty the segment ring of every pipe and tank
+    resetsegs(pr);
 
     // Add one segment with assigned downstream node quality to each pipe
     for (k = 1; k <= net->Nlinks; k++)
     {
-        qual->FirstSeg[k] = NULL;
-        qual->LastSeg[k] = NULL;
         if (net->Link[k].Type == PIPE)
         {
             v = LINKVOL(k);
             j = net->Link[k].N2;
-            c = qual->NodeQual[j];
+            for (i = 0; i <= qual->Nconstits; i++)
+            {
+                c[i] = qual->ConstitQual[i][j];
+                if (qual->Eulerflag)
+                {
+                    qual->InletQual[(size_t)k * (qual->Nconstits + 1) + i] = c[i];
+                }
+            }
             addseg(pr, k, v, c);
         }
     }
@@ -600,13 +1350,15 @@ void initsegs(Project *pr)
 
         // Establish initial tank quality & volume
         k = net->Tank[j].Node;
-        c = net->Node[k].C0;
+        for (i = 1; i <= qual->Nconstits; i++)
+        {
+            c[i] = qual->ConstitQual[i][k];
+        }
+        c[0] = net->Node[k].C0;
         v = net->Tank[j].V0;
 
         // Create one volume segment for entire tank
         k = net->Nlinks + j;
-        qual->FirstSeg[k] = NULL;
-        qual->LastSeg[k] = NULL;
         addseg(pr, k, v, c);
 
         // Create a 2nd segment for the 2-compartment tank model
@@ -614,7 +1366,7 @@ void initsegs(Project *pr)
         {
             // ... mixing zone segment
             v1 = MAX(0, v - net->Tank[j].V1frac * net->Tank[j].Vmax);
-            qual->FirstSeg[k]->v = v1;
+            FIRSTSEG(qual, k)->v = v1;
 
             // ... stagnant zone segment
             v = v - v1;
@@ -624,38 +1376,76 @@ void initsegs(Project *pr)
 }
 
 
+void resetsegs(Project *pr)
+/*
+**--------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: removes all segments from every pipe and tank.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    memset(qual->SegRing, 0, (net->Nlinks + net->Ntanks + 1) * sizeof(Sring));
+    qual->SegTop = 0;
+}
+
+
 void reversesegs(Project *pr, int k)
 /*
 **--------------------------------------------------------------
 **   Input:   k = link index
 **   Output:  none
 **   Purpose: re-orients a link's segments when flow reverses.
+**   Note:    the segments stay where they are in the link's ring;
+**            only the ring's first segment and direction change.
+**            With Eulerian transport they are swapped end for end
+**            instead, so that a pipe's cells always run from the
+**            downstream to the upstream end of its ring's buffer.
 **--------------------------------------------------------------
 */
 {
     Quality *qual = &pr->quality;
-    Pseg  seg, nseg, pseg;
+    Sring *ring = &qual->SegRing[k];
+
+    int i, j;
+    double c;
+    Pseg seg1, seg2;
+    struct Sseg seg;
 
-    seg = qual->FirstSeg[k];
-    qual->FirstSeg[k] = qual->LastSeg[k];
-    qual->LastSeg[k] = seg;
-    pseg = NULL;
-    while (seg != NULL)
+    if (ring->count == 0) return;
+    if (qual->Eulerflag)
     {
-        nseg = seg->prev;
-        seg->prev = pseg;
-        pseg = seg;
-        seg = nseg;
+        for (i = 0; i < ring->count / 2; i++)
+        {
+            seg1 = SEGMENT(qual, ring, i);
+            seg2 = SEGMENT(qual, ring, ring->count - 1 - i);
+            seg = *seg1;
+            *seg1 = *seg2;
+            *seg2 = seg;
+            for (j = 0; j <= qual->Nconstits; j++)
+            {
+                c = SEGQUAL(qual, j, seg1);
+                SEGQUAL(qual, j, seg1) = SEGQUAL(qual, j, seg2);
+                SEGQUAL(qual, j, seg2) = c;
+            }
+        }
+        return;
     }
+    ring->head = (ring->head + ring->dir * (ring->count - 1)) &
+                 (ring->size - 1);
+    ring->dir = -ring->dir;
 }
 
 
-void addseg(Project *pr, int k, double v, double c)
+void addseg(Project *pr, int k, double v, double *c)
 /*
 **-------------------------------------------------------------
 **   Input:   k = segment chain index
 **            v = segment volume
-**            c = segment quality
+**            c = segment quality of each constituent
 **   Output:  none
 **   Purpose: adds a segment to the start of a link
 **            upstream of its current last segment.
@@ -663,34 +1453,337 @@ void addseg(Project *pr, int k, double v, double c)
 */
 {
     Quality *qual = &pr->quality;
+    Sring *ring = &qual->SegRing[k];
+    int i;
     Pseg seg;
 
-    // Grab the next free segment from the segment pool if available
-    if (qual->FreeSeg != NULL)
+    // Move the link's segments to a larger ring if its ring is full
+    if (ring->count == ring->size &&
+        !growring(pr, k, MAX(2 * ring->size, MINRING)))
     {
-        seg = qual->FreeSeg;
-        qual->FreeSeg = seg->prev;
+        qual->OutOfMemory = TRUE;
+        return;
     }
 
-    // Otherwise allocate a new segment
+    // Assign volume and quality to a new last segment
+    seg = SEGMENT(qual, ring, ring->count);
+    seg->v = v;
+    for (i = 0; i <= qual->Nconstits; i++) SEGQUAL(qual, i, seg) = c[i];
+    ring->count++;
+}
+
+
+int samequal(Project *pr, Pseg seg, double *c)
+/*
+**-------------------------------------------------------------
+**   Input:   seg = a pipe or tank segment
+**            c = quality of each constituent
+**   Output:  returns TRUE if the segment's quality is within
+**            tolerance of c for every constituent
+**   Purpose: checks if flow can be merged into a segment.
+**-------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+    int i;
+
+    for (i = 0; i <= qual->Nconstits; i++)
+    {
+        if (!(fabs(SEGQUAL(qual, i, seg) - c[i]) < qual->Constit[i].Ctol))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+void removeseg(Project *pr, int k)
+/*
+**-------------------------------------------------------------
+**   Input:   k = segment chain index
+**   Output:  none
+**   Purpose: removes the first (most downstream) segment
+**            of a link.
+**-------------------------------------------------------------
+*/
+{
+    Sring *ring = &pr->quality.SegRing[k];
+
+    if (ring->count == 0) return;
+    ring->head = (ring->head + ring->dir) & (ring->size - 1);
+    ring->count--;
+}
+
+
+int growring(Project *pr, int k, int size)
+/*
+**-------------------------------------------------------------
+**   Input:   k = segment chain index
+**            size = new ring capacity (a power of 2)
+**   Output:  returns TRUE if successful, FALSE if out of memory
+**   Purpose: moves a link's segments into a larger ring placed
+**            at the top of the segment arena.
+**-------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+    Sring *ring = &qual->SegRing[k];
+
+    int i, j, base, pos;
+    Pseg buf;
+
+    // Take room for the new ring from the top of the arena
+    // (locked as worker threads may be growing other rings)
+    if (qual->Pool) workpool_lock(qual->Pool);
+    if (size > qual->SegCapacity - qual->SegTop &&
+        !compactsegs(pr, size)) base = -1;
     else
     {
-        seg = (struct Sseg *) mempool_alloc(qual->SegPool, sizeof(struct Sseg));
-        if (seg == NULL)
+        base = qual->SegTop;
+        qual->SegTop += size;
+    }
+    if (qual->Pool) workpool_unlock(qual->Pool);
+    if (base < 0) return FALSE;
+
+    // Copy the segments into the new ring from first to last
+    buf = qual->Segs + base;
+    for (i = 0; i < ring->count; i++)
+    {
+        pos = (int)(SEGMENT(qual, ring, i) - qual->Segs);
+        buf[i] = qual->Segs[pos];
+        for (j = 0; j <= qual->Nconstits; j++)
         {
-            qual->OutOfMemory = TRUE;
-            return;
+            qual->SegQual[j][base + i] = qual->SegQual[j][pos];
         }
     }
+    ring->base = base;
+    ring->size = size;
+    ring->head = 0;
+    ring->dir = 1;
+    return TRUE;
+}
 
-    // Assign volume and quality to the segment
-    seg->v = v;
-    seg->c = c;
-
-    // Add the new segment to the end of the segment chain
-    seg->prev = NULL;
-    if (qual->FirstSeg[k] == NULL) qual->FirstSeg[k] = seg;
-    if (qual->LastSeg[k] != NULL)  qual->LastSeg[k]->prev = seg;
-    qual->LastSeg[k] = seg;
-    qual->MassBalance.segCount++;                                     
+
+int compactsegs(Project *pr, int need)
+/*
+**-------------------------------------------------------------
+**   Input:   need = number of free arena positions required
+**   Output:  returns TRUE if successful, FALSE if out of memory
+**   Purpose: copies every link's segment ring into a new arena,
+**            dropping the space left behind by rings that grew.
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, j, k, n, nc, top, pos, capacity;
+    Sring *ring;
+    Pseg segs;
+    double *segqual;
+
+    // Size the new arena to hold the rings in use with room to grow
+    n = net->Nlinks + net->Ntanks;
+    top = 0;
+    for (k = 1; k <= n; k++) top += qual->SegRing[k].size;
+    if (top > INT_MAX / 2 - need) return FALSE;
+    capacity = MAX(qual->SegCapacity, 2 * (top + need));
+    nc = qual->Nconstits + 1;
+    segs = (Pseg)malloc(capacity * sizeof(struct Sseg));
+    segqual = (double *)malloc((size_t)nc * capacity * sizeof(double));
+    if (segs == NULL || segqual == NULL)
+    {
+        free(segs);
+        free(segqual);
+        return FALSE;
+    }
+
+    // Copy each ring's segments from first to last, in link order
+    top = 0;
+    for (k = 1; k <= n; k++)
+    {
+        ring = &qual->SegRing[k];
+        for (i = 0; i < ring->count; i++)
+        {
+            pos = (int)(SEGMENT(qual, ring, i) - qual->Segs);
+            segs[top + i] = qual->Segs[pos];
+            for (j = 0; j < nc; j++)
+            {
+                segqual[(size_t)j * capacity + top + i] =
+                    qual->SegQual[j][pos];
+            }
+        }
+        ring->base = top;
+        ring->head = 0;
+        ring->dir = 1;
+        top += ring->size;
+    }
+    free(qual->Segs);
+    free(qual->SegQual[0]);
+    qual->Segs = segs;
+    qual->SegCapacity = capacity;
+    qual->SegTop = top;
+    for (j = 0; j < nc; j++) qual->SegQual[j] = segqual + (size_t)j * capacity;
+    return TRUE;
+}
+
+
+void limitsegs(Project *pr)
+/*
+**-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: records the most segments held and, once they near
+**            the segment budget, merges neighbouring segments
+**            in the pipes holding the most of them.
+**   Note:    segments are first merged if their quality is
+**            within each constituent's tolerance, which is then
+**            doubled until enough segments have been merged.
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i, k, m, n, nsegs = 0, more;
+    double f;
+    Spipesegs *pipes;
+
+    // Count the segments held in pipes & tanks
+    n = net->Nlinks + net->Ntanks;
+    for (k = 1; k <= n; k++) nsegs += qual->SegRing[k].count;
+    qual->Peaksegs = MAX(qual->Peaksegs, nsegs);
+    if (qual->SegBudget <= 0 || qual->Eulerflag ||
+        nsegs <= BUDGETHIGH * qual->SegBudget) return;
+
+    // List pipes with more than one segment, most segments first
+    pipes = (Spipesegs *)malloc(net->Nlinks * sizeof(Spipesegs));
+    if (pipes == NULL) return;
+    m = 0;
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        if (net->Link[k].Type != PIPE || qual->SegRing[k].count < 2) continue;
+        pipes[m].count = qual->SegRing[k].count;
+        pipes[m].link = k;
+        m++;
+    }
+    qsort(pipes, m, sizeof(Spipesegs), comparepipesegs);
+
+    // Merge segments in the listed pipes, relaxing the merge
+    // tolerance until few enough segments are left
+    f = 1.0;
+    while (nsegs > BUDGETLOW * qual->SegBudget)
+    {
+        more = FALSE;
+        for (i = 0; i < m && nsegs > BUDGETLOW * qual->SegBudget; i++)
+        {
+            k = pipes[i].link;
+            n = mergesegs(pr, k, f);
+            nsegs -= n;
+            qual->MassBalance.segCount -= n;
+            if (qual->SegRing[k].count > 1) more = TRUE;
+        }
+        if (!more) break;
+        f *= 2.0;
+    }
+    free(pipes);
+}
+
+
+int mergesegs(Project *pr, int k, double f)
+/*
+**-------------------------------------------------------------
+**   Input:   k = pipe index
+**            f = factor applied to each constituent's tolerance
+**   Output:  returns the number of segments removed
+**   Purpose: merges runs of neighbouring segments in a pipe
+**            whose spread in quality is within f times the
+**            tolerance of each constituent.
+**   Note:    merged segments take the volume-weighted average
+**            of their quality so that no mass is lost.
+**-------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+    Sring *ring = &qual->SegRing[k];
+
+    int i, j, m, merge, count = ring->count;
+    int nc = qual->Nconstits + 1;
+    double c, v, tol;
+    double cmin[MAXCONSTITS + 1], cmax[MAXCONSTITS + 1];
+    Pseg seg, last;
+
+    if (count < 2) return 0;
+
+    // Start a run with the pipe's first segment
+    m = 0;
+    last = SEGMENT(qual, ring, 0);
+    for (j = 0; j < nc; j++) cmin[j] = cmax[j] = SEGQUAL(qual, j, last);
+
+    // Examine each segment behind it
+    for (i = 1; i < count; i++)
+    {
+        // ... check if the segment can join the current run
+        seg = SEGMENT(qual, ring, i);
+        merge = TRUE;
+        for (j = 0; j < nc && merge; j++)
+        {
+            c = SEGQUAL(qual, j, seg);
+            tol = f * MAX(qual->Constit[j].Ctol, MINMERGETOL);
+            if (!(MAX(cmax[j], c) - MIN(cmin[j], c) < tol)) merge = FALSE;
+        }
+
+        // ... if so then mix it into the run's segment
+        if (merge)
+        {
+            v = last->v + seg->v;
+            for (j = 0; j < nc; j++)
+            {
+                c = SEGQUAL(qual, j, seg);
+                cmin[j] = MIN(cmin[j], c);
+                cmax[j] = MAX(cmax[j], c);
+                if (v > 0.0)
+                {
+                    SEGQUAL(qual, j, last) = (SEGQUAL(qual, j, last) *
+                                              last->v + c * seg->v) / v;
+                }
+            }
+            last->v = v;
+            qual->MergeError = MAX(qual->MergeError, cmax[0] - cmin[0]);
+        }
+
+        // ... otherwise start a new run with it
+        else
+        {
+            m++;
+            last = SEGMENT(qual, ring, m);
+            *last = *seg;
+            for (j = 0; j < nc; j++)
+            {
+                SEGQUAL(qual, j, last) = SEGQUAL(qual, j, seg);
+                cmin[j] = cmax[j] = SEGQUAL(qual, j, last);
+            }
+        }
+    }
+    ring->count = m + 1;
+    return count - ring->count;
+}
+
+
+int comparepipesegs(const void *a, const void *b)
+/*
+**-------------------------------------------------------------
+**   Input:   a, b = pointers to the segment counts of two pipes
+**   Output:  returns -1, 0 or 1
+**   Purpose: orders pipes for qsort() by decreasing number of
+**            segments (then by increasing index).
+**-------------------------------------------------------------
+*/
+{
+    const Spipesegs *p1 = (const Spipesegs *)a;
+    const Spipesegs *p2 = (const Spipesegs *)b;
+
+    if (p1->count != p2->count) return (p1->count > p2->count) ? -1 : 1;
+    return (p1->link > p2->link) - (p1->link < p2->link);
 }
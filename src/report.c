@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/14/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -505,6 +505,28 @@ void writemassbalance(Project *pr)
     writeline(pr, s1);
     snprintf(s1, MAXMSG, "Total Segments:     %d", qual->MassBalance.segCount);
     writeline(pr, s1);                          
+
+    // Transport solver diagnostics (also available from
+    // EN_getstatistic) only appear in a full status report
+    if (pr->report.Statflag == FULL)
+    {
+        snprintf(s1, MAXMSG, "Full Node Sorts:    %d", qual->Nfullsorts);
+        writeline(pr, s1);
+        snprintf(s1, MAXMSG, "Local Node Sorts:   %d", qual->Nlocalsorts);
+        writeline(pr, s1);
+        snprintf(s1, MAXMSG, "Quality Steps:      %d", qual->Nqualsteps);
+        writeline(pr, s1);
+        snprintf(s1, MAXMSG, "Peak Segments:      %d (%.1f KB)", qual->Peaksegs,
+                 qual->Peaksegs * (sizeof(struct Sseg) +
+                 (qual->Nconstits + 1) * sizeof(double)) / 1024.0);
+        writeline(pr, s1);
+    }
+    if (qual->SegBudget > 0)
+    {
+        snprintf(s1, MAXMSG, "Merge Error Bound:  %-.5f",
+                 qual->MergeError * pr->Ucf[QUALITY]);
+        writeline(pr, s1);
+    }
     snprintf(s1, MAXMSG, "================================\n");
     writeline(pr, s1);
 }
@@ -1508,6 +1530,9 @@ void writetime(Project *pr, char *fmt)
 */
 {
     time_t timer;
+
+    // ctime() isn't thread safe so skip it when there's no report
+    if (pr->report.RptFile == NULL) return;
     time(&timer);
     sprintf(pr->Msg, fmt, ctime(&timer));
     writeline(pr, pr->Msg);
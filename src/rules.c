@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/11/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -79,12 +79,19 @@ char *Operator[] = {"=",  "<>",  "<=",    ">=",    "<", ">",
 enum Values { IS_NUMBER, IS_OPEN, IS_CLOSED, IS_ACTIVE };
 char *Value[] = {"XXXX", w_OPEN, w_CLOSED, w_ACTIVE, NULL};
 
+// Types of variables tracked by the rule dependency index
+enum Watchtypes { WATCH_NODE, WATCH_LINK, WATCH_DEMAND, WATCH_CLOCK };
+
 // Local functions
 static void newrule(Project *);
 static int  newpremise(Project *, int);
 static int  newaction(Project *);
 static int  newpriority(Project *);
 
+static int  addwatch(Project *, Spremise *, int *, int *, int *);
+static void freerulecode(Rules *);
+static void findstalerules(Project *);
+
 static int  evalpremises(Project *, int);
 static int  checkpremise(Project *, Spremise *);
 static int  checktime(Project *, Spremise *);
@@ -113,6 +120,15 @@ void initrules(Project *pr)
     pr->rules.LastThenAction = NULL;
     pr->rules.LastElseAction = NULL;
     pr->rules.ActionList = NULL;
+    pr->rules.Compiled = FALSE;
+    pr->rules.Nwatches = 0;
+    pr->rules.PremStart = NULL;
+    pr->rules.DepRules = NULL;
+    pr->rules.IsStale = NULL;
+    pr->rules.RuleResult = NULL;
+    pr->rules.Premises = NULL;
+    pr->rules.Watches = NULL;
+    pr->rules.LinkAction = NULL;
     pr->network.Rule = NULL;
 }
 
@@ -151,6 +167,7 @@ void deleterule(Project *pr, int index)
 
     // Reduce active rule count by one
     net->Nrules--;
+    pr->rules.Compiled = FALSE;
 }
 
 int allocrules(Project *pr)
@@ -173,6 +190,9 @@ void freerules(Project *pr)
 {
     int i;
 
+    // Free compiled form of rules
+    freerulecode(&pr->rules);
+
     // Already freed
     if (pr->network.Rule == NULL)
         return;
@@ -360,6 +380,9 @@ void adjustrules(Project *pr, int objtype, int index)
     Spremise *p;
     Saction *a;
 
+    // Rule indexes will change
+    pr->rules.Compiled = FALSE;
+
     // Delete rules that refer to objtype and index
     for (i = net->Nrules; i >= 1; i--)
     {
@@ -425,6 +448,7 @@ void adjusttankrules(Project *pr, int ndiff)
     int i, njuncs;
     Spremise *p;
 
+    pr->rules.Compiled = FALSE;
     njuncs = net->Njuncs;
     for (i = 1; i <= net->Nrules; i++)
     {
@@ -520,9 +544,142 @@ int writerule(Project *pr, FILE *f, int ruleIndex)
     return 0;
 }
 
+int compilerules(Project *pr)
+//-----------------------------------------------------------------------------
+//  Compiles the premises of all rules into a single array and builds
+//  an index of the rules that depend on each node, link or time variable.
+//-----------------------------------------------------------------------------
+{
+    Network *net = &pr->network;
+    Rules   *rules = &pr->rules;
+
+    int i, k, w, nprem;
+    int errcode = 0;
+    int *nodewatch = NULL,   // index item of each node
+        *linkwatch = NULL,   // index item of each link
+        syswatch[2],         // index items of system demand & time
+        *premwatch = NULL,   // index item of each compiled premise
+        *lastrule = NULL;    // last rule added to each index item
+    Spremise *p;
+    SruleWatch *watch;
+
+    // Count number of premises
+    freerulecode(rules);
+    nprem = 0;
+    for (i = 1; i <= net->Nrules; i++)
+    {
+        for (p = net->Rule[i].Premises; p != NULL; p = p->next) nprem++;
+    }
+
+    // Allocate memory for the compiled rules
+    rules->PremStart = (int *)calloc(net->Nrules + 2, sizeof(int));
+    rules->Premises = (Spremise *)calloc(nprem + 1, sizeof(Spremise));
+    rules->Watches = (SruleWatch *)calloc(nprem + 1, sizeof(SruleWatch));
+    rules->DepRules = (int *)calloc(nprem + 1, sizeof(int));
+    rules->IsStale = (char *)calloc(net->Nrules + 1, sizeof(char));
+    rules->RuleResult = (char *)calloc(net->Nrules + 1, sizeof(char));
+    rules->LinkAction = (SactionList *)calloc(net->Nlinks + 1,
+                                              sizeof(SactionList));
+    nodewatch = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    linkwatch = (int *)calloc(net->Nlinks + 1, sizeof(int));
+    premwatch = (int *)calloc(nprem + 1, sizeof(int));
+    lastrule = (int *)calloc(nprem + 1, sizeof(int));
+    ERRCODE(MEMCHECK(rules->PremStart));
+    ERRCODE(MEMCHECK(rules->Premises));
+    ERRCODE(MEMCHECK(rules->Watches));
+    ERRCODE(MEMCHECK(rules->DepRules));
+    ERRCODE(MEMCHECK(rules->IsStale));
+    ERRCODE(MEMCHECK(rules->RuleResult));
+    ERRCODE(MEMCHECK(rules->LinkAction));
+    ERRCODE(MEMCHECK(nodewatch));
+    ERRCODE(MEMCHECK(linkwatch));
+    ERRCODE(MEMCHECK(premwatch));
+    ERRCODE(MEMCHECK(lastrule));
+
+    if (!errcode)
+    {
+        // Copy each rule's premises into a contiguous block and find
+        // the index item each premise depends on
+        syswatch[0] = 0;
+        syswatch[1] = 0;
+        rules->Nwatches = 0;
+        k = 0;
+        for (i = 1; i <= net->Nrules; i++)
+        {
+            rules->PremStart[i] = k;
+            for (p = net->Rule[i].Premises; p != NULL; p = p->next)
+            {
+                rules->Premises[k] = *p;
+                rules->Premises[k].next = NULL;
+                w = addwatch(pr, p, nodewatch, linkwatch, syswatch);
+                premwatch[k] = w;
+                k++;
+
+                // Count rule only once for each index item
+                if (lastrule[w] != i)
+                {
+                    rules->Watches[w].count++;
+                    lastrule[w] = i;
+                }
+            }
+        }
+        rules->PremStart[net->Nrules + 1] = k;
+
+        // Find where each index item's list of dependent rules begins
+        k = 0;
+        for (w = 0; w < rules->Nwatches; w++)
+        {
+            watch = &rules->Watches[w];
+            watch->first = k;
+            k += watch->count;
+            watch->count = 0;
+            lastrule[w] = 0;
+        }
+
+        // Fill in the list of dependent rules
+        for (i = 1; i <= net->Nrules; i++)
+        {
+            for (k = rules->PremStart[i]; k < rules->PremStart[i + 1]; k++)
+            {
+                w = premwatch[k];
+                if (lastrule[w] == i) continue;
+                watch = &rules->Watches[w];
+                rules->DepRules[watch->first + watch->count] = i;
+                watch->count++;
+                lastrule[w] = i;
+            }
+        }
+        rules->Compiled = TRUE;
+        resetrules(pr);
+    }
+    else freerulecode(rules);
+
+    free(nodewatch);
+    free(linkwatch);
+    free(premwatch);
+    free(lastrule);
+    return errcode;
+}
+
+void resetrules(Project *pr)
+//-----------------------------------------------------------------------------
+//  Marks all rules for re-evaluation (e.g., after a change in network data
+//  that the rule dependency index does not track).
+//-----------------------------------------------------------------------------
+{
+    Rules *rules = &pr->rules;
+
+    int i;
+
+    if (!rules->Compiled) return;
+    for (i = 1; i <= pr->network.Nrules; i++) rules->IsStale[i] = TRUE;
+}
+
 int checkrules(Project *pr, long dt)
 //-----------------------------------------------------
-//    Checks which rules should fire at current time.
+//    Checks which rules should fire at current time
+//    (the rules must have been compiled, which
+//    ruletimestep() in HYDRAUL.C makes sure of).
 //-----------------------------------------------------
 {
     Network *net = &pr->network;
@@ -535,6 +692,9 @@ int checkrules(Project *pr, long dt)
                             // Start of rule evaluation time interval
     rules->Time1 = time->Htime - dt + 1;
 
+    // Find which rules depend on variables that have changed
+    findstalerules(pr);
+
     // Iterate through each rule
     rules->ActionList = NULL;
     for (i = 1; i <= net->Nrules; i++)
@@ -544,8 +704,16 @@ int checkrules(Project *pr, long dt)
         {
             continue;
         }
+
+        // Re-evaluate premises only if their variables have changed
+        if (rules->IsStale[i])
+        {
+            rules->RuleResult[i] = (char)evalpremises(pr, i);
+            rules->IsStale[i] = FALSE;
+        }
+
         // If premises true, add THEN clauses to action list
-        if (evalpremises(pr, i) == TRUE)
+        if (rules->RuleResult[i] == TRUE)
         {
             updateactionlist(pr, i, net->Rule[i].ThenActions);
         }
@@ -579,6 +747,7 @@ void updateruleunits(Project *pr, double dcf, double pcf, double hcf, double qcf
     Spremise *p;
     Saction *a;
     
+    pr->rules.Compiled = FALSE;
     for (i = 1; i <= net->Nrules; i++)
     {
         p = net->Rule[i].Premises;
@@ -702,6 +871,7 @@ void newrule(Project *pr)
     rule->ElseActions = NULL;
     rule->priority = 0.0;
     rule->isEnabled = TRUE;
+    pr->rules.Compiled = FALSE;
     pr->rules.LastPremise = NULL;
     pr->rules.LastThenAction = NULL;
     pr->rules.LastElseAction = NULL;
@@ -950,15 +1120,15 @@ int evalpremises(Project *pr, int i)
 //    Checks if premises to rule i are true
 //----------------------------------------------------------
 {
-    Network *net = &pr->network;
+    Rules *rules = &pr->rules;
 
-    int result;
+    int k, result;
     Spremise *p;
 
     result = TRUE;
-    p = net->Rule[i].Premises;
-    while (p != NULL)
+    for (k = rules->PremStart[i]; k < rules->PremStart[i + 1]; k++)
     {
+        p = &rules->Premises[k];
         if (p->logop == r_OR)
         {
             if (result == FALSE) result = checkpremise(pr, p);
@@ -968,7 +1138,6 @@ int evalpremises(Project *pr, int i)
             if (result == FALSE) return (FALSE);
             result = checkpremise(pr, p);
         }
-        p = p->next;
     }
     return result;
 }
@@ -1190,14 +1359,11 @@ void updateactionlist(Project *pr, int i, Saction *actions)
         // Add action to list if its link not already on it
         if (!onactionlist(pr, i, a))
         {
-            actionItem = (SactionList *)malloc(sizeof(SactionList));
-            if (actionItem != NULL)
-            {
-                actionItem->action = a;
-                actionItem->ruleIndex = i;
-                actionItem->next = rules->ActionList;
-                rules->ActionList = actionItem;
-            }
+            actionItem = &rules->LinkAction[a->link];
+            actionItem->action = a;
+            actionItem->ruleIndex = i;
+            actionItem->next = rules->ActionList;
+            rules->ActionList = actionItem;
         }
         a = a->next;
     }
@@ -1210,36 +1376,22 @@ int onactionlist(Project *pr, int i, Saction *a)
 {
     Network *net = &pr->network;
 
-    int link, i1;
     SactionList *actionItem;
-    Saction *a1;
-
-    // Search action list for link included in action a
-    link = a->link;
-    actionItem = pr->rules.ActionList;
-    while (actionItem != NULL)
-    {
-        a1 = actionItem->action;
-        i1 = actionItem->ruleIndex;
 
-        // Link appears in list
-        if (link == a1->link)
-        {
-            // Replace its action with 'a' if rule i has higher priority
-            if (net->Rule[i].priority > net->Rule[i1].priority)
-            {
-                actionItem->action = a;
-                actionItem->ruleIndex = i;
-            }
+    // Each link has its own item on the action list
+    actionItem = &pr->rules.LinkAction[a->link];
+    if (actionItem->action == NULL) return 0;
 
-            // Return indicating that 'a' should not be added to action list
-            return 1;
-        }
-        actionItem = actionItem->next;
+    // Link appears in list so replace its action with 'a'
+    // if rule i has higher priority
+    if (net->Rule[i].priority > net->Rule[actionItem->ruleIndex].priority)
+    {
+        actionItem->action = a;
+        actionItem->ruleIndex = i;
     }
 
-    // Return indicating that it's ok to add 'a' to the action list
-    return 0;
+    // Return indicating that 'a' should not be added to action list
+    return 1;
 }
 
 int takeactions(Project *pr)
@@ -1325,7 +1477,7 @@ int takeactions(Project *pr)
 
 void clearactionlist(Rules *rules)
 //----------------------------------------------------------
-//    Clears memory used for action list
+//    Clears the items on the action list
 //----------------------------------------------------------
 {
     SactionList *nextItem;
@@ -1334,9 +1486,145 @@ void clearactionlist(Rules *rules)
     while (actionItem != NULL)
     {
         nextItem = actionItem->next;
-        free(actionItem);
+        actionItem->action = NULL;
+        actionItem->next = NULL;
         actionItem = nextItem;
     }
+    rules->ActionList = NULL;
+}
+
+int addwatch(Project *pr, Spremise *p, int *nodewatch, int *linkwatch,
+             int *syswatch)
+//-----------------------------------------------------------------------------
+//  Returns the rule dependency index item for the variable tested by
+//  premise p, adding a new item if none exists.
+//-----------------------------------------------------------------------------
+{
+    Network *net = &pr->network;
+    Rules   *rules = &pr->rules;
+
+    int type, index, *w;
+    SruleWatch *watch;
+
+    // Find the type of variable the premise depends on
+    // (premises with invalid object indexes are re-evaluated every time)
+    index = p->index;
+    if (p->variable == r_TIME || p->variable == r_CLOCKTIME)
+    {
+        type = WATCH_CLOCK;
+    }
+    else if (p->object == r_SYSTEM) type = WATCH_DEMAND;
+    else if (p->object == r_NODE && index > 0 && index <= net->Nnodes)
+    {
+        type = WATCH_NODE;
+    }
+    else if (p->object == r_LINK && index > 0 && index <= net->Nlinks)
+    {
+        type = WATCH_LINK;
+    }
+    else type = WATCH_CLOCK;
+
+    // Find the location that holds the variable's index item
+    switch (type)
+    {
+      case WATCH_NODE:   w = &nodewatch[index]; break;
+      case WATCH_LINK:   w = &linkwatch[index]; break;
+      case WATCH_DEMAND: w = &syswatch[0];      break;
+      default:           w = &syswatch[1];
+    }
+
+    // Add a new index item if needed (item numbers stored offset by 1)
+    if (*w == 0)
+    {
+        watch = &rules->Watches[rules->Nwatches];
+        watch->type = type;
+        watch->index = index;
+        watch->count = 0;
+        watch->x[0] = MISSING;
+        watch->x[1] = MISSING;
+        watch->x[2] = MISSING;
+        rules->Nwatches++;
+        *w = rules->Nwatches;
+    }
+    return *w - 1;
+}
+
+void freerulecode(Rules *rules)
+//-----------------------------------------------------------------------------
+//  Frees memory used by the compiled form of a project's rules.
+//-----------------------------------------------------------------------------
+{
+    FREE(rules->PremStart);
+    FREE(rules->Premises);
+    FREE(rules->Watches);
+    FREE(rules->DepRules);
+    FREE(rules->IsStale);
+    FREE(rules->RuleResult);
+    FREE(rules->LinkAction);
+    rules->ActionList = NULL;
+    rules->Nwatches = 0;
+    rules->Compiled = FALSE;
+}
+
+void findstalerules(Project *pr)
+//-----------------------------------------------------------------------------
+//  Marks for re-evaluation the rules whose variables have changed since
+//  the rules were last checked.
+//-----------------------------------------------------------------------------
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Rules   *rules = &pr->rules;
+
+    int i, j, w, changed;
+    double x[3];
+    SruleWatch *watch;
+
+    for (w = 0; w < rules->Nwatches; w++)
+    {
+        watch = &rules->Watches[w];
+        i = watch->index;
+        x[0] = 0.0;
+        x[1] = 0.0;
+        x[2] = 0.0;
+        switch (watch->type)
+        {
+          case WATCH_NODE:
+            x[0] = hyd->NodeHead[i];
+            x[1] = hyd->NodeDemand[i];
+            if (i > net->Njuncs) x[2] = net->Tank[i - net->Njuncs].V;
+            break;
+
+          case WATCH_LINK:
+            x[0] = hyd->LinkFlow[i];
+            x[1] = hyd->LinkStatus[i];
+            x[2] = hyd->LinkSetting[i];
+            break;
+
+          case WATCH_DEMAND:
+            x[0] = hyd->Dsystem;
+            break;
+        }
+
+        // Mark the dependent rules as stale if any variable has changed
+        // (time changes every time the rules are checked)
+        changed = (watch->type == WATCH_CLOCK);
+        for (j = 0; j < 3; j++)
+        {
+            if (x[j] != watch->x[j])
+            {
+                watch->x[j] = x[j];
+                changed = TRUE;
+            }
+        }
+        if (changed)
+        {
+            for (j = watch->first; j < watch->first + watch->count; j++)
+            {
+                rules->IsStale[rules->DepRules[j]] = TRUE;
+            }
+        }
+    }
 }
 
 void clearrule(Project *pr, int i)
@@ -0,0 +1,1023 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       schedule.c
+ Description:  schedules simple control activations and tank fill/drain events
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+After each hydraulic time step the solver must find which simple controls
+activate at the current time and how long it will be until the next control
+activates or the next tank fills or drains. Rather than examining every
+control and tank each time, this module keeps them in the following
+structures:
+
+  - a min-heap of TIMER and TIMEOFDAY controls keyed on the next time at
+    which each control activates;
+  - for each tank, lists of its LOWLEVEL and HILEVEL controls sorted by
+    control grade, along with the tank volume at each grade, so that the
+    controls triggered by the tank's current volume, or the next ones it
+    will reach, are found by binary search;
+  - an indexed min-heap of tanks keyed on the approximate time at which
+    each tank fills or drains. A tank is only re-keyed when its net inflow
+    changes; exact times are only computed for tanks near the top of the
+    heap.
+
+Controls that fit none of these categories are examined individually. The
+schedule is built when the hydraulic solver is opened and rebuilt whenever
+the simulation clock is reset or control or tank data are edited. The time
+steps and control actions it produces are identical to those found by
+examining every control and tank in turn.
+*/
+
+#include <stdlib.h>
+
+#include "types.h"
+#include "funcs.h"
+
+// Exported functions (declared in funcs.h)
+//int     openschedule(Project *);
+//void    closeschedule(Project *);
+//void    resetschedule(Project *);
+//int     firedcontrols(Project *);
+//int     tanktimestep(Project *, long *);
+//int     controltimestep(Project *, long *);
+
+// Imported variables
+extern const double QZERO;
+
+// Key of an event that never occurs
+static const double NEVER = 1.e30;
+
+// Control categories
+enum ControlClass {TIMED_CONTROL, LEVEL_CONTROL, OTHER_CONTROL};
+
+// Local functions
+static int    build_schedule(Project *pr);
+static void   free_schedule(Sschedule *sched);
+static int    sync_schedule(Project *pr);
+static int    control_class(Project *pr, int i);
+static int    control_fires(Project *pr, int i);
+static long   control_time(Project *pr, int i);
+static int    control_changes_link(Project *pr, int i);
+static double timer_key(Project *pr, int i, long t);
+static double tank_fill_time(Project *pr, int i);
+static void   update_tank_queue(Project *pr);
+static void   rekey_tank(Project *pr, int i, double xt);
+static void   add_level_controls(Project *pr, int *nfired);
+static int    first_level_above(Project *pr, int first, int last, double h);
+static void   check_level_timestep(Project *pr, int first, int last,
+              int ascending, double q, long *tbest, int *ibest);
+static void   consider_control(Project *pr, int i, long t,
+              long *tbest, int *ibest);
+static void   sift_up(SqueueItem *q, int *slot, int pos);
+static void   sift_down(SqueueItem *q, int *slot, int n, int pos);
+static int    compare_ints(const void *a, const void *b);
+static int    compare_items(const void *a, const void *b);
+
+
+int openschedule(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns an error code
+**   Purpose: opens (or re-builds) the control & tank event schedule
+**-------------------------------------------------------------
+*/
+{
+    Sschedule *sched = &pr->hydraul.schedule;
+
+    sched->Open = TRUE;
+    return build_schedule(pr);
+}
+
+void closeschedule(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: frees memory used by the event schedule
+**-------------------------------------------------------------
+*/
+{
+    Sschedule *sched = &pr->hydraul.schedule;
+
+    free_schedule(sched);
+    sched->Open = FALSE;
+}
+
+void resetschedule(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: marks the event schedule as needing to be re-built
+**-------------------------------------------------------------
+*/
+{
+    pr->hydraul.schedule.Built = FALSE;
+}
+
+int firedcontrols(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns number of controls activated at current time
+**   Purpose: places the indexes of all simple controls activated
+**            at the current time, in increasing order, into the
+**            schedule's Fired array.
+**   Note:    the schedule must have been built by openschedule().
+**-------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Sschedule *sched = &pr->hydraul.schedule;
+    double    htime = (double)pr->times.Htime;
+
+    int i, m, pos, nstack, nfired = 0;
+    Scontrol *control;
+
+    if (!sync_schedule(pr)) return 0;
+
+    // Controls examined individually
+    for (m = 0; m < sched->Nother; m++)
+    {
+        i = sched->Other[m];
+        control = &net->Control[i];
+        if (!control->isEnabled || control->Link <= 0) continue;
+        if (control_fires(pr, i)) sched->Fired[nfired++] = i;
+    }
+
+    // Time-based controls whose activation time equals current time
+    nstack = 0;
+    if (sched->Ntimers > 0) sched->Stack[nstack++] = 0;
+    while (nstack > 0)
+    {
+        pos = sched->Stack[--nstack];
+        if (sched->TimerQueue[pos].key > htime) continue;
+        i = sched->TimerQueue[pos].index;
+        if (net->Control[i].isEnabled) sched->Fired[nfired++] = i;
+        if (2 * pos + 1 < sched->Ntimers) sched->Stack[nstack++] = 2 * pos + 1;
+        if (2 * pos + 2 < sched->Ntimers) sched->Stack[nstack++] = 2 * pos + 2;
+    }
+
+    // Controls triggered by current tank levels
+    add_level_controls(pr, &nfired);
+
+    // Controls are applied in the order they were defined (when many
+    // controls fire, flagging them and scanning the flags is quicker
+    // than sorting)
+    if (nfired > 1 && nfired < net->Ncontrols / 32)
+    {
+        qsort(sched->Fired, nfired, sizeof(int), compare_ints);
+    }
+    else if (nfired > 1)
+    {
+        for (m = 0; m < nfired; m++) sched->IsFired[sched->Fired[m]] = TRUE;
+        nfired = 0;
+        for (i = 1; i <= net->Ncontrols; i++)
+        {
+            if (!sched->IsFired[i]) continue;
+            sched->IsFired[i] = FALSE;
+            sched->Fired[nfired++] = i;
+        }
+    }
+    return nfired;
+}
+
+int tanktimestep(Project *pr, long *tstep)
+/*
+**-----------------------------------------------------------------
+**  Input:   *tstep = current time step
+**  Output:  *tstep = modified current time step
+**           returns index of the node of the tank that fills or
+**           drains first (0 if none does within the time step)
+**  Purpose: revises time step based on shortest time to fill or
+**           drain a tank
+**-----------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Sschedule *sched = &pr->hydraul.schedule;
+    double    htime = (double)pr->times.Htime;
+
+    int     i, pos, nstack, nvisited, ibest = 0;
+    long    t, tbest = *tstep;
+    double  xt;
+
+    // Examine each tank if no schedule is available
+    if (!sync_schedule(pr))
+    {
+        for (i = 1; i <= net->Ntanks; i++)
+        {
+            xt = tank_fill_time(pr, i);
+            if (ABS(xt) > tbest + 1) continue;
+            t = (long)ROUND(xt);
+            if (t > 0 && t < tbest)
+            {
+                tbest = t;
+                ibest = i;
+            }
+        }
+    }
+
+    // Otherwise search only those tanks in the tank queue whose
+    // approximate fill/drain time is within the current time step
+    else
+    {
+        update_tank_queue(pr);
+        nstack = 0;
+        nvisited = 0;
+        if (net->Ntanks > 0) sched->Stack[nstack++] = 0;
+        while (nstack > 0)
+        {
+            pos = sched->Stack[--nstack];
+            if (sched->TankQueue[pos].key - htime > tbest + 2) continue;
+            i = sched->TankQueue[pos].index;
+            xt = tank_fill_time(pr, i);
+            sched->TankVisit[nvisited] = i;
+            sched->TankTime[nvisited++] = xt;
+            if (2 * pos + 1 < net->Ntanks) sched->Stack[nstack++] = 2 * pos + 1;
+            if (2 * pos + 2 < net->Ntanks) sched->Stack[nstack++] = 2 * pos + 2;
+            if (ABS(xt) > tbest + 1) continue;
+
+            // Ties go to the lowest tank index
+            t = (long)ROUND(xt);
+            if (t > 0 && (t < tbest || (t == tbest && i < ibest)))
+            {
+                tbest = t;
+                ibest = i;
+            }
+        }
+
+        // Replace the approximate times of the tanks examined
+        for (pos = 0; pos < nvisited; pos++)
+        {
+            rekey_tank(pr, sched->TankVisit[pos], sched->TankTime[pos]);
+        }
+    }
+    *tstep = tbest;
+    if (ibest == 0) return 0;
+    return net->Tank[ibest].Node;
+}
+
+int controltimestep(Project *pr, long *tstep)
+/*
+**------------------------------------------------------------------
+**  Input:   *tstep = current time step
+**  Output:  *tstep = modified current time step
+**           returns index of the control that activates first
+**           (0 if none does within the time step)
+**  Purpose: revises time step based on shortest time to activate
+**           a simple control
+**------------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Hydraul   *hyd = &pr->hydraul;
+    Sschedule *sched = &hyd->schedule;
+    double    htime = (double)pr->times.Htime;
+
+    int    i, j, n, m, pos, nstack, ibest = 0;
+    int    *start;
+    long   tbest = *tstep;
+    double q;
+
+    // Examine each control if no schedule is available
+    if (!sync_schedule(pr))
+    {
+        for (i = 1; i <= net->Ncontrols; i++)
+        {
+            if (!net->Control[i].isEnabled) continue;
+            consider_control(pr, i, control_time(pr, i), &tbest, &ibest);
+        }
+        *tstep = tbest;
+        return ibest;
+    }
+
+    // Controls examined individually
+    for (m = 0; m < sched->Nother; m++)
+    {
+        i = sched->Other[m];
+        if (!net->Control[i].isEnabled) continue;
+        consider_control(pr, i, control_time(pr, i), &tbest, &ibest);
+    }
+
+    // Time-based controls that activate within the current time step
+    nstack = 0;
+    if (sched->Ntimers > 0) sched->Stack[nstack++] = 0;
+    while (nstack > 0)
+    {
+        pos = sched->Stack[--nstack];
+        if (sched->TimerQueue[pos].key - htime > tbest) continue;
+        i = sched->TimerQueue[pos].index;
+        if (net->Control[i].isEnabled)
+        {
+            consider_control(pr, i, (long)(sched->TimerQueue[pos].key - htime),
+                             &tbest, &ibest);
+        }
+        if (2 * pos + 1 < sched->Ntimers) sched->Stack[nstack++] = 2 * pos + 1;
+        if (2 * pos + 2 < sched->Ntimers) sched->Stack[nstack++] = 2 * pos + 2;
+    }
+
+    // Level controls of tanks that are filling or draining
+    start = sched->LevelStart;
+    for (j = 1; j <= net->Ntanks; j++)
+    {
+        n = net->Tank[j].Node;
+        q = hyd->NodeDemand[n];
+        if (ABS(q) <= QZERO) continue;
+        if (q > 0.0)
+        {
+            check_level_timestep(pr, start[2*j+1], start[2*j+2], TRUE, q,
+                                 &tbest, &ibest);
+        }
+        else
+        {
+            check_level_timestep(pr, start[2*j], start[2*j+1], FALSE, q,
+                                 &tbest, &ibest);
+        }
+    }
+    *tstep = tbest;
+    return ibest;
+}
+
+int build_schedule(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns an error code
+**   Purpose: builds the control & tank event schedule
+**-------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Sschedule *sched = &pr->hydraul.schedule;
+    long      htime = pr->times.Htime;
+
+    int  i, j, g, k, nc, nt, ng, errcode = 0;
+    int  *count;
+    Scontrol *control;
+
+    // Allocate memory for the schedule's arrays
+    free_schedule(sched);
+    nc = net->Ncontrols;
+    nt = net->Ntanks;
+    ng = 2 * (nt + 1);
+    sched->Other = (int *)calloc(nc + 1, sizeof(int));
+    sched->Fired = (int *)calloc(nc + 1, sizeof(int));
+    sched->LevelStart = (int *)calloc(ng + 1, sizeof(int));
+    sched->TankSlot = (int *)calloc(nt + 1, sizeof(int));
+    sched->TankVisit = (int *)calloc(nt + 1, sizeof(int));
+    sched->Stack = (int *)calloc(MAX(nc, nt) + 1, sizeof(int));
+    sched->IsFired = (char *)calloc(nc + 1, sizeof(char));
+    sched->LevelSorted = (char *)calloc(ng, sizeof(char));
+    sched->LevelVol = (double *)calloc(nc + 1, sizeof(double));
+    sched->TankInflow = (double *)calloc(nt + 1, sizeof(double));
+    sched->TankTime = (double *)calloc(nt + 1, sizeof(double));
+    sched->LevelList = (SqueueItem *)calloc(nc + 1, sizeof(SqueueItem));
+    sched->TimerQueue = (SqueueItem *)calloc(nc + 1, sizeof(SqueueItem));
+    sched->TankQueue = (SqueueItem *)calloc(nt + 1, sizeof(SqueueItem));
+    ERRCODE(MEMCHECK(sched->Other));
+    ERRCODE(MEMCHECK(sched->Fired));
+    ERRCODE(MEMCHECK(sched->LevelStart));
+    ERRCODE(MEMCHECK(sched->TankSlot));
+    ERRCODE(MEMCHECK(sched->TankVisit));
+    ERRCODE(MEMCHECK(sched->Stack));
+    ERRCODE(MEMCHECK(sched->IsFired));
+    ERRCODE(MEMCHECK(sched->LevelSorted));
+    ERRCODE(MEMCHECK(sched->LevelVol));
+    ERRCODE(MEMCHECK(sched->TankInflow));
+    ERRCODE(MEMCHECK(sched->TankTime));
+    ERRCODE(MEMCHECK(sched->LevelList));
+    ERRCODE(MEMCHECK(sched->TimerQueue));
+    ERRCODE(MEMCHECK(sched->TankQueue));
+    if (errcode)
+    {
+        free_schedule(sched);
+        return errcode;
+    }
+
+    // Place each control in the timer queue, the level lists of
+    // its tank or the list of controls examined individually
+    // (LevelStart temporarily holds the size of each level list)
+    count = sched->LevelStart;
+    for (i = 1; i <= nc; i++)
+    {
+        control = &net->Control[i];
+        switch (control_class(pr, i))
+        {
+        case TIMED_CONTROL:
+            k = sched->Ntimers++;
+            sched->TimerQueue[k].key = timer_key(pr, i, htime);
+            sched->TimerQueue[k].index = i;
+            sift_up(sched->TimerQueue, NULL, k);
+            break;
+        case LEVEL_CONTROL:
+            j = control->Node - net->Njuncs;
+            count[2*j + (control->Type == HILEVEL) + 1]++;
+            break;
+        default:
+            sched->Other[sched->Nother++] = i;
+        }
+    }
+
+    // Convert level list sizes to starting positions
+    for (g = 1; g <= ng; g++) count[g] += count[g-1];
+
+    // Fill each tank's level lists and sort them by control grade
+    for (i = 1; i <= nc; i++)
+    {
+        control = &net->Control[i];
+        if (control_class(pr, i) != LEVEL_CONTROL) continue;
+        j = control->Node - net->Njuncs;
+        g = 2*j + (control->Type == HILEVEL);
+        k = count[g]++;
+        sched->LevelList[k].key = control->Grade;
+        sched->LevelList[k].index = i;
+    }
+    for (g = ng; g > 0; g--) count[g] = count[g-1];
+    count[0] = 0;
+    for (g = 0; g < ng; g++)
+    {
+        qsort(&sched->LevelList[count[g]], count[g+1] - count[g],
+              sizeof(SqueueItem), compare_items);
+    }
+
+    // Find the tank volume at each level control's grade and check
+    // if volume increases with grade throughout each list
+    for (g = 0; g < ng; g++)
+    {
+        j = g / 2;
+        sched->LevelSorted[g] = TRUE;
+        for (k = count[g]; k < count[g+1]; k++)
+        {
+            sched->LevelVol[k] = tankvolume(pr, j, sched->LevelList[k].key);
+            if (k > count[g] && sched->LevelVol[k] < sched->LevelVol[k-1])
+            {
+                sched->LevelSorted[g] = FALSE;
+            }
+        }
+    }
+
+    // Tanks are given a time when their inflow is first examined
+    for (i = 1; i <= nt; i++)
+    {
+        sched->TankQueue[i-1].key = NEVER;
+        sched->TankQueue[i-1].index = i;
+        sched->TankSlot[i] = i - 1;
+        sched->TankInflow[i] = MISSING;
+    }
+    sched->Tref = htime;
+    sched->Built = TRUE;
+    return 0;
+}
+
+void free_schedule(Sschedule *sched)
+/*-------------------------------------------------------------
+**   Input:   sched = an event schedule
+**   Output:  none
+**   Purpose: frees memory used by an event schedule
+**-------------------------------------------------------------
+*/
+{
+    FREE(sched->Other);
+    FREE(sched->Fired);
+    FREE(sched->LevelStart);
+    FREE(sched->LevelList);
+    FREE(sched->TankSlot);
+    FREE(sched->TankVisit);
+    FREE(sched->Stack);
+    FREE(sched->IsFired);
+    FREE(sched->LevelSorted);
+    FREE(sched->LevelVol);
+    FREE(sched->TankInflow);
+    FREE(sched->TankTime);
+    FREE(sched->TimerQueue);
+    FREE(sched->TankQueue);
+    sched->Ntimers = 0;
+    sched->Nother = 0;
+    sched->Built = FALSE;
+}
+
+int sync_schedule(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns TRUE if the schedule can be used
+**   Purpose: brings the event schedule up to the current time,
+**            re-building it if necessary
+**-------------------------------------------------------------
+*/
+{
+    Sschedule *sched = &pr->hydraul.schedule;
+    long      htime = pr->times.Htime;
+
+    SqueueItem *top;
+
+    if (!sched->Open) return FALSE;
+    if (sched->Built && htime < sched->Tref) sched->Built = FALSE;
+    if (!sched->Built && build_schedule(pr) > 0) return FALSE;
+
+    // Advance time-based controls whose activation time has passed
+    if (htime > sched->Tref)
+    {
+        top = &sched->TimerQueue[0];
+        while (sched->Ntimers > 0 && top->key < (double)htime)
+        {
+            top->key = timer_key(pr, top->index, htime);
+            sift_down(sched->TimerQueue, NULL, sched->Ntimers, 0);
+        }
+        sched->Tref = htime;
+    }
+    return TRUE;
+}
+
+int control_class(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = control index
+**   Output:  returns the control's category
+**   Purpose: determines how a control is scheduled
+**-------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Scontrol *control = &net->Control[i];
+
+    if (control->Link <= 0) return OTHER_CONTROL;
+    switch (control->Type)
+    {
+    case TIMER:
+        if (control->Node == 0) return TIMED_CONTROL;
+        break;
+    case TIMEOFDAY:
+        if (control->Node == 0 && control->Time >= 0 &&
+            control->Time < SECperDAY) return TIMED_CONTROL;
+        break;
+    case LOWLEVEL:
+    case HILEVEL:
+        if (control->Node > net->Njuncs && control->Node <= net->Nnodes)
+            return LEVEL_CONTROL;
+        break;
+    }
+    return OTHER_CONTROL;
+}
+
+int control_fires(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = control index
+**   Output:  returns TRUE if control activates at current time
+**   Purpose: checks if an individual control activates
+**-------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Hydraul  *hyd = &pr->hydraul;
+    Times    *time = &pr->times;
+    Scontrol *control = &net->Control[i];
+
+    int    n, reset = 0;
+    double h, vplus, v1, v2;
+
+    // Link is controlled by tank level
+    if ((n = control->Node) > 0 && n > net->Njuncs)
+    {
+        h = hyd->NodeHead[n];
+        vplus = ABS(hyd->NodeDemand[n]);
+        v1 = tankvolume(pr, n - net->Njuncs, h);
+        v2 = tankvolume(pr, n - net->Njuncs, control->Grade);
+        if (control->Type == LOWLEVEL && v1 <= v2 + vplus) reset = 1;
+        if (control->Type == HILEVEL && v1 >= v2 - vplus)  reset = 1;
+    }
+
+    // Link is time-controlled
+    if (control->Type == TIMER)
+    {
+        if (control->Time == time->Htime) reset = 1;
+    }
+
+    // Link is time-of-day controlled
+    if (control->Type == TIMEOFDAY)
+    {
+        if ((time->Htime + time->Tstart) % SECperDAY == control->Time)
+        {
+            reset = 1;
+        }
+    }
+    return reset;
+}
+
+long control_time(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = control index
+**   Output:  returns time until control activates (0 if unknown)
+**   Purpose: finds the time until an individual control activates
+**-------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Hydraul  *hyd = &pr->hydraul;
+    Times    *time = &pr->times;
+    Scontrol *control = &net->Control[i];
+
+    int    j, n;
+    long   t = 0, t1, t2;
+    double h, q, v;
+
+    // Control depends on a tank level
+    if ((n = control->Node) > 0)
+    {
+        // Skip node if not a tank or reservoir
+        if ((j = n - net->Njuncs) <= 0) return 0;
+
+        // Find current head and flow into tank
+        h = hyd->NodeHead[n];
+        q = hyd->NodeDemand[n];
+        if (ABS(q) <= QZERO) return 0;
+
+        // Find time to reach upper or lower control level
+        if ( (h < control->Grade && control->Type == HILEVEL && q > 0.0)
+        ||   (h > control->Grade && control->Type == LOWLEVEL && q < 0.0) )
+        {
+            v = tankvolume(pr, j, control->Grade) - net->Tank[j].V;
+            t = (long)ROUND(v/q);
+        }
+    }
+
+    // Control is based on elapsed time
+    if (control->Type == TIMER)
+    {
+        if (control->Time > time->Htime) t = control->Time - time->Htime;
+    }
+
+    // Control is based on time of day
+    if (control->Type == TIMEOFDAY)
+    {
+        t1 = (time->Htime + time->Tstart) % SECperDAY;
+        t2 = control->Time;
+        if (t2 >= t1) t = t2 - t1;
+        else          t = SECperDAY - t1 + t2;
+    }
+    return t;
+}
+
+int control_changes_link(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = control index
+**   Output:  returns TRUE if control would change its link
+**   Purpose: checks if a control changes its link's status or
+**            setting
+**-------------------------------------------------------------
+*/
+{
+    Network  *net = &pr->network;
+    Hydraul  *hyd = &pr->hydraul;
+    Scontrol *control = &net->Control[i];
+    int      k = control->Link;
+
+    return (net->Link[k].Type > PIPE &&
+            hyd->LinkSetting[k] != control->Setting) ||
+           (hyd->LinkStatus[k] != control->Status);
+}
+
+double timer_key(Project *pr, int i, long t)
+/*-------------------------------------------------------------
+**   Input:   i = index of a time-based control
+**            t = current time (sec)
+**   Output:  returns next time at or after t when control activates
+**   Purpose: finds the timer queue key of a time-based control
+**-------------------------------------------------------------
+*/
+{
+    Scontrol *control = &pr->network.Control[i];
+    long     t1, t2;
+
+    if (control->Type == TIMER)
+    {
+        if (control->Time >= t) return (double)control->Time;
+        return NEVER;
+    }
+    t1 = (t + pr->times.Tstart) % SECperDAY;
+    t2 = control->Time;
+    if (t2 >= t1) return (double)(t + t2 - t1);
+    return (double)(t + SECperDAY - t1 + t2);
+}
+
+double tank_fill_time(Project *pr, int i)
+/*-------------------------------------------------------------
+**   Input:   i = tank index
+**   Output:  returns time (sec) for tank to fill or drain
+**   Purpose: finds the time for a tank to fill or drain at its
+**            current net inflow (NEVER if it won't)
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Stank   *tank = &net->Tank[i];
+
+    int    n;
+    double h, q, v;
+
+    // Skip reservoirs
+    if (tank->A == 0.0) return NEVER;
+
+    // Get current tank grade (h) & inflow (q)
+    n = tank->Node;
+    h = hyd->NodeHead[n];
+    q = hyd->NodeDemand[n];
+    if (ABS(q) <= QZERO) return NEVER;
+
+    // Find volume to fill/drain tank
+    if      (q > 0.0 && h < tank->Hmax) v = tank->Vmax - tank->V;
+    else if (q < 0.0 && h > tank->Hmin) v = tank->Vmin - tank->V;
+    else return NEVER;
+    return v / q;
+}
+
+void update_tank_queue(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  none
+**   Purpose: re-keys the tanks whose inflow has changed
+**-------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Hydraul   *hyd = &pr->hydraul;
+    Sschedule *sched = &hyd->schedule;
+
+    int   i;
+    Stank *tank;
+
+    for (i = 1; i <= net->Ntanks; i++)
+    {
+        tank = &net->Tank[i];
+        if (tank->A == 0.0) continue;
+        if (hyd->NodeDemand[tank->Node] == sched->TankInflow[i]) continue;
+        rekey_tank(pr, i, tank_fill_time(pr, i));
+    }
+}
+
+void rekey_tank(Project *pr, int i, double xt)
+/*-------------------------------------------------------------
+**   Input:   i = tank index
+**            xt = time (sec) for tank to fill or drain
+**   Output:  none
+**   Purpose: updates a tank's position in the tank queue
+**-------------------------------------------------------------
+*/
+{
+    Sschedule *sched = &pr->hydraul.schedule;
+    int       pos = sched->TankSlot[i];
+
+    sched->TankInflow[i] = pr->hydraul.NodeDemand[pr->network.Tank[i].Node];
+    if (xt >= NEVER) sched->TankQueue[pos].key = NEVER;
+    else sched->TankQueue[pos].key = pr->times.Htime + xt;
+    sift_up(sched->TankQueue, sched->TankSlot, pos);
+    sift_down(sched->TankQueue, sched->TankSlot, pr->network.Ntanks,
+              sched->TankSlot[i]);
+}
+
+void add_level_controls(Project *pr, int *nfired)
+/*-------------------------------------------------------------
+**   Input:   *nfired = number of controls fired so far
+**   Output:  *nfired = updated number of controls fired
+**   Purpose: adds the level controls activated by each tank's
+**            current level to the schedule's Fired array
+**-------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Hydraul   *hyd = &pr->hydraul;
+    Sschedule *sched = &hyd->schedule;
+
+    int    g, j, k, n, lo, hi, mid, first, last;
+    double v1, vplus;
+    double *vol = sched->LevelVol;
+
+    for (j = 1; j <= net->Ntanks; j++)
+    {
+        first = sched->LevelStart[2*j];
+        last = sched->LevelStart[2*j+2];
+        if (first == last) continue;
+        n = net->Tank[j].Node;
+        v1 = tankvolume(pr, j, hyd->NodeHead[n]);
+        vplus = ABS(hyd->NodeDemand[n]);
+
+        // LOWLEVEL controls fire when v1 <= v2 + vplus, which holds
+        // for a trailing portion of a list sorted by volume v2
+        g = 2*j;
+        lo = sched->LevelStart[g];
+        hi = sched->LevelStart[g+1];
+        if (sched->LevelSorted[g])
+        {
+            while (lo < hi)
+            {
+                mid = (lo + hi) / 2;
+                if (v1 <= vol[mid] + vplus) hi = mid;
+                else lo = mid + 1;
+            }
+            hi = sched->LevelStart[g+1];
+        }
+        for (k = lo; k < hi; k++)
+        {
+            if (!(v1 <= vol[k] + vplus)) continue;
+            if (!net->Control[sched->LevelList[k].index].isEnabled) continue;
+            sched->Fired[(*nfired)++] = sched->LevelList[k].index;
+        }
+
+        // HILEVEL controls fire when v1 >= v2 - vplus, which holds
+        // for a leading portion of a list sorted by volume v2
+        g = 2*j + 1;
+        lo = sched->LevelStart[g];
+        hi = sched->LevelStart[g+1];
+        if (sched->LevelSorted[g])
+        {
+            while (lo < hi)
+            {
+                mid = (lo + hi) / 2;
+                if (v1 >= vol[mid] - vplus) lo = mid + 1;
+                else hi = mid;
+            }
+            hi = lo;
+            lo = sched->LevelStart[g];
+        }
+        for (k = lo; k < hi; k++)
+        {
+            if (!(v1 >= vol[k] - vplus)) continue;
+            if (!net->Control[sched->LevelList[k].index].isEnabled) continue;
+            sched->Fired[(*nfired)++] = sched->LevelList[k].index;
+        }
+    }
+}
+
+int first_level_above(Project *pr, int first, int last, double h)
+/*-------------------------------------------------------------
+**   Input:   first, last = range of a level control list
+**            h = tank grade
+**   Output:  returns position of first control with grade above h
+**   Purpose: binary searches a level control list sorted by grade
+**-------------------------------------------------------------
+*/
+{
+    Sschedule *sched = &pr->hydraul.schedule;
+
+    int mid;
+
+    while (first < last)
+    {
+        mid = (first + last) / 2;
+        if (h < sched->LevelList[mid].key) last = mid;
+        else first = mid + 1;
+    }
+    return first;
+}
+
+void check_level_timestep(Project *pr, int first, int last, int ascending,
+                          double q, long *tbest, int *ibest)
+/*-------------------------------------------------------------
+**   Input:   first, last = range of a tank's level control list
+**            ascending = TRUE for a filling tank's HILEVEL list,
+**                        FALSE for a draining tank's LOWLEVEL list
+**            q = tank's net inflow
+**            *tbest = current time step
+**            *ibest = control that sets the current time step
+**   Output:  updated values of *tbest and *ibest
+**   Purpose: finds the first level control of a tank to activate
+**-------------------------------------------------------------
+*/
+{
+    Network   *net = &pr->network;
+    Sschedule *sched = &pr->hydraul.schedule;
+
+    int    g, i, j, k, n;
+    double h, v, xt;
+
+    if (first == last) return;
+    i = sched->LevelList[first].index;
+    n = net->Control[i].Node;
+    j = n - net->Njuncs;
+    g = 2*j + ascending;
+
+    // Examine each control if volume doesn't increase with grade
+    if (!sched->LevelSorted[g])
+    {
+        for (k = first; k < last; k++)
+        {
+            i = sched->LevelList[k].index;
+            if (!net->Control[i].isEnabled) continue;
+            consider_control(pr, i, control_time(pr, i), tbest, ibest);
+        }
+        return;
+    }
+
+    // Otherwise examine controls in the order the tank reaches their
+    // grade, stopping once the time to reach them exceeds the time step
+    h = pr->hydraul.NodeHead[n];
+    k = first_level_above(pr, first, last, h);
+    if (!ascending)
+    {
+        // Skip controls whose grade equals h
+        while (k > first && !(h > sched->LevelList[k-1].key)) k--;
+        k--;
+    }
+    while (k >= first && k < last)
+    {
+        i = sched->LevelList[k].index;
+        v = sched->LevelVol[k] - net->Tank[j].V;
+        xt = v / q;
+        if (xt > *tbest + 1) break;
+        if (net->Control[i].isEnabled)
+        {
+            consider_control(pr, i, (long)ROUND(xt), tbest, ibest);
+        }
+        if (ascending) k++;
+        else k--;
+    }
+}
+
+void consider_control(Project *pr, int i, long t, long *tbest, int *ibest)
+/*-------------------------------------------------------------
+**   Input:   i = control index
+**            t = time until control activates
+**            *tbest = current time step
+**            *ibest = control that sets the current time step
+**   Output:  updated values of *tbest and *ibest
+**   Purpose: shortens the time step to a control's activation
+**            time if the control would change its link
+**   Note:    ties go to the lowest control index so the result
+**            doesn't depend on the order controls are examined.
+**-------------------------------------------------------------
+*/
+{
+    if (t <= 0 || t > *tbest) return;
+    if (t == *tbest && (*ibest == 0 || i > *ibest)) return;
+    if (!control_changes_link(pr, i)) return;
+    *tbest = t;
+    *ibest = i;
+}
+
+void sift_up(SqueueItem *q, int *slot, int pos)
+/*-------------------------------------------------------------
+**   Input:   q = a heap of queue items
+**            slot = heap position of each item's index (or NULL)
+**            pos = heap position of an item whose key decreased
+**   Output:  none
+**   Purpose: restores the heap property by moving an item up
+**-------------------------------------------------------------
+*/
+{
+    int        parent;
+    SqueueItem item = q[pos];
+
+    while (pos > 0)
+    {
+        parent = (pos - 1) / 2;
+        if (q[parent].key <= item.key) break;
+        q[pos] = q[parent];
+        if (slot) slot[q[pos].index] = pos;
+        pos = parent;
+    }
+    q[pos] = item;
+    if (slot) slot[item.index] = pos;
+}
+
+void sift_down(SqueueItem *q, int *slot, int n, int pos)
+/*-------------------------------------------------------------
+**   Input:   q = a heap of n queue items
+**            slot = heap position of each item's index (or NULL)
+**            pos = heap position of an item whose key increased
+**   Output:  none
+**   Purpose: restores the heap property by moving an item down
+**-------------------------------------------------------------
+*/
+{
+    int        child;
+    SqueueItem item = q[pos];
+
+    while ((child = 2 * pos + 1) < n)
+    {
+        if (child + 1 < n && q[child+1].key < q[child].key) child++;
+        if (item.key <= q[child].key) break;
+        q[pos] = q[child];
+        if (slot) slot[q[pos].index] = pos;
+        pos = child;
+    }
+    q[pos] = item;
+    if (slot) slot[item.index] = pos;
+}
+
+int compare_ints(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+int compare_items(const void *a, const void *b)
+{
+    const SqueueItem *x = (const SqueueItem *)a;
+    const SqueueItem *y = (const SqueueItem *)b;
+
+    if (x->key < y->key) return -1;
+    if (x->key > y->key) return 1;
+    return x->index - y->index;
+}
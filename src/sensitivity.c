@@ -0,0 +1,347 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       sensitivity.c
+ Description:  sensitivities of heads and flows to model parameters
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+The sensitivities of a hydraulic solution's heads and flows to a parameter
+(a pipe's roughness or a junction's demand or emitter coefficient) are found
+by linearizing the network's equations about the solution. With P = the
+inverse head loss gradient of each link, a change dp in a parameter changes
+heads and flows by:
+
+  A*dH = r*dp
+  dQ   = P*(dH1 - dH2 - g*dp)
+
+where A is the matrix of the solution's nodal equations (see HYDCOEFFS.C),
+dH1 & dH2 are the head changes at a link's end nodes, g is the derivative of
+a link's head loss with respect to the parameter and r holds the matching
+changes in node flow balances:
+
+  roughness of link k:  r = P[k]*g[k] at k's start node, -P[k]*g[k] at its
+                        end node
+  demand or emitter coeff. of junction i: r = -dD/dp at i, where D is the
+                        flow leaving i through its demand or emitter
+
+hydsolve() leaves A factored once a solution is found, so each parameter's
+head & flow sensitivities (a column of the sensitivity matrix) only cost one
+forward & back substitution.
+
+For an objective J = w'H + v'Q, the gradient of J with respect to all
+parameters of a given kind is found with an adjoint solution (also a single
+substitution since A is symmetric):
+
+  A*L = w + u,   where u = P[k]*v[k] at each link k's start node and
+                 -P[k]*v[k] at its end node
+
+  dJ/dp = L'r - v[k]*P[k]*g[k]  (the last term only for roughness of link k)
+
+Flows through active pressure and flow control valves are set by the valve
+rather than by P and their sensitivities are not found.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "epanet2_2.h"
+#include "types.h"
+#include "funcs.h"
+
+// Exported functions (declared in funcs.h)
+//int     sensitivity(Project *, int, int, double *, double *);
+//int     linearsens(Project *, int, const double *, double *, double *);
+//int     adjointgradient(Project *, int, const double *, const double *,
+//                        double *);
+
+// Imported functions
+extern void linsubst(Smatrix *, double *, double *, double *, int); //(see SMATRIX.C)
+
+// Local functions
+static int    checkparam(Project *, int, int);
+static double linkderiv(Project *, int);
+static double nodederiv(Project *, int, int);
+
+
+int sensitivity(Project *pr, int param, int index, double *dh, double *dq)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter (see EN_SensitivityParam)
+**           index = index of parameter's link or junction
+**  Output:  dh = change in each node's head per unit change in
+**                parameter (user units, may be NULL)
+**           dq = change in each link's flow per unit change in
+**                parameter (user units, may be NULL)
+**           returns an error code
+**  Purpose: finds the sensitivity of the current hydraulic
+**           solution's heads and flows to a parameter.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+
+    int    i, k, errcode;
+    double *dp, *x, *y;
+
+    // checkparam() lets index 0 through for adjointgradient()
+    errcode = checkparam(pr, param, index);
+    if (!errcode && index == 0)
+    {
+        errcode = (param == EN_SENS_ROUGHNESS) ? 204 : 203;
+    }
+    if (errcode) return errcode;
+    dp = (double *)calloc(net->Nnodes + net->Nlinks + 1, sizeof(double));
+    x = (double *)calloc(net->Nnodes + 1, sizeof(double));
+    y = (double *)calloc(net->Nlinks + 1, sizeof(double));
+    ERRCODE(MEMCHECK(dp));
+    ERRCODE(MEMCHECK(x));
+    ERRCODE(MEMCHECK(y));
+    if (!errcode)
+    {
+        dp[index] = 1.0;
+        errcode = linearsens(pr, param, dp, x, y);
+    }
+    if (!errcode)
+    {
+        for (i = 1; i <= net->Nnodes && dh; i++)
+        {
+            dh[i - 1] = x[i] * pr->Ucf[HEAD];
+        }
+        for (k = 1; k <= net->Nlinks && dq; k++)
+        {
+            dq[k - 1] = y[k] * pr->Ucf[FLOW];
+        }
+    }
+    free(dp);
+    free(x);
+    free(y);
+    return errcode;
+}
+
+int linearsens(Project *pr, int param, const double *dp, double *dh,
+               double *dq)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter (see EN_SensitivityParam)
+**           dp = change in each link's or node's parameter (user
+**                units, indexed from 1, may be NULL)
+**           dh = change in head of each tank & reservoir (ft,
+**                indexed by node from 1)
+**  Output:  dh = change in head of each junction (ft)
+**           dq = change in flow of each link (cfs, indexed from 1)
+**           returns an error code
+**  Purpose: finds the changes in the current hydraulic solution
+**           produced by changes in the parameters of its links
+**           or nodes and in the heads of its fixed grade nodes.
+**
+**  Note:    the solution must be factored (see checkparam()).
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+
+    int    i, k, n1, n2, n = net->Njuncs;
+    double c;
+    double *x;
+
+    // Build the change in node flow balances
+    x = (double *)calloc(n + 1, sizeof(double));
+    if (x == NULL) return 101;
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        n1 = net->Link[k].N1;
+        n2 = net->Link[k].N2;
+        c = 0.0;
+        if (param == EN_SENS_ROUGHNESS && dp && dp[k] != 0.0)
+        {
+            c = dp[k] * linkderiv(pr, k);
+        }
+        if (n1 <= n)
+        {
+            x[sm->Row[n1]] += hyd->P[k] * c;
+            if (n2 > n) x[sm->Row[n1]] += hyd->P[k] * dh[n2];
+        }
+        if (n2 <= n)
+        {
+            x[sm->Row[n2]] -= hyd->P[k] * c;
+            if (n1 > n) x[sm->Row[n2]] += hyd->P[k] * dh[n1];
+        }
+    }
+    for (i = 1; i <= n && param != EN_SENS_ROUGHNESS && dp; i++)
+    {
+        if (dp[i] != 0.0) x[sm->Row[i]] -= dp[i] * nodederiv(pr, param, i);
+    }
+
+    // Solve for the head changes
+    linsubst(sm, sm->Aii, sm->Aij, x, n);
+    for (i = 1; i <= n; i++) dh[i] = x[sm->Row[i]];
+    free(x);
+
+    // Find the flow changes they produce
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        n1 = net->Link[k].N1;
+        n2 = net->Link[k].N2;
+        dq[k] = hyd->P[k] * (dh[n1] - dh[n2]);
+        if (param == EN_SENS_ROUGHNESS && dp && dp[k] != 0.0)
+        {
+            dq[k] -= hyd->P[k] * dp[k] * linkderiv(pr, k);
+        }
+    }
+    return 0;
+}
+
+int adjointgradient(Project *pr, int param, const double *hweights,
+                    const double *qweights, double *grad)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter (see EN_SensitivityParam)
+**           hweights = weight on each node's head (may be NULL)
+**           qweights = weight on each link's flow (may be NULL)
+**  Output:  grad = derivative of the weighted sum of heads and
+**                  flows with respect to the parameter of each
+**                  link (for roughness) or node (otherwise)
+**           returns an error code
+**  Purpose: finds the gradient of an objective function of the
+**           current hydraulic solution using its adjoint.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+
+    int    i, k, n1, n2, n = net->Njuncs;
+    int    errcode;
+    double c, l1, l2, v;
+    double *x;
+
+    errcode = checkparam(pr, param, 0);
+    if (errcode) return errcode;
+    x = (double *)calloc(n + 1, sizeof(double));
+    if (x == NULL) return 101;
+
+    // Build the adjoint's right hand side
+    for (i = 1; i <= n && hweights; i++)
+    {
+        x[sm->Row[i]] = hweights[i - 1] * pr->Ucf[HEAD];
+    }
+    for (k = 1; k <= net->Nlinks && qweights; k++)
+    {
+        c = qweights[k - 1] * pr->Ucf[FLOW] * hyd->P[k];
+        n1 = net->Link[k].N1;
+        n2 = net->Link[k].N2;
+        if (n1 <= n) x[sm->Row[n1]] += c;
+        if (n2 <= n) x[sm->Row[n2]] -= c;
+    }
+
+    // Solve for the adjoint & combine it with each
+    // parameter's change in node flow balances
+    linsubst(sm, sm->Aii, sm->Aij, x, n);
+    if (param == EN_SENS_ROUGHNESS)
+    {
+        for (k = 1; k <= net->Nlinks; k++)
+        {
+            n1 = net->Link[k].N1;
+            n2 = net->Link[k].N2;
+            l1 = (n1 <= n) ? x[sm->Row[n1]] : 0.0;
+            l2 = (n2 <= n) ? x[sm->Row[n2]] : 0.0;
+            v = (qweights) ? qweights[k - 1] * pr->Ucf[FLOW] : 0.0;
+            grad[k - 1] = hyd->P[k] * linkderiv(pr, k) * (l1 - l2 - v);
+        }
+    }
+    else
+    {
+        for (i = 1; i <= net->Nnodes; i++)
+        {
+            if (i > n) grad[i - 1] = 0.0;
+            else grad[i - 1] = -nodederiv(pr, param, i) * x[sm->Row[i]];
+        }
+    }
+    free(x);
+    return 0;
+}
+
+int checkparam(Project *pr, int param, int index)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter
+**           index = index of parameter's link or junction (0 if
+**                   not checked)
+**  Output:  returns an error code
+**  Purpose: checks that sensitivities can be found for a
+**           parameter of the current hydraulic solution.
+**----------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+
+    if (!hyd->OpenHflag) return 103;
+    if (!hyd->Factored) return 109;
+    switch (param)
+    {
+    case EN_SENS_ROUGHNESS:
+        if (index < 0 || index > net->Nlinks) return 204;
+        break;
+    case EN_SENS_DEMAND:
+    case EN_SENS_EMITTER:
+        if (index < 0 || index > net->Njuncs) return 203;
+        break;
+    default:
+        return 251;
+    }
+    return 0;
+}
+
+double linkderiv(Project *pr, int k)
+/*----------------------------------------------------------------
+**  Input:   k = link index
+**  Output:  returns derivative of head loss w.r.t. roughness
+**  Purpose: finds the derivative of a link's head loss with
+**           respect to its roughness coeff. (in user units).
+**----------------------------------------------------------------
+*/
+{
+    double g = roughnessgrad(pr, k);
+
+    if (pr->hydraul.Formflag == DW) g /= 1000.0 * pr->Ucf[ELEV];
+    return g;
+}
+
+double nodederiv(Project *pr, int param, int i)
+/*----------------------------------------------------------------
+**  Input:   param = type of parameter
+**           i = junction index
+**  Output:  returns derivative of outflow w.r.t. parameter
+**  Purpose: finds the derivative of the flow leaving a junction
+**           through its demand or emitter with respect to its
+**           demand or emitter coeff. (in user units).
+**----------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &pr->hydraul;
+    Snode   *node = &pr->network.Node[i];
+    double  p, ecf;
+
+    // Demand delivered is a fixed fraction of the full demand
+    // at the solution's pressure
+    if (param == EN_SENS_DEMAND)
+    {
+        if (hyd->DemandModel == PDA && hyd->FullDemand[i] > 0.0)
+        {
+            return hyd->DemandFlow[i] / hyd->FullDemand[i] / pr->Ucf[FLOW];
+        }
+        return 1.0 / pr->Ucf[FLOW];
+    }
+
+    // Emitter flow = coeff. * pressure^(1/Qexp) in user units
+    p = hyd->NodeHead[i] - node->El;
+    if (p <= 0.0) return 0.0;
+    ecf = (pr->parser.Unitsflag == US) ? PSIperFT * hyd->SpGrav : MperFT;
+    return pow(ecf * p, 1.0 / hyd->Qexp) / pr->Ucf[FLOW];
+}
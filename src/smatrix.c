@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 05/15/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 /*
@@ -15,7 +15,11 @@
  hydraulic equations. The functions exported by this module are:
    createsparse() -- called from openhyd() in HYDRAUL.C
    freesparse()   -- called from closehyd() in HYDRAUL.C
-   linsolve()     -- called from netsolve() in HYDRAUL.C
+   linsolve()     -- called from hydsolve() in HYDSOLVER.C
+   linfactor()    -- called from runfireflow() in FIREFLOW.C
+   linsubst()     -- called from chordsolve() in HYDSOLVER.C
+   linfactorzone() -- called from zonesolve() in ZONES.C
+   linsubstzone() -- called from zonesolve() in ZONES.C
 */
 
 #include <stdlib.h>
@@ -39,6 +43,10 @@ extern int genmmd(int *neqns, int *xadj, int *adjncy, int *invp, int *perm,
 int  createsparse(Project *);
 void freesparse(Project *);
 int  linsolve(Smatrix *, int);
+int  linfactor(Smatrix *, int);
+void linsubst(Smatrix *, double *, double *, double *, int);
+int  linfactorzone(Smatrix *, const int *, int, const int *);
+void linsubstzone(Smatrix *, double *, const int *, int, const int *);
 
 // Local functions
 static int     allocsmatrix(Smatrix *, int, int);
@@ -48,9 +56,8 @@ static int     paralink(Network *, Smatrix *, int, int, int k);
 static void    xparalinks(Network *);
 static int     reordernodes(Project *);
 static int     factorize(Project *);
-static int     growlist(Project *, int, int *);
-static int     newlink(Project *, Padjlist, int *);
-static int     linked(Network *, int, int);
+static int     growlist(Project *, int, int *, int *);
+static int     newlink(Project *, Padjlist, int *, int *);
 static int     addlink(Network *, int, int, int);
 static int     storesparse(Project *, int);
 static int     sortsparse(Smatrix *, int);
@@ -91,6 +98,24 @@ int  createsparse(Project *pr)
 //    cleartimer(SmatrixTimer);
 //    starttimer(SmatrixTimer);
 
+    // Borrow the matrix structure shared with the project's
+    // clones if there is one (see CLONE.C)
+    sm->Borrowed = FALSE;
+    if (net->Sparse != NULL)
+    {
+        sm->Ncoeffs = net->Sparse->Ncoeffs;
+        sm->Order = net->Sparse->Order;
+        sm->Row = net->Sparse->Row;
+        sm->Ndx = net->Sparse->Ndx;
+        sm->XLNZ = net->Sparse->XLNZ;
+        sm->NZSUB = net->Sparse->NZSUB;
+        sm->LNZ = net->Sparse->LNZ;
+        sm->Borrowed = TRUE;
+        ERRCODE(alloclinsolve(sm, net->Nnodes));
+        ERRCODE(buildadjlists(net));
+        return errcode;
+    }
+
     // Allocate sparse matrix data structures
     errcode = allocsmatrix(sm, net->Nnodes, net->Nlinks);
     if (errcode) return errcode;
@@ -120,6 +145,7 @@ int  createsparse(Project *pr)
 
     // Allocate memory used by linear eqn. solver
     ERRCODE(alloclinsolve(sm, net->Nnodes));
+    ERRCODE(allocdomains(pr));
 
     // Re-build adjacency lists for future use
     ERRCODE(buildadjlists(net));
@@ -201,6 +227,17 @@ void  freesparse(Project *pr)
 //    printf("\n    Processing Time = %7.3f s", gettimer(SmatrixTimer));
 //    printf("\n");
 
+    // A borrowed matrix structure is freed by its owner
+    if (sm->Borrowed)
+    {
+        sm->Order = NULL;
+        sm->Row = NULL;
+        sm->Ndx = NULL;
+        sm->XLNZ = NULL;
+        sm->NZSUB = NULL;
+        sm->LNZ = NULL;
+        sm->Borrowed = FALSE;
+    }
     FREE(sm->Order);
     FREE(sm->Row);
     FREE(sm->Ndx);
@@ -414,6 +451,13 @@ int   reordernodes(Project *pr)
     }
     else errcode = 101;  //insufficient memory
 
+    // Group the rows of domains solved on separate
+    // processes together (see DOMAINS.C)
+    if (!errcode && pr->hydraul.domains.Ndomains > 1)
+    {
+        errcode = orderdomains(pr);
+    }
+
     // Free memory
     FREE(adjncy);
     FREE(xadj);
@@ -444,7 +488,13 @@ int factorize(Project *pr)
 
     // Find degree of each junction node
     int *degree = (int *)calloc(net->Nnodes + 1, sizeof(int));
-    if (degree == NULL) return 101;
+    int *marker = (int *)calloc(net->Nnodes + 1, sizeof(int));
+    if (degree == NULL || marker == NULL)
+    {
+        free(degree);
+        free(marker);
+        return 101;
+    }
 
     // NOTE: For purposes of node re-ordering, Tanks (nodes with
     //       indexes above Njuncs) have zero degree of adjacency.
@@ -463,7 +513,7 @@ int factorize(Project *pr)
     for (k = 1; k <= net->Njuncs; k++)          // Examine each junction
     {
         knode = sm->Order[k];                   // Re-ordered index
-        if (!growlist(pr, knode, degree))               // Augment adjacency list
+        if (!growlist(pr, knode, degree, marker))   // Augment adjacency list
         {
             errcode = 101;
             break;
@@ -471,14 +521,17 @@ int factorize(Project *pr)
         degree[knode] = 0;                  // In-activate node
     }
     free(degree);
+    free(marker);
     return errcode;
 }
 
 
-int  growlist(Project *pr, int knode, int *degree)
+int  growlist(Project *pr, int knode, int *degree, int *marker)
 /*
 **--------------------------------------------------------------
 ** Input:   knode = node index
+**          degree = degree of adjacency of each active node
+**          marker = work array used by newlink()
 ** Output:  returns 1 if successful, 0 if not
 ** Purpose: creates new entries in knode's adjacency list for
 **          all unlinked pairs of active nodes that are
@@ -499,7 +552,7 @@ int  growlist(Project *pr, int knode, int *degree)
         if (node > 0 && degree[node] > 0) // End node is active
         {
             degree[node]--;           // Reduce degree of adjacency
-            if (!newlink(pr, alink, degree))      // Add to adjacency list
+            if (!newlink(pr, alink, degree, marker))  // Add to adjacency list
             {
                 return 0;
             }
@@ -509,10 +562,13 @@ int  growlist(Project *pr, int knode, int *degree)
 }
 
 
-int  newlink(Project *pr, Padjlist alink, int *degree)
+int  newlink(Project *pr, Padjlist alink, int *degree, int *marker)
 /*
 **--------------------------------------------------------------
 ** Input:   alink = element of node's adjacency list
+**          degree = degree of adjacency of each active node
+**          marker = work array (holds inode for each node known
+**                   to be linked to inode)
 ** Output:  returns 1 if successful, 0 if not
 ** Purpose: links end of current adjacent link to end nodes of
 **          all links that follow it on adjacency list
@@ -525,8 +581,16 @@ int  newlink(Project *pr, Padjlist alink, int *degree)
     int inode, jnode;
     Padjlist blink;
 
-    // Scan all entries in adjacency list that follow anode.
+    // Mark the nodes that inode is linked to, so that checking
+    // for a link doesn't scan inode's list (which grows long for
+    // rows eliminated late, e.g. the interface rows of DOMAINS.C)
     inode = alink->node;             // End node of connection to anode
+    for (blink = net->Adjlist[inode]; blink != NULL; blink = blink->next)
+    {
+        marker[blink->node] = inode;
+    }
+
+    // Scan all entries in adjacency list that follow anode.
     for (blink = alink->next; blink != NULL; blink = blink->next)
     {
         jnode = blink->node;          // End node of next connection
@@ -535,7 +599,7 @@ int  newlink(Project *pr, Padjlist alink, int *degree)
         // then add a new connection between inode and jnode.
         if (jnode > 0 && degree[jnode] > 0)  // jnode still active
         {
-            if (!linked(net, inode, jnode))      // inode not linked to jnode
+            if (marker[jnode] != inode)      // inode not linked to jnode
             {
                 // Since new connection represents a non-zero coeff.
                 // in the solution matrix, update the coeff. count.
@@ -547,6 +611,7 @@ int  newlink(Project *pr, Padjlist alink, int *degree)
                 if (!addlink(net, jnode, inode, sm->Ncoeffs)) return 0;
                 degree[inode]++;
                 degree[jnode]++;
+                marker[jnode] = inode;
             }
         }
     }
@@ -554,25 +619,6 @@ int  newlink(Project *pr, Padjlist alink, int *degree)
 }
 
 
-int  linked(Network *net, int i, int j)
-/*
-**--------------------------------------------------------------
-** Input:   i = node index
-**          j = node index
-** Output:  returns 1 if nodes i and j are linked, 0 if not
-** Purpose: checks if nodes i and j are already linked.
-**--------------------------------------------------------------
-*/
-{
-    Padjlist alink;
-    for (alink = net->Adjlist[i]; alink != NULL; alink = alink->next)
-    {
-        if (alink->node == j) return 1;
-    }
-    return 0;
-}
-
-
 int  addlink(Network *net, int i, int j, int n)
 /*
 **--------------------------------------------------------------
@@ -736,6 +782,26 @@ int  linsolve(Smatrix *sm, int n)
 **          equation causing system to be ill-conditioned
 ** Purpose: solves sparse symmetric system of linear
 **          equations using Cholesky factorization
+**--------------------------------------------------------------
+*/
+{
+    int errcode = linfactor(sm, n);
+    if (errcode) return errcode;
+    linsubst(sm, sm->Aii, sm->Aij, sm->F, n);
+    return 0;
+}
+
+
+int  linfactor(Smatrix *sm, int n)
+/*
+**--------------------------------------------------------------
+** Input:   sm   = sparse matrix struct
+            n    = number of equations
+** Output:  sm->Aii, sm->Aij = coeffs. of Cholesky factor L
+**          returns 0 if factorization found, or index of
+**          equation causing system to be ill-conditioned
+** Purpose: replaces a sparse symmetric matrix with its
+**          Cholesky factor
 **
 ** NOTE:   This procedure assumes that the solution matrix has
 **         been symbolically factorized with the positions of
@@ -754,7 +820,6 @@ int  linsolve(Smatrix *sm, int n)
 {
     double *Aii  = sm->Aii;
     double *Aij  = sm->Aij;
-    double *B    = sm->F;
     double *temp = sm->temp;
     int *LNZ     = sm->LNZ;
     int *XLNZ    = sm->XLNZ;
@@ -833,6 +898,30 @@ int  linsolve(Smatrix *sm, int n)
          }
       }
    }      // next j
+   return 0;
+}
+
+
+void  linsubst(Smatrix *sm, double *Aii, double *Aij, double *B, int n)
+/*
+**--------------------------------------------------------------
+** Input:   sm   = sparse matrix struct
+**          Aii, Aij = coeffs. of Cholesky factor L
+**          B    = right hand side vector
+**          n    = number of equations
+** Output:  B    = solution values
+** Purpose: solves L*L'*x = B for a matrix factored by
+**          linfactor(), so that a factorization can be
+**          re-used for any number of right hand sides
+**--------------------------------------------------------------
+*/
+{
+    int *LNZ   = sm->LNZ;
+    int *XLNZ  = sm->XLNZ;
+    int *NZSUB = sm->NZSUB;
+
+    int    i, istop, istrt, isub, j;
+    double bj;
 
    // Forward substitution
    for (j = 1; j <= n; j++)
@@ -867,5 +956,166 @@ int  linsolve(Smatrix *sm, int n)
       }
       B[j] = bj/Aii[j];
    }
-   return 0;
+}
+
+
+int  linfactorzone(Smatrix *sm, const int *rows, int nrows, const int *zone)
+/*
+**--------------------------------------------------------------
+** Input:   sm    = sparse matrix struct
+**          rows  = rows of a zone in ascending order
+**          nrows = number of rows in the zone
+**          zone  = zone of each row
+** Output:  sm->Aii, sm->Aij = coeffs. of Cholesky factor L
+**          in the zone's columns
+**          returns 0 if factorization found, or index of
+**          equation causing system to be ill-conditioned
+** Purpose: factors the block of a zone of rows that are not
+**          coupled to rows of other zones.
+**
+** NOTE:   This is linfactor() restricted to the zone's columns.
+**         Coeffs. of a column in rows of other zones are taken
+**         to be zero (and are set to zero), so that the blocks
+**         of different zones can be factored at the same time
+**         and the result is the factor of the whole matrix
+**         without its coupling between zones.
+**--------------------------------------------------------------
+*/
+{
+    double *Aii  = sm->Aii;
+    double *Aij  = sm->Aij;
+    double *temp = sm->temp;
+    int *LNZ     = sm->LNZ;
+    int *XLNZ    = sm->XLNZ;
+    int *NZSUB   = sm->NZSUB;
+    int *link    = sm->link;
+    int *first   = sm->first;
+
+    int    i, istop, istrt, isub, j, k, kfirst, newk, m, z;
+    double bj, diagj, ljk;
+
+    if (nrows == 0) return 0;
+    z = zone[rows[0]];
+    for (m = 0; m < nrows; m++)
+    {
+        j = rows[m];
+        temp[j] = 0.0;
+        link[j] = 0;
+        first[j] = 0;
+    }
+
+    for (m = 0; m < nrows; m++)
+    {
+        // For each column L(*,k) that affects L(*,j):
+        j = rows[m];
+        diagj = 0.0;
+        newk = link[j];
+        k = newk;
+        while (k != 0)
+        {
+            newk = link[k];
+            kfirst = first[k];
+            ljk = Aij[LNZ[kfirst]];
+            diagj += ljk*ljk;
+            istrt = kfirst + 1;
+            istop = XLNZ[k+1] - 1;
+            while (istrt <= istop && zone[NZSUB[istrt]] != z) istrt++;
+            if (istop >= istrt)
+            {
+                first[k] = istrt;
+                isub = NZSUB[istrt];
+                link[k] = link[isub];
+                link[isub] = k;
+                for (i = istrt; i <= istop; i++)
+                {
+                    isub = NZSUB[i];
+                    if (zone[isub] == z) temp[isub] += Aij[LNZ[i]]*ljk;
+                }
+            }
+            k = newk;
+        }
+
+        // Apply the modifications accumulated
+        // in 'temp' to column L(*,j)
+        diagj = Aii[j] - diagj;
+        if (diagj <= 0.0) return j;
+        diagj = sqrt(diagj);
+        Aii[j] = diagj;
+        istrt = XLNZ[j];
+        istop = XLNZ[j+1] - 1;
+        for (i = istrt; i <= istop; i++)
+        {
+            isub = NZSUB[i];
+            if (zone[isub] != z)
+            {
+                Aij[LNZ[i]] = 0.0;
+                continue;
+            }
+            if (first[j] == 0)
+            {
+                first[j] = i;
+                link[j] = link[isub];
+                link[isub] = j;
+            }
+            bj = (Aij[LNZ[i]] - temp[isub])/diagj;
+            Aij[LNZ[i]] = bj;
+            temp[isub] = 0.0;
+        }
+    }
+    return 0;
+}
+
+
+void  linsubstzone(Smatrix *sm, double *B, const int *rows, int nrows,
+                   const int *zone)
+/*
+**--------------------------------------------------------------
+** Input:   sm    = sparse matrix struct
+**          B     = right hand side vector
+**          rows  = rows of a zone in ascending order
+**          nrows = number of rows in the zone
+**          zone  = zone of each row
+** Output:  B     = solution values in the zone's rows
+** Purpose: solves L*L'*x = B for the rows of a zone factored
+**          by linfactorzone().
+**--------------------------------------------------------------
+*/
+{
+    double *Aii = sm->Aii;
+    double *Aij = sm->Aij;
+    int *LNZ    = sm->LNZ;
+    int *XLNZ   = sm->XLNZ;
+    int *NZSUB  = sm->NZSUB;
+
+    int    i, isub, j, m, z;
+    double bj;
+
+    if (nrows == 0) return;
+    z = zone[rows[0]];
+
+    // Forward substitution
+    for (m = 0; m < nrows; m++)
+    {
+        j = rows[m];
+        bj = B[j]/Aii[j];
+        B[j] = bj;
+        for (i = XLNZ[j]; i < XLNZ[j+1]; i++)
+        {
+            isub = NZSUB[i];
+            if (zone[isub] == z) B[isub] -= Aij[LNZ[i]]*bj;
+        }
+    }
+
+    // Backward substitution
+    for (m = nrows - 1; m >= 0; m--)
+    {
+        j = rows[m];
+        bj = B[j];
+        for (i = XLNZ[j]; i < XLNZ[j+1]; i++)
+        {
+            isub = NZSUB[i];
+            if (zone[isub] == z) bj -= Aij[LNZ[i]]*B[isub];
+        }
+        B[j] = bj/Aii[j];
+    }
 }
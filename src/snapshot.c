@@ -0,0 +1,440 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       snapshot.c
+ Description:  saves and restores the run-time state of a simulation
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+The state of a simulation at its current hydraulic and water quality time
+can be saved to a block of memory and later restored into the same project,
+or into another project built from the same network, so that the simulation
+can be continued from that point without re-running it from time 0 (e.g., to
+compare what-if scenarios that branch off from a common history).
+
+The state consists of the simulation clock, the hydraulic solution, tank
+volumes, pump energy usage, flow balance totals and, when the water quality
+solver is open, node and tank qualities, the volume segments held in pipes and
+tanks, mass balance totals and the counts of quality steps, node sorts and
+segments reported by EN_getstatistic. Items derived from these (the control event
+schedule, rule evaluation results and pattern demands) are re-evaluated at the
+next time step. The contents of the binary hydraulics and output files and of
+the status report are not part of the state.
+
+The state block is laid out as follows:
+
+  header   - identifier, version and the project dimensions it applies to
+  times    - current hydraulic, water quality and reporting times and
+             the current water quality time step
+  hydraul  - hydraulic arrays, scalars, tank volumes and pump energy
+  quality  - node & tank qualities, for each pipe and tank a segment count
+             followed by the volume and the quality of each constituent
+             of its segments, mass balance and the solver statistics
+             reported by EN_getstatistic
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "funcs.h"
+
+#define STATE_ID      0x54534E45    // "ENST"
+#define STATE_VERSION 4
+#define STATE_HDRSIZE 11
+
+// Exported functions (declared in funcs.h)
+//long    statesize(Project *);
+//int     savestate(Project *, char *, long);
+//int     restorestate(Project *, const char *, long);
+
+// Ways of transferring the state
+typedef enum {
+    SIZE_STATE,        // find size of state
+    SAVE_STATE,        // copy project's state to buffer
+    CHECK_STATE,       // check contents of buffer
+    RESTORE_STATE      // copy buffer's state to project
+} StateMode;
+
+typedef struct {       // State buffer cursor
+    char  *buf;        // state buffer
+    long  size;        // size of buffer (bytes)
+    long  pos;         // current position in buffer
+    int   overrun;     // TRUE if position passed end of buffer
+    StateMode mode;    // how state is being transferred
+} Scursor;
+
+// Imported functions
+extern void addseg(Project *, int, double, double *);
+extern void resetsegs(Project *);
+
+// Local functions
+static void  transfer_state(Project *pr, Scursor *s);
+static void  transfer_hydraul(Project *pr, Scursor *s);
+static void  transfer_quality(Project *pr, Scursor *s);
+static void  transfer_segs(Project *pr, Scursor *s);
+static void  transfer(Scursor *s, void *data, size_t n);
+static void  get_header(Project *pr, int *hdr);
+
+
+long statesize(Project *pr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  returns size of simulation state (bytes)
+**   Purpose: finds the size of a buffer needed to hold the
+**            current state of a simulation
+**-------------------------------------------------------------
+*/
+{
+    Scursor s = {NULL, 0, 0, FALSE, SIZE_STATE};
+
+    transfer_state(pr, &s);
+    return s.pos;
+}
+
+int savestate(Project *pr, char *buffer, long size)
+/*-------------------------------------------------------------
+**   Input:   buffer = memory block to receive the state
+**            size = size of buffer (bytes)
+**   Output:  returns an error code
+**   Purpose: saves the current state of a simulation
+**-------------------------------------------------------------
+*/
+{
+    Scursor s = {buffer, size, 0, FALSE, SAVE_STATE};
+
+    if (buffer == NULL || size < statesize(pr)) return 265;
+    transfer_state(pr, &s);
+    return 0;
+}
+
+int restorestate(Project *pr, const char *buffer, long size)
+/*-------------------------------------------------------------
+**   Input:   buffer = memory block holding a saved state
+**            size = size of buffer (bytes)
+**   Output:  returns an error code
+**   Purpose: restores a previously saved simulation state
+**-------------------------------------------------------------
+*/
+{
+    Quality *qual = &pr->quality;
+    Scursor s = {(char *)buffer, size, 0, FALSE, CHECK_STATE};
+
+    // Check that the buffer holds a complete state that
+    // applies to the project before changing anything
+    if (buffer == NULL) return 265;
+    transfer_state(pr, &s);
+    if (s.overrun || s.pos != size) return 265;
+
+    // Restore the state
+    s.pos = 0;
+    s.mode = RESTORE_STATE;
+    transfer_state(pr, &s);
+    if (qual->OpenQflag && qual->OutOfMemory) return 101;
+
+    // Have the control schedule, rule results and
+    // junction demands re-evaluated at the next time step
+    // (the factored matrix of the last solution, the stages
+    // of nodes routed by worker threads and the positions of
+    // sorted nodes no longer apply)
+    pr->hydraul.Factored = FALSE;
+    qual->Nstages = 0;
+    qual->Sortedflag = FALSE;
+    resetrules(pr);
+    resetschedule(pr);
+    resetdemands(pr);
+    return 0;
+}
+
+void transfer_state(Project *pr, Scursor *s)
+/*-------------------------------------------------------------
+**   Input:   s = state buffer cursor
+**   Output:  none
+**   Purpose: transfers a simulation's state to or from a
+**            state buffer
+**-------------------------------------------------------------
+*/
+{
+    Times *time = &pr->times;
+
+    int hdr[STATE_HDRSIZE], bufhdr[STATE_HDRSIZE];
+
+    // Transfer the header, checking it against the project's
+    get_header(pr, hdr);
+    if (s->mode == CHECK_STATE)
+    {
+        if (s->size < (long)sizeof(hdr)) s->overrun = TRUE;
+        else memcpy(bufhdr, s->buf, sizeof(hdr));
+        if (s->overrun || memcmp(bufhdr, hdr, sizeof(hdr)) != 0)
+        {
+            s->overrun = TRUE;
+            return;
+        }
+    }
+    transfer(s, hdr, sizeof(hdr));
+
+    // Transfer simulation times
+    transfer(s, &time->Htime, sizeof(long));
+    transfer(s, &time->Hydstep, sizeof(long));
+    transfer(s, &time->Qtime, sizeof(long));
+    transfer(s, &time->Rtime, sizeof(long));
+    transfer(s, &time->Qualstep, sizeof(long));
+
+    // Transfer hydraulic & water quality states
+    transfer_hydraul(pr, s);
+    if (pr->quality.OpenQflag) transfer_quality(pr, s);
+}
+
+void transfer_hydraul(Project *pr, Scursor *s)
+/*-------------------------------------------------------------
+**   Input:   s = state buffer cursor
+**   Output:  none
+**   Purpose: transfers the state of the hydraulic solver
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+
+    int    i, k;
+    size_t nnodes = (net->Nnodes + 1) * sizeof(double);
+    size_t nlinks = (net->Nlinks + 1) * sizeof(double);
+
+    // Node and link solution arrays
+    transfer(s, hyd->NodeHead, nnodes);
+    transfer(s, hyd->NodeDemand, nnodes);
+    transfer(s, hyd->FullDemand, nnodes);
+    transfer(s, hyd->DemandFlow, nnodes);
+    transfer(s, hyd->EmitterFlow, nnodes);
+    transfer(s, hyd->LeakageFlow, nnodes);
+    transfer(s, hyd->LinkFlow, nlinks);
+    transfer(s, hyd->LinkSetting, nlinks);
+    transfer(s, hyd->LinkStatus, (net->Nlinks + 1) * sizeof(StatusType));
+    transfer(s, hyd->OldStatus,
+             (net->Nlinks + net->Ntanks + 1) * sizeof(StatusType));
+    if (hyd->HasLeakage)
+    {
+        transfer(s, hyd->Leakage, (net->Njuncs + 1) * sizeof(Sleakage));
+    }
+
+    // Solution statistics & running totals
+    transfer(s, &hyd->Haltflag, sizeof(int));
+    transfer(s, &hyd->Iterations, sizeof(int));
+    transfer(s, &hyd->DeficientNodes, sizeof(int));
+    transfer(s, &hyd->RelativeError, sizeof(double));
+    transfer(s, &hyd->MaxHeadError, sizeof(double));
+    transfer(s, &hyd->MaxFlowChange, sizeof(double));
+    transfer(s, &hyd->DemandReduction, sizeof(double));
+    transfer(s, &hyd->LeakageLoss, sizeof(double));
+    transfer(s, &hyd->Dsystem, sizeof(double));
+    transfer(s, &hyd->Emax, sizeof(double));
+    transfer(s, &hyd->FlowBalance, sizeof(SflowBalance));
+
+    // Tank volumes, PCV resistances & pump energy usage
+    for (i = 1; i <= net->Ntanks; i++)
+    {
+        transfer(s, &net->Tank[i].V, sizeof(double));
+    }
+    for (i = 1; i <= net->Nvalves; i++)
+    {
+        k = net->Valve[i].Link;
+        if (net->Link[k].Type == PCV)
+        {
+            transfer(s, &net->Link[k].R, sizeof(double));
+        }
+    }
+    for (i = 1; i <= net->Npumps; i++)
+    {
+        transfer(s, &net->Pump[i].Energy, sizeof(Senergy));
+    }
+}
+
+void transfer_quality(Project *pr, Scursor *s)
+/*-------------------------------------------------------------
+**   Input:   s = state buffer cursor
+**   Output:  none
+**   Purpose: transfers the state of the water quality solver
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int i;
+
+    // Node, source and tank qualities
+    transfer(s, qual->NodeQual, (net->Nnodes + 1) * sizeof(double));
+    if (qual->Nconstits > 0)
+    {
+        transfer(s, qual->ConstitQual[1],
+                 qual->Nconstits * (net->Nnodes + 1) * sizeof(double));
+    }
+    for (i = 1; i <= net->Nnodes; i++)
+    {
+        if (net->Node[i].S != NULL)
+        {
+            transfer(s, &net->Node[i].S->Smass, sizeof(double));
+        }
+    }
+    for (i = 1; i <= net->Ntanks; i++)
+    {
+        transfer(s, &net->Tank[i].C, sizeof(double));
+    }
+
+    // Transport state & pipe wall reaction coeffs.
+    transfer(s, qual->FlowDir, (net->Nlinks + 1) * sizeof(FlowDirection));
+    transfer(s, qual->PipeRateCoeff, (net->Nlinks + 1) * sizeof(double));
+    for (i = 1; i <= net->Nlinks; i++)
+    {
+        transfer(s, &net->Link[i].Rc, sizeof(double));
+    }
+    transfer(s, qual->SortedNodes,
+             (net->Nlinks + net->Ntanks + 1) * sizeof(int));
+    if (qual->Eulerflag)
+    {
+        transfer(s, qual->InletQual, (qual->Nconstits + 1) *
+                 (net->Nlinks + 1) * sizeof(double));
+    }
+
+    // Reaction & mass balance totals
+    transfer(s, &qual->Wbulk, sizeof(double));
+    transfer(s, &qual->Wwall, sizeof(double));
+    transfer(s, &qual->Wtank, sizeof(double));
+    transfer(s, &qual->Wsource, sizeof(double));
+
+    // Pipe & tank volume segments (followed by the mass balance
+    // whose segment count is incremented when segments are restored)
+    transfer_segs(pr, s);
+    transfer(s, &qual->MassBalance, sizeof(SmassBalance));
+
+    // Solver statistics (the peak segment count follows the
+    // segments, whose restoration can raise it)
+    transfer(s, &qual->Peaksegs, sizeof(int));
+    transfer(s, &qual->Nfullsorts, sizeof(int));
+    transfer(s, &qual->Nlocalsorts, sizeof(int));
+    transfer(s, &qual->Nqualsteps, sizeof(int));
+    transfer(s, &qual->MergeError, sizeof(double));
+}
+
+void transfer_segs(Project *pr, Scursor *s)
+/*-------------------------------------------------------------
+**   Input:   s = state buffer cursor
+**   Output:  none
+**   Purpose: transfers the water quality volume segments held
+**            in each pipe and tank
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Quality *qual = &pr->quality;
+
+    int    i, j, k, n, count;
+    int    nc = qual->Nconstits + 1;
+    long   segsize = (long)((nc + 1) * sizeof(double));
+    double v, c[MAXCONSTITS + 1];
+    Pseg   seg;
+
+    // Remove all segments from their pipes and tanks before restoring them
+    if (s->mode == RESTORE_STATE)
+    {
+        resetsegs(pr);
+        qual->OutOfMemory = FALSE;
+    }
+
+    n = net->Nlinks + net->Ntanks;
+    for (k = 1; k <= n; k++)
+    {
+        // Save each segment, from downstream to upstream end
+        if (s->mode == SIZE_STATE || s->mode == SAVE_STATE)
+        {
+            count = qual->SegRing[k].count;
+            transfer(s, &count, sizeof(int));
+            for (i = 0; i < count; i++)
+            {
+                seg = SEGMENT(qual, &qual->SegRing[k], i);
+                transfer(s, &seg->v, sizeof(double));
+                for (j = 0; j < nc; j++)
+                {
+                    transfer(s, &SEGQUAL(qual, j, seg), sizeof(double));
+                }
+            }
+        }
+
+        // Read the segment count
+        else
+        {
+            count = 0;
+            if (s->pos + (long)sizeof(int) <= s->size)
+            {
+                memcpy(&count, s->buf + s->pos, sizeof(int));
+            }
+            s->pos += sizeof(int);
+            if (count < 0 || count > (s->size - s->pos) / segsize)
+            {
+                s->overrun = TRUE;
+                return;
+            }
+
+            // Skip over the segments when checking the buffer
+            if (s->mode == CHECK_STATE)
+            {
+                s->pos += count * segsize;
+                continue;
+            }
+
+            // Otherwise rebuild them in the pipe or tank
+            while (count > 0)
+            {
+                transfer(s, &v, sizeof(double));
+                transfer(s, c, nc * sizeof(double));
+                addseg(pr, k, v, c);
+                count--;
+            }
+        }
+    }
+}
+
+void transfer(Scursor *s, void *data, size_t n)
+/*-------------------------------------------------------------
+**   Input:   s = state buffer cursor
+**            data = item being transferred
+**            n = size of item (bytes)
+**   Output:  none
+**   Purpose: transfers an item to or from a state buffer
+**-------------------------------------------------------------
+*/
+{
+    if (s->pos + (long)n > s->size) s->overrun = TRUE;
+    else if (s->mode == SAVE_STATE) memcpy(s->buf + s->pos, data, n);
+    else if (s->mode == RESTORE_STATE) memcpy(data, s->buf + s->pos, n);
+    s->pos += (long)n;
+}
+
+void get_header(Project *pr, int *hdr)
+/*-------------------------------------------------------------
+**   Input:   none
+**   Output:  hdr = state header
+**   Purpose: fills in the header that identifies the project
+**            a simulation state applies to
+**-------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+
+    hdr[0] = STATE_ID;
+    hdr[1] = STATE_VERSION;
+    hdr[2] = net->Nnodes;
+    hdr[3] = net->Nlinks;
+    hdr[4] = net->Ntanks;
+    hdr[5] = net->Npumps;
+    hdr[6] = pr->hydraul.HasLeakage;
+    hdr[7] = pr->quality.OpenQflag;
+    hdr[8] = pr->quality.Qualflag;
+    hdr[9] = pr->quality.Nconstits;
+    hdr[10] = pr->quality.Eulerflag;
+}
@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/10/2025
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -18,6 +18,7 @@
 
 #define   w_USE         "USE"
 #define   w_SAVE        "SAVE"
+#define   w_MEMORY      "MEMO"
 
 #define   w_NONE        "NONE"
 #define   w_ALL         "ALL"
@@ -65,6 +66,7 @@
 #define   w_ENERGY      "ENER"
 #define   w_NODE        "NODE"
 #define   w_LINK        "LINK"
+#define   w_OPTION      "OPTION"
 #define   w_FILE        "FILE"
 #define   w_YES         "YES"
 #define   w_NO          "NO"
@@ -98,8 +100,10 @@
 #define   w_HEAD        "HEAD"
 #define   w_PRESSURE    "PRESSURE"
 #define   w_QUALITY     "QUAL"
+#define   w_CONSTIT     "CONSTIT"
 
 #define   w_DIAM        "DIAM"
+#define   w_LENGTH      "LENG"
 #define   w_FLOW        "FLOW"
 #define   w_ROUGHNESS   "ROUG"
 #define   w_VELOCITY    "VELO"
@@ -129,6 +133,7 @@
 #define   w_TRIALS      "TRIAL"
 #define   w_ACCURACY    "ACCU"
 #define   w_SEGMENTS    "SEGM"
+#define   w_BUDGET      "BUDG"
 #define   w_TOLERANCE   "TOLER"
 #define   w_EMITTER     "EMIT"
 #define   w_BACKFLOW    "BACK"
@@ -142,6 +147,11 @@
 #define   w_RQTOL       "RQTOL"
 #define   w_CHECKFREQ   "CHECKFREQ"
 #define   w_MAXCHECK    "MAXCHECK"
+#define   w_THREADS     "THREADS"
+#define   w_TRANSPORT   "TRANSP"
+#define   w_COURANT     "COUR"
+#define   w_LAGRANGIAN  "LAGR"
+#define   w_EULERIAN    "EULER"
 #define   w_DAMPLIMIT   "DAMPLIMIT"
 
 #define   w_FLOWCHANGE  "FLOWCHANGE"
@@ -187,6 +197,17 @@
 #define   w_MAX         "MAXIMUM"
 #define   w_RANGE       "RANGE"
 
+#define   w_REALIZE     "REAL"
+#define   w_SEED        "SEED"
+#define   w_QUANTILE    "QUAN"
+#define   w_NORMAL      "NORM"
+#define   w_LOGNORMAL   "LOGN"
+#define   w_UNIFORM     "UNIF"
+#define   w_TRIANGULAR  "TRIA"
+#define   w_LIMITS      "LIMITS"
+#define   w_WEIGHT      "WEIG"
+#define   w_ITERATIONS  "ITER"
+
 #define   w_UNBALANCED  "UNBA"
 #define   w_STOP        "STOP"
 #define   w_CONTINUE    "CONT"
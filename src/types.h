@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 02/03/2026
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -35,6 +35,7 @@ typedef  int          INT4;
 #define   MAGICNUMBER        516114521
 #define   ENGINE_VERSION     201   // Used for binary hydraulics file
 #define   EOFMARK            0x1A  // Use 0x04 for UNIX systems
+#define   HYDMEMORY          256.  // Default memory (MB) for scratch hydraulics
 #define   MAXTITLE  3        // Max. # title lines
 #define   TITLELEN  79       // Max. # characters in a title line
 #define   MAXID     31       // Max. # characters in ID name
@@ -42,6 +43,7 @@ typedef  int          INT4;
 #define   MAXLINE   1024     // Max. # characters read from input line
 #define   MAXFNAME  259      // Max. # characters in file name
 #define   MAXTOKS   40       // Max. items per line of input
+#define   MAXCONSTITS 64     // Max. # additional quality constituents
 #define   TRUE      1
 #define   FALSE     0
 #define   FULL      2
@@ -167,6 +169,17 @@ typedef enum {
   TRACE          // trace % of flow from a source
 } QualType;
 
+typedef enum {
+  LAGRANGIAN,    // variable volume segments moved with the flow
+  EULERIAN       // fixed cells of pipe volume with fluxes between them
+} TransportType;
+
+typedef enum {
+  ANY_ORDER,     // general bulk & wall kinetics in each segment
+  AGING,         // water age grows by the time step
+  FIRST_ORDER    // 1st-order bulk & wall decay factor per pipe
+} ReactKernelType;
+
 typedef enum {
   VOLUME_CURVE,  // volume curve
   PUMP_CURVE,    // pump curve
@@ -319,6 +332,22 @@ typedef enum {
   PDA            // pressure driven analysis
 } DemandModelType;
 
+typedef enum {
+  SHARED_NODES,     // node array, demands, sources, comments & tags
+  SHARED_LINKS,     // link array
+  SHARED_LINKEXTRA, // link vertices, comments & tags
+  SHARED_TANKS,     // tank array
+  SHARED_PUMPS,     // pump array
+  SHARED_VALVES,    // valve array
+  SHARED_CONTROLS,  // simple control array
+  SHARED_PATTERNS,  // time patterns
+  SHARED_CURVES,    // data curves
+  SHARED_RULES,     // rule-based controls
+  SHARED_HASH,      // node & link ID hash tables
+  SHARED_MATRIX,    // symbolic structure of sparse matrix
+  MAXSHARED
+} SharedData;
+
 /*
 ------------------------------------------------------
    Fundamental Data Structures
@@ -503,13 +532,40 @@ struct Sadjlist            // Node Adjacency List Item
 };
 typedef struct Sadjlist *Padjlist; // Pointer to adjacency list
 
-struct  Sseg               // Pipe Segment List Item
+struct  Sseg               // Pipe or Tank Volume Segment
 {
     double  v;             // segment volume
-    double  c;             // segment water quality
-    struct  Sseg *prev;    // previous segment in list
 };
-typedef struct Sseg *Pseg; // Pointer to pipe segment list
+typedef struct Sseg *Pseg; // Pointer to a volume segment
+
+typedef struct             // Water Quality Constituent
+{
+    int    Type;           // CHEM, AGE or TRACE (see QualType)
+    int    Node;           // node whose flow is traced
+    double Ctol;           // tolerance for merging segments
+} Sconstit;
+
+typedef struct             // Ring Buffer of a Pipe's or Tank's Segments
+{
+    int    base;           // offset of buffer within segment arena
+    int    size;           // buffer capacity (a power of 2)
+    int    head;           // buffer position of first (downstream) segment
+    int    dir;            // step (+1 or -1) from first towards last segment
+    int    count;          // number of segments held
+} Sring;
+
+// Macros to locate the i-th segment (counting upstream from the first)
+// and the first and last segments of pipe or tank k's segment ring
+#define SEGMENT(q,r,i) ((q)->Segs + (r)->base + \
+                        (((r)->head + (r)->dir * (i)) & ((r)->size - 1)))
+#define FIRSTSEG(q,k)  ((q)->SegRing[k].count == 0 ? NULL : \
+                        SEGMENT(q, &(q)->SegRing[k], 0))
+#define LASTSEG(q,k)   ((q)->SegRing[k].count == 0 ? NULL : \
+                        SEGMENT(q, &(q)->SegRing[k], (q)->SegRing[k].count - 1))
+
+// Macro to locate the quality of constituent i (0 for the one named
+// by the QUALITY option) in segment s
+#define SEGQUAL(q,i,s) ((q)->SegQual[i][(s) - (q)->Segs])
 
 typedef struct s_Premise       // Rule Premise Clause
 {
@@ -548,6 +604,15 @@ typedef struct s_ActionItem    // Action List Item
     struct  s_ActionItem *next;  // next action on the list
 } SactionList;
 
+typedef struct                 // Rule Dependency Index Item
+{
+    int      type;             // type of object watched (node, link, etc.)
+    int      index;            // object's index
+    int      first;            // position of first dependent rule
+    int      count;            // number of dependent rules
+    double   x[3];             // last seen values of object's variables
+} SruleWatch;
+
 typedef struct                 // Mass Balance Components
 {
     double    initial;         // initial mass in system
@@ -559,6 +624,14 @@ typedef struct                 // Mass Balance Components
     int       segCount;        // total number of pipe segments used                       
 } SmassBalance;
 
+typedef struct                 // Mass Carried Through a Node in a Time Step
+{
+    double    inflow;          // mass added to system
+    double    outflow;         // mass removed from system
+    double    source;          // mass added by a quality source
+    int       segs;            // change in number of segments
+} SnodeMass;
+
 typedef struct
 {
     double    totalInflow;
@@ -579,6 +652,12 @@ typedef struct                 // Node Leakage Object
   double cva;                  // variable area leakage coeff.
 } Sleakage;
 
+typedef struct                 // Event Queue Item
+{
+  double key;                  // time (sec) of event or control grade
+  int    index;                // index of control or tank
+} SqueueItem;
+
 /*
 ------------------------------------------------------
   Wrapper Data Structures
@@ -635,6 +714,7 @@ typedef struct {
     Htime,                 // Current hyd. time
     Hydstep,               // Actual hydraulic time step
     Qstep,                 // Quality time step
+    Qualstep,              // Actual quality time step of current hyd. period
     Qtime,                 // Current quality time
     Rulestep,              // Rule evaluation time step
     Dur;                   // Duration of simulation
@@ -695,10 +775,25 @@ typedef struct {
     OutOffset1,            // 1st output file byte offset
     OutOffset2;            // 2nd output file byte offset
 
+  double
+    HydMemory;             // Most memory (MB) holding scratch hydraulics
+
+  char
+    *HydStore;             // In-memory scratch hydraulics (or NULL)
+
+  const char
+    *HydData;              // Memory-mapped hydraulics file (or NULL)
+
+  size_t
+    HydSize,               // Size of mapped hydraulics file in bytes
+    HydCapacity,           // Bytes allocated to in-memory hydraulics
+    HydPos;                // Read position in mapped hydraulics file
+
   FILE
     *OutFile,              // Output file handle
     *HydFile,              // Hydraulics file handle
-    *TmpOutFile;           // Temporary file handle
+    *TmpOutFile,           // Temporary file handle
+    *ConstitFile;          // Added constituents' results file handle
 
 } Outfile;
 
@@ -713,6 +808,16 @@ typedef struct {
     Saction     *LastThenAction; // Previous THEN action
     Saction     *LastElseAction; // Previous ELSE action
 
+    int         Compiled;        // TRUE if rules compiled for evaluation
+    int         Nwatches;        // Number of rule dependency index items
+    int         *PremStart;      // Start of each rule's compiled premises
+    int         *DepRules;       // Dependent rules of each index item
+    char        *IsStale;        // TRUE if rule needs re-evaluation
+    char        *RuleResult;     // Last evaluated result of each rule
+    Spremise    *Premises;       // Compiled premises of all rules
+    SruleWatch  *Watches;        // Rule dependency index
+    SactionList *LinkAction;     // Action list item for each link
+
 } Rules;
 
 // Sparse Matrix Wrapper
@@ -732,11 +837,145 @@ typedef struct {
     *XLNZ,       // Start position of each column in NZSUB
     *NZSUB,      // Row index of each coeff. in each column
     *LNZ,        // Position of each coeff. in Aij array
+    Borrowed,    // TRUE if Order thru LNZ are shared with clones
     *link,       // Array used by linear eqn. solver
     *first;      // Array used by linear eqn. solver
 
 } Smatrix;
 
+// Factored Matrix of a Hydraulic Solution (see HYDSOLVER.C)
+typedef struct {
+
+  double
+    *Lii,        // Diagonal coeffs. of Cholesky factor
+    *Lij,        // Off-diagonal coeffs. of Cholesky factor
+    *z,          // Factored matrix's solution for update's link
+    w;           // Weight of rank-one update
+
+  int
+    link;        // Link whose coeff. is updated (0 if none)
+
+} Sfactor;
+
+// Base Case of an Analysis Run on Worker Threads (see BASECASE.C)
+typedef struct {
+
+  struct Project
+    **Clones;    // Each worker's clone of the project
+
+  char
+    *State;      // Saved state of the base case solution
+
+  long
+    StateSize;   // Size of saved state
+
+  int
+    Nworkers;    // Number of worker threads
+
+  Sfactor
+    Factor;      // Factored base case matrix (Lii is NULL if singular)
+
+  struct Workpool
+    *Pool;       // Worker threads of the analysis
+
+} Sbasecase;
+
+// Control & Tank Event Schedule
+typedef struct {
+
+  int
+    Open,        // TRUE if schedule is in use
+    Built,       // TRUE if schedule reflects current data
+    Ntimers,     // Number of controls in timer queue
+    Nother,      // Number of controls examined individually
+    *Other,      // Controls examined individually
+    *Fired,      // Controls activated at current time
+    *LevelStart, // Start of each tank's LOWLEVEL & HILEVEL lists
+    *TankSlot,   // Position of each tank in tank queue
+    *TankVisit,  // Tanks examined in tank queue
+    *Stack;      // Array used to search queues
+
+  char
+    *IsFired,    // TRUE if control is activated at current time
+    *LevelSorted; // TRUE if volume increases with grade in a list
+
+  long
+    Tref;        // Time at which schedule was last updated
+
+  double
+    *LevelVol,   // Tank volume at each level control's grade
+    *TankInflow, // Tank inflow when tank was last keyed
+    *TankTime;   // Fill/drain times of tanks examined
+
+  SqueueItem
+    *LevelList,  // Level controls sorted by grade
+    *TimerQueue, // Heap of time-based controls
+    *TankQueue;  // Heap of tanks by time to fill/drain
+
+} Sschedule;
+
+// Junction Demand Matrix
+typedef struct {
+
+  int
+    Built,       // TRUE if matrix reflects current demand data
+    Ncats,       // Number of demand categories
+    Npats,       // Number of time patterns
+    *RowStart,   // Start of each junction's categories
+    *CatPat,     // Time pattern of each category
+    *PatStart,   // Start of each pattern's junctions in PatRows
+    *PatRows,    // Junctions that use each pattern
+    *ChangedRows; // Junctions whose demands must be re-evaluated
+
+  char
+    *Changed;    // TRUE if junction is in ChangedRows
+
+  long
+    Period;      // Pattern period of current demands
+
+  double
+    Dmult,       // Demand multiplier of current demands
+    *CatBase,    // Base demand of each category
+    *CatDemand,  // Current demand of each category
+    *PatFactor;  // Current factor of each pattern
+
+} SdemandMatrix;
+
+// Independent Zones of Solution Matrix
+typedef struct {
+
+  int
+    Nzones,      // Number of zones in current trial
+    *Parent,     // Parent of each junction in a zone's tree
+    *Zone,       // Zone of each row of solution matrix
+    *Start,      // Start of each zone's rows in Rows
+    *Rows,       // Rows of each zone in ascending order
+    *Failed,     // Ill-conditioned row of each zone (0 if none)
+    *Skipped;    // TRUE if a zone wasn't solved in current trial
+
+  struct Workpool
+    *Pool;       // Worker threads that solve the zones
+
+} Szones;
+
+// Domains of Solution Matrix Solved on Separate Processes
+typedef struct {
+
+  int
+    Ndomains,    // Number of domains (one per process, 0 if not used)
+    Rank,        // Process's rank (the domain that it solves)
+    Nrows,       // Number of interface rows
+    Ncoeffs,     // Number of off-diagonal coeffs. in interface columns
+    *Start,      // First row of each domain (and of interface rows)
+    *Counts,     // Number of rows in each domain
+    *Displs;     // Offset of each domain's rows in solution vector
+
+  double
+    *Work,       // Interface coeffs. contributed by a process's domain
+    *Sum;        // Sum of all domains' contributions (on rank 0)
+
+} Sdomains;
+
 // Hydraulics Solver Wrapper
 typedef struct {
 
@@ -775,6 +1014,7 @@ typedef struct {
     DemandReduction,       // % demand reduction at pressure deficient nodes
     LeakageLoss,           // % system leakage loss
     RelaxFactor,           // Relaxation factor for flow updating
+    FireFlow,              // Fire flow drawn from FireNode
     *P,                    // Inverse of head loss derivatives
     *Y,                    // Flow correction factors
     *Xflow;                // Inflow - outflow at each node
@@ -793,7 +1033,10 @@ typedef struct {
     OpenHflag,             // Hydraulic system opened flag
     Haltflag,              // Flag to halt simulation
     DeficientNodes,        // Number of pressure deficient nodes
-    HasLeakage;            // TRUE if project has non-zero leakage parameters
+    HasLeakage,            // TRUE if project has non-zero leakage parameters
+    FireNode,              // Junction drawing a fire flow (0 if none)
+    Factored,              // TRUE if smatrix holds factored matrix of solution
+    Threads;               // Threads solving independent zones (1 if none)
     
   Sleakage *Leakage;       // Array of node leakage parameters
 
@@ -806,10 +1049,15 @@ typedef struct {
 
   Smatrix smatrix;         // Sparse matrix storage
 
-} Hydraul;
+  Sschedule schedule;      // Control & tank event schedule
+
+  SdemandMatrix dmatrix;   // Junction demand matrix
 
-// Forward declaration of the Mempool structure defined in mempool.h
-struct Mempool;
+  Szones zones;            // Independent zones of solution matrix
+
+  Sdomains domains;        // Domains of solution matrix on processes
+
+} Hydraul;
 
 // Water Quality Solver Wrapper
 typedef struct {
@@ -817,11 +1065,36 @@ typedef struct {
   int
     Qualflag,              // Water quality analysis flag
     OpenQflag,             // Quality system opened flag
+    Transport,             // Pipe transport method (see TransportType)
+    Eulerflag,             // TRUE if pipes hold fixed cells in this run
     Reactflag,             // Reaction indicator
+    ReactKernel,           // Pipe reaction kernel (see ReactKernelType)
     OutOfMemory,           // Out of memory indicator
+    SegCapacity,           // Capacity of segment arena
+    SegTop,                // Next unused position in segment arena
+    Nstages,               // Number of stages of sorted nodes (0 if none)
+    *StageNodes,           // Sorted nodes listed by stage
+    *StageStart,           // Start of each stage in StageNodes
+    *StageShared,          // TRUE if a stage is routed by worker threads
+    *NodeLevel,            // Level of each node
     TraceNode,             // Source node for flow tracing
+    Nconstits,             // Number of additional constituents
+    SegBudget,             // Most segments to be held (0 if no limit)
+    Peaksegs,              // Most segments held at any time
+    Sortedflag,            // TRUE if SortedNodes can be repaired locally
+    Nfullsorts,            // Number of full sorts of the nodes
+    Nlocalsorts,           // Number of local repairs of the sorted nodes
+    Nqualsteps,            // Number of transport steps taken
+    Nnewflows,             // Number of links listed in NewFlows
+    *NewFlows,             // Links whose flow took a new direction
+    *SortPos,              // Position of each node in SortedNodes
+    *SortMark,             // Visit marks of a local repair
+    *SortWork,             // Work space for sorting nodes
     *SortedNodes;          // Topologically sorted node indexes
 
+  Sconstit
+    Constit[MAXCONSTITS+1];// Constituents (0 mirrors the QUALITY option)
+
   char
     ChemName[MAXID + 1],   // Name of chemical
     ChemUnits[MAXID + 1];  // Units of chemical
@@ -843,17 +1116,19 @@ typedef struct {
     Kbulk,                 // Global bulk reaction coeff.
     Kwall,                 // Global wall reaction coeff.
     Climit,                // Limiting potential quality
-    SourceQual,            // External source quality
+    MergeError,            // Largest spread in quality of merged segments
+    Courant,               // Target Courant number of adaptive steps (0 if fixed)
     *NodeQual,             // Reported node quality state
+    *ConstitQual[MAXCONSTITS+1], // Node quality of each constituent
+    *SegQual[MAXCONSTITS+1],     // Segment quality of each constituent
+    *InletQual,            // Quality of each constituent entering each pipe
     *PipeRateCoeff;        // Pipe reaction rate coeffs.
 
-  struct Mempool
-    *SegPool;              // Memory pool for water quality segments
-
   Pseg
-    FreeSeg,               // Pointer to unused segment
-    *FirstSeg,             // First (downstream) segment in each pipe
-    *LastSeg;              // Last (upstream) segment in each pipe
+    Segs;                  // Arena holding all segment rings
+
+  Sring
+    *SegRing;              // Segment ring of each pipe & tank
 
   FlowDirection
     *FlowDir;              // Flow direction for each pipe
@@ -861,6 +1136,12 @@ typedef struct {
   SmassBalance
     MassBalance;           // Mass balance components
 
+  SnodeMass
+    *NodeMass;             // Mass carried through each node
+
+  struct Workpool
+    *Pool;                 // Worker threads that route flow through nodes
+
 } Quality;
 
 // Pipe Network Wrapper
@@ -892,6 +1173,8 @@ typedef struct {
     *NodeHashTable,        // Hash table for Node ID names
     *LinkHashTable;        // Hash table for Link ID names
   Padjlist *Adjlist;       // Node adjacency lists
+  Smatrix  *Sparse;        // Sparse matrix structure shared with clones
+  long     *Refcount[MAXSHARED]; // Reference counts of shared data
 
 } Network;
 
@@ -919,7 +1202,8 @@ typedef struct Project {
     MapFname[MAXFNAME+1],        // Map file name
     TmpHydFname[MAXFNAME+1],     // Temporary hydraulics file name
     TmpOutFname[MAXFNAME+1],     // Temporary output file name
-    TmpStatFname[MAXFNAME+1];    // Temporary statistic file name
+    TmpStatFname[MAXFNAME+1],    // Temporary statistic file name
+    TmpConstitFname[MAXFNAME+1]; // Temporary constituent results file name
 
   void (* viewprog) (char *);    // Pointer to progress viewing function
 
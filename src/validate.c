@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/18/2024
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -223,7 +223,9 @@ int pumpcurvepump(Project *pr, Spump *pump, Scurve *curve)
     double a, b, c, h0 = 0.0, h1 = 0.0, h2 = 0.0, q1 = 0.0, q2 = 0.0;
     int npts = curve->Npts;
 
-    curve->Type = PUMP_CURVE;
+    // (curve may be shared with clones of the project so it
+    // is only written to if its type changes)
+    if (curve->Type != PUMP_CURVE) curve->Type = PUMP_CURVE;
 
     // Generic power function curve
     if (npts == 1)
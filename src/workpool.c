@@ -0,0 +1,330 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       workpool.c
+ Description:  a work-stealing pool of worker threads
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+A pool runs jobs made up of a number of independent items (e.g., scenarios
+to be analyzed) on a fixed set of worker threads, the thread that submits a
+job being worker 0. The items of a job are split evenly into a range of item
+numbers for each worker. A worker takes items from the front of its own
+range and, once it runs out of them, steals the back half of the range of
+another worker, so that workers that finish early keep busy while others
+are held up by items that take longer to process.
+
+The worker threads wait between jobs and are only stopped when the pool is
+deleted, so a pool can also be used for jobs that are run many times over.
+A task must not submit a job to the pool that is running it.
+*/
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "workpool.h"
+
+// Thread synchronization primitives
+#ifdef _WIN32
+typedef HANDLE             Thread;
+typedef CRITICAL_SECTION   Mutex;
+typedef CONDITION_VARIABLE Condition;
+#define mutex_init(m)      InitializeCriticalSection(m)
+#define mutex_free(m)      DeleteCriticalSection(m)
+#define mutex_lock(m)      EnterCriticalSection(m)
+#define mutex_unlock(m)    LeaveCriticalSection(m)
+#define cond_init(c)       InitializeConditionVariable(c)
+#define cond_free(c)
+#define cond_wait(c, m)    SleepConditionVariableCS(c, m, INFINITE)
+#define cond_signal(c)     WakeConditionVariable(c)
+#define cond_broadcast(c)  WakeAllConditionVariable(c)
+#else
+typedef pthread_t          Thread;
+typedef pthread_mutex_t    Mutex;
+typedef pthread_cond_t     Condition;
+#define mutex_init(m)      pthread_mutex_init(m, NULL)
+#define mutex_free(m)      pthread_mutex_destroy(m)
+#define mutex_lock(m)      pthread_mutex_lock(m)
+#define mutex_unlock(m)    pthread_mutex_unlock(m)
+#define cond_init(c)       pthread_cond_init(c, NULL)
+#define cond_free(c)       pthread_cond_destroy(c)
+#define cond_wait(c, m)    pthread_cond_wait(c, m)
+#define cond_signal(c)     pthread_cond_signal(c)
+#define cond_broadcast(c)  pthread_cond_broadcast(c)
+#endif
+
+// Range of items not yet taken from a worker's share of a job
+struct WorkRange
+{
+    Mutex lock;
+    int   first;     // First item in range
+    int   last;      // One past the last item in range
+};
+
+struct WorkThread
+{
+    struct Workpool *pool;
+    Thread          thread;
+    int             index;   // Worker index
+};
+
+struct Workpool
+{
+    int               size;       // Number of workers (incl. worker 0)
+    struct WorkRange  *ranges;    // Each worker's range of items
+    struct WorkThread *threads;   // Workers 1 to size - 1
+    Mutex             lock;       // Guards the job variables below
+    Mutex             userlock;   // Lock available to tasks
+    Condition         start;      // Signals that a job was posted
+    Condition         done;       // Signals that a job was completed
+    Workpool_task     task;       // Job's task function
+    void              *data;      // Data passed to task function
+    long              job;        // Number of jobs posted
+    int               busy;       // Number of workers still running a job
+    int               quit;       // TRUE if workers should exit
+};
+
+
+static int takeitem(struct Workpool *pool, int worker)
+/*
+**  Removes the first item from a worker's range, stealing half of
+**  another worker's range when it's empty. Returns -1 if all of a
+**  job's items have been taken.
+*/
+{
+    struct WorkRange *range = &pool->ranges[worker];
+    struct WorkRange *victim;
+    int i, n, item = -1;
+
+    mutex_lock(&range->lock);
+    if (range->first < range->last) item = range->first++;
+    mutex_unlock(&range->lock);
+    if (item >= 0) return item;
+
+    // Steal the back half of the first non-empty range found
+    for (i = 1; i < pool->size; i++)
+    {
+        victim = &pool->ranges[(worker + i) % pool->size];
+        mutex_lock(&victim->lock);
+        n = victim->last - victim->first;
+        if (n > 0)
+        {
+            item = victim->last - (n + 1) / 2;
+            n = victim->last;
+            victim->last = item;
+        }
+        mutex_unlock(&victim->lock);
+        if (item < 0) continue;
+
+        // Keep the rest of the stolen items for later
+        mutex_lock(&range->lock);
+        range->first = item + 1;
+        range->last = n;
+        mutex_unlock(&range->lock);
+        return item;
+    }
+    return -1;
+}
+
+
+static void runitems(struct Workpool *pool, int worker)
+{
+    int item;
+    while ((item = takeitem(pool, worker)) >= 0)
+    {
+        pool->task(pool->data, worker, item);
+    }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI workerthread(LPVOID arg)
+#else
+static void *workerthread(void *arg)
+#endif
+{
+    struct WorkThread *t = (struct WorkThread *)arg;
+    struct Workpool *pool = t->pool;
+    long job = 0;
+
+    for (;;)
+    {
+        // Wait for the next job to be posted
+        mutex_lock(&pool->lock);
+        while (pool->job == job && !pool->quit)
+        {
+            cond_wait(&pool->start, &pool->lock);
+        }
+        job = pool->job;
+        mutex_unlock(&pool->lock);
+        if (pool->quit) break;
+
+        // Process the job's items & report back when done
+        runitems(pool, t->index);
+        mutex_lock(&pool->lock);
+        pool->busy--;
+        if (pool->busy == 0) cond_signal(&pool->done);
+        mutex_unlock(&pool->lock);
+    }
+    return 0;
+}
+
+
+int workpool_cpucount(void)
+{
+    int n;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = (int)info.dwNumberOfProcessors;
+#else
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0) ? n : 1;
+}
+
+
+struct Workpool * workpool_create(int nthreads)
+/*
+**  Creates a pool with nthreads workers (or one per processor
+**  if nthreads <= 0), including the thread that runs its jobs.
+*/
+{
+    struct Workpool *pool;
+    int i;
+
+    if (nthreads <= 0) nthreads = workpool_cpucount();
+    pool = (struct Workpool *)calloc(1, sizeof(struct Workpool));
+    if (pool == NULL) return NULL;
+    pool->ranges = (struct WorkRange *)calloc(nthreads, sizeof(struct WorkRange));
+    pool->threads = (struct WorkThread *)calloc(nthreads, sizeof(struct WorkThread));
+    if (pool->ranges == NULL || pool->threads == NULL)
+    {
+        free(pool->ranges);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    for (i = 0; i < nthreads; i++) mutex_init(&pool->ranges[i].lock);
+    mutex_init(&pool->lock);
+    mutex_init(&pool->userlock);
+    cond_init(&pool->start);
+    cond_init(&pool->done);
+
+    // Start the worker threads (a pool that fails to start
+    // all of them runs with those that did start)
+    pool->size = 1;
+    for (i = 1; i < nthreads; i++)
+    {
+        pool->threads[i].pool = pool;
+        pool->threads[i].index = i;
+#ifdef _WIN32
+        pool->threads[i].thread = CreateThread(NULL, 0, workerthread,
+                                               &pool->threads[i], 0, NULL);
+        if (pool->threads[i].thread == NULL) break;
+#else
+        if (pthread_create(&pool->threads[i].thread, NULL, workerthread,
+                           &pool->threads[i]) != 0) break;
+#endif
+        pool->size++;
+    }
+    return pool;
+}
+
+
+void workpool_delete(struct Workpool *pool)
+{
+    int i;
+
+    if (pool == NULL) return;
+    mutex_lock(&pool->lock);
+    pool->quit = 1;
+    cond_broadcast(&pool->start);
+    mutex_unlock(&pool->lock);
+    for (i = 1; i < pool->size; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i].thread, INFINITE);
+        CloseHandle(pool->threads[i].thread);
+#else
+        pthread_join(pool->threads[i].thread, NULL);
+#endif
+    }
+    for (i = 0; i < pool->size; i++) mutex_free(&pool->ranges[i].lock);
+    mutex_free(&pool->lock);
+    mutex_free(&pool->userlock);
+    cond_free(&pool->start);
+    cond_free(&pool->done);
+    free(pool->ranges);
+    free(pool->threads);
+    free(pool);
+}
+
+
+int workpool_size(struct Workpool *pool)
+{
+    return pool->size;
+}
+
+
+void workpool_run(struct Workpool *pool, int nitems, Workpool_task task,
+                  void *data)
+/*
+**  Runs task on items 0 to nitems - 1, returning once all
+**  of them have been processed.
+*/
+{
+    int i, n = pool->size;
+
+    if (nitems <= 0) return;
+
+    // Give each worker an equal share of the items
+    for (i = 0; i < n; i++)
+    {
+        pool->ranges[i].first = (int)((long long)nitems * i / n);
+        pool->ranges[i].last = (int)((long long)nitems * (i + 1) / n);
+    }
+    pool->task = task;
+    pool->data = data;
+
+    // Post the job to the worker threads & take part in it
+    if (n > 1)
+    {
+        mutex_lock(&pool->lock);
+        pool->busy = n - 1;
+        pool->job++;
+        cond_broadcast(&pool->start);
+        mutex_unlock(&pool->lock);
+    }
+    runitems(pool, 0);
+
+    // Wait for the other workers to finish
+    if (n > 1)
+    {
+        mutex_lock(&pool->lock);
+        while (pool->busy > 0) cond_wait(&pool->done, &pool->lock);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+
+void workpool_lock(struct Workpool *pool)
+{
+    mutex_lock(&pool->userlock);
+}
+
+
+void workpool_unlock(struct Workpool *pool)
+{
+    mutex_unlock(&pool->userlock);
+}
@@ -0,0 +1,31 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       workpool.h
+ Description:  header for a work-stealing pool of worker threads
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+struct Workpool;
+
+// Function that processes one item of a job (worker = 0 to size - 1)
+typedef void (*Workpool_task)(void *data, int worker, int item);
+
+struct Workpool * workpool_create(int nthreads);
+void   workpool_delete(struct Workpool *pool);
+int    workpool_size(struct Workpool *pool);
+void   workpool_run(struct Workpool *pool, int nitems, Workpool_task task,
+                    void *data);
+void   workpool_lock(struct Workpool *pool);
+void   workpool_unlock(struct Workpool *pool);
+int    workpool_cpucount(void);
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ ******************************************************************************
+ Project:      OWA EPANET
+ Version:      2.3
+ Module:       zones.c
+ Description:  solves independent zones of a network's hydraulic equations
+               in parallel
+ Authors:      see AUTHORS
+ Copyright:    see AUTHORS
+ License:      see LICENSE
+ Last Updated: 10/18/2026
+ ******************************************************************************
+*/
+/*
+Closed links (including closed check valves) and active pressure reducing,
+pressure sustaining and flow control valves can split a network into zones
+whose heads don't depend on one another within a trial of hydsolve(): an
+active valve fixes the head or flow at its ends, acting as a boundary for the
+zones on either side of it, and a closed link only has the tiny conductance
+given to it so that the solution matrix stays non-singular.
+
+When a project's Threads option isn't 1, the zones are found at each trial
+from the current link coefficients and each zone's block of the solution
+matrix is factored and solved on its own on a pool of worker threads (see
+WORKPOOL.C). The coupling through a closed link joining two zones is moved to
+the right hand side using the current heads, so the converged solution is
+the same as that of the whole matrix. The matrix's elimination order needs
+no change: with no coupling between zones the Cholesky factor of one zone's
+columns involves no other zone's columns.
+
+A zone whose flow balance is already met by its current heads (to within
+ZONETOL) is skipped for that trial, keeping its heads. Any zones skipped on
+the last trial are factored once a solution is found so that the factored
+matrix left by hydsolve() is complete (see SENSITIVITY.C).
+
+The exported functions are:
+  openzones()   -- called from openhyd() in HYDRAUL.C
+  closezones()  -- called from closehyd() in HYDRAUL.C
+  zonesolve()   -- called from hydsolve() in HYDSOLVER.C
+  factorzones() -- called from hydsolve() in HYDSOLVER.C
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "types.h"
+#include "funcs.h"
+#include "workpool.h"
+
+#define ZONETOL 1.e-6   // Flow imbalance (cfs) below which a zone is skipped
+
+// Exported functions (declared in funcs.h)
+//int     openzones(Project *);
+//void    closezones(Project *);
+//int     zonesolve(Project *);
+//int     factorzones(Project *);
+
+// Imported functions
+extern int  linsolve(Smatrix *, int);   //(see SMATRIX.C)
+extern int  linfactorzone(Smatrix *, const int *, int, const int *);
+extern void linsubstzone(Smatrix *, double *, const int *, int,
+                         const int *);
+
+// Local functions
+static int  findroot(int *, int);
+static void findzones(Project *);
+static void cutzones(Project *);
+static void solvezone(void *, int, int);
+static void factorzone(void *, int, int);
+static int  zonebalanced(Project *, int);
+
+
+int openzones(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns error code
+**  Purpose: allocates memory and threads used to solve
+**           independent zones of a network.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Szones  *zn = &hyd->zones;
+    int n = net->Njuncs;
+    int nthreads, errcode = 0;
+
+    memset(zn, 0, sizeof(Szones));
+    if (hyd->Threads == 1 || n < 2) return 0;
+    zn->Parent = (int *)calloc(n + 1, sizeof(int));
+    zn->Zone = (int *)calloc(n + 1, sizeof(int));
+    zn->Start = (int *)calloc(n + 2, sizeof(int));
+    zn->Rows = (int *)calloc(n + 1, sizeof(int));
+    zn->Failed = (int *)calloc(n + 1, sizeof(int));
+    zn->Skipped = (int *)calloc(n + 1, sizeof(int));
+    ERRCODE(MEMCHECK(zn->Parent));
+    ERRCODE(MEMCHECK(zn->Zone));
+    ERRCODE(MEMCHECK(zn->Start));
+    ERRCODE(MEMCHECK(zn->Rows));
+    ERRCODE(MEMCHECK(zn->Failed));
+    ERRCODE(MEMCHECK(zn->Skipped));
+    if (!errcode)
+    {
+        nthreads = hyd->Threads;
+        if (nthreads <= 0) nthreads = workpool_cpucount();
+        zn->Pool = workpool_create(nthreads);
+        if (zn->Pool == NULL) errcode = 101;
+    }
+    if (errcode) closezones(pr);
+    return errcode;
+}
+
+void closezones(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: frees memory and threads used to solve independent
+**           zones of a network.
+**--------------------------------------------------------------
+*/
+{
+    Szones *zn = &pr->hydraul.zones;
+
+    workpool_delete(zn->Pool);
+    free(zn->Parent);
+    free(zn->Zone);
+    free(zn->Start);
+    free(zn->Rows);
+    free(zn->Failed);
+    free(zn->Skipped);
+    memset(zn, 0, sizeof(Szones));
+}
+
+int zonesolve(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  sm->F = solution values
+**           returns 0 if solution found, or index of equation
+**           causing system to be ill-conditioned
+**  Purpose: solves the linearized hydraulic equations of the
+**           current trial one independent zone at a time.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Szones  *zn = &hyd->zones;
+    int z, errcode = 0;
+
+    // A network that forms a single zone is solved as a whole
+    findzones(pr);
+    if (zn->Nzones <= 1) return linsolve(sm, net->Njuncs);
+
+    // Solve the zones in parallel, reporting the first
+    // ill-conditioned row
+    cutzones(pr);
+    workpool_run(zn->Pool, zn->Nzones, solvezone, pr);
+    for (z = 0; z < zn->Nzones; z++)
+    {
+        if (zn->Failed[z] == 0) continue;
+        if (errcode == 0 || zn->Failed[z] < errcode) errcode = zn->Failed[z];
+    }
+    return errcode;
+}
+
+int factorzones(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  returns TRUE if the solution matrix is left factored
+**  Purpose: factors the zones skipped on the last trial of
+**           hydsolve().
+**--------------------------------------------------------------
+*/
+{
+    Szones *zn = &pr->hydraul.zones;
+    int z;
+
+    if (zn->Nzones <= 1) return TRUE;
+    workpool_run(zn->Pool, zn->Nzones, factorzone, pr);
+    for (z = 0; z < zn->Nzones; z++)
+    {
+        if (zn->Failed[z] > 0) return FALSE;
+    }
+    return TRUE;
+}
+
+int findroot(int *parent, int i)
+/*
+**--------------------------------------------------------------
+**  Input:   parent = parent of each junction
+**           i = junction index
+**  Output:  returns the junction at the root of i's tree
+**  Purpose: finds the junction that stands for i's zone,
+**           shortening the path to it as it goes.
+**--------------------------------------------------------------
+*/
+{
+    int root = i, next;
+
+    while (parent[root] != root) root = parent[root];
+    while (parent[i] != root)
+    {
+        next = parent[i];
+        parent[i] = root;
+        i = next;
+    }
+    return root;
+}
+
+void findzones(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: groups the rows of the solution matrix into zones
+**           joined by links that are neither closed nor active
+**           control valves.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Szones  *zn = &hyd->zones;
+    int *parent = zn->Parent;
+    int i, k, n1, n2, r, z, n = net->Njuncs;
+
+    // Join the junctions at either end of each coupling link
+    for (i = 1; i <= n; i++) parent[i] = i;
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        n1 = net->Link[k].N1;
+        n2 = net->Link[k].N2;
+        if (n1 > n || n2 > n) continue;
+        if (hyd->P[k] == 0.0 || hyd->LinkStatus[k] <= CLOSED) continue;
+        n1 = findroot(parent, n1);
+        n2 = findroot(parent, n2);
+        if (n1 < n2) parent[n2] = n1;
+        else if (n2 < n1) parent[n1] = n2;
+    }
+
+    // Number the zones in order of their first row
+    // (Failed is used to hold each root's zone number)
+    zn->Nzones = 0;
+    memset(zn->Failed, 0, (n + 1) * sizeof(int));
+    memset(zn->Start, 0, (n + 2) * sizeof(int));
+    for (r = 1; r <= n; r++)
+    {
+        i = findroot(parent, sm->Order[r]);
+        if (zn->Failed[i] == 0) zn->Failed[i] = ++zn->Nzones;
+        z = zn->Failed[i] - 1;
+        zn->Zone[r] = z;
+        zn->Start[z + 1]++;
+    }
+
+    // List the rows of each zone in ascending order
+    for (z = 1; z <= zn->Nzones; z++) zn->Start[z] += zn->Start[z - 1];
+    memset(zn->Failed, 0, (n + 1) * sizeof(int));
+    for (r = 1; r <= n; r++)
+    {
+        z = zn->Zone[r];
+        zn->Rows[zn->Start[z] + zn->Failed[z]] = r;
+        zn->Failed[z]++;
+    }
+    memset(zn->Failed, 0, (n + 1) * sizeof(int));
+}
+
+void cutzones(Project *pr)
+/*
+**--------------------------------------------------------------
+**  Input:   none
+**  Output:  none
+**  Purpose: moves the coupling through closed links that join
+**           different zones to the right hand side of the
+**           solution matrix.
+**--------------------------------------------------------------
+*/
+{
+    Network *net = &pr->network;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Szones  *zn = &hyd->zones;
+    int k, n1, n2, n = net->Njuncs;
+
+    for (k = 1; k <= net->Nlinks; k++)
+    {
+        n1 = net->Link[k].N1;
+        n2 = net->Link[k].N2;
+        if (n1 > n || n2 > n || hyd->P[k] == 0.0) continue;
+        if (zn->Zone[sm->Row[n1]] == zn->Zone[sm->Row[n2]]) continue;
+        sm->F[sm->Row[n1]] += hyd->P[k] * hyd->NodeHead[n2];
+        sm->F[sm->Row[n2]] += hyd->P[k] * hyd->NodeHead[n1];
+    }
+}
+
+void solvezone(void *data, int worker, int z)
+/*
+**--------------------------------------------------------------
+**  Input:   data = project being analyzed
+**           worker = index of worker thread
+**           z = index of zone
+**  Output:  none
+**  Purpose: solves the equations of a zone on a worker thread,
+**           or keeps its current heads if they balance its
+**           flows.
+**--------------------------------------------------------------
+*/
+{
+    Project *pr = (Project *)data;
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Szones  *zn = &hyd->zones;
+    int *rows = &zn->Rows[zn->Start[z]];
+    int m, nrows = zn->Start[z + 1] - zn->Start[z];
+
+    (void)worker;
+    zn->Failed[z] = 0;
+    zn->Skipped[z] = zonebalanced(pr, z);
+    if (zn->Skipped[z])
+    {
+        for (m = 0; m < nrows; m++)
+        {
+            sm->F[rows[m]] = hyd->NodeHead[sm->Order[rows[m]]];
+        }
+        return;
+    }
+    zn->Failed[z] = linfactorzone(sm, rows, nrows, zn->Zone);
+    if (zn->Failed[z] == 0) linsubstzone(sm, sm->F, rows, nrows, zn->Zone);
+}
+
+void factorzone(void *data, int worker, int z)
+/*
+**--------------------------------------------------------------
+**  Input:   data = project being analyzed
+**           worker = index of worker thread
+**           z = index of zone
+**  Output:  none
+**  Purpose: factors the block of a zone skipped on the last
+**           trial on a worker thread.
+**--------------------------------------------------------------
+*/
+{
+    Project *pr = (Project *)data;
+    Smatrix *sm = &pr->hydraul.smatrix;
+    Szones  *zn = &pr->hydraul.zones;
+    int nrows = zn->Start[z + 1] - zn->Start[z];
+
+    (void)worker;
+    if (!zn->Skipped[z]) return;
+    zn->Skipped[z] = FALSE;
+    zn->Failed[z] = linfactorzone(sm, &zn->Rows[zn->Start[z]], nrows,
+                                  zn->Zone);
+}
+
+int zonebalanced(Project *pr, int z)
+/*
+**--------------------------------------------------------------
+**  Input:   z = index of zone
+**  Output:  returns TRUE if the zone's current heads satisfy its
+**           linearized equations to within ZONETOL
+**  Purpose: checks if a zone has converged.
+**--------------------------------------------------------------
+*/
+{
+    Hydraul *hyd = &pr->hydraul;
+    Smatrix *sm = &hyd->smatrix;
+    Szones  *zn = &hyd->zones;
+    int *rows = &zn->Rows[zn->Start[z]];
+    int i, j, m, r, nrows = zn->Start[z + 1] - zn->Start[z];
+    double a, *res = sm->temp;
+
+    // Residual A*H - F of the zone's rows (held in the zone's
+    // rows of sm->temp)
+    for (m = 0; m < nrows; m++)
+    {
+        j = rows[m];
+        res[j] = sm->Aii[j] * hyd->NodeHead[sm->Order[j]] - sm->F[j];
+    }
+    for (m = 0; m < nrows; m++)
+    {
+        j = rows[m];
+        for (i = sm->XLNZ[j]; i < sm->XLNZ[j + 1]; i++)
+        {
+            r = sm->NZSUB[i];
+            if (zn->Zone[r] != z) continue;
+            a = sm->Aij[sm->LNZ[i]];
+            res[r] += a * hyd->NodeHead[sm->Order[j]];
+            res[j] += a * hyd->NodeHead[sm->Order[r]];
+        }
+    }
+    for (m = 0; m < nrows; m++)
+    {
+        if (ABS(res[rows[m]]) > ZONETOL) return FALSE;
+    }
+    return TRUE;
+}
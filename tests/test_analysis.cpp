@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -44,7 +44,7 @@ BOOST_FIXTURE_TEST_CASE(test_anlys_getoption, FixtureOpenClose)
     BOOST_CHECK_EQUAL_COLLECTIONS(ref.begin(), ref.end(), test.begin(), test.end());
 
     double temp;
-    error = EN_getoption(ph, 27, &temp);
+    error = EN_getoption(ph, 32, &temp);
     BOOST_CHECK(error == 251);
 }
 
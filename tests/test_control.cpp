@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -82,4 +82,83 @@ BOOST_FIXTURE_TEST_CASE(test_add_get_rule,  FixtureOpenClose)
     BOOST_CHECK(pump9_before - pump9_after == 2);
 }
 
+BOOST_FIXTURE_TEST_CASE(test_edit_rule_during_run,  FixtureOpenClose)
+{
+    int link11;
+    long t, tstep, tclosed = -1;
+    double status;
+    char R4[] = "RULE 4\nIF SYSTEM TIME >= 4\nTHEN LINK 11 STATUS = CLOSED";
+
+    error = EN_addrule(ph, R4);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getlinkindex(ph, (char *)"11", &link11);
+    BOOST_REQUIRE(error == 0);
+
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    do {
+        error = EN_runH(ph, &t);
+        BOOST_REQUIRE(error == 0);
+
+        // Delay the rule's time premise before it can fire
+        if (t == 7200)
+        {
+            error = EN_setpremisevalue(ph, 1, 1, 36000);
+            BOOST_REQUIRE(error == 0);
+        }
+
+        // Record when link 11 was closed by the rule
+        error = EN_getlinkvalue(ph, link11, EN_STATUS, &status);
+        BOOST_REQUIRE(error == 0);
+        if (status == EN_CLOSED && tclosed < 0) tclosed = t;
+
+        error = EN_nextH(ph, &tstep);
+        BOOST_REQUIRE(error == 0);
+    } while (tstep > 0);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+
+    BOOST_CHECK(tclosed == 36000);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_add_control_during_run,  FixtureOpenClose)
+{
+    int link11, index;
+    long t, tstep, tclosed = -1;
+    double status;
+
+    error = EN_getlinkindex(ph, (char *)"11", &link11);
+    BOOST_REQUIRE(error == 0);
+
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    do {
+        error = EN_runH(ph, &t);
+        BOOST_REQUIRE(error == 0);
+
+        // Add a timer control that closes link 11 between time steps
+        if (t == 7200)
+        {
+            error = EN_addcontrol(ph, EN_TIMER, link11, 0.0, 0, 19800.0, &index);
+            BOOST_REQUIRE(error == 0);
+        }
+
+        // Record when link 11 was closed by the control
+        error = EN_getlinkvalue(ph, link11, EN_STATUS, &status);
+        BOOST_REQUIRE(error == 0);
+        if (status == EN_CLOSED && tclosed < 0) tclosed = t;
+
+        error = EN_nextH(ph, &tstep);
+        BOOST_REQUIRE(error == 0);
+    } while (tstep > 0);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+
+    BOOST_CHECK(tclosed == 19800);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
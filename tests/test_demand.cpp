@@ -7,10 +7,11 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 08/02/2023
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
+#include <math.h>
 #include <boost/test/unit_test.hpp>
 
 #include "test_toolkit.hpp"
@@ -124,6 +125,45 @@ BOOST_FIXTURE_TEST_CASE(test_adddemand, FixtureSingleNode)
     BOOST_CHECK(nD1 - nD2 == 1);
 }
 
+BOOST_FIXTURE_TEST_CASE(test_edit_demand_during_run, FixtureOpenClose)
+{
+    int node11;
+    long t, tstep;
+    double base, demand;
+
+    error = EN_getnodeindex(ph, (char *)"11", &node11);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getbasedemand(ph, node11, 1, &base);
+    BOOST_REQUIRE(error == 0);
+
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+
+    // Double the base demand within the first pattern period
+    error = EN_runH(ph, &t);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodevalue(ph, node11, EN_DEMAND, &demand);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(fabs(demand - base) < 1.e-6);
+    error = EN_setbasedemand(ph, node11, 1, 2.0 * base);
+    BOOST_REQUIRE(error == 0);
+
+    // The new demand applies at the next time step of the same period
+    error = EN_nextH(ph, &tstep);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runH(ph, &t);
+    BOOST_REQUIRE(error == 0);
+    BOOST_REQUIRE(t == 3600);
+    error = EN_getnodevalue(ph, node11, EN_DEMAND, &demand);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(fabs(demand - 2.0 * base) < 1.e-6);
+
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+}
+
 BOOST_AUTO_TEST_CASE(test_cms_unit)
 {
     int flowType;
@@ -0,0 +1,145 @@
+/*
+******************************************************************************
+Project:      OWA EPANET
+Version:      2.3
+Module:       test_domains.cpp
+Description:  Tests solving a network's domains on separate MPI processes
+              (run with mpirun -np 2 or more)
+Authors:      see AUTHORS
+Copyright:    see AUTHORS
+License:      see LICENSE
+Last Updated: 10/18/2026
+******************************************************************************
+*/
+
+
+#define BOOST_TEST_MODULE domains
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include <boost/test/included/unit_test.hpp>
+
+// Only MPI's C interface is used
+#define OMPI_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX
+#include <mpi.h>
+
+#include "epanet2_2.h"
+
+
+#define NROWS 12
+#define NCOLS 10
+
+
+struct FixtureMPI {
+    FixtureMPI() { MPI_Init(NULL, NULL); }
+    ~FixtureMPI() { MPI_Finalize(); }
+};
+
+BOOST_GLOBAL_FIXTURE(FixtureMPI);
+
+
+// Builds a grid of pipes fed by a reservoir at one corner
+// and a tank at the opposite one
+static void build_grid(EN_Project ph)
+{
+    char id[32], id1[32], id2[32];
+    int  i, j, index;
+
+    for (i = 0; i < NROWS; i++)
+    {
+        for (j = 0; j < NCOLS; j++)
+        {
+            sprintf(id, "J%d_%d", i, j);
+            BOOST_REQUIRE(EN_addnode(ph, id, EN_JUNCTION, &index) == 0);
+            BOOST_REQUIRE(EN_setjuncdata(ph, index, 10.0 * ((i + j) % 3),
+                          5.0 + (i * NCOLS + j) % 7, "") == 0);
+        }
+    }
+    BOOST_REQUIRE(EN_addnode(ph, "R", EN_RESERVOIR, &index) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_ELEVATION, 200.0) == 0);
+    BOOST_REQUIRE(EN_addnode(ph, "T", EN_TANK, &index) == 0);
+    BOOST_REQUIRE(EN_settankdata(ph, index, 150.0, 10.0, 0.0, 20.0, 40.0,
+                  0.0, "") == 0);
+
+    for (i = 0; i < NROWS; i++)
+    {
+        for (j = 0; j < NCOLS; j++)
+        {
+            sprintf(id1, "J%d_%d", i, j);
+            if (j + 1 < NCOLS)
+            {
+                sprintf(id, "H%d_%d", i, j);
+                sprintf(id2, "J%d_%d", i, j + 1);
+                BOOST_REQUIRE(EN_addlink(ph, id, EN_PIPE, id1, id2, &index) == 0);
+                BOOST_REQUIRE(EN_setpipedata(ph, index, 1000.0, 8.0 + 2 * (i % 3),
+                              100.0, 0.0) == 0);
+            }
+            if (i + 1 < NROWS)
+            {
+                sprintf(id, "V%d_%d", i, j);
+                sprintf(id2, "J%d_%d", i + 1, j);
+                BOOST_REQUIRE(EN_addlink(ph, id, EN_PIPE, id1, id2, &index) == 0);
+                BOOST_REQUIRE(EN_setpipedata(ph, index, 800.0, 6.0 + 2 * (j % 4),
+                              120.0, 0.0) == 0);
+            }
+        }
+    }
+    BOOST_REQUIRE(EN_addlink(ph, "PR", EN_PIPE, "R", "J0_0", &index) == 0);
+    BOOST_REQUIRE(EN_setpipedata(ph, index, 500.0, 24.0, 120.0, 0.0) == 0);
+    sprintf(id2, "J%d_%d", NROWS - 1, NCOLS - 1);
+    BOOST_REQUIRE(EN_addlink(ph, "PT", EN_PIPE, "T", id2, &index) == 0);
+    BOOST_REQUIRE(EN_setpipedata(ph, index, 500.0, 12.0, 120.0, 0.0) == 0);
+}
+
+
+BOOST_AUTO_TEST_SUITE(test_domains)
+
+BOOST_AUTO_TEST_CASE(test_domain_heads)
+{
+    EN_Project ph, cp;
+    int i, n, nprocs;
+    double h, diff = 0.0, spread = 0.0;
+    double hmin, hmax;
+    std::vector<double> heads;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    BOOST_REQUIRE(nprocs >= 2);
+
+    // Solve the network with its domains on separate processes
+    EN_createproject(&ph);
+    BOOST_REQUIRE(EN_init(ph, "", "", EN_GPM, EN_HW) == 0);
+    build_grid(ph);
+    BOOST_REQUIRE(EN_solveH(ph) == 0);
+    BOOST_REQUIRE(EN_getcount(ph, EN_NODECOUNT, &n) == 0);
+    heads.resize(n + 1);
+    for (i = 1; i <= n; i++)
+    {
+        BOOST_REQUIRE(EN_getnodevalue(ph, i, EN_HEAD, &heads[i]) == 0);
+    }
+
+    // A clone solves its whole matrix on each process
+    EN_createproject(&cp);
+    BOOST_REQUIRE(EN_cloneproject(ph, cp, "", "") == 0);
+    BOOST_REQUIRE(EN_solveH(cp) == 0);
+    for (i = 1; i <= n; i++)
+    {
+        BOOST_REQUIRE(EN_getnodevalue(cp, i, EN_HEAD, &h) == 0);
+        diff = fmax(diff, fabs(h - heads[i]));
+
+        // Every process has the same heads
+        MPI_Allreduce(&heads[i], &hmin, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+        MPI_Allreduce(&heads[i], &hmax, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        spread = fmax(spread, hmax - hmin);
+    }
+    BOOST_CHECK(diff < 1.e-4);
+    BOOST_CHECK(spread == 0.0);
+
+    EN_deleteproject(cp);
+    EN_deleteproject(ph);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
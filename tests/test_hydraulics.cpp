@@ -7,10 +7,14 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
+#include <fstream>
+#include <sstream>
+#include <string>
+
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
 
@@ -81,4 +85,41 @@ BOOST_FIXTURE_TEST_CASE(test_hydr_usefile, FixtureOpenClose, * boost::unit_test:
     BOOST_REQUIRE(error == 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(test_hydr_memory, FixtureOpenClose)
+{
+    const char *files[] = {"test_memory1.hyd", "test_memory2.hyd", "test_memory3.hyd"};
+    // held in memory, moved to a file part way through & always in a file
+    double memory[] = {256.0, 0.001, 0.0};
+    std::string contents[3];
+    double value;
+    int i;
+
+    error = EN_getoption(ph, EN_HYDMEMORY, &value);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(value == 256.0);
+    error = EN_setoption(ph, EN_HYDMEMORY, -1.0);
+    BOOST_CHECK(error == 213);
+
+    // the saved hydraulics don't depend on where they were kept
+    for (i = 0; i < 3; i++)
+    {
+        error = EN_setoption(ph, EN_HYDMEMORY, memory[i]);
+        BOOST_REQUIRE(error == 0);
+        error = EN_solveH(ph);
+        BOOST_REQUIRE(error == 0);
+        error = EN_solveQ(ph);
+        BOOST_REQUIRE(error == 0);
+        error = EN_savehydfile(ph, files[i]);
+        BOOST_REQUIRE(error == 0);
+
+        std::ifstream f(files[i], std::ios::binary);
+        std::stringstream s;
+        s << f.rdbuf();
+        contents[i] = s.str();
+    }
+    BOOST_CHECK(contents[0].size() > 1024);
+    BOOST_CHECK(contents[0] == contents[1]);
+    BOOST_CHECK(contents[0] == contents[2]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
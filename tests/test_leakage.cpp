@@ -15,6 +15,7 @@
    Tests Pipe Leakage Feature
 */
 
+#include <math.h>
 #include <boost/test/unit_test.hpp>
 
 #include "test_toolkit.hpp"
@@ -7,11 +7,16 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
 #include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
@@ -116,6 +121,707 @@ BOOST_AUTO_TEST_CASE(test_run)
     EN_deleteproject(ph);
 }
 
+BOOST_FIXTURE_TEST_CASE(test_clone, FixtureOpenClose)
+{
+    int i, n, nnodes, nlinks;
+    double d, h1[12], h2[12];
+    EN_Project cp = NULL;
+
+    error = EN_createproject(&cp);
+    BOOST_REQUIRE(error == 0);
+    error = EN_cloneproject(ph, ph, "", "");
+    BOOST_CHECK(error == 251);
+    error = EN_cloneproject(ph, cp, "./test_clone.rpt", "");
+    BOOST_REQUIRE(error == 0);
+
+    // clone has the same network and produces the same results
+    error = EN_getcount(cp, EN_NODECOUNT, &nnodes);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(nnodes == 11);
+    error = EN_solveH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_solveH(cp);
+    BOOST_REQUIRE(error == 0);
+    for (i = 1; i <= nnodes; i++)
+    {
+        EN_getnodevalue(ph, i, EN_HEAD, &h1[i]);
+        EN_getnodevalue(cp, i, EN_HEAD, &h2[i]);
+        BOOST_CHECK(h1[i] == h2[i]);
+    }
+
+    // changes made to the clone are not seen by the parent
+    error = EN_setlinkvalue(cp, 1, EN_DIAMETER, 6.0);
+    BOOST_REQUIRE(error == 0);
+    error = EN_addnode(cp, "N1", EN_JUNCTION, &n);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getlinkvalue(ph, 1, EN_DIAMETER, &d);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(d == 18.0);
+    error = EN_getcount(ph, EN_NODECOUNT, &n);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(n == nnodes);
+
+    error = EN_deleteproject(cp);
+    BOOST_REQUIRE(error == 0);
+
+    // clone still runs after the project it was cloned from is deleted
+    EN_Project pp = NULL;
+    long t, tstep;
+    error = EN_createproject(&pp);
+    BOOST_REQUIRE(error == 0);
+    error = EN_open(pp, DATA_PATH_NET1, "./test_clone1.rpt", "");
+    BOOST_REQUIRE(error == 0);
+    error = EN_createproject(&cp);
+    BOOST_REQUIRE(error == 0);
+    error = EN_cloneproject(pp, cp, "./test_clone2.rpt", "");
+    BOOST_REQUIRE(error == 0);
+    error = EN_openH(cp);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(cp, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    error = EN_deleteproject(pp);
+    BOOST_REQUIRE(error == 0);
+    do {
+        error = EN_runH(cp, &t);
+        BOOST_REQUIRE(error == 0);
+        error = EN_nextH(cp, &tstep);
+        BOOST_REQUIRE(error == 0);
+    } while (tstep > 0);
+    error = EN_getcount(cp, EN_LINKCOUNT, &nlinks);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(nlinks == 13);
+    for (i = 1; i <= nnodes; i++)
+    {
+        EN_getnodevalue(cp, i, EN_HEAD, &h2[i]);
+        BOOST_CHECK(abs(h1[i] - h2[i]) < 1.e-5);
+    }
+    error = EN_closeH(cp);
+    BOOST_REQUIRE(error == 0);
+    error = EN_deleteproject(cp);
+    BOOST_REQUIRE(error == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_batch, FixtureOpenClose)
+{
+    std::string line;
+    int n = 0, index;
+    double d;
+
+    std::ofstream scn("./test_batch.scn");
+    scn << "; Net1 scenarios\n"
+        << "bigpipe  LINK   110  DIAMETER  24\n"
+        << "peak     OPTION DEMAND    1.5\n"
+        << "closed   LINK   12   STATUS    CLOSED\n"
+        << "peak     NODE   22   DEMAND    300\n"
+        << "short    OPTION DURATION  6\n"
+        << "bigpipe  LINK   111  DIAMETER  16\n";
+    scn.close();
+
+    error = EN_runbatch(ph, "./test_batch.scn", "./test_batch.sum", 3);
+    BOOST_REQUIRE(error == 0);
+
+    // summary has 2 heading lines and 1 line per scenario
+    std::ifstream sum("./test_batch.sum");
+    while (std::getline(sum, line)) n++;
+    sum.close();
+    BOOST_CHECK(n == 6);
+
+    // the base project is left unchanged
+    error = EN_getlinkindex(ph, (char *)"110", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getlinkvalue(ph, index, EN_DIAMETER, &d);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(d == 18.0);
+
+    // invalid scenario data & missing scenario file
+    scn.open("./test_batch.scn");
+    scn << "bad  NODE  22  COLOR  2\n";
+    scn.close();
+    error = EN_runbatch(ph, "./test_batch.scn", "./test_batch.sum", 2);
+    BOOST_CHECK(error == 266);
+    error = EN_runbatch(ph, "./no_such_file.scn", "./test_batch.sum", 2);
+    BOOST_CHECK(error == 310);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_qualbatch, FixtureOpenClose)
+{
+    std::vector<std::string> sum1, sum3;
+    std::string line, name, node, atime;
+    int i, n = 0, nnodes, code, reached = 0, nreached = -1;
+    long t, tleft;
+    double c, peak = 0.0, peakqual = -1.0;
+
+    std::ofstream scn("./test_qbatch.scn");
+    scn << "; Net1 contamination events\n"
+        << "source  10  SETPOINT  10\n"
+        << "pulse   22  MASS      500  2  1\n"
+        << "two     10  SETPOINT  5    0:30  2\n"
+        << "two     31  MASS      100\n";
+    scn.close();
+
+    // without a chemical analysis the contaminant is initially absent
+    error = EN_setqualtype(ph, EN_NONE, "", "", "");
+    BOOST_REQUIRE(error == 0);
+
+    // results don't depend on the number of threads used,
+    // though scenarios are listed in the order they complete
+    error = EN_runqualbatch(ph, "", "./test_qbatch.scn", "./test_qbatch1.sum", 1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runqualbatch(ph, "", "./test_qbatch.scn", "./test_qbatch3.sum", 3);
+    BOOST_REQUIRE(error == 0);
+
+    std::ifstream f1("./test_qbatch1.sum");
+    while (std::getline(f1, line))
+    {
+        sum1.push_back(line);
+        if (n++ < 2) continue;
+        std::istringstream s(line);
+        s >> name;
+        if (name == "source") s >> code >> nreached >> peakqual >> node >> atime;
+    }
+    f1.close();
+    std::ifstream f3("./test_qbatch3.sum");
+    while (std::getline(f3, line)) sum3.push_back(line);
+    f3.close();
+    std::sort(sum1.begin(), sum1.end());
+    std::sort(sum3.begin(), sum3.end());
+    BOOST_CHECK(sum1 == sum3);
+    BOOST_CHECK(n == 2 + 3);
+
+    // the "source" scenario matches a water quality run of the project
+    // that reads its hydraulics from file
+    error = EN_setqualtype(ph, EN_CHEM, "Chemical", "mg/L", "");
+    BOOST_REQUIRE(error == 0);
+    error = EN_getcount(ph, EN_NODECOUNT, &nnodes);
+    BOOST_REQUIRE(error == 0);
+    for (i = 1; i <= nnodes; i++)
+    {
+        error = EN_setnodevalue(ph, i, EN_INITQUAL, 0.0);
+        BOOST_REQUIRE(error == 0);
+    }
+    error = EN_getnodeindex(ph, (char *)"10", &i);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setnodevalue(ph, i, EN_SOURCETYPE, EN_SETPOINT);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setnodevalue(ph, i, EN_SOURCEQUAL, 10.0);
+    BOOST_REQUIRE(error == 0);
+    error = EN_solveH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_openQ(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initQ(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    std::vector<char> hit(nnodes + 1, 0);
+    do {
+        error = EN_runQ(ph, &t);
+        BOOST_REQUIRE(error == 0);
+        for (i = 1; i <= nnodes; i++)
+        {
+            error = EN_getnodevalue(ph, i, EN_QUALITY, &c);
+            BOOST_REQUIRE(error == 0);
+            if (c > 0.01 && !hit[i])
+            {
+                hit[i] = 1;
+                reached++;
+            }
+            if (c > peak) peak = c;
+        }
+        error = EN_stepQ(ph, &tleft);
+        BOOST_REQUIRE(error == 0);
+    } while (tleft > 0);
+    error = EN_closeQ(ph);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(nreached == reached);
+    BOOST_CHECK(abs(peakqual - peak) < 0.01);
+    BOOST_CHECK(node == "10");
+
+    // scenarios can also share a saved hydraulics file
+    error = EN_savehydfile(ph, "./test_qbatch.hyd");
+    BOOST_REQUIRE(error == 0);
+    error = EN_runqualbatch(ph, "./test_qbatch.hyd", "./test_qbatch.scn",
+                            "./test_qbatch1.sum", 2);
+    BOOST_CHECK(error == 0);
+    error = EN_runqualbatch(ph, "./no_such_file.hyd", "./test_qbatch.scn",
+                            "./test_qbatch1.sum", 2);
+    BOOST_CHECK(error == 305);
+
+    // invalid source type & unknown node
+    scn.open("./test_qbatch.scn");
+    scn << "bad  10  DYE  5\n";
+    scn.close();
+    error = EN_runqualbatch(ph, "", "./test_qbatch.scn", "./test_qbatch1.sum", 2);
+    BOOST_CHECK(error == 266);
+    scn.open("./test_qbatch.scn");
+    scn << "bad  99  MASS  5\n";
+    scn.close();
+    error = EN_runqualbatch(ph, "", "./test_qbatch.scn", "./test_qbatch1.sum", 2);
+    BOOST_CHECK(error == 203);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_backtrack, FixtureOpenClose)
+{
+    std::vector<std::string> res1, res3;
+    std::string line, sensor, atime, node;
+    int i, n = 0;
+    long t, tleft;
+    double impact, impact9 = -1.0, impact10 = -1.0, c, trace = -1.0;
+
+    std::ofstream sns("./test_bt.txt");
+    sns << "; Net1 sensor samples\n"
+        << "11  12\n"
+        << "32  20:00\n";
+    sns.close();
+
+    // results don't depend on the number of threads used,
+    // though samples are listed in the order they complete
+    error = EN_solveH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runbacktrack(ph, "", "./test_bt.txt", "./test_bt1.rpt", 1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runbacktrack(ph, "", "./test_bt.txt", "./test_bt3.rpt", 3);
+    BOOST_REQUIRE(error == 0);
+
+    std::ifstream f1("./test_bt1.rpt");
+    while (std::getline(f1, line))
+    {
+        res1.push_back(line);
+        if (n++ < 2) continue;
+        std::istringstream s(line);
+        s >> sensor >> atime >> node >> impact;
+        if (sensor == "11" && node == "9") impact9 = impact;
+        if (sensor == "32" && node == "10") impact10 = impact;
+    }
+    f1.close();
+    std::ifstream f3("./test_bt3.rpt");
+    while (std::getline(f3, line)) res3.push_back(line);
+    f3.close();
+    std::sort(res1.begin(), res1.end());
+    std::sort(res3.begin(), res3.end());
+    BOOST_CHECK(res1 == res3);
+
+    // all of the water at node 11 at noon came from the river
+    BOOST_CHECK(abs(impact9 - 100.0) < 0.01);
+
+    // node 10's impact on node 32 at 20:00 is close to what a
+    // trace analysis from node 10 finds there
+    error = EN_setqualtype(ph, EN_TRACE, "", "", "10");
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodeindex(ph, (char *)"32", &i);
+    BOOST_REQUIRE(error == 0);
+    error = EN_openQ(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initQ(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    do {
+        error = EN_runQ(ph, &t);
+        BOOST_REQUIRE(error == 0);
+        if (t == 20 * 3600)
+        {
+            error = EN_getnodevalue(ph, i, EN_QUALITY, &c);
+            BOOST_REQUIRE(error == 0);
+            trace = c;
+        }
+        error = EN_stepQ(ph, &tleft);
+        BOOST_REQUIRE(error == 0);
+    } while (tleft > 0);
+    error = EN_closeQ(ph);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(trace > 0.0);
+    BOOST_CHECK(abs(impact10 - trace) < 2.0);
+
+    // missing sensor file, unknown node & invalid time
+    error = EN_runbacktrack(ph, "", "./no_such_file.txt", "./test_bt1.rpt", 2);
+    BOOST_CHECK(error == 319);
+    sns.open("./test_bt.txt");
+    sns << "99  12\n";
+    sns.close();
+    error = EN_runbacktrack(ph, "", "./test_bt.txt", "./test_bt1.rpt", 2);
+    BOOST_CHECK(error == 203);
+    sns.open("./test_bt.txt");
+    sns << "11  noon\n";
+    sns.close();
+    error = EN_runbacktrack(ph, "", "./test_bt.txt", "./test_bt1.rpt", 2);
+    BOOST_CHECK(error == 271);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_montecarlo, FixtureOpenClose)
+{
+    std::string line, stats1, stats3;
+    int n = 0;
+
+    std::ofstream mc("./test_mc.txt");
+    mc << "REALIZATIONS  50\n"
+       << "SEED          7\n"
+       << "QUANTILES     0.05  0.5  0.95\n"
+       << "DEMAND        *    NORMAL      1.0  0.2\n"
+       << "DEMAND        22   UNIFORM     1.0  2.0\n"
+       << "ROUGHNESS     *    TRIANGULAR  0.8  1.0  1.1\n";
+    mc.close();
+
+    // results don't depend on the number of threads used
+    error = EN_runmontecarlo(ph, "./test_mc.txt", "./test_mc1.txt", 1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runmontecarlo(ph, "./test_mc.txt", "./test_mc3.txt", 3);
+    BOOST_REQUIRE(error == 0);
+
+    std::ifstream f1("./test_mc1.txt");
+    while (std::getline(f1, line))
+    {
+        stats1 += line + "\n";
+        n++;
+    }
+    f1.close();
+    std::ifstream f3("./test_mc3.txt");
+    while (std::getline(f3, line)) stats3 += line + "\n";
+    f3.close();
+    BOOST_CHECK(stats1 == stats3);
+    BOOST_CHECK(stats1.find("50 (0 failed") != std::string::npos);
+
+    // 3 heading lines, then 3 lines + 1 per node or link in each table
+    BOOST_CHECK(n == 3 + 3 + 11 + 3 + 13);
+
+    // invalid distribution
+    mc.open("./test_mc.txt");
+    mc << "DEMAND  *  GAMMA  1.0  0.2\n";
+    mc.close();
+    error = EN_runmontecarlo(ph, "./test_mc.txt", "./test_mc1.txt", 2);
+    BOOST_CHECK(error == 267);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fireflow, FixtureOpenClose)
+{
+    std::vector<double> flows1(11), flows2(11);
+    int i, index;
+    long t;
+    double demand, pressure;
+
+    // results don't depend on the number of threads used
+    error = EN_runfireflow(ph, 20.0, 0, "./test_ff1.txt", 1, flows1.data());
+    BOOST_REQUIRE(error == 0);
+    error = EN_runfireflow(ph, 20.0, 0, "./test_ff2.txt", 2, flows2.data());
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(flows1.begin(), flows1.end(),
+                                  flows2.begin(), flows2.end());
+    for (i = 0; i < 9; i++) BOOST_CHECK(flows1[i] > 0.0);
+    BOOST_CHECK(flows1[9] == 0.0 && flows1[10] == 0.0);
+
+    // drawing a junction's fire flow brings its pressure down to 20 psi
+    error = EN_getnodeindex(ph, (char *)"22", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodevalue(ph, index, EN_BASEDEMAND, &demand);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setnodevalue(ph, index, EN_BASEDEMAND, demand + flows1[index - 1]);
+    BOOST_REQUIRE(error == 0);
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runH(ph, &t);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodevalue(ph, index, EN_PRESSURE, &pressure);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(abs(pressure - 20.0) < 0.01);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+
+    // invalid residual pressure
+    error = EN_runfireflow(ph, -1.0, 0, "./test_ff1.txt", 1, NULL);
+    BOOST_CHECK(error == 202);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_criticality, FixtureOpenClose)
+{
+    std::vector<double> shortfalls1(13), shortfalls2(13);
+    std::vector<int> deficient1(13), deficient2(13);
+    int i, index, n = 0;
+    long t;
+    double pressure;
+
+    // results don't depend on the number of threads used
+    error = EN_runcriticality(ph, 110.0, 0, "./test_crit1.txt", 1,
+                              shortfalls1.data(), deficient1.data());
+    BOOST_REQUIRE(error == 0);
+    error = EN_runcriticality(ph, 110.0, 0, "./test_crit2.txt", 2,
+                              shortfalls2.data(), deficient2.data());
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(shortfalls1.begin(), shortfalls1.end(),
+                                  shortfalls2.begin(), shortfalls2.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(deficient1.begin(), deficient1.end(),
+                                  deficient2.begin(), deficient2.end());
+
+    // closing a link gives the same deficient junctions as a full
+    // simulation with the link closed
+    error = EN_getlinkindex(ph, (char *)"121", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setlinkvalue(ph, index, EN_INITSTATUS, EN_CLOSED);
+    BOOST_REQUIRE(error == 0);
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    error = EN_runH(ph, &t);
+    BOOST_REQUIRE(error == 0);
+    for (i = 1; i <= 9; i++)
+    {
+        error = EN_getnodevalue(ph, i, EN_PRESSURE, &pressure);
+        BOOST_REQUIRE(error == 0);
+        if (pressure < 110.0) n++;
+    }
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(n == 2);
+    BOOST_CHECK(deficient1[index - 1] == n);
+    BOOST_CHECK(shortfalls1[index - 1] > 0.0);
+
+    // invalid pressure target
+    error = EN_runcriticality(ph, -1.0, 0, "./test_crit1.txt", 1, NULL, NULL);
+    BOOST_CHECK(error == 202);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_sensitivity, FixtureOpenClose)
+{
+    std::vector<double> dh(11), dq(13), h1(11), h2(11), w(11), grad(11);
+    int i, index, index2;
+    long t;
+    double demand;
+
+    error = EN_setoption(ph, EN_ACCURACY, 1.e-8);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodeindex(ph, (char *)"22", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodeindex(ph, (char *)"12", &index2);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodevalue(ph, index, EN_BASEDEMAND, &demand);
+    BOOST_REQUIRE(error == 0);
+
+    // no solution to find sensitivities of yet
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getsensitivity(ph, EN_SENS_DEMAND, index, dh.data(), dq.data());
+    BOOST_CHECK(error == 109);
+
+    error = EN_runH(ph, &t);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getsensitivity(ph, EN_SENS_DEMAND, index, dh.data(), dq.data());
+    BOOST_REQUIRE(error == 0);
+
+    // the adjoint gradient of a node's head equals the head
+    // sensitivities found for each junction's demand
+    w[index2 - 1] = 1.0;
+    error = EN_getadjointgradient(ph, EN_SENS_DEMAND, w.data(), NULL, grad.data());
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(abs(grad[index - 1] - dh[index2 - 1]) < 1.e-8);
+
+    // re-solve with the demand changed
+    for (i = 0; i < 2; i++)
+    {
+        error = EN_setnodevalue(ph, index, EN_BASEDEMAND, demand + (i ? 1.0 : -1.0));
+        BOOST_REQUIRE(error == 0);
+        error = EN_initH(ph, EN_NOSAVE);
+        BOOST_REQUIRE(error == 0);
+        error = EN_runH(ph, &t);
+        BOOST_REQUIRE(error == 0);
+        for (int j = 1; j <= 11; j++)
+        {
+            error = EN_getnodevalue(ph, j, EN_HEAD, i ? &h2[j - 1] : &h1[j - 1]);
+            BOOST_REQUIRE(error == 0);
+        }
+    }
+
+    // head sensitivities match a finite difference of the two
+    // solutions (Net1's demand multiplier is 1 at time 0)
+    for (i = 0; i < 11; i++)
+    {
+        BOOST_CHECK(abs((h2[i] - h1[i]) / 2.0 - dh[i]) < 1.e-4);
+    }
+    BOOST_CHECK(dh[index - 1] < 0.0);
+    BOOST_CHECK(dh[9] == 0.0);
+
+    // invalid parameter
+    error = EN_getsensitivity(ph, 3, index, dh.data(), NULL);
+    BOOST_CHECK(error == 251);
+
+    // invalid link and junction indexes
+    error = EN_getsensitivity(ph, EN_SENS_ROUGHNESS, 0, dh.data(), NULL);
+    BOOST_CHECK(error == 204);
+    error = EN_getsensitivity(ph, EN_SENS_ROUGHNESS, 14, dh.data(), NULL);
+    BOOST_CHECK(error == 204);
+    error = EN_getsensitivity(ph, EN_SENS_DEMAND, 0, dh.data(), NULL);
+    BOOST_CHECK(error == 203);
+    error = EN_getnodeindex(ph, (char *)"2", &index2);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getsensitivity(ph, EN_SENS_DEMAND, index2, dh.data(), NULL);
+    BOOST_CHECK(error == 203);
+    error = EN_getsensitivity(ph, EN_SENS_EMITTER, index2, dh.data(), NULL);
+    BOOST_CHECK(error == 203);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_calibration, FixtureOpenClose)
+{
+    std::vector<double> roughness(13), demand(11), value(11);
+    int i, j, type, tank, index[] = {2, 5, 8};
+    long t, tstep;
+    double v, elev;
+    char id[EN_MAXID + 1];
+
+    for (i = 1; i <= 13; i++)
+    {
+        error = EN_getlinkvalue(ph, i, EN_ROUGHNESS, &roughness[i - 1]);
+        BOOST_REQUIRE(error == 0);
+    }
+    for (i = 1; i <= 11; i++)
+    {
+        error = EN_getnodevalue(ph, i, EN_BASEDEMAND, &demand[i - 1]);
+        BOOST_REQUIRE(error == 0);
+    }
+
+    // observe a simulation with rougher pipes and higher demands
+    std::ofstream cal("./test_cal.txt");
+    cal << "ROUGHNESS  pipes  *\nDEMAND  all  *\nLIMITS  all  0.5  2\n";
+    cal.close();
+    std::ofstream obs("./test_obs.csv");
+    obs << "Time,Type,ID,Value\n";
+    for (i = 1; i <= 13; i++)
+    {
+        error = EN_getlinktype(ph, i, &type);
+        BOOST_REQUIRE(error == 0);
+        if (type > EN_PIPE) continue;
+        error = EN_setlinkvalue(ph, i, EN_ROUGHNESS, 0.8 * roughness[i - 1]);
+        BOOST_REQUIRE(error == 0);
+    }
+    for (i = 1; i <= 9; i++)
+    {
+        error = EN_setnodevalue(ph, i, EN_BASEDEMAND, 1.2 * demand[i - 1]);
+        BOOST_REQUIRE(error == 0);
+    }
+    error = EN_getnodeindex(ph, (char *)"2", &tank);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getnodevalue(ph, tank, EN_ELEVATION, &elev);
+    BOOST_REQUIRE(error == 0);
+    error = EN_openH(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_initH(ph, EN_NOSAVE);
+    BOOST_REQUIRE(error == 0);
+    do {
+        error = EN_runH(ph, &t);
+        BOOST_REQUIRE(error == 0);
+        for (j = 0; j < 3 && t % 3600 == 0; j++)
+        {
+            error = EN_getnodevalue(ph, index[j], EN_PRESSURE, &v);
+            BOOST_REQUIRE(error == 0);
+            error = EN_getnodeid(ph, index[j], id);
+            BOOST_REQUIRE(error == 0);
+            obs << t / 3600 << ",PRESSURE," << id << "," << v << "\n";
+        }
+        if (t % 21600 == 0)
+        {
+            error = EN_getnodevalue(ph, tank, EN_HEAD, &v);
+            BOOST_REQUIRE(error == 0);
+            obs << t / 3600 << ",LEVEL,2," << v - elev << "\n";
+        }
+        error = EN_nextH(ph, &tstep);
+        BOOST_REQUIRE(error == 0);
+    } while (tstep > 0);
+    obs.close();
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+
+    // results don't depend on the number of threads used
+    for (i = 0; i < 2; i++)
+    {
+        for (j = 1; j <= 13; j++)
+        {
+            error = EN_setlinkvalue(ph, j, EN_ROUGHNESS, roughness[j - 1]);
+            BOOST_REQUIRE(error == 0);
+        }
+        for (j = 1; j <= 9; j++)
+        {
+            error = EN_setnodevalue(ph, j, EN_BASEDEMAND, demand[j - 1]);
+            BOOST_REQUIRE(error == 0);
+        }
+        error = EN_runcalibration(ph, "./test_cal.txt", "./test_obs.csv",
+                                  "./test_cal.rpt", i + 1);
+        BOOST_REQUIRE(error == 0);
+        for (j = 1; j <= 9; j++)
+        {
+            error = EN_getnodevalue(ph, j, EN_BASEDEMAND, &v);
+            BOOST_REQUIRE(error == 0);
+            if (i == 0) value[j - 1] = v;
+            else BOOST_CHECK(v == value[j - 1]);
+        }
+    }
+
+    // the calibration recovers the observed network's multipliers
+    BOOST_CHECK(abs(value[1] - 1.2 * demand[1]) < 1.e-3 * demand[1]);
+    error = EN_getlinkvalue(ph, 2, EN_ROUGHNESS, &v);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(abs(v - 0.8 * roughness[1]) < 1.e-3 * roughness[1]);
+
+    // a level observed at a junction is invalid
+    obs.open("./test_obs.csv");
+    obs << "0,LEVEL,11,10\n";
+    obs.close();
+    error = EN_runcalibration(ph, "./test_cal.txt", "./test_obs.csv", "", 1);
+    BOOST_CHECK(error == 269);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_zones, FixtureOpenClose)
+{
+    std::vector<double> head(11);
+    int i, j, index;
+    long t;
+    double v;
+
+    // split Net1 into a zone fed through a PRV and a zone
+    // that holds the pump and tank
+    error = EN_getlinkindex(ph, (char *)"112", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_deletelink(ph, index, EN_UNCONDITIONAL);
+    BOOST_REQUIRE(error == 0);
+    error = EN_addlink(ph, (char *)"V1", EN_PRV, (char *)"12", (char *)"22", &index);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setlinkvalue(ph, index, EN_INITSETTING, 60.0);
+    BOOST_REQUIRE(error == 0);
+    for (const char *id : {"111", "113"})
+    {
+        error = EN_getlinkindex(ph, (char *)id, &index);
+        BOOST_REQUIRE(error == 0);
+        error = EN_setlinkvalue(ph, index, EN_INITSTATUS, EN_CLOSED);
+        BOOST_REQUIRE(error == 0);
+    }
+
+    // the zones solved apart give the same heads as the whole network
+    for (i = 0; i < 2; i++)
+    {
+        error = EN_setoption(ph, EN_THREADS, i ? 2.0 : 1.0);
+        BOOST_REQUIRE(error == 0);
+        error = EN_openH(ph);
+        BOOST_REQUIRE(error == 0);
+        error = EN_initH(ph, EN_NOSAVE);
+        BOOST_REQUIRE(error == 0);
+        error = EN_runH(ph, &t);
+        BOOST_REQUIRE(error == 0);
+        for (j = 1; j <= 11; j++)
+        {
+            error = EN_getnodevalue(ph, j, EN_HEAD, &v);
+            BOOST_REQUIRE(error == 0);
+            if (i == 0) head[j - 1] = v;
+            else BOOST_CHECK(abs(v - head[j - 1]) < 1.e-4);
+        }
+        error = EN_closeH(ph);
+        BOOST_REQUIRE(error == 0);
+    }
+    error = EN_getoption(ph, EN_THREADS, &v);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(v == 2.0);
+    error = EN_setoption(ph, EN_THREADS, -1.0);
+    BOOST_CHECK(error == 213);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(test_proj_fixture)
@@ -158,7 +864,10 @@ BOOST_FIXTURE_TEST_CASE(test_getcount, FixtureOpenClose)
 
     BOOST_CHECK_EQUAL_COLLECTIONS(ref.begin(), ref.end(), test.begin(), test.end());
 
-	error = EN_getcount(ph, 7, &i);
+	error = EN_getcount(ph, EN_CONSTITCOUNT, &i);
+	BOOST_CHECK(error == 0 && i == 0);
+
+	error = EN_getcount(ph, 9, &i);
 	BOOST_CHECK(error == 251);
 }
 
@@ -7,15 +7,183 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
 #include <boost/test/unit_test.hpp>
 
 #include "test_toolkit.hpp"
 
 
+// Continues a step-by-step hydraulic & water quality simulation
+// to its end, summing the level and quality of tank 2 over time
+static int continue_run(EN_Project ph, double *sum)
+{
+    int error, tank2;
+    long t, tstep_h, tstep_q;
+    double level, qual;
+
+    *sum = 0.0;
+    error = EN_getnodeindex(ph, (char *)"2", &tank2);
+    while (!error)
+    {
+        error = EN_nextH(ph, &tstep_h);
+        if (!error) error = EN_nextQ(ph, &tstep_q);
+        if (error || tstep_h == 0) break;
+        error = EN_runH(ph, &t);
+        if (!error) error = EN_runQ(ph, &t);
+        if (!error) error = EN_getnodevalue(ph, tank2, EN_TANKLEVEL, &level);
+        if (!error) error = EN_getnodevalue(ph, tank2, EN_QUALITY, &qual);
+        *sum += level + qual;
+    }
+    return error;
+}
+
+
+// Builds a network whose hub feeds many parallel chains of junctions
+// that drain into a tank, so that each level of its sorted nodes is
+// wide enough to be routed by worker threads
+static void build_chains(EN_Project ph, int nchains, int nlinks)
+{
+    char id[32], id1[32], id2[32];
+    int  i, j, index;
+
+    BOOST_REQUIRE(EN_addnode(ph, (char *)"R", EN_RESERVOIR, &index) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_ELEVATION, 200.0) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_INITQUAL, 1.0) == 0);
+    BOOST_REQUIRE(EN_addnode(ph, (char *)"H", EN_JUNCTION, &index) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_SOURCETYPE, EN_SETPOINT) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_SOURCEQUAL, 2.0) == 0);
+    BOOST_REQUIRE(EN_addnode(ph, (char *)"T", EN_TANK, &index) == 0);
+    BOOST_REQUIRE(EN_settankdata(ph, index, 100.0, 10.0, 0.0, 20.0, 50.0,
+                  0.0, (char *)"") == 0);
+    BOOST_REQUIRE(EN_addlink(ph, (char *)"P", EN_PIPE, (char *)"R",
+                  (char *)"H", &index) == 0);
+    BOOST_REQUIRE(EN_setpipedata(ph, index, 100.0, 48.0, 120.0, 0.0) == 0);
+
+    for (i = 0; i < nchains; i++)
+    {
+        for (j = 1; j < nlinks; j++)
+        {
+            sprintf(id, "J%d_%d", i, j);
+            BOOST_REQUIRE(EN_addnode(ph, id, EN_JUNCTION, &index) == 0);
+            BOOST_REQUIRE(EN_setjuncdata(ph, index, 20.0 * (j % 2),
+                          1.0 + (i + j) % 5, (char *)"") == 0);
+        }
+        for (j = 0; j < nlinks; j++)
+        {
+            sprintf(id, "P%d_%d", i, j);
+            if (j == 0) strcpy(id1, "H");
+            else sprintf(id1, "J%d_%d", i, j);
+            if (j == nlinks - 1) strcpy(id2, "T");
+            else sprintf(id2, "J%d_%d", i, j + 1);
+            BOOST_REQUIRE(EN_addlink(ph, id, EN_PIPE, id1, id2, &index) == 0);
+            BOOST_REQUIRE(EN_setpipedata(ph, index, 200.0 + 100.0 * (i % 7),
+                          4.0 + 2.0 * (i % 3), 100.0, 0.0) == 0);
+            BOOST_REQUIRE(EN_setlinkvalue(ph, index, EN_KBULK, -0.5) == 0);
+        }
+    }
+}
+
+// Builds a grid of looped pipes fed by a reservoir at one corner and
+// a tank at the opposite one, whose demands follow two patterns that
+// reverse the flow in some of its pipes from hour to hour
+static void build_grid(EN_Project ph, int nrows, int ncols)
+{
+    char id[32], id1[32], id2[32];
+    int  i, j, index;
+    double mult1[] = {0.5, 1.5, 1.0, 0.2, 1.8, 1.0};
+    double mult2[] = {1.6, 0.3, 1.0, 1.9, 0.4, 0.8};
+
+    BOOST_REQUIRE(EN_addpattern(ph, (char *)"1") == 0);
+    BOOST_REQUIRE(EN_setpattern(ph, 1, mult1, 6) == 0);
+    BOOST_REQUIRE(EN_addpattern(ph, (char *)"2") == 0);
+    BOOST_REQUIRE(EN_setpattern(ph, 2, mult2, 6) == 0);
+    for (i = 0; i < nrows; i++)
+    {
+        for (j = 0; j < ncols; j++)
+        {
+            sprintf(id, "J%d_%d", i, j);
+            BOOST_REQUIRE(EN_addnode(ph, id, EN_JUNCTION, &index) == 0);
+            BOOST_REQUIRE(EN_setjuncdata(ph, index, 10.0 * ((i + j) % 3),
+                          5.0 + (i * ncols + j) % 7,
+                          (char *)((i + j) % 2 ? "1" : "2")) == 0);
+        }
+    }
+    BOOST_REQUIRE(EN_addnode(ph, (char *)"R", EN_RESERVOIR, &index) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_ELEVATION, 200.0) == 0);
+    BOOST_REQUIRE(EN_setnodevalue(ph, index, EN_INITQUAL, 1.0) == 0);
+    BOOST_REQUIRE(EN_addnode(ph, (char *)"T", EN_TANK, &index) == 0);
+    BOOST_REQUIRE(EN_settankdata(ph, index, 150.0, 10.0, 0.0, 20.0, 40.0,
+                  0.0, (char *)"") == 0);
+
+    for (i = 0; i < nrows; i++)
+    {
+        for (j = 0; j < ncols; j++)
+        {
+            sprintf(id1, "J%d_%d", i, j);
+            if (j + 1 < ncols)
+            {
+                sprintf(id, "H%d_%d", i, j);
+                sprintf(id2, "J%d_%d", i, j + 1);
+                BOOST_REQUIRE(EN_addlink(ph, id, EN_PIPE, id1, id2, &index) == 0);
+                BOOST_REQUIRE(EN_setpipedata(ph, index, 1000.0,
+                              8.0 + 2 * (i % 3), 100.0, 0.0) == 0);
+            }
+            if (i + 1 < nrows)
+            {
+                sprintf(id, "V%d_%d", i, j);
+                sprintf(id2, "J%d_%d", i + 1, j);
+                BOOST_REQUIRE(EN_addlink(ph, id, EN_PIPE, id1, id2, &index) == 0);
+                BOOST_REQUIRE(EN_setpipedata(ph, index, 800.0,
+                              6.0 + 2 * (j % 4), 120.0, 0.0) == 0);
+            }
+        }
+    }
+    BOOST_REQUIRE(EN_addlink(ph, (char *)"PR", EN_PIPE, (char *)"R",
+                  (char *)"J0_0", &index) == 0);
+    BOOST_REQUIRE(EN_setpipedata(ph, index, 500.0, 24.0, 120.0, 0.0) == 0);
+    sprintf(id2, "J%d_%d", nrows - 1, ncols - 1);
+    BOOST_REQUIRE(EN_addlink(ph, (char *)"PT", EN_PIPE, (char *)"T",
+                  id2, &index) == 0);
+    BOOST_REQUIRE(EN_setpipedata(ph, index, 500.0, 12.0, 120.0, 0.0) == 0);
+}
+
+// Runs a water quality analysis, saving the quality of each node
+// after each time step and the final mass balance ratio
+static void run_quality(EN_Project ph, std::vector<double> &quals,
+                        double *massbal)
+{
+    int i, n;
+    long t, tstep;
+    double c;
+
+    quals.clear();
+    BOOST_REQUIRE(EN_getcount(ph, EN_NODECOUNT, &n) == 0);
+    BOOST_REQUIRE(EN_solveH(ph) == 0);
+    BOOST_REQUIRE(EN_openQ(ph) == 0);
+    BOOST_REQUIRE(EN_initQ(ph, EN_NOSAVE) == 0);
+    do
+    {
+        BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+        for (i = 1; i <= n; i++)
+        {
+            BOOST_REQUIRE(EN_getnodevalue(ph, i, EN_QUALITY, &c) == 0);
+            quals.push_back(c);
+        }
+        BOOST_REQUIRE(EN_nextQ(ph, &tstep) == 0);
+    } while (tstep > 0);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_MASSBALANCE, massbal) == 0);
+    BOOST_REQUIRE(EN_closeQ(ph) == 0);
+}
+
+
 BOOST_AUTO_TEST_SUITE (test_quality)
 
 BOOST_FIXTURE_TEST_CASE(test_solveQ, FixtureOpenClose)
@@ -97,4 +265,469 @@ BOOST_FIXTURE_TEST_CASE(test_progressive_step, FixtureOpenClose)
 
 }
 
+// Opens a project's hydraulic & water quality solvers and runs them to
+// 12:00, saving the simulation's state there
+static void run_to_noon(EN_Project ph, std::vector<char> &state)
+{
+    long t, tstep, size;
+
+    BOOST_REQUIRE(EN_openH(ph) == 0);
+    BOOST_REQUIRE(EN_initH(ph, EN_NOSAVE) == 0);
+    BOOST_REQUIRE(EN_openQ(ph) == 0);
+    BOOST_REQUIRE(EN_initQ(ph, EN_NOSAVE) == 0);
+    for (;;) {
+        BOOST_REQUIRE(EN_runH(ph, &t) == 0);
+        BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+        if (t == 43200) break;
+        BOOST_REQUIRE(EN_nextH(ph, &tstep) == 0);
+        BOOST_REQUIRE(EN_nextQ(ph, &tstep) == 0);
+    }
+    BOOST_REQUIRE(EN_getstatesize(ph, &size) == 0);
+    state.resize(size);
+    BOOST_REQUIRE(EN_savestate(ph, &state[0], size) == 0);
+}
+
+// Restores a state saved by run_to_noon into a second project built
+// from Net1 with the same quality time step and Courant number and
+// finishes its run
+static void finish_restored(std::vector<char> &state, double qualstep,
+                            double courant, double *sum, double *steps)
+{
+    EN_Project ph2 = NULL;
+
+    BOOST_REQUIRE(EN_createproject(&ph2) == 0);
+    BOOST_REQUIRE(EN_open(ph2, DATA_PATH_NET1, "", "") == 0);
+    BOOST_REQUIRE(EN_setstatusreport(ph2, EN_NO_REPORT) == 0);
+    BOOST_REQUIRE(EN_settimeparam(ph2, EN_QUALSTEP, (long)qualstep) == 0);
+    BOOST_REQUIRE(EN_setoption(ph2, EN_COURANT, courant) == 0);
+    BOOST_REQUIRE(EN_openH(ph2) == 0);
+    BOOST_REQUIRE(EN_initH(ph2, EN_NOSAVE) == 0);
+    BOOST_REQUIRE(EN_openQ(ph2) == 0);
+    BOOST_REQUIRE(EN_initQ(ph2, EN_NOSAVE) == 0);
+    BOOST_REQUIRE(EN_restorestate(ph2, &state[0], (long)state.size()) == 0);
+    BOOST_REQUIRE(continue_run(ph2, sum) == 0);
+    BOOST_REQUIRE(EN_getstatistic(ph2, EN_QUALSTEPS, steps) == 0);
+    BOOST_REQUIRE(EN_closeQ(ph2) == 0);
+    BOOST_REQUIRE(EN_closeH(ph2) == 0);
+    BOOST_REQUIRE(EN_close(ph2) == 0);
+    EN_deleteproject(ph2);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_save_restore_state, FixtureOpenClose)
+{
+    long qualstep;
+    double sum1, sum2, sum3, steps1, steps3;
+    std::vector<char> state;
+
+    // Run to 12:00 and save the simulation's state
+    run_to_noon(ph, state);
+
+    // Finish the run, then restore the state and finish it again
+    error = continue_run(ph, &sum1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_restorestate(ph, &state[0], (long)state.size());
+    BOOST_REQUIRE(error == 0);
+    error = continue_run(ph, &sum2);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(sum1 == sum2);
+
+    // An incomplete state can't be restored
+    error = EN_restorestate(ph, &state[0], (long)state.size() - 1);
+    BOOST_CHECK(error == 265);
+
+    error = EN_closeQ(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+
+    // Restore the state into a second project and finish its run
+    error = EN_gettimeparam(ph, EN_QUALSTEP, &qualstep);
+    BOOST_REQUIRE(error == 0);
+    finish_restored(state, (double)qualstep, 0.0, &sum3, &steps3);
+    BOOST_CHECK(sum1 == sum3);
+
+    // With adaptive quality steps the restored run keeps the saved
+    // run's current quality step and its statistics
+    error = EN_settimeparam(ph, EN_QUALSTEP, 60);
+    BOOST_REQUIRE(error == 0);
+    error = EN_setoption(ph, EN_COURANT, 0.1);
+    BOOST_REQUIRE(error == 0);
+    run_to_noon(ph, state);
+    error = continue_run(ph, &sum1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_getstatistic(ph, EN_QUALSTEPS, &steps1);
+    BOOST_REQUIRE(error == 0);
+    error = EN_closeQ(ph);
+    BOOST_REQUIRE(error == 0);
+    error = EN_closeH(ph);
+    BOOST_REQUIRE(error == 0);
+    finish_restored(state, 60.0, 0.1, &sum3, &steps3);
+    BOOST_CHECK(sum1 == sum3);
+    BOOST_CHECK(steps1 == steps3);
+}
+
+// Runs a step-by-step hydraulic & water quality analysis, saving the
+// quality of each node after each time step and the final mass balance
+// ratio (restoring the state after each step when asked to)
+static void run_restored(EN_Project ph, int restore, std::vector<double> &quals,
+                         double *massbal)
+{
+    int i, n;
+    long t, tstep_h, tstep_q, size;
+    double c;
+    std::vector<char> state;
+
+    quals.clear();
+    BOOST_REQUIRE(EN_getcount(ph, EN_NODECOUNT, &n) == 0);
+    BOOST_REQUIRE(EN_openH(ph) == 0);
+    BOOST_REQUIRE(EN_initH(ph, EN_NOSAVE) == 0);
+    BOOST_REQUIRE(EN_openQ(ph) == 0);
+    BOOST_REQUIRE(EN_initQ(ph, EN_NOSAVE) == 0);
+    do
+    {
+        BOOST_REQUIRE(EN_runH(ph, &t) == 0);
+        BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+        for (i = 1; i <= n; i++)
+        {
+            BOOST_REQUIRE(EN_getnodevalue(ph, i, EN_QUALITY, &c) == 0);
+            quals.push_back(c);
+        }
+        if (restore)
+        {
+            BOOST_REQUIRE(EN_getstatesize(ph, &size) == 0);
+            state.resize(size);
+            BOOST_REQUIRE(EN_savestate(ph, &state[0], size) == 0);
+            BOOST_REQUIRE(EN_restorestate(ph, &state[0], size) == 0);
+        }
+        BOOST_REQUIRE(EN_nextH(ph, &tstep_h) == 0);
+        BOOST_REQUIRE(EN_nextQ(ph, &tstep_q) == 0);
+    } while (tstep_h > 0);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_MASSBALANCE, massbal) == 0);
+    BOOST_REQUIRE(EN_closeQ(ph) == 0);
+    BOOST_REQUIRE(EN_closeH(ph) == 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_threaded_transport)
+{
+    int threads;
+    double massbal1, massbal2;
+    std::vector<double> quals1, quals2;
+    EN_Project ph;
+
+    // Route quality through the network serially and then with
+    // worker threads sharing out its wide levels of nodes
+    EN_createproject(&ph);
+    BOOST_REQUIRE(EN_init(ph, "", "", EN_GPM, EN_HW) == 0);
+    build_chains(ph, 300, 6);
+    BOOST_REQUIRE(EN_setqualtype(ph, EN_CHEM, (char *)"Chlorine",
+                  (char *)"mg/L", (char *)"") == 0);
+    BOOST_REQUIRE(EN_setoption(ph, EN_BULKORDER, 1.0) == 0);
+    BOOST_REQUIRE(EN_settimeparam(ph, EN_DURATION, 24 * 3600) == 0);
+    for (threads = 1; threads <= 3; threads += 2)
+    {
+        BOOST_REQUIRE(EN_setoption(ph, EN_THREADS, threads) == 0);
+        if (threads == 1) run_quality(ph, quals1, &massbal1);
+        else run_quality(ph, quals2, &massbal2);
+    }
+    EN_deleteproject(ph);
+
+    // Results don't depend on the number of threads
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    BOOST_CHECK(quals1 == quals2);
+    BOOST_CHECK(massbal1 == massbal2);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_constituents, FixtureOpenClose)
+{
+    int i, n, nnodes, type, node, index;
+    long t, tstep;
+    double trace, age, c, diff = 0.0, agemax = 0.0;
+
+    // Trace the flow from reservoir 9 both as the QUALITY option and
+    // as an added constituent that is routed along with water age
+    BOOST_REQUIRE(EN_setqualtype(ph, EN_TRACE, (char *)"", (char *)"",
+                  (char *)"9") == 0);
+    BOOST_REQUIRE(EN_addconstituent(ph, EN_AGE, (char *)"", &index) == 0);
+    BOOST_CHECK(index == 1);
+    BOOST_REQUIRE(EN_addconstituent(ph, EN_TRACE, (char *)"9", &index) == 0);
+    BOOST_CHECK(index == 2);
+    BOOST_CHECK(EN_addconstituent(ph, EN_TRACE, (char *)"X", &index) == 212);
+    BOOST_REQUIRE(EN_getcount(ph, EN_CONSTITCOUNT, &n) == 0);
+    BOOST_CHECK(n == 2);
+    BOOST_REQUIRE(EN_getconstituent(ph, 2, &type, &node) == 0);
+    BOOST_REQUIRE(EN_getnodeindex(ph, (char *)"9", &i) == 0);
+    BOOST_CHECK(type == EN_TRACE && node == i);
+
+    // A traced node can't be deleted
+    BOOST_CHECK(EN_deletenode(ph, i, EN_UNCONDITIONAL) == 260);
+
+    // Added constituents start out at zero, so clear the initial
+    // quality that the QUALITY option's trace would otherwise use
+    BOOST_REQUIRE(EN_getcount(ph, EN_NODECOUNT, &nnodes) == 0);
+    for (i = 1; i <= nnodes; i++)
+    {
+        BOOST_REQUIRE(EN_setnodevalue(ph, i, EN_INITQUAL, 0.0) == 0);
+    }
+    BOOST_REQUIRE(EN_solveH(ph) == 0);
+    BOOST_REQUIRE(EN_openQ(ph) == 0);
+    BOOST_CHECK(EN_addconstituent(ph, EN_AGE, (char *)"", &index) == 262);
+    BOOST_REQUIRE(EN_initQ(ph, EN_SAVE) == 0);
+    do {
+        BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+        for (i = 1; i <= nnodes; i++)
+        {
+            BOOST_REQUIRE(EN_getnodevalue(ph, i, EN_QUALITY, &trace) == 0);
+            BOOST_REQUIRE(EN_getconstituentvalue(ph, 2, EN_NODE, i, &c) == 0);
+            diff = fmax(diff, fabs(c - trace));
+            BOOST_REQUIRE(EN_getconstituentvalue(ph, 1, EN_NODE, i, &age) == 0);
+            agemax = fmax(agemax, age - t / 3600.0);
+        }
+        BOOST_REQUIRE(EN_getconstituentvalue(ph, 1, EN_LINK, 1, &age) == 0);
+        BOOST_REQUIRE(EN_stepQ(ph, &tstep) == 0);
+    } while (tstep > 0);
+    BOOST_CHECK(EN_getconstituentvalue(ph, 3, EN_NODE, 1, &c) == 251);
+    BOOST_REQUIRE(EN_closeQ(ph) == 0);
+
+    // The added trace matches the QUALITY one and no water is older
+    // than the time simulated
+    BOOST_CHECK(diff < 1.e-6);
+    BOOST_CHECK(agemax < 1.e-6);
+    BOOST_REQUIRE(EN_report(ph) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_trace_matrix)
+{
+    int i, j, n, nnodes, nsources, sources[2];
+    long t, tstep;
+    double c, diff = 0.0;
+    std::vector<double> matrix, single;
+    EN_Project ph;
+    const char *ids[2] = {"9", "2"};
+
+    // Trace reservoir 9 and tank 2 in a single run
+    EN_createproject(&ph);
+    BOOST_REQUIRE(EN_open(ph, DATA_PATH_NET1, DATA_PATH_RPT, "") == 0);
+    BOOST_REQUIRE(EN_setqualtype(ph, EN_TRACE, (char *)"", (char *)"",
+                  (char *)ids[0]) == 0);
+    BOOST_REQUIRE(EN_addconstituent(ph, EN_TRACE, (char *)ids[1], &i) == 0);
+    BOOST_REQUIRE(EN_getcount(ph, EN_TRACECOUNT, &nsources) == 0);
+    BOOST_REQUIRE(nsources == 2);
+    BOOST_REQUIRE(EN_getcount(ph, EN_NODECOUNT, &nnodes) == 0);
+    for (i = 1; i <= nnodes; i++)
+    {
+        BOOST_REQUIRE(EN_setnodevalue(ph, i, EN_INITQUAL, 0.0) == 0);
+    }
+    BOOST_REQUIRE(EN_solveH(ph) == 0);
+    BOOST_REQUIRE(EN_openQ(ph) == 0);
+    BOOST_REQUIRE(EN_initQ(ph, EN_NOSAVE) == 0);
+    n = 0;
+    do {
+        BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+        matrix.resize((n + 1) * nnodes * nsources);
+        BOOST_REQUIRE(EN_gettracematrix(ph, sources,
+                      &matrix[n * nnodes * nsources]) == 0);
+        n++;
+        BOOST_REQUIRE(EN_stepQ(ph, &tstep) == 0);
+    } while (tstep > 0);
+    BOOST_REQUIRE(EN_closeQ(ph) == 0);
+    EN_close(ph);
+
+    // Compare each source's column with a run tracing it alone
+    for (j = 0; j < nsources; j++)
+    {
+        BOOST_REQUIRE(EN_open(ph, DATA_PATH_NET1, DATA_PATH_RPT, "") == 0);
+        BOOST_REQUIRE(EN_getnodeindex(ph, (char *)ids[j], &i) == 0);
+        BOOST_CHECK(sources[j] == i);
+        BOOST_REQUIRE(EN_setqualtype(ph, EN_TRACE, (char *)"", (char *)"",
+                      (char *)ids[j]) == 0);
+        for (i = 1; i <= nnodes; i++)
+        {
+            BOOST_REQUIRE(EN_setnodevalue(ph, i, EN_INITQUAL, 0.0) == 0);
+        }
+        BOOST_REQUIRE(EN_solveH(ph) == 0);
+        BOOST_REQUIRE(EN_openQ(ph) == 0);
+        BOOST_REQUIRE(EN_initQ(ph, EN_NOSAVE) == 0);
+        n = 0;
+        do {
+            BOOST_REQUIRE(EN_runQ(ph, &t) == 0);
+            for (i = 1; i <= nnodes; i++)
+            {
+                BOOST_REQUIRE(EN_getnodevalue(ph, i, EN_QUALITY, &c) == 0);
+                diff = fmax(diff, fabs(c / 100.0 -
+                       matrix[(n * nnodes + i - 1) * nsources + j]));
+            }
+            n++;
+            BOOST_REQUIRE(EN_stepQ(ph, &tstep) == 0);
+        } while (tstep > 0);
+        BOOST_REQUIRE(EN_closeQ(ph) == 0);
+        EN_close(ph);
+    }
+    EN_deleteproject(ph);
+
+    // Segments split on either source's tolerance, so contributions
+    // only agree to within that tolerance
+    BOOST_CHECK(diff < 1.e-3);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_first_order_kernel, FixtureOpenClose)
+{
+    size_t i;
+    double massbal1, massbal2, diff = 0.0;
+    std::vector<double> quals1, quals2;
+
+    // Net1's 1st-order bulk & wall decay is reacted by the pipe
+    // kernel, while an order a hair above 1 takes the general path
+    BOOST_REQUIRE(error == 0);
+    run_quality(ph, quals1, &massbal1);
+    BOOST_REQUIRE(EN_setoption(ph, EN_BULKORDER, 1.0 + 1.e-12) == 0);
+    run_quality(ph, quals2, &massbal2);
+
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    for (i = 0; i < quals1.size(); i++)
+    {
+        diff = fmax(diff, fabs(quals1[i] - quals2[i]));
+    }
+    BOOST_CHECK(diff < 1.e-6);
+    BOOST_CHECK(fabs(massbal1 - massbal2) < 1.e-6);
+}
+
+BOOST_AUTO_TEST_CASE(test_local_resort)
+{
+    size_t i;
+    double fullsorts, localsorts, diff = 0.0;
+    double massbal1, massbal2;
+    std::vector<double> quals1, quals2;
+    EN_Project ph;
+
+    EN_createproject(&ph);
+    BOOST_REQUIRE(EN_init(ph, "", "", EN_GPM, EN_HW) == 0);
+    build_grid(ph, 12, 10);
+    BOOST_REQUIRE(EN_setqualtype(ph, EN_CHEM, (char *)"Chlorine",
+                  (char *)"mg/L", (char *)"") == 0);
+    BOOST_REQUIRE(EN_settimeparam(ph, EN_DURATION, 48 * 3600) == 0);
+
+    // Flow reversals in a few pipes are repaired locally
+    run_restored(ph, 0, quals1, &massbal1);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_FULLSORTS, &fullsorts) == 0);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_LOCALSORTS, &localsorts) == 0);
+    BOOST_CHECK(fullsorts >= 1.0);
+    BOOST_CHECK(localsorts > 0.0);
+
+    // Restoring the state after each step has the nodes fully
+    // sorted whenever flow directions change
+    run_restored(ph, 1, quals2, &massbal2);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_LOCALSORTS, &localsorts) == 0);
+    BOOST_CHECK(localsorts == 0.0);
+    EN_deleteproject(ph);
+
+    // Both orders of the nodes give the same results
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    for (i = 0; i < quals1.size(); i++)
+    {
+        diff = fmax(diff, fabs(quals1[i] - quals2[i]));
+    }
+    BOOST_CHECK(diff < 1.e-9);
+    BOOST_CHECK(fabs(massbal1 - massbal2) < 1.e-9);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_eulerian_transport, FixtureOpenClose)
+{
+    size_t i;
+    double method, massbal1, massbal2, diff = 0.0;
+    std::vector<double> quals1, quals2;
+
+    BOOST_REQUIRE(error == 0);
+    BOOST_REQUIRE(EN_getoption(ph, EN_TRANSPORT, &method) == 0);
+    BOOST_CHECK(method == EN_LAGRANGIAN);
+    BOOST_CHECK(EN_setoption(ph, EN_TRANSPORT, 2) == 213);
+
+    // Route Net1's chlorine with moving segments and then with
+    // fixed cells in each pipe
+    run_quality(ph, quals1, &massbal1);
+    BOOST_REQUIRE(EN_setoption(ph, EN_TRANSPORT, EN_EULERIAN) == 0);
+    run_quality(ph, quals2, &massbal2);
+
+    // Both methods conserve mass and closely agree
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    for (i = 0; i < quals1.size(); i++)
+    {
+        diff = fmax(diff, fabs(quals1[i] - quals2[i]));
+    }
+    BOOST_CHECK(diff < 0.2);
+    BOOST_CHECK(fabs(massbal2 - 1.0) < 1.e-4);
+    BOOST_CHECK(fabs(massbal1 - massbal2) < 1.e-4);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_segment_budget, FixtureOpenClose)
+{
+    size_t i;
+    double peak1, peak2, mergeerror, massbal1, massbal2, diff = 0.0;
+    std::vector<double> quals1, quals2;
+
+    // Age Net1's water over 10 days with a short quality time step
+    BOOST_REQUIRE(error == 0);
+    BOOST_REQUIRE(EN_setqualtype(ph, EN_AGE, (char *)"", (char *)"",
+                  (char *)"") == 0);
+    BOOST_REQUIRE(EN_settimeparam(ph, EN_DURATION, 240 * 3600) == 0);
+    BOOST_REQUIRE(EN_settimeparam(ph, EN_QUALSTEP, 60) == 0);
+    run_quality(ph, quals1, &massbal1);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_PEAKSEGMENTS, &peak1) == 0);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_MERGEERROR, &mergeerror) == 0);
+    BOOST_CHECK(peak1 > 150.0);
+    BOOST_CHECK(mergeerror == 0.0);
+
+    // Repeat with a budget of 150 segments
+    BOOST_CHECK(EN_setoption(ph, EN_SEGBUDGET, -1.0) == 213);
+    BOOST_REQUIRE(EN_setoption(ph, EN_SEGBUDGET, 150.0) == 0);
+    run_quality(ph, quals2, &massbal2);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_PEAKSEGMENTS, &peak2) == 0);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_MERGEERROR, &mergeerror) == 0);
+    BOOST_CHECK(peak2 <= 150.0);
+    BOOST_CHECK(mergeerror > 0.0);
+    BOOST_CHECK(mergeerror < 1.0);
+
+    // Merged segments conserve mass & change ages by little
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    for (i = 0; i < quals1.size(); i++)
+    {
+        diff = fmax(diff, fabs(quals1[i] - quals2[i]));
+    }
+    BOOST_CHECK(diff < 1.0);
+    BOOST_CHECK(fabs(massbal1 - massbal2) < 1.e-6);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_adaptive_step, FixtureOpenClose)
+{
+    size_t i;
+    double courant, steps1, steps2, massbal1, massbal2, diff = 0.0;
+    std::vector<double> quals1, quals2;
+
+    // Route Net1's chlorine with a fixed 1 minute quality time step
+    BOOST_REQUIRE(error == 0);
+    BOOST_REQUIRE(EN_getoption(ph, EN_COURANT, &courant) == 0);
+    BOOST_CHECK(courant == 0.0);
+    BOOST_REQUIRE(EN_settimeparam(ph, EN_QUALSTEP, 60) == 0);
+    run_quality(ph, quals1, &massbal1);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_QUALSTEPS, &steps1) == 0);
+    BOOST_CHECK(steps1 >= 24 * 60);
+
+    // Repeat choosing the step of each hydraulic period from the
+    // pipes' travel time
+    BOOST_CHECK(EN_setoption(ph, EN_COURANT, -1.0) == 213);
+    BOOST_REQUIRE(EN_setoption(ph, EN_COURANT, 0.1) == 0);
+    run_quality(ph, quals2, &massbal2);
+    BOOST_REQUIRE(EN_getstatistic(ph, EN_QUALSTEPS, &steps2) == 0);
+
+    // Far fewer steps are taken and results stay close
+    BOOST_CHECK(steps2 < steps1 / 4);
+    BOOST_REQUIRE(quals1.size() == quals2.size());
+    for (i = 0; i < quals1.size(); i++)
+    {
+        diff = fmax(diff, fabs(quals1[i] - quals2[i]));
+    }
+    BOOST_CHECK(diff < 0.2);
+    BOOST_CHECK(fabs(massbal2 - 1.0) < 1.e-4);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
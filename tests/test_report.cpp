@@ -7,7 +7,7 @@
  Authors:      see AUTHORS
  Copyright:    see AUTHORS
  License:      see LICENSE
- Last Updated: 03/21/2019
+ Last Updated: 10/18/2026
  ******************************************************************************
 */
 
@@ -42,7 +42,11 @@ BOOST_FIXTURE_TEST_CASE(test_rprt_anlysstats, FixtureOpenClose)
     BOOST_CHECK(check_cdd_double(test, ref, 3));
 
     double temp;
-    error = EN_getstatistic(ph, 8, &temp);
+    error = EN_getstatistic(ph, EN_FULLSORTS, &temp);
+    BOOST_REQUIRE(error == 0);
+    BOOST_CHECK(temp >= 1.0);
+
+    error = EN_getstatistic(ph, 13, &temp);
     BOOST_CHECK(error == 251);
 }
 
@@ -23,9 +23,9 @@ Find /i "x86" < checkOS.tmp > StringCheck.tmp
 If %ERRORLEVEL% == 1 (
 	CALL "%SDK_PATH%bin\"SetEnv.cmd /x64 /release
 	rem : create epanet2.dll
-	cl -o epanet2.dll epanet.c epanet2.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c mempool.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c flowbalance.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /link /DLL
+	cl -o epanet2.dll epanet.c epanet2.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c schedule.c demands.c flowbalance.c snapshot.c clone.c workpool.c batch.c montecarlo.c basecase.c fireflow.c criticality.c sensitivity.c calibrate.c zones.c domains.c qualbatch.c backtrack.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /link /DLL
 	rem : create runepanet.exe
-	cl -o runepanet.exe epanet.c epanet2.c ..\run\main.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c mempool.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c flowbalance.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /I ..\src /link
+	cl -o runepanet.exe epanet.c epanet2.c ..\run\main.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c schedule.c demands.c flowbalance.c snapshot.c clone.c workpool.c batch.c montecarlo.c basecase.c fireflow.c criticality.c sensitivity.c calibrate.c zones.c domains.c qualbatch.c backtrack.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /I ..\src /link
 	md "%Build_PATH%"\64bit
 	move /y "%SRC_PATH%"\*.dll "%Build_PATH%"\64bit
 	move /y "%SRC_PATH%"\*.exe "%Build_PATH%"\64bit
@@ -37,9 +37,9 @@ rem : 32 bit with DEF
 CALL "%SDK_PATH%bin\"SetEnv.cmd /x86 /release
 echo "32 bit with epanet2.def mapping"
 rem : create epanet2.dll
-cl -o epanet2.dll epanet.c epanet2.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c mempool.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c flowbalance.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /link /DLL /def:..\include\epanet2.def /MAP
+cl -o epanet2.dll epanet.c epanet2.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c schedule.c demands.c flowbalance.c snapshot.c clone.c workpool.c batch.c montecarlo.c basecase.c fireflow.c criticality.c sensitivity.c calibrate.c zones.c domains.c qualbatch.c backtrack.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /link /DLL /def:..\include\epanet2.def /MAP
 rem : create runepanet.exe
-cl -o runepanet.exe epanet.c epanet2.c ..\run\main.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c mempool.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c flowbalance.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /I ..\src /link
+cl -o runepanet.exe epanet.c epanet2.c ..\run\main.c hash.c hydraul.c hydcoeffs.c hydstatus.c hydsolver.c inpfile.c input1.c input2.c input3.c output.c project.c quality.c qualroute.c qualreact.c report.c rules.c smatrix.c genmmd.c validate.c leakage.c schedule.c demands.c flowbalance.c snapshot.c clone.c workpool.c batch.c montecarlo.c basecase.c fireflow.c criticality.c sensitivity.c calibrate.c zones.c domains.c qualbatch.c backtrack.c /O2 /Depanet2_EXPORTS /I ..\include /I ..\run /I ..\src /link
 md "%Build_PATH%"\32bit
 move /y "%SRC_PATH%"\*.dll "%Build_PATH%"\32bit
 move /y "%SRC_PATH%"\*.exe "%Build_PATH%"\32bit